@@ -209,6 +209,9 @@ struct App : public OpenGLApplication
 		setupSquareCamera();
 	}
 
+	// En mode sur demande (--on-demand), la pyramide tourne et change de luminosité à chaque trame : on dessine donc toujours.
+	bool isAnimating() const override { return true; }
+
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
 	void drawFrame() override {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
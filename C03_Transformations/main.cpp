@@ -74,17 +74,17 @@ struct App : public OpenGLApplication
 		);
 
 		// Config de base.
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glEnable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.enable(GL_CULL_FACE);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		// Mettre des lignes assez visibles.
-		glEnable(GL_POINT_SMOOTH);
+		glState.enable(GL_POINT_SMOOTH);
 		glPointSize(3.0f);
 		glLineWidth(3.0f);
 		// La couleur de fond.
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		loadShaders();
 		initPyramid();
@@ -93,6 +93,9 @@ struct App : public OpenGLApplication
 		applyPerspective();
 	}
 
+	// En mode sur demande (--on-demand), le cube rouge et la pyramide tournent à chaque trame : on dessine donc toujours.
+	bool isAnimating() const override { return true; }
+
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
 	void drawFrame() override {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -366,7 +369,7 @@ struct App : public OpenGLApplication
 
 	void applyPerspective() {
 		// Calculer l'aspect de notre caméra à partir des dimensions de la fenêtre.
-		auto windowSize = window_.getSize();
+		auto windowSize = getWindowSize();
 		float aspect = (float)windowSize.x / windowSize.y;
 
 		projection.pushIdentity();
@@ -378,7 +381,7 @@ struct App : public OpenGLApplication
 
 	void applyOrtho() {
 		// Calculer l'aspect de notre caméra à partir des dimensions de la fenêtre.
-		auto windowSize = window_.getSize();
+		auto windowSize = getWindowSize();
 		float aspect = (float)windowSize.x / windowSize.y;
 
 		projection.pushIdentity();
@@ -65,12 +65,12 @@ struct App : public OpenGLApplication
 			"4 : Démo des modes de débordement." "\n"
 		);
 
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_CULL_FACE);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_CULL_FACE);
+		glState.enable(GL_BLEND);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		// On peut demander le nombre maximal d'unités de texture (les glActiveTexture). Le standard demande au moins 80.
 		GLint maxTexUnits = 0;
@@ -134,14 +134,14 @@ struct App : public OpenGLApplication
 			progCompositing.use();
 
 			// Lier la texture de carton à l'unité de texture 0.
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texBoxBG);
+			glState.activeTexture(GL_TEXTURE0);
+			glState.bindTexture(GL_TEXTURE_2D, texBoxBG);
 			// Lier la texture de texte à l'unité de texture 1.
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texBoxText);
+			glState.activeTexture(GL_TEXTURE1);
+			glState.bindTexture(GL_TEXTURE_2D, texBoxText);
 			// Lier la texture transparente à l'unité de texture 2.
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, texBlank);
+			glState.activeTexture(GL_TEXTURE2);
+			glState.bindTexture(GL_TEXTURE_2D, texBlank);
 
 			model.push(); {
 				progCompositing.setMat("model", model);
@@ -153,8 +153,8 @@ struct App : public OpenGLApplication
 			// Pour les autres modes, on applique simplement une texture.
 			progBasic.use();
 			// Lier la texture d'asphalte à l'unité de texture 0.
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, mode == 2 ? texAsphalt : texLevels);
+			glState.activeTexture(GL_TEXTURE0);
+			glState.bindTexture(GL_TEXTURE_2D, mode == 2 ? texAsphalt : texLevels);
 			model.push(); {
 				progCompositing.setMat("model", model);
 			} model.pop();
@@ -164,8 +164,8 @@ struct App : public OpenGLApplication
 			progBasic.use();
 
 			// Lier la texture de test à l'unité de texture 0.
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texTest);
+			glState.activeTexture(GL_TEXTURE0);
+			glState.bindTexture(GL_TEXTURE_2D, texTest);
 
 			// Appliquer une projection orthogonale et une caméra fixe.
 			projection.pushIdentity();
@@ -254,12 +254,12 @@ struct App : public OpenGLApplication
 		cubeBox.deleteObjects();
 		cubeRoad.deleteObjects();
 		quad.deleteObjects();
-		glDeleteTextures(1, &texBlank);
-		glDeleteTextures(1, &texBoxBG);
-		glDeleteTextures(1, &texBoxText);
-		glDeleteTextures(1, &texAsphalt);
-		glDeleteTextures(1, &texLevels);
-		glDeleteTextures(1, &texTest);
+		glState.deleteTextures(1, &texBlank);
+		glState.deleteTextures(1, &texBoxBG);
+		glState.deleteTextures(1, &texBoxText);
+		glState.deleteTextures(1, &texAsphalt);
+		glState.deleteTextures(1, &texLevels);
+		glState.deleteTextures(1, &texTest);
 		texBlank = texBoxBG = texBoxText = texAsphalt = texLevels = texTest = 0;
 		progBasic.deleteShaders();
 		progBasic.deleteProgram();
@@ -325,7 +325,7 @@ struct App : public OpenGLApplication
 		// Générer et lier un objet de texture. Ça ressemble un peu aux VBO.
 		GLuint texID = 0;
 		glGenTextures(1, &texID);
-		glBindTexture(GL_TEXTURE_2D, texID);
+		glState.bindTexture(GL_TEXTURE_2D, texID);
 		// Passer les données de l'image (un peu comme avec glBufferData). Il faut spécifier le format interne qui sera enregistré sur le GPU ainsi que celui dont est fait le tableau de données passé en paramètre.
 		glTexImage2D(
 			GL_TEXTURE_2D,
@@ -360,7 +360,7 @@ struct App : public OpenGLApplication
 		// Créer et lier l'objet de texture. Quand on fait des mipmap manuellement, il faut créer une seule texture à laquelle on passe une image différente pour chaque niveau de détail.
 		GLuint texID = 0;
 		glGenTextures(1, &texID);
-		glBindTexture(GL_TEXTURE_2D, texID);
+		glState.bindTexture(GL_TEXTURE_2D, texID);
 		// Pour chaque niveau de détails:
 		for (int i = 0; i < numLevels; i++) {
 			// Générer le nom de fichier (du beau C++20).
@@ -403,7 +403,7 @@ struct App : public OpenGLApplication
 
 	void applyPerspective() {
 		// Calculer l'aspect de notre caméra à partir des dimensions de la fenêtre.
-		auto windowSize = window_.getSize();
+		auto windowSize = getWindowSize();
 		float aspect = (float)windowSize.x / windowSize.y;
 
 		// Appliquer la perspective avec un champs de vision (FOV) vertical donné et avec un aspect correspondant à celui de la fenêtre.
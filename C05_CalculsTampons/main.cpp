@@ -3,6 +3,8 @@
 
 #include <array>
 #include <cmath>
+#include <deque>
+#include <future>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -16,6 +18,7 @@
 #include <inf2705/OpenGLApplication.hpp>
 #include <inf2705/Mesh.hpp>
 #include <inf2705/ShaderProgram.hpp>
+#include <inf2705/AsyncReadback.hpp>
 
 
 using namespace gl;
@@ -39,6 +42,21 @@ inline std::ostream& operator<< (std::ostream& out, const Buffers& buffers) {
 	);
 }
 
+// Un test dont les lectures de tampons sont encore en route vers le CPU.
+struct PendingTest
+{
+	std::string id;
+	Buffers frag;
+	Buffers init;
+	std::future<std::vector<vec4>> color;
+	std::future<std::vector<float>> z;
+	std::future<std::vector<uint8_t>> stencil;
+
+	bool isReady() const {
+		return ::isReady(color) and ::isReady(z) and ::isReady(stencil);
+	}
+};
+
 
 struct App : public OpenGLApplication
 {
@@ -46,6 +64,9 @@ struct App : public OpenGLApplication
 
 	ShaderProgram basicProg;
 
+	AsyncReadback readback;
+	std::deque<PendingTest> pendingTests;
+
 	// Appelée avant la première trame.
 	void init() override {
 		glPointSize(500.0f);
@@ -60,11 +81,18 @@ struct App : public OpenGLApplication
 
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
 	void drawFrame() override {
+		// Afficher les tests dont les résultats sont arrivés (une ou deux trames après la simulation).
+		readback.update();
+		printReadyTests();
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-		// Rouler la simulation une seule fois.
-		if (getCurrentFrameNumber() != 0)
+		// Rouler la simulation une seule fois. L'application est en mode sur demande : après la première trame, on ne dessine que pour recevoir les résultats en attente (ou sur un événement de la fenêtre). Une fois tout affiché, la boucle dort au lieu de vider et d'échanger les tampons 30 fois par seconde pour rien.
+		if (getCurrentFrameNumber() != 0) {
+			if (not pendingTests.empty())
+				requestRedraw();
 			return;
+		}
 
 		// Exemples pris d'un ancien examen (intra hiver 2018).
 
@@ -72,10 +100,10 @@ struct App : public OpenGLApplication
 			{0.2, {0.9, 0.7, 0.5, 0.3}, 0},
 			{0.6, {0.8, 0.8, 0.8, 0.8}, 0},
 			[]() {
-				glDisable(GL_STENCIL_TEST);
-				glEnable(GL_DEPTH_TEST);
-				glDepthFunc(GL_LEQUAL);
-				glDisable(GL_BLEND);
+				glState.disable(GL_STENCIL_TEST);
+				glState.enable(GL_DEPTH_TEST);
+				glState.depthFunc(GL_LEQUAL);
+				glState.disable(GL_BLEND);
 			}
 		);
 
@@ -83,10 +111,10 @@ struct App : public OpenGLApplication
 			{0.2, {0.9, 0.7, 0.5, 0.3}, 0},
 			{0.6, {0.8, 0.8, 0.8, 0.8}, 0},
 			[]() {
-				glDisable(GL_STENCIL_TEST);
-				glDisable(GL_DEPTH_TEST);
-				glDepthFunc(GL_GEQUAL);
-				glDisable(GL_BLEND);
+				glState.disable(GL_STENCIL_TEST);
+				glState.disable(GL_DEPTH_TEST);
+				glState.depthFunc(GL_GEQUAL);
+				glState.disable(GL_BLEND);
 			}
 		);
 
@@ -94,12 +122,12 @@ struct App : public OpenGLApplication
 			{0.2, {0.9, 0.7, 0.5, 0.3}, 0},
 			{0.6, {0.8, 0.8, 0.8, 0.8}, 1},
 			[]() {
-				glEnable(GL_STENCIL_TEST);
-				glStencilFunc(GL_GEQUAL, 2, 3);
-				glStencilOp(GL_REPLACE, GL_DECR, GL_KEEP);
-				glEnable(GL_DEPTH_TEST);
-				glDepthFunc(GL_LESS);
-				glDisable(GL_BLEND);
+				glState.enable(GL_STENCIL_TEST);
+				glState.stencilFunc(GL_GEQUAL, 2, 3);
+				glState.stencilOp(GL_REPLACE, GL_DECR, GL_KEEP);
+				glState.enable(GL_DEPTH_TEST);
+				glState.depthFunc(GL_LESS);
+				glState.disable(GL_BLEND);
 			}
 		);
 
@@ -107,12 +135,12 @@ struct App : public OpenGLApplication
 			{0.2, {0.9, 0.7, 0.5, 0.3}, 0},
 			{0.6, {0.8, 0.8, 0.8, 0.8}, 1},
 			[]() {
-				glEnable(GL_STENCIL_TEST);
-				glStencilFunc(GL_LESS, 2, 3);
-				glStencilOp(GL_REPLACE, GL_DECR, GL_KEEP);
-				glEnable(GL_DEPTH_TEST);
-				glDepthFunc(GL_GEQUAL);
-				glDisable(GL_BLEND);
+				glState.enable(GL_STENCIL_TEST);
+				glState.stencilFunc(GL_LESS, 2, 3);
+				glState.stencilOp(GL_REPLACE, GL_DECR, GL_KEEP);
+				glState.enable(GL_DEPTH_TEST);
+				glState.depthFunc(GL_GEQUAL);
+				glState.disable(GL_BLEND);
 			}
 		);
 
@@ -120,12 +148,12 @@ struct App : public OpenGLApplication
 			{0.2, {0.9, 0.7, 0.5, 0.3}, 0},
 			{0.6, {0.8, 0.8, 0.8, 0.8}, 1},
 			[]() {
-				glEnable(GL_STENCIL_TEST);
-				glStencilFunc(GL_GREATER, 2, 3);
-				glStencilOp(GL_REPLACE, GL_DECR, GL_KEEP);
-				glEnable(GL_DEPTH_TEST);
-				glDepthFunc(GL_EQUAL);
-				glDisable(GL_BLEND);
+				glState.enable(GL_STENCIL_TEST);
+				glState.stencilFunc(GL_GREATER, 2, 3);
+				glState.stencilOp(GL_REPLACE, GL_DECR, GL_KEEP);
+				glState.enable(GL_DEPTH_TEST);
+				glState.depthFunc(GL_EQUAL);
+				glState.disable(GL_BLEND);
 			}
 		);
 
@@ -133,11 +161,11 @@ struct App : public OpenGLApplication
 			{0.2, {0.9, 0.7, 0.5, 0.3}, 0},
 			{0.6, {0.8, 0.8, 0.8, 0.8}, 0},
 			[]() {
-				glDisable(GL_STENCIL_TEST);
-				glEnable(GL_DEPTH_TEST);
-				glDepthFunc(GL_LESS);
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_ONE, GL_ZERO);
+				glState.disable(GL_STENCIL_TEST);
+				glState.enable(GL_DEPTH_TEST);
+				glState.depthFunc(GL_LESS);
+				glState.enable(GL_BLEND);
+				glState.blendFunc(GL_ONE, GL_ZERO);
 			}
 		);
 
@@ -145,11 +173,11 @@ struct App : public OpenGLApplication
 			{0.2, {0.9, 0.7, 0.5, 0.3}, 0},
 			{0.6, {0.8, 0.8, 0.8, 0.8}, 0},
 			[]() {
-				glDisable(GL_STENCIL_TEST);
-				glEnable(GL_DEPTH_TEST);
-				glDepthFunc(GL_GREATER);
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				glState.disable(GL_STENCIL_TEST);
+				glState.enable(GL_DEPTH_TEST);
+				glState.depthFunc(GL_GREATER);
+				glState.enable(GL_BLEND);
+				glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			}
 		);
 
@@ -157,23 +185,33 @@ struct App : public OpenGLApplication
 			{0.2, {0.9, 0.7, 0.5, 0.3}, 0},
 			{0.6, {0.8, 0.8, 0.8, 0.8}, 0},
 			[]() {
-				glDisable(GL_STENCIL_TEST);
-				glEnable(GL_DEPTH_TEST);
-				glDepthFunc(GL_ALWAYS);
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+				glState.disable(GL_STENCIL_TEST);
+				glState.enable(GL_DEPTH_TEST);
+				glState.depthFunc(GL_ALWAYS);
+				glState.enable(GL_BLEND);
+				glState.blendFunc(GL_SRC_ALPHA, GL_ONE);
 			}
 		);
+
+		requestRedraw();
 	}
 
-	void runTest(const std::string& id, const Buffers& frag, const Buffers& init, std::function<void()> setup) {
-		// Afficher le nom du test
-		std::cout << id << ")" << "\n";
+	// Appelée lorsque la fenêtre se ferme.
+	void onClose() override {
+		// Ne pas perdre les résultats si on ferme la fenêtre avant qu'ils arrivent.
+		readback.waitAll();
+		printReadyTests();
+		readback.deleteObjects();
+		points.deleteObjects();
+		basicProg.deleteShaders();
+		basicProg.deleteProgram();
+	}
 
+	void runTest(const std::string& id, const Buffers& frag, const Buffers& init, std::function<void()> setup) {
 		// Changer les "clear values" des buffers pour les valeurs initiales voulues.
-		glClearColor(init.color.r, init.color.g, init.color.b, init.color.a);
-		glClearDepthf(init.z);
-		glClearStencil(init.stencil);
+		glState.clearColor(init.color.r, init.color.g, init.color.b, init.color.a);
+		glState.clearDepth(init.z);
+		glState.clearStencil(init.stencil);
 		// Faire le clear avec les valeurs précédentes. On va ainsi mettre les valeurs initiales qu'on veut dans les buffers.
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
@@ -189,35 +227,43 @@ struct App : public OpenGLApplication
 		// Dessiner un point au milieu de l'écran.
 		glPointSize(10.0f);
 		points.draw(GL_POINTS);
-		// Attendre que les opérations soient complétées.
-		glFinish();
-
-		// Lire les valeurs de buffers pour le fragment au milieu de l'écran.
-		Buffers result = {};
-		ivec2 middle = ivec2{getWindow().getSize().x, getWindow().getSize().y} / 2;
-		glReadPixels(middle.x, middle.y, 1, 1, GL_RGBA, GL_FLOAT, &result.color);
-		glReadPixels(middle.x, middle.y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &result.z);
-		glReadPixels(middle.x, middle.y, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &result.stencil);
-
-		// Afficher les buffers.
-		std::cout << "             Z  |    Color Buffer     | Stencil" << "\n"
-		          << "----------------+---------------------+----------" << "\n"
-		          << "  frag     " << frag << "\n"
-		          << "  init     " << init << "\n"
-		          << "  result   " << result << "\n"
-		          << std::endl;
+
+		// Demander les valeurs de buffers pour le fragment au milieu de l'écran. Pas besoin d'attendre que le point soit dessiné (avec glFinish) : les lectures sont mises en file après le dessin et copiées par le GPU dans des tampons intermédiaires. Le prochain test peut donc vider les tampons tout de suite.
+		ivec2 middle = ivec2{getWindowSize().x, getWindowSize().y} / 2;
+		PendingTest& test = pendingTests.emplace_back(id, frag, init);
+		test.color = readback.readPixels<vec4>(middle.x, middle.y, 1, 1, GL_RGBA, GL_FLOAT);
+		test.z = readback.readPixels<float>(middle.x, middle.y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT);
+		test.stencil = readback.readPixels<uint8_t>(middle.x, middle.y, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE);
+	}
+
+	// Afficher les tests terminés, dans l'ordre où ils ont été lancés.
+	void printReadyTests() {
+		while (not pendingTests.empty() and pendingTests.front().isReady()) {
+			PendingTest& test = pendingTests.front();
+			Buffers result = {test.z.get()[0], test.color.get()[0], test.stencil.get()[0]};
+
+			// Afficher le nom du test et les buffers.
+			std::cout << test.id << ")" << "\n"
+			          << "             Z  |    Color Buffer     | Stencil" << "\n"
+			          << "----------------+---------------------+----------" << "\n"
+			          << "  frag     " << test.frag << "\n"
+			          << "  init     " << test.init << "\n"
+			          << "  result   " << result << "\n"
+			          << std::endl;
+			pendingTests.pop_front();
+		}
 	}
 
 	void resetDefaultGLConfig() {
-		glStencilFunc(GL_ALWAYS, 0, 0xFF);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-		glDepthFunc(GL_LESS);
-		glDisable(GL_BLEND);
-		glDisable(GL_DEPTH_TEST);
-		glDisable(GL_STENCIL_TEST);
-		glClearColor(0, 0, 0, 0);
-		glClearDepthf(0);
-		glClearStencil(0);
+		glState.stencilFunc(GL_ALWAYS, 0, 0xFF);
+		glState.stencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		glState.depthFunc(GL_LESS);
+		glState.disable(GL_BLEND);
+		glState.disable(GL_DEPTH_TEST);
+		glState.disable(GL_STENCIL_TEST);
+		glState.clearColor(0, 0, 0, 0);
+		glState.clearDepth(0);
+		glState.clearStencil(0);
 	}
 
 	void loadShaders() {
@@ -234,6 +280,7 @@ int main(int argc, char* argv[]) {
 	settings.fps = 30;
 	settings.context.antiAliasingLevel = 0;
 	settings.videoMode = sf::VideoMode({200, 200});
+	settings.renderOnDemand = true;
 
 	App app;
 	app.run(argc, argv, "Exemple Semaine 5: Calculs de tampons", settings);
@@ -65,18 +65,18 @@ struct App : public OpenGLApplication
 		);
 
 		// Pas de cull
-		glDisable(GL_CULL_FACE);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.disable(GL_CULL_FACE);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		// Activer le test de profondeur.
-		glEnable(GL_DEPTH_TEST);
+		glState.enable(GL_DEPTH_TEST);
 		// Choisir la fonction de comparaison (GL_LESS par défaut)
-		glDepthFunc(GL_LESS);
+		glState.depthFunc(GL_LESS);
 		// Activer la fusion de couleur.
-		glEnable(GL_BLEND);
+		glState.enable(GL_BLEND);
 		// Choisir les facteurs de mélange.
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 		loadShaders();
 
@@ -120,7 +120,7 @@ struct App : public OpenGLApplication
 		// La façon la plus fiable d'afficher des objets semi transparents dans une scène est d'afficher les objets opaques en premier en activant l'écriture dans le tampon de profondeur. On affiche ensuite les objets translucides en appliquant le test de profondeur mais sans la modification du tampon pour ne pas que les objets transparents se cachent.
 
 		// Activer l'écriture dans le tampon de profondeur.
-		glDepthMask(GL_TRUE);
+		glState.depthMask(GL_TRUE);
 		// Lier la texture de plâtre
 		texDrywall.bindToTextureUnit(0);
 		// Positionner le paneau applati.
@@ -144,7 +144,7 @@ struct App : public OpenGLApplication
 		cube.draw();
 
 		// Désactiver l'écriture dans le tampon de profondeur. Le test de profondeur va quand même s'effectuer, mais le tampon ne sera pas modifié.
-		glDepthMask(GL_FALSE);
+		glState.depthMask(GL_FALSE);
 		// Lier la texture de vitre givrée.
 		texWindow.bindToTextureUnit(0);
 
@@ -171,7 +171,7 @@ struct App : public OpenGLApplication
 		}
 
 		// Réactiver l'écriture dans le tampon. Oui, c'est un peu redondant vu qu'on le fait au début de la fonction, mais c'est bon pour la paix d'esprit.
-		glDepthMask(GL_TRUE);
+		glState.depthMask(GL_TRUE);
 
 		// Malgré nos précautions, on observe quand même une aberration si on regarde le cube de vitre devant le carré de vitre. Ça donne l'impression que le carré est devant le cube. Il n'y a pas de façon magique de régler ce problème juste en manipulant le tampon de profondeur. Il faut soit changer l'ordre d'affichage (coûteux pour les scènes avec beaucoup d'objets) ou appliquer un algorithme plus avancé comme la transparence avec poids ou un tampon de profondeur auxiliaire. De nos jours, la tendance est certainement vers le ray-tracing (pas matière à INF2705) pour gérer les problèmes de transparence/réflexion/réfraction.
 	}
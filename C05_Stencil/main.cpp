@@ -3,6 +3,7 @@
 
 #include <array>
 #include <cmath>
+#include <format>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -19,6 +20,9 @@
 #include <inf2705/ShaderProgram.hpp>
 #include <inf2705/Texture.hpp>
 #include <inf2705/OrbitCamera.hpp>
+#include <inf2705/FrameGraph.hpp>
+#include <inf2705/GpuProfiler.hpp>
+#include <inf2705/DynamicResolution.hpp>
 
 
 using namespace gl;
@@ -39,6 +43,13 @@ struct App : public OpenGLApplication
 	Texture texScopeMask;
 
 	ShaderProgram basicProg;
+	FrameGraph frameGraph;
+	GpuProfiler gpuProfiler;
+
+	// La scène est rendue dans une cible plus petite que la fenêtre quand le GPU dépasse son budget, puis agrandie. Le réticule reste dessiné à la résolution de la fenêtre.
+	DynamicResolutionController dynamicResolution = DynamicResolutionSettings{.targetFrameMs = 1000.0f / 60};
+	Upscaler upscaler;
+	UpscaleFilter upscaleFilter = UpscaleFilter::EdgeAware;
 
 	TransformStack model = {"model"};
 	TransformStack view = {"view"};
@@ -65,20 +76,30 @@ struct App : public OpenGLApplication
 			"2 : wireframe à travers la lunette" "\n"
 			"3 : filtre négatif à travers la lunette" "\n"
 			"X et Z : zoom in/out dans la lunette" "\n"
+			"D : résolution dynamique" "\n"
+			"F : filtre d'agrandissement (bilinéaire ou adaptatif aux bords)" "\n"
 		);
 
 		// Config de base, pas de cull, lignes assez visibles.
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glDisable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glEnable(GL_POINT_SMOOTH);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.disable(GL_CULL_FACE);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.enable(GL_POINT_SMOOTH);
 		glPointSize(3.0f);
 		glLineWidth(3.0f);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		// Le négatif dans la lunette se fait avec un XOR (voir la passe « Négatif »).
+		glLogicOp(GL_XOR);
+
+		// L'état commun à toutes les passes du graphe de trame. Chaque passe ne précise que ce qui diffère.
+		frameGraph.setDefaultState({
+			.depthTest = true, .depthWrite = true, .stencilTest = false,
+			.colorWrite = true, .colorLogicOp = false, .faceCulling = false, .polygonMode = GL_FILL,
+		});
 
 		loadShaders();
+		upscaler.setup();
 
 		cube = Mesh::loadFromWavefrontFile("cube_box.obj")[0];
 		road = Mesh::loadFromWavefrontFile("cube_road.obj")[0];
@@ -116,8 +137,12 @@ struct App : public OpenGLApplication
 
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
 	void drawFrame() override {
-		// On efface maintenant aussi le tampon de pochoir (stencil).
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		// Le temps GPU de la trame d'il y a quelques trames décide de l'échelle de celle-ci.
+		gpuProfiler.beginFrame();
+		if (const GpuScopeStats* frameStats = gpuProfiler.getStats("Trame"); frameStats != nullptr and frameStats->numSamples > 0) {
+			if (dynamicResolution.update(frameStats->lastMs))
+				std::cout << std::format("Échelle de rendu {:.0f}% ({:.2f} ms)", dynamicResolution.getScale() * 100, frameStats->lastMs) << std::endl;
+		}
 
 		basicProg.use();
 
@@ -126,69 +151,108 @@ struct App : public OpenGLApplication
 		//    - Dessiner la scène alternative (avec grossissement, wireframe, négatif) en activant le test de stencil mais sans modifier le tampon de stencil. On teste pour la valeur 1 (celle écrite par le cercle blanc précédent).
 		//    - Dessiner la scène régulière en appliquant le test de stencil, mais en testant pour des 0.
 		//    - Dessiner le réticule (cercle avec croix) sans test de stencil, sans écriture ou test de profondeur, et sans matrices de visualisation ou de projection.
-
-		if (showingScope) {
-			// Désactiver l'écriture dans le tampon de couleur et activer l'écriture dans le tampon de stencil. De cette façon, on ne dessine rien à l'écran mais on crée un masque dans le stencil.
-			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-			// Écrire des 1 dans le stencil pour les fragments dessinés. Au départ, il n'y a que des 0 (fait par glClear).
-			glStencilFunc(GL_ALWAYS, 1, 0xFF);
-			glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-			// Désactiver le test de profondeur et l'écriture du tampon de profondeur.
-			glDisable(GL_DEPTH_TEST);
-			glDepthMask(GL_FALSE);
-			// Dessiner le masque.
-			drawScopeMask();
-			// Rétablir les états.
-			glDepthMask(GL_TRUE);
-			glEnable(GL_DEPTH_TEST);
-			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-
-			// Activer le test de stencil et ne pas écrire dans le tampon de stencil.
-			glEnable(GL_STENCIL_TEST);
-			glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-			// Tester pour des 1, ce qui a été mis dans le stencil par le cercle précédent.
-			glStencilFunc(GL_EQUAL, 1, 0xFF);
-			if (showingScopeWireframe)
-				// Si on veut du wireframe, changer pour GL_LINE.
-				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			// Dessiner la scène en appliquant une perspective plus mince (facteur scopeZoom).
-			projection.push();
-			applyPerspective(50 / scopeZoom);
-			drawScene();
-			// Rétablir la matrice de projection.
-			projection.pop();
-			basicProg.setMat(projection);
-			if (showingScopeWireframe)
-				// Rétablir à GL_FILL
-				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			if (showingScopeNegative) {
-				// Pour afficher en négatif, il faut activer les opérations logiques et choisir le XOR. A XOR 1 = ~A. Il faut ensuite dessiner encore le cercle blanc (donc des composantes avec tous les bits à 1) et le XOR va s'appliquer sur la scène dans la lunette. Ça donne le négatif de la couleur.
-				glLogicOp(GL_XOR);
-				glEnable(GL_COLOR_LOGIC_OP);
-				// Pour afficher par-dessus tout, il faut désactiver le test de profondeur.
-				glDisable(GL_DEPTH_TEST);
-				// Dessiner le cercle blanc de la lunette. Le test de stencil est toujours actif.
-				drawScopeMask();
-				glEnable(GL_DEPTH_TEST);
-				glDisable(GL_COLOR_LOGIC_OP);
-			}
-		}
+		// Chaque étape est une passe du graphe de trame avec son propre état. Le graphe applique l'état de chaque passe par-dessus l'état par défaut, donc on n'a plus à rétablir les états après chaque étape.
+
+		auto windowSize = getWindowSize();
+		frameGraph.reset({(int)windowSize.x, (int)windowSize.y});
+		auto backbuffer = frameGraph.getBackbuffer();
+		// Les tampons de la scène, à l'échelle choisie. L'échelle est arrondie à un pas de 1/16 et ne change pas souvent : le bassin du graphe garde les mêmes textures d'une trame à l'autre. On garde l'antialiasing de la fenêtre, et un tampon de profondeur avec stencil (GL_DEPTH24_STENCIL8) pour le masque.
+		ivec2 sceneSize = dynamicResolution.getRenderSize(frameGraph.getBackbufferSize());
+		int samples = std::max((int)getContextSettings().antiAliasingLevel, 1);
+		auto sceneColor = frameGraph.createTexture("Couleur scène", {sceneSize, GL_RGBA8});
+		auto sceneTarget = sceneColor;
+		if (samples > 1)
+			sceneTarget = frameGraph.createTexture("Couleur scène MSAA", {sceneSize, GL_RGBA8, samples});
+		auto sceneDepth = frameGraph.createTexture("Profondeur et stencil scène", {sceneSize, GL_DEPTH24_STENCIL8, samples});
+
+		// On efface maintenant aussi le tampon de pochoir (stencil). L'effacement est déclaré sur la première passe; si la lunette est cachée, le graphe le reporte à la passe de la scène.
+		frameGraph.addPass("Masque de la lunette")
+			.writeColor(sceneTarget, vec4(0.1f, 0.2f, 0.2f, 1.0f))
+			.writeDepth(sceneDepth, 1.0f, 0)
+			.setEnabled(showingScope)
+			.setState({
+				// Désactiver le test de profondeur et l'écriture du tampon de profondeur.
+				.depthTest = false, .depthWrite = false,
+				// Écrire des 1 dans le stencil pour les fragments dessinés. Au départ, il n'y a que des 0 (fait par glClear).
+				.stencilTest = true,
+				.stencilFunc = StencilFuncState{GL_ALWAYS, 1, 0xFF},
+				.stencilOp = StencilOpState{GL_KEEP, GL_KEEP, GL_REPLACE},
+				// Désactiver l'écriture dans le tampon de couleur. De cette façon, on ne dessine rien à l'écran mais on crée un masque dans le stencil.
+				.colorWrite = false,
+			})
+			.setExecute([&](FrameGraphPassContext&) { drawScopeMask(); });
+
+		// Dessiner la scène en appliquant une perspective plus mince (facteur scopeZoom).
+		frameGraph.addPass("Scène dans la lunette")
+			.writeColor(sceneTarget)
+			.writeDepth(sceneDepth)
+			.setEnabled(showingScope)
+			.setState({
+				// Activer le test de stencil et ne pas écrire dans le tampon de stencil. Tester pour des 1, ce qui a été mis dans le stencil par le cercle précédent.
+				.stencilTest = true,
+				.stencilFunc = StencilFuncState{GL_EQUAL, 1, 0xFF},
+				.stencilOp = StencilOpState{GL_KEEP, GL_KEEP, GL_KEEP},
+				// Si on veut du wireframe, GL_LINE.
+				.polygonMode = showingScopeWireframe ? GL_LINE : GL_FILL,
+			})
+			.setExecute([&](FrameGraphPassContext&) {
+				projection.push();
+				applyPerspective(50 / scopeZoom);
+				drawScene();
+				// Rétablir la matrice de projection.
+				projection.pop();
+				basicProg.setMat(projection);
+			});
+
+		// Pour afficher en négatif, on active les opérations logiques avec le XOR. A XOR 1 = ~A. On dessine encore le cercle blanc (donc des composantes avec tous les bits à 1) et le XOR va s'appliquer sur la scène dans la lunette. Ça donne le négatif de la couleur.
+		frameGraph.addPass("Négatif")
+			.writeColor(sceneTarget)
+			.writeDepth(sceneDepth)
+			.setEnabled(showingScope and showingScopeNegative)
+			.setState({
+				// Pour afficher par-dessus tout, il faut désactiver le test de profondeur. Le test de stencil est toujours actif.
+				.depthTest = false,
+				.stencilTest = true,
+				.stencilFunc = StencilFuncState{GL_EQUAL, 1, 0xFF},
+				.stencilOp = StencilOpState{GL_KEEP, GL_KEEP, GL_KEEP},
+				.colorLogicOp = true,
+			})
+			.setExecute([&](FrameGraphPassContext&) { drawScopeMask(); });
 
 		// Dessiner la scène normalement en testant pour des 0 dans le stencil.
-		glStencilFunc(GL_EQUAL, 0, 0xFF);
-		drawScene();
-
-		if (showingScope) {
-			// Afficher un overlay de réticule en désactivant le stencil et la profondeur.
-			glDisable(GL_STENCIL_TEST);
-			glDisable(GL_DEPTH_TEST);
-			glDepthMask(GL_FALSE);
-			drawCrosshairs();
-			// Rétablir l'état.
-			glDepthMask(GL_TRUE);
-			glEnable(GL_DEPTH_TEST);
-			glEnable(GL_STENCIL_TEST);
-		}
+		frameGraph.addPass("Scène")
+			.writeColor(sceneTarget)
+			.writeDepth(sceneDepth)
+			.setState({
+				.stencilTest = true,
+				.stencilFunc = StencilFuncState{GL_EQUAL, 0, 0xFF},
+				.stencilOp = StencilOpState{GL_KEEP, GL_KEEP, GL_KEEP},
+			})
+			.setExecute([&](FrameGraphPassContext&) { drawScene(); });
+
+		if (samples > 1)
+			frameGraph.addResolve("Résolution MSAA", sceneTarget, sceneColor);
+
+		// Agrandir la scène vers la fenêtre. Le triangle couvre tout l'écran, pas besoin d'effacer.
+		frameGraph.addPass("Mise à l'échelle")
+			.read(sceneColor)
+			.writeColor(backbuffer)
+			.setState({.depthTest = false, .depthWrite = false, .stencilTest = false})
+			.setExecute([&](FrameGraphPassContext& context) { upscaler.draw(context.getTexture(sceneColor), upscaleFilter); });
+
+		// Afficher un overlay de réticule en désactivant le stencil et la profondeur. Il est dessiné directement dans la fenêtre, donc toujours net peu importe l'échelle de la scène.
+		frameGraph.addPass("Réticule")
+			.writeColor(backbuffer)
+			.setEnabled(showingScope)
+			.setState({.depthTest = false, .depthWrite = false, .stencilTest = false})
+			.setExecute([&](FrameGraphPassContext&) { drawCrosshairs(); });
+
+		frameGraph.compile();
+		// Traiter les derniers mouvements de souris juste avant de dessiner : onMouseMove met à jour la matrice de vue (applyCamera) avec la position la plus récente de la souris.
+		latchInput();
+		gpuProfiler.begin("Trame");
+		frameGraph.execute();
+		gpuProfiler.end();
 	}
 
 	// Appelée lorsque la fenêtre se ferme.
@@ -203,6 +267,9 @@ struct App : public OpenGLApplication
 		texRoad.deleteObject();
 		texScopeReticle.deleteObject();
 		texScopeMask.deleteObject();
+		frameGraph.deleteObjects();
+		gpuProfiler.deleteObjects();
+		upscaler.deleteObjects();
 		basicProg.deleteShaders();
 		basicProg.deleteProgram();
 	}
@@ -221,6 +288,8 @@ struct App : public OpenGLApplication
 		// Touche 3 : Filtre négatif à travers la lunette
 		// Touche Z : Zoom out
 		// Touche X : Zoom in
+		// Touche D : Résolution dynamique
+		// Touche F : Filtre d'agrandissement
 		using enum sf::Keyboard::Key;
 		switch (key.code) {
 		case Num1:
@@ -239,6 +308,14 @@ struct App : public OpenGLApplication
 		case X:
 			scopeZoom += 1;
 			break;
+		case D:
+			dynamicResolution.setEnabled(not dynamicResolution.isEnabled());
+			std::cout << "Résolution dynamique " << (dynamicResolution.isEnabled() ? "ON" : "OFF") << std::endl;
+			break;
+		case F:
+			upscaleFilter = upscaleFilter == UpscaleFilter::Bilinear ? UpscaleFilter::EdgeAware : UpscaleFilter::Bilinear;
+			std::cout << "Filtre d'agrandissement " << (upscaleFilter == UpscaleFilter::Bilinear ? "bilinéaire" : "adaptatif aux bords") << std::endl;
+			break;
 
 		case F5:
 			std::string path = saveScreenshot();
@@ -20,6 +20,8 @@
 #include <inf2705/Texture.hpp>
 #include <inf2705/TransformStack.hpp>
 #include <inf2705/OrbitCamera.hpp>
+#include <inf2705/RenderQueue.hpp>
+#include <inf2705/FrameGraph.hpp>
 
 
 using namespace gl;
@@ -45,18 +47,25 @@ struct App : public OpenGLApplication
 	Texture texStencil;
 
 	ShaderProgram clipPlaneProg;
+	RenderQueue renderQueue;
+	FrameGraph frameGraph;
+	GpuProfiler gpuProfiler;
 
 	TransformStack model = {"model"};
 	TransformStack view = {"view"};
 	TransformStack projection = {"projection"};
 
 	OrbitCamera camera = {5, 30, 30, 0, {0, 2, 0}};
+	// L'animation avance dans update() à pas fixe. On garde l'angle du pas précédent et du pas courant pour dessiner l'angle interpolé entre les deux.
 	float teapotValue = 0;
+	float previousTeapotAngle = 0;
+	float currentTeapotAngle = 0;
 	float teapotAngle = 0;
 	vec3 mirrorPosition = {0, 3, -5};
 	bool showingStencil = false;
 	bool usingGlassTextured = true;
 	bool showingRegularScene = true;
+	bool reportingGpuTimes = false;
 	Uniform<vec4> clipPlane = {"clipPlane"};
 	Uniform<bool> clipEnabled = {"clipEnabled"};
 
@@ -75,14 +84,21 @@ struct App : public OpenGLApplication
 			"3 : activer/désactiver la texture de vitre du miroir." "\n"
 			"W et S : bouger le miroir en Z." "\n"
 			"A et D : bouger le miroir en X." "\n"
+			"P : activer/désactiver l'affichage périodique du temps GPU de chaque passe." "\n"
 		);
 
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glEnable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.enable(GL_CULL_FACE);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		// L'état commun à toutes les passes du graphe de trame. Chaque passe ne précise que ce qui diffère.
+		frameGraph.setDefaultState({
+			.depthTest = true, .depthWrite = true, .stencilTest = false,
+			.colorWrite = true, .faceCulling = true, .frontFace = GL_CCW,
+		});
+		// Chaque passe exécutée par le graphe est mesurée sous son nom.
+		frameGraph.setProfiler(&gpuProfiler);
 
 		loadShaders();
 
@@ -109,44 +125,81 @@ struct App : public OpenGLApplication
 		applyPerspective();
 	}
 
+	// Appelée à fréquence fixe avant les trames. Faire avancer l'angle de la théière d'un pas de temps.
+	void update(float dt) override {
+		previousTeapotAngle = currentTeapotAngle;
+		teapotValue += dt;
+		teapotValue = fmodf(teapotValue, 5.0f);
+		currentTeapotAngle = 20 * sin(teapotValue / 5 * 2*std::numbers::pi_v<float>);
+	}
+
+	// En mode sur demande (--on-demand), la théière bouge toujours : on dessine donc toutes les trames, et update() continue d'avancer.
+	bool isAnimating() const override { return true; }
+
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
-	void drawFrame() override {
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	void drawFrame(float alpha) override {
+		// Lire les temps GPU d'il y a quelques trames, puis mesurer toute la trame courante. Les passes du graphe sont imbriquées dans cette portée.
+		gpuProfiler.beginFrame();
+		GpuProfileScope frameScope(gpuProfiler, "Trame");
 
-		// Calculer l'angle de la théière selon le temps écoulé depuis la dernière trame.
-		teapotValue += getFrameDeltaTime();
-		teapotValue = fmodf(teapotValue, 5.0f);
-		teapotAngle = 20 * sin(teapotValue / 5 * 2*std::numbers::pi_v<float>);
+		// L'angle dessiné, interpolé entre les deux derniers pas de update().
+		teapotAngle = mix(previousTeapotAngle, currentTeapotAngle, alpha);
+
+		// Toutes les passes dessinent dans la fenêtre. Le graphe de trame s'occupe de l'état de chacune, donc pas besoin de rétablir le stencil ou l'ordre des faces entre les passes.
+		auto windowSize = getWindowSize();
+		frameGraph.reset({(int)windowSize.x, (int)windowSize.y});
+		auto backbuffer = frameGraph.getBackbuffer();
 
 		// Remplir le stencil avec le miroir (on veut des 1 pour tous les pixels du miroir, 0 partout ailleurs), mais sans rien dessiner concrètement. Pour y arriver, on configure le test de stencil pour qu'il ne passe jamais tout en remplissant le stencil de 1.
-		glEnable(GL_STENCIL_TEST);
-		// Le test ne passe jamais, donc les tampons de couleurs et de profondeur ne sont pas modifiés.
-		glStencilFunc(GL_NEVER, 1, 1);
-		// Pour chaque pixel du miroir, remplacer par la valeur de référence (1 dans notre cas).
-		glStencilOp(GL_REPLACE, GL_REPLACE, GL_REPLACE);
-		// On a déjà activé le culling pour le programme. Ça fait en sorte que la face arrière du miroir remplisse le stencil. Ça fait en sorte que la face arrière ne fait pas de réflexion. Ça simplifie le reste du code, car on n'a pas besoin de penser au plan de coupe pour les deux faces.
-		drawMirrorSurface();
+		// C'est la première passe, donc c'est elle qui efface les tampons de couleur, de profondeur et de stencil (en un seul glClear).
+		frameGraph.addPass("Stencil du miroir")
+			.writeColor(backbuffer, vec4(0.1f, 0.2f, 0.2f, 1.0f))
+			.writeDepth(backbuffer, 1.0f, 0)
+			.setState({
+				.stencilTest = true,
+				// Le test ne passe jamais, donc les tampons de couleurs et de profondeur ne sont pas modifiés.
+				.stencilFunc = StencilFuncState{GL_NEVER, 1, 1},
+				// Pour chaque pixel du miroir, remplacer par la valeur de référence (1 dans notre cas).
+				.stencilOp = StencilOpState{GL_REPLACE, GL_REPLACE, GL_REPLACE},
+			})
+			// On a déjà activé le culling pour le programme. Ça fait en sorte que la face arrière du miroir remplisse le stencil. Ça fait en sorte que la face arrière ne fait pas de réflexion. Ça simplifie le reste du code, car on n'a pas besoin de penser au plan de coupe pour les deux faces.
+			.setExecute([&](FrameGraphPassContext&) { drawMirrorSurface(); });
 
 		// Dessiner la scène réfléchie, mais seulement dans la région du miroir.
-		// Activer le test de stencil pour garder seulement ce qui est dans la zone du stencil égale à 1.
-		glStencilFunc(GL_EQUAL, 1, 1);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-		// Définir les faces avant en ordre horaire (donc l'inverse du mode usuel). En effet, la scène réfléchie est bel et bien un miroir, donc l'ordre relatif des sommets dessinés (horaire/anti-horaire) est aussi inversé.
-		glFrontFace(GL_CW);
-		drawReflectedScene();
-		if (showingStencil)
-			// À fin d'illustration, montrer la zone affectée par le stencil.
-			drawStencilZone();
-		// Rétablir l'ordre usuel des faces et désactiver le test de stencil.
-		glFrontFace(GL_CCW);
-		glDisable(GL_STENCIL_TEST);
+		frameGraph.addPass("Scène réfléchie")
+			.writeColor(backbuffer)
+			.writeDepth(backbuffer)
+			.setState({
+				// Activer le test de stencil pour garder seulement ce qui est dans la zone du stencil égale à 1.
+				.stencilTest = true,
+				.stencilFunc = StencilFuncState{GL_EQUAL, 1, 1},
+				.stencilOp = StencilOpState{GL_KEEP, GL_KEEP, GL_KEEP},
+				// Définir les faces avant en ordre horaire (donc l'inverse du mode usuel). En effet, la scène réfléchie est bel et bien un miroir, donc l'ordre relatif des sommets dessinés (horaire/anti-horaire) est aussi inversé.
+				.frontFace = GL_CW,
+			})
+			.setExecute([&](FrameGraphPassContext&) {
+				drawReflectedScene();
+				if (showingStencil)
+					// À fin d'illustration, montrer la zone affectée par le stencil.
+					drawStencilZone();
+			});
 
 		// Dessiner la surface du miroir comme une vitre. D'une part, ça identifie visuellement la surface en lui donnant une texture. D'autre part (plus important), ça met les bonnes valeurs en Z pour la surface. En effet, le tampon de profondeur est jusque là remplit avec les valeurs laissées par la scène réfléchie, alors que le miroir est supposé être un objet solide dans la scène. On dessine donc une surface plane (même si on lui donne une couleur entièrement transparente) pour remplir le z-buffer correctement avant de dessiner le reste de la scène normalement.
-		drawMirrorSurface();
+		// L'état par défaut rétablit l'ordre usuel des faces et désactive le test de stencil.
+		frameGraph.addPass("Surface du miroir")
+			.writeColor(backbuffer)
+			.writeDepth(backbuffer)
+			.setExecute([&](FrameGraphPassContext&) { drawMirrorSurface(); });
 
 		// Dessiner la scène normalement.
-		if (showingRegularScene)
-			drawScene();
+		frameGraph.addPass("Scène")
+			.writeColor(backbuffer)
+			.writeDepth(backbuffer)
+			.setEnabled(showingRegularScene)
+			.setExecute([&](FrameGraphPassContext&) { drawScene(); });
+
+		frameGraph.compile();
+		frameGraph.execute();
 	}
 
 	// Appelée lorsque la fenêtre se ferme.
@@ -155,6 +208,8 @@ struct App : public OpenGLApplication
 			mesh->deleteObjects();
 		for (auto tex : {&texSteel, &texRust, &texConcrete, &texBox, &texBuilding, &texRock, &texGlass, &texBlank, &texStencil})
 			tex->deleteObject();
+		frameGraph.deleteObjects();
+		gpuProfiler.deleteObjects();
 		clipPlaneProg.deleteShaders();
 		clipPlaneProg.deleteProgram();
 	}
@@ -196,6 +251,13 @@ struct App : public OpenGLApplication
 			mirrorPosition.x += 0.5;
 			break;
 
+		case P:
+			reportingGpuTimes ^= 1;
+			// Afficher les temps toutes les 120 trames (environ 2 secondes à 60 FPS).
+			gpuProfiler.setReportInterval(reportingGpuTimes ? 120 : 0);
+			std::cout << "Temps GPU " << (reportingGpuTimes ? "ON" : "OFF") << "\n";
+			break;
+
 		case F5:
 			std::string path = saveScreenshot();
 			std::cout << "Capture d'écran dans " << path << std::endl;
@@ -245,7 +307,7 @@ struct App : public OpenGLApplication
 		clipPlaneProg.use();
 
 		// Activer le plan de coupe et définir sa formule à partir de l'équation implicite du plan.
-		glEnable(GL_CLIP_PLANE0);
+		glState.enable(GL_CLIP_PLANE0);
 		clipEnabled = true;
 		clipPlane = {0, 0, -1, mirrorPosition.z};
 		// La distance au plan de coupe est calculée dans le nuanceur de sommets.
@@ -264,7 +326,7 @@ struct App : public OpenGLApplication
 		} model.pop();
 
 		// Désactiver le plan de coupe, on n'en veut pas pour le dessin autre que la scène réfléchie.
-		glDisable(GL_CLIP_PLANE0);
+		glState.disable(GL_CLIP_PLANE0);
 		clipEnabled = false;
 		clipPlaneProg.setUniform(clipEnabled);
 	}
@@ -273,43 +335,36 @@ struct App : public OpenGLApplication
 		clipPlaneProg.use();
 
 		clipPlaneProg.setMat(model);
+		renderQueue.setViewMatrix(view.top());
 
 		// Le plancher en ciment.
 		model.push(); {
 			model.translate({0, 0, -0.5});
-			clipPlaneProg.setMat(model);
+			submitDraw(floor, texConcrete);
 		} model.pop();
-		texConcrete.bindToTextureUnit(0);
-		floor.draw();
 
 		// Le cube qui ressemble à un bâtiment.
 		model.push(); {
 			model.translate({-4, 1.45, 5});
 			model.scale({1, 1.5, 1});
-			clipPlaneProg.setMat(model);
+			submitDraw(cube, texBuilding);
 		} model.pop();
-		texBuilding.bindToTextureUnit(0);
-		cube.draw();
 
 		// La grosse boîte de carton.
 		model.push(); {
 			model.translate({3, 1.45, 4});
 			model.rotate(45, {0, 1, 0});
 			model.scale({1.5, 1.5, 1.5});
-			clipPlaneProg.setMat(model);
+			submitDraw(cube, texBox);
 		} model.pop();
-		texBox.bindToTextureUnit(0);
-		cube.draw();
 
 		// Le pole de rotation de la théière.
 		model.push(); {
 			model.translate({-2.8, 2.8, 4.5});
 			model.rotate(90, {1, 0, 0});
 			model.scale({0.5, 0.2, 0.5});
-			clipPlaneProg.setMat(model);
+			submitDraw(pole, texRust);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		pole.draw();
 
 		// La théière qui bouge.
 		model.push(); {
@@ -317,28 +372,30 @@ struct App : public OpenGLApplication
 			model.rotate(90, {0, 1, 0});
 			model.rotate(teapotAngle, {1, 0, 0});
 			model.translate({0, -0.3, 1.5});
-			clipPlaneProg.setMat(model);
+			submitDraw(teapot, texRock);
 		} model.pop();
-		texRock.bindToTextureUnit(0);
-		teapot.draw();
 
 		// Le poteau auquel est attaché le miroir.
 		model.push(); {
 			model.translate({mirrorPosition.x, 0, mirrorPosition.z - 0.5});
 			model.scale({0.75, 1, 0.75});
-			clipPlaneProg.setMat(model);
+			submitDraw(pole, texRust);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		pole.draw();
 
 		// Le cadre du miroir.
 		model.push(); {
 			model.translate(mirrorPosition);
 			model.scale({4, 2, 1});
-			clipPlaneProg.setMat(model);
+			submitDraw(mirrorFrame, texSteel);
 		} model.pop();
-		texSteel.bindToTextureUnit(0);
-		mirrorFrame.draw();
+
+		// Tout dessiner, trié par texture et mesh plutôt que dans l'ordre du code. Ça doit être fait ici, pendant que le stencil et le plan de coupe de la scène réfléchie sont encore actifs.
+		renderQueue.flush();
+	}
+
+	// Soumettre un objet à la file de rendu avec la matrice de modélisation courante (qui inclut la réflexion si on dessine la scène réfléchie).
+	void submitDraw(Mesh& mesh, Texture& tex) {
+		renderQueue.submit({&clipPlaneProg, &mesh, {&tex}, model.top()});
 	}
 
 	void drawStencilZone() {
@@ -348,9 +405,9 @@ struct App : public OpenGLApplication
 			clipPlaneProg.setMat(view);
 			clipPlaneProg.setMat(projection);
 			texStencil.bindToTextureUnit(0);
-			glDisable(GL_CULL_FACE);
+			glState.disable(GL_CULL_FACE);
 			quad.draw();
-			glEnable(GL_CULL_FACE);
+			glState.enable(GL_CULL_FACE);
 		} model.pop(); view.pop(); projection.pop();
 		clipPlaneProg.setMat(model);
 		clipPlaneProg.setMat(view);
@@ -19,6 +19,8 @@
 #include <inf2705/Texture.hpp>
 #include <inf2705/TransformStack.hpp>
 #include <inf2705/OrbitCamera.hpp>
+#include <inf2705/UniformBufferRing.hpp>
+#include <inf2705/BufferLayout.hpp>
 
 
 using namespace gl;
@@ -51,12 +53,12 @@ struct LightSource
 	vec4 diffuseColor;
 	// Couleur spéculaire émise par la source.
 	vec4 specularColor;
+	// Direction (seulement utile pour les "spots").
+	vec4 direction;
 	// Coefficents d'atténuation constante, linéaire et quadratique selon la distance.
 	float fadeCst;
 	float fadeLin;
 	float fadeQuad;
-	// Direction (seulement utile pour les "spots").
-	vec4 direction;
 	// Angle d'ouverture (seulement utile pour les "spots").
 	float beamAngle;
 	// Exposant du cône de lumière (seulement utile pour les "spots").
@@ -73,6 +75,12 @@ struct LightModel
 	uint32_t localViewer;
 };
 
+// Déclarer les membres des blocs pour que le compilateur vérifie qu'ils ont les mêmes décalages qu'en GLSL (std140). Un float placé avant un vec4 laisse un trou en GLSL, mais pas en C++ avec glm. C'est pour ça que les vec4 sont tous au début.
+DECLARE_BLOCK_LAYOUT(BufferLayout::Std140, Material, emissionColor, ambientColor, diffuseColor, specularColor, shininess);
+DECLARE_BLOCK_LAYOUT(BufferLayout::Std140, LightSource, position, ambientColor, diffuseColor, specularColor, direction, fadeCst, fadeLin, fadeQuad, beamAngle, exponent);
+DECLARE_BLOCK_LAYOUT(BufferLayout::Std140, LightModel, ambientColor, localViewer);
+static_assert(blockLayoutPadding_v<LightSource> == 0);
+
 struct App : public OpenGLApplication
 {
 	Mesh shapeFlat;
@@ -84,6 +92,8 @@ struct App : public OpenGLApplication
 	UniformBlock<Material> material = {"Material", 0};
 	UniformBlock<LightSource> light = {"LightSource", 1};
 	UniformBlock<LightModel> lightModel = {"LightModel", 2};
+	// Les blocs uniformes sont copiés à chaque trame dans une région de cet anneau plutôt que mis à jour sur place avec glBufferSubData.
+	UniformBufferRing uniformRing;
 
 	ShaderProgram uniformProg;
 	ShaderProgram flatProg;
@@ -136,15 +146,15 @@ struct App : public OpenGLApplication
 		);
 
 		// Config de base, pas de cull, lignes assez visibles.
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glDisable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glEnable(GL_POINT_SMOOTH);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.disable(GL_CULL_FACE);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.enable(GL_POINT_SMOOTH);
 		glPointSize(3.0f);
 		glLineWidth(3.0f);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		loadShaders();
 
@@ -161,7 +171,6 @@ struct App : public OpenGLApplication
 			{0.5, 0.5, 1.0, 1.0},
 			50
 		};
-		material.setup();
 
 		// Initialiser la lumière.
 		light = LightSource{
@@ -169,18 +178,19 @@ struct App : public OpenGLApplication
 			{1.0, 1.0, 1.0, 1.0},
 			{1.0, 1.0, 1.0, 1.0},
 			{1.0, 1.0, 1.0, 1.0},
+			{0, 0, -1, 1},
 			0.001,
 			0.005,
 			0.01,
-			{0, 0, -1, 1},
 			20,
 			1,
 		};
-		light.setup();
 
 		// Initialiser le modèle d'éclairage. Dans ce cas on n'utilise pas de couleur ambiante (c'est la source lumineuse qui l'a).
 		lightModel = LightModel{{0, 0, 0, 1}, true};
-		lightModel.setup();
+
+		// Un seul tampon pour tous les blocs uniformes. Chaque trame y copie ses blocs et les lie avec glBindBufferRange.
+		uniformRing.setup();
 
 		// Lier chacun des blocs uniformes aux variables uniformes des nuanceurs.
 		for (auto* prog : programs) {
@@ -199,6 +209,12 @@ struct App : public OpenGLApplication
 	void drawFrame() override {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
+		// Copier les blocs uniformes dans la région de la trame courante. Les modifications faites par les touches (position de la lumière par exemple) sont donc prises en compte sans qu'on ait à appeler updateBuffer() nous-mêmes.
+		uniformRing.beginFrame();
+		material.updateBuffer(uniformRing);
+		light.updateBuffer(uniformRing);
+		lightModel.updateBuffer(uniformRing);
+
 		switch (drawMode) {
 		// Démo visuelles des normales.
 		case 1:
@@ -215,9 +231,9 @@ struct App : public OpenGLApplication
 			// Dessiner les arêtes des primitives en noir en dessinant la sphère en wireframe.
 			globalColor = {0, 0, 0, 1};
 			currentProg->setUniform(globalColor);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			glState.polygonMode(GL_FRONT_AND_BACK, GL_LINE);
 			shapeSmooth.draw(GL_TRIANGLES);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
 			// Dessiner les droites de normales selon le type voulu.
 			globalColor = {0.2, 1, 0.2, 1};
@@ -260,6 +276,9 @@ struct App : public OpenGLApplication
 
 			break;
 		}
+
+		// Marquer la fin des lectures de la région de cette trame.
+		uniformRing.endFrame();
 	}
 
 	// Appelée lorsque la fenêtre se ferme.
@@ -269,9 +288,7 @@ struct App : public OpenGLApplication
 		shapeSmooth.deleteObjects();
 		normalsSmooth.deleteObjects();
 		lightBulb.deleteObjects();
-		material.deleteObject();
-		light.deleteObject();
-		lightModel.deleteObject();
+		uniformRing.deleteObjects();
 		for (auto* prog : programs) {
 			prog->deleteShaders();
 			prog->deleteProgram();
@@ -313,16 +330,13 @@ struct App : public OpenGLApplication
 			break;
 		case W:
 			light->position.z -= 0.5;
-			light.updateBuffer();
 			break;
 		case S:
 			light->position.z += 0.5;
-			light.updateBuffer();
 			break;
 		case R:
 			model.identity();
 			light->position.z = 5;
-			light.updateBuffer();
 			break;
 
 		case Num1:
@@ -24,10 +24,10 @@ layout(std140) uniform LightSource
 	vec4 ambientColor;
 	vec4 diffuseColor;
 	vec4 specularColor;
+	vec4 direction;
 	float fadeCst;
 	float fadeLin;
 	float fadeQuad;
-	vec4 direction;
 	float beamAngle;
 	float exponent;
 } light;
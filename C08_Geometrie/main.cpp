@@ -112,15 +112,15 @@ struct App : public OpenGLApplication
 		);
 
 		// Config de base, lignes assez visibles.
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glEnable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glEnable(GL_POINT_SMOOTH);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.enable(GL_CULL_FACE);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.enable(GL_POINT_SMOOTH);
 		glPointSize(3.0f);
 		glLineWidth(10.0f);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		loadShaders();
 
@@ -165,30 +165,38 @@ struct App : public OpenGLApplication
 		applyPerspective();
 	}
 
+	// En mode sur demande (--on-demand), on dessine toutes les trames pendant le coup d'épée : l'animation de Link, puis l'épée qui traverse l'écran (une soixantaine de trames).
+	bool isAnimating() const override {
+		if (swingStartFrame == -1)
+			return false;
+		int linkAnimLength = (int)spriteLink.sprites.size() * 4;
+		return getCurrentFrameNumber() - swingStartFrame < linkAnimLength + 60;
+	}
+
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
 	void drawFrame() override {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-		auto winSize = getWindow().getSize();
+		auto winSize = getWindowSize();
 
 		// Viewport de la moitié supérieur de la fenêtre.
-		glViewport(0, winSize.y / 2, winSize.x, winSize.y / 2);
+		glState.viewport(0, winSize.y / 2, winSize.x, winSize.y / 2);
 		drawExtrudedD20();
 
-		glDisable(GL_DEPTH_TEST);
+		glState.disable(GL_DEPTH_TEST);
 
 		// Viewport de la moitié inférieur de la fenêtre.
-		glViewport(0, 0, winSize.x, winSize.y / 2);
+		glState.viewport(0, 0, winSize.x, winSize.y / 2);
 		drawAnimatedCharacter();
 		drawAnimatedSword();
 
 		// Viewport de la fenêtre au complet
-		glViewport(0, 0, winSize.x, winSize.y);
+		glState.viewport(0, 0, winSize.x, winSize.y);
 		// Dessiner une ligne pour séparer visuellement la fenêtre en deux.
 		uniColorProg.use();
 		line.draw(GL_LINES);
 
-		glEnable(GL_DEPTH_TEST);
+		glState.enable(GL_DEPTH_TEST);
 	}
 
 	// Appelée lorsque la fenêtre se ferme.
@@ -65,16 +65,16 @@ struct App : public OpenGLApplication
 		);
 
 		// Config de base, pas de cull, lignes assez visibles.
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glDisable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glEnable(GL_POINT_SMOOTH);
-		glEnable(GL_LINE_SMOOTH);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.disable(GL_CULL_FACE);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.enable(GL_POINT_SMOOTH);
+		glState.enable(GL_LINE_SMOOTH);
 		glPointSize(5.0f);
 		glLineWidth(3.0f);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		loadShaders();
 
@@ -99,11 +99,11 @@ struct App : public OpenGLApplication
 
 		sphereProg.use();
 		sphereProg.setMat(model);
-		glPolygonMode(GL_FRONT_AND_BACK, (wireframeMode) ? GL_LINE : GL_FILL);
+		glState.polygonMode(GL_FRONT_AND_BACK, (wireframeMode) ? GL_LINE : GL_FILL);
 		if (cullMode)
-			glEnable(GL_CULL_FACE);
+			glState.enable(GL_CULL_FACE);
 		else
-			glDisable(GL_CULL_FACE);
+			glState.disable(GL_CULL_FACE);
 		// Configurer le nombre de sommets par patch. Ici on choisit 3 pour traiter chaque triangle comme un patch (plus simple pour ce qu'on veut faire).
 		glPatchParameteri(GL_PATCH_VERTICES, 3);
 		// Dessiner le d20 en utilisant GL_PATCHES plutôt que le GL_TRIANGLES auquel on est habitué.
@@ -113,10 +113,10 @@ struct App : public OpenGLApplication
 		if (showingOriginalShape) {
 			uniColorProg.use();
 			uniColorProg.setMat(model);
-			glDisable(GL_DEPTH_TEST);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			glState.disable(GL_DEPTH_TEST);
+			glState.polygonMode(GL_FRONT_AND_BACK, GL_LINE);
 			d20.draw(GL_TRIANGLES);
-			glEnable(GL_DEPTH_TEST);
+			glState.enable(GL_DEPTH_TEST);
 		}
 	}
 
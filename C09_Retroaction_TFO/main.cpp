@@ -4,13 +4,15 @@
 #include <array>
 #include <cmath>
 #include <iostream>
+#include <iterator>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <random>
 #include <algorithm>
-#include <thread>
+#include <filesystem>
+#include <future>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -22,6 +24,8 @@
 #include <inf2705/Texture.hpp>
 #include <inf2705/TransformStack.hpp>
 #include <inf2705/OrbitCamera.hpp>
+#include <inf2705/AsyncReadback.hpp>
+#include <inf2705/GpuProfiler.hpp>
 
 
 using namespace gl;
@@ -73,6 +77,15 @@ struct App : public OpenGLApplication
 
 	float orthoHeight = 50;
 	bool savingData = false;
+	bool takingScreenshot = false;
+	GpuProfiler gpuProfiler;
+	bool reportingGpuTimes = false;
+
+	// Les données de la sauvegarde demandée, qui arrivent une ou deux trames plus tard.
+	AsyncReadback readback;
+	std::future<GLuint> savedCount;
+	std::future<std::vector<Particle>> savedParticles;
+	int savedFrameNumber = 0;
 
 	// Appelée avant la première trame.
 	void init() override {
@@ -84,12 +97,13 @@ struct App : public OpenGLApplication
 			"clic droit : appliquer un champ répulsif sous le curseur de la souris." "\n"
 			"espace : freiner les particules." "\n"
 			"F : sauvegarder les données de particules dans un fichier CSV en plus d'un screenshot." "\n"
+			"P : activer/désactiver l'affichage périodique du temps GPU du calcul et de l'affichage (aussi dans output/gpu_times.csv)." "\n"
 		);
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.enable(GL_BLEND);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		loadShaders();
 
@@ -125,14 +139,14 @@ struct App : public OpenGLApplication
 
 		// Passer les données des particles dans le VBO d'entrée. On configure avec GL_DYNAMIC_COPY vu que ça va être souvent lu et modifié. Ce n'est qu'une suggestion au driver et celui-ci peut l'ignorer.
 		auto numBytes = (GLsizeiptr)particles.size() * sizeof(Particle);
-		glBindBuffer(GL_ARRAY_BUFFER, vboIn);
+		glState.bindBuffer(GL_ARRAY_BUFFER, vboIn);
 		glBufferData(GL_ARRAY_BUFFER, numBytes, particles.data(), GL_DYNAMIC_COPY);
 		// Configurer le VBO de sortie avec le même nombre d'octets. On n'a pas besoin de passer des données vu qu'il va être rempli avec les résultats de calculs.
-		glBindBuffer(GL_ARRAY_BUFFER, vboOut);
+		glState.bindBuffer(GL_ARRAY_BUFFER, vboOut);
 		glBufferData(GL_ARRAY_BUFFER, numBytes, nullptr, GL_DYNAMIC_COPY);
 
 		// Lier le TFO au VAO de calcul (pas besoin pour le VAO d'affichage).
-		glBindVertexArray(vaoComputation);
+		glState.bindVertexArray(vaoComputation);
 		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, tfoComputation);
 
 		// Configurer les variables de sortie de la rétroaction. Il faut passer les noms dans l'ordre dans lequel ils seront écrits dans le tampon de sortie. Dans notre cas, on met le même ordre que dans la struct `Particle`. On veut que la sortie des calculs ait le même format que les données en entrée.
@@ -170,40 +184,67 @@ struct App : public OpenGLApplication
 		applyOrtho();
 	}
 
-	// Appelée à chaque trame. Le buffer swap est fait juste après.
-	void drawFrame() override {
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	// Appelée au début de chaque trame, avant les pas de update(). Lire les temps GPU d'il y a quelques trames : les pas de calcul de update() sont ainsi mesurés dans la trame courante du profileur, à côté de l'affichage.
+	void onFrameStart() override {
+		gpuProfiler.beginFrame();
+	}
 
-		// Exécuter le pipeline de calcul. On utilise vboIn comme source de données et les résultats sont mis dans vboOut.
-		computePhysics();
+	// Appelée à fréquence fixe (60 Hz par défaut), avant l'affichage. La physique avance donc toujours du même pas, peu importe le fps : un pas qui suivrait la durée de la trame s'allongerait quand l'affichage ralentit, et la simulation deviendrait moins stable et différente selon la machine.
+	void update(float dt) override {
+		// Exécuter le pipeline de calcul. On utilise vboIn comme source de données et les résultats sont mis dans vboOut. Sur le CPU, cet appel revient presque tout de suite; c'est le profileur GPU qui nous dit combien de temps prend vraiment la rétroaction.
+		{
+			GpuProfileScope scope(gpuProfiler, "Calcul (TFO)");
+			computePhysics(dt);
+		}
 
 		// Échanger les VBO. De cette façon, le programme d'affichage peut utiliser les résultats de calcul comme données d'entrée, d'où l'idée d'avoir le même format de données dans les deux VBO.
 		std::swap(vboIn, vboOut);
 
+		if (savingData) {
+			// Demander les données des particules juste après le pas où la requête a compté les résultats. Elles seront enregistrées quand elles arriveront sur le CPU (voir saveParticleData).
+			requestParticleData();
+			savingData = false;
+			takingScreenshot = true;
+		}
+	}
+
+	// En mode sur demande (--on-demand), les particules bougent toujours : on dessine donc toutes les trames, et update() continue d'avancer.
+	bool isAnimating() const override { return true; }
+
+	// Appelée à chaque trame. Le buffer swap est fait juste après. Les particules sont sur le GPU, on dessine donc simplement le dernier état calculé (sans interpolation).
+	void drawFrame() override {
+		// Si les données d'une sauvegarde sont arrivées, les enregistrer.
+		readback.update();
+		if (isReady(savedCount) and isReady(savedParticles))
+			saveParticleData();
+
+		// Le profileur a commencé la trame dans onFrameStart().
+		GpuProfileScope frameScope(gpuProfiler, "Trame");
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
 		// Afficher les particules avec le programme d'affichage qui a un nuanceur de géométrie donnant une forme aux particules.
-		drawParticles();
+		{
+			GpuProfileScope scope(gpuProfiler, "Affichage");
+			drawParticles();
+		}
 
-		if (savingData) {
-			// Pour sauvegarder, il faut attendre que les commandes soient exécutées, puis faire la requête pour rapatrier les données sur le CPU.
-			glFinish();
-			queryParticleData();
-			// Enregistrer les données dans un fichier CSV avec un nom généré.
-			std::string csvName = saveParticleDataAsCsv();
-			// Prendre une capture d'écran tant qu'à y être et la mettre dans le même dossier que le CSV.
+		if (takingScreenshot) {
+			// Prendre une capture d'écran tant qu'à y être et la mettre dans le même dossier que le CSV, pour qu'elle montre le même état que les données.
 			std::string screenshotName = saveScreenshot("output");
-			std::cout << "Sauvegarde des données dans " << csvName << "\n"
-			          << "Capture d'écran dans " << screenshotName << std::endl;
-
-			savingData = false;
+			std::cout << "Capture d'écran dans " << screenshotName << std::endl;
+			takingScreenshot = false;
 		}
 	}
 
 	// Appelée lorsque la fenêtre se ferme.
 	void onClose() override {
-		glDeleteVertexArrays(1, &vaoComputation);
-		glDeleteVertexArrays(1, &vaoDrawing);
-		glDeleteBuffers(1, &vboIn);
-		glDeleteBuffers(1, &vboOut);
+		readback.deleteObjects();
+		gpuProfiler.deleteObjects();
+		glState.deleteVertexArrays(1, &vaoComputation);
+		glState.deleteVertexArrays(1, &vaoDrawing);
+		glState.deleteBuffers(1, &vboIn);
+		glState.deleteBuffers(1, &vboOut);
 		glDeleteQueries(1, &reqParticles);
 		glDeleteTransformFeedbacks(1, &tfoComputation);
 		particleSprite.deleteObject();
@@ -246,9 +287,22 @@ struct App : public OpenGLApplication
 			computationProg.setUniform(globalSpeedFactor);
 			break;
 
+		case P:
+			reportingGpuTimes ^= 1;
+			// Afficher les temps toutes les 120 trames et les ajouter au fichier CSV.
+			gpuProfiler.setReportInterval(reportingGpuTimes ? 120 : 0);
+			if (reportingGpuTimes) {
+				std::filesystem::create_directory("output");
+				gpuProfiler.setCsvFile("output/gpu_times.csv");
+			}
+			std::cout << "Temps GPU " << (reportingGpuTimes ? "ON" : "OFF") << "\n";
+			break;
+
 		case F:
 		case F5:
-			savingData = true;
+			// Une seule sauvegarde à la fois, puisque la requête est réutilisée.
+			if (not savedCount.valid())
+				savingData = true;
 			break;
 		}
 
@@ -308,11 +362,11 @@ struct App : public OpenGLApplication
 		applyOrtho();
 	}
 
-	void computePhysics() {
+	void computePhysics(float dt) {
 		computationProg.use();
 
-		// Mettre à jour le temps depuis la dernière trame.
-		deltaTime = getFrameDeltaTime();
+		// Le pas de temps de la simulation.
+		deltaTime = dt;
 		computationProg.setUniform(deltaTime);
 
 		// Mettre à jour l'origine du champ de force avec la souris.
@@ -325,25 +379,27 @@ struct App : public OpenGLApplication
 		forceFieldPosition = vec3(invTransform * vec4(mousePosition, 0, 1));
 		computationProg.setUniform(forceFieldPosition);
 
-		glBindVertexArray(vaoComputation);
+		glState.bindVertexArray(vaoComputation);
 		// Configurer le VBO d'entrée pour les données de sommets. Il faut répéter les configurations d'attributs quand on bind un différent VBO.
-		glBindBuffer(GL_ARRAY_BUFFER, vboIn);
+		glState.bindBuffer(GL_ARRAY_BUFFER, vboIn);
 		Particle::setupAttribs();
 		// Configurer le VBO de sortie pour contenir les résultats de calculs.
-		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vboOut);
+		glState.bindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vboOut);
 
-		// Commencer la requête et la rétroaction.
-		glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, reqParticles);
+		// Commencer la requête et la rétroaction. La requête sert seulement à la sauvegarde, on ne la fait donc que dans la trame où on sauvegarde. Ça évite aussi de la recommencer pendant que son résultat est en route.
+		if (savingData)
+			glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, reqParticles);
 		glBeginTransformFeedback(GL_POINTS);
 		// Désactiver le tramage.
-		glEnable(GL_RASTERIZER_DISCARD);
+		glState.enable(GL_RASTERIZER_DISCARD);
 		// Dessiner les particles (appel normal).
 		glDrawArrays(GL_POINTS, 0, (GLint)particles.size());
 		// Réactiver le tramage.
-		glDisable(GL_RASTERIZER_DISCARD);
+		glState.disable(GL_RASTERIZER_DISCARD);
 		// Terminer la requête et la rétroaction.
 		glEndTransformFeedback();
-		glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+		if (savingData)
+			glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
 	}
 
 	void drawParticles() {
@@ -351,52 +407,54 @@ struct App : public OpenGLApplication
 
 		// Rien de très spécial ici, on fait le bind et les configs d'attributs puis on dessine. Le nuanceur de géométrie s'occupe de générer les sommets en temps réel selon les propriétés physiques des particules.
 		particleSprite.bindToTextureUnit(0);
-		glBindVertexArray(vaoDrawing);
-		glBindBuffer(GL_ARRAY_BUFFER, vboIn);
+		glState.bindVertexArray(vaoDrawing);
+		glState.bindBuffer(GL_ARRAY_BUFFER, vboIn);
 		Particle::setupAttribs();
 		glDrawArrays(GL_POINTS, 0, (GLsizei)particles.size());
 	}
 
-	void queryParticleData() {
-		// Obtenir le nombre de résultats capturés par la requête.
-		GLuint numResults = 0;
-		glGetQueryObjectuiv(reqParticles, GL_QUERY_RESULT, &numResults);
+	void requestParticleData() {
+		// On met en file une copie du tampon de rétroaction (qui est maintenant vboIn, après l'échange) et la lecture de la requête, sans attendre le GPU : lire les données tout de suite (glGetBufferSubData, glGetQueryObjectuiv) bloquerait l'affichage le temps qu'il vide sa file de commandes. Le GPU fait la copie à son rythme et on reçoit les données une ou deux trames plus tard.
+		savedCount = readback.readQuery(reqParticles);
+		savedParticles = readback.readBuffer<Particle>(vboIn, 0, particles.size());
+		savedFrameNumber = getCurrentFrameNumber();
+	}
+
+	void saveParticleData() {
+		// Le nombre de résultats capturés par la requête. On garde seulement ces particules-là dans le tableau de particules original (donc on le met à jour).
+		GLuint numResults = savedCount.get();
+		particles = savedParticles.get();
 		particles.resize(numResults);
-		// Si ce nombre est non-nul, on a des résultats.
-		if (numResults != 0) {
-			// Lire le contenu du tampon de rétroaction dans le tableau de particules original (donc le mettre à jour).
-			auto numBytes = numResults * sizeof(Particle);
-			glGetBufferSubData(
-				GL_TRANSFORM_FEEDBACK_BUFFER,
-				0,
-				numBytes,
-				particles.data()
-			);
-		}
+		// Enregistrer les données dans un fichier CSV avec un nom généré.
+		std::string csvName = saveParticleDataAsCsv(savedFrameNumber);
+		std::cout << "Sauvegarde des données dans " << csvName << std::endl;
 	}
 
-	std::string saveParticleDataAsCsv() {
+	std::string saveParticleDataAsCsv(int frameNumber) {
 		// Construire un nom de fichier avec l'heure de départ de l'application et le numéro de trame.
 		std::string dateTimeStr = formatStartTime("%Y%m%d_%H%M%S");
 		std::string filename = std::format(
 			"output/particles_{}_{}.csv",
 			dateTimeStr,
-			getCurrentFrameNumber()
+			frameNumber
 		);
 		auto dataCopy = particles;
 
-		// Dans notre exemple, on peut facilement gérer des millions de particules. Formater et écrire sur le disque autant de données peut prendre plusieurs secondes. On fait donc cette écriture dans un fil d'exécution (thread) séparé en lui passant une copie des données de particules. Ça permet de moins ralentir le fil principal qui fait l'affichage.
-		// On note la capture par copie des variables `filename` et `dataCopy`.
-		std::thread savingThread([=]() {
+		// Dans notre exemple, on peut facilement gérer des millions de particules. Formater et écrire sur le disque autant de données peut prendre plusieurs secondes. On fait donc cette écriture dans une tâche exécutée par un des fils de travail du système de tâches (voir JobSystem.hpp), en lui passant une copie des données de particules. Ça permet de moins ralentir le fil principal qui fait l'affichage.
+		// On note la capture par copie des variables `filename` et `dataCopy`. Contrairement à un fil détaché, la tâche ne peut pas être coupée par la fin du programme : l'application attend les tâches en cours à la fermeture.
+		jobSystem.submit([=]() {
 			std::ofstream file(filename);
 			file << "m\tx\ty\tvx\tvy" << "\n";
+			// std::format_to écrit directement dans le fichier, sans construire une std::string par ligne.
+			std::ostreambuf_iterator<char> out(file);
 			for (auto& p : dataCopy) {
-				file << std::format(
-					"{:.5e}\t{:.5e}\t{:.5e}\t{:.5e}\t{:.5e}",
+				std::format_to(
+					out,
+					"{:.5e}\t{:.5e}\t{:.5e}\t{:.5e}\t{:.5e}\n",
 					p.mass,
 					p.position.x, p.position.y,
 					p.velocity.x, p.velocity.y
-				) << "\n";
+				);
 			}
 			// Pour aider au débogage, afficher le contenu du fichier dans la sortie standard si peu de données.
 			if (dataCopy.size() <= 10) {
@@ -404,8 +462,6 @@ struct App : public OpenGLApplication
 				std::cout << readFile(filename) << "\n";
 			}
 		});
-		// Détacher le fil pour qu'il se gère tout seul, donc pas besoin de join() ou de garder la variable vivante.
-		savingThread.detach();
 		return filename;
 	}
 
@@ -20,6 +20,8 @@
 #include <inf2705/Texture.hpp>
 #include <inf2705/TransformStack.hpp>
 #include <inf2705/OrbitCamera.hpp>
+#include <inf2705/RenderQueue.hpp>
+#include <inf2705/FrameGraph.hpp>
 
 
 using namespace gl;
@@ -28,37 +30,49 @@ using namespace glm;
 
 struct App : public OpenGLApplication
 {
-	Mesh floor;
-	Mesh teapot;
-	Mesh cube;
-	Mesh pole;
-	Mesh sphere;
-	Mesh eye;
-	Mesh quad;
-	Mesh tv;
-	Texture texSteel;
-	Texture texRust;
-	Texture texEye;
-	Texture texConcrete;
-	Texture texBox;
-	Texture texBuilding;
-	Texture texRock;
-
-	Texture texRender;
-	GLuint camFrameBuffer;
-	GLuint camZBuffer;
+	// Les mesh et les textures sont possédés par des GLOwned (voir inf2705/GLObject.hpp) : leurs objets OpenGL sont supprimés à la fermeture sans les énumérer dans onClose(). Un objet oublié apparaît dans le rapport de fuites de glResources.
+	GLOwned<Mesh> floor;
+	GLOwned<Mesh> teapot;
+	GLOwned<Mesh> cube;
+	GLOwned<Mesh> pole;
+	GLOwned<Mesh> sphere;
+	GLOwned<Mesh> eye;
+	GLOwned<Mesh> quad;
+	GLOwned<Mesh> tv;
+	GLOwned<Texture> texSteel;
+	GLOwned<Texture> texRust;
+	GLOwned<Texture> texEye;
+	GLOwned<Texture> texConcrete;
+	GLOwned<Texture> texBox;
+	GLOwned<Texture> texBuilding;
+	GLOwned<Texture> texRock;
+
+	// L'aspect de l'écran de la TV, donc de la texture de rendu de la caméra de surveillance. La texture elle-même est une ressource transitoire du graphe de trame.
+	float camAspect = 4.0f / 3.0f;
+	int camSamples = 4;
+	FrameGraph frameGraph;
+	GpuProfiler gpuProfiler;
+	bool reportingGpuTimes = false;
 
 	ShaderProgram basicProg;
+	RenderQueue renderQueue;
 
 	TransformStack model = {"model"};
 	TransformStack view = {"view"};
 	TransformStack projection = {"projection"};
 
 	OrbitCamera camera = {10, 15, 30, 0, {0, 2, -5}};
+	// Les animations avancent dans update() à pas fixe. On garde l'angle du pas précédent et du pas courant pour dessiner l'angle interpolé entre les deux.
 	float scanValue = 0;
+	float previousScanAngle = 0;
+	float currentScanAngle = 0;
 	float scanAngle = 0;
 	bool scanPaused = false;
+	bool showingTv = true;
 	float teapotValue = 0;
+	float previousTeapotAngle = 0;
+	float currentTeapotAngle = 0;
+	float teapotAngle = 0;
 
 	// Appelée avant la première trame.
 	void init() override {
@@ -71,14 +85,18 @@ struct App : public OpenGLApplication
 			"clic droit ou central : bouger la caméra en glissant la souris." "\n"
 			"roulette : rapprocher et éloigner la caméra orbitale." "\n"
 			"espace : mettre en pause le mouvement de la caméra de surveillance." "\n"
+			"T : cacher/montrer la TV (la passe de la caméra de surveillance est alors éliminée)." "\n"
+			"M : activer/désactiver l'antialiasing (MSAA) de la caméra de surveillance." "\n"
+			"G : afficher les passes et les textures du graphe de trame." "\n"
+			"P : activer/désactiver l'affichage périodique du temps GPU de chaque passe." "\n"
 		);
 
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glDisable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.disable(GL_CULL_FACE);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		// On utilise les nuanceurs de base qui échantillonnent les textures, pas besoin de quoique ce soit de fancy.
 		loadShaders();
@@ -102,105 +120,112 @@ struct App : public OpenGLApplication
 		basicProg.use();
 		basicProg.setInt("texMain", 0);
 
-		// Créer une texture de rendu comme une texture normale.
-		texRender.size = {1024, 768};
-		texRender.numLevels = 1;
-		glGenTextures(1, &texRender.id);
-		glBindTexture(GL_TEXTURE_2D, texRender.id);
-		// Créer un tampon de trame (frame buffer);
-		glGenFramebuffers(1, &camFrameBuffer);
-		glBindFramebuffer(GL_FRAMEBUFFER, camFrameBuffer);
-		// Formatter les données de la texture de rendu en RGBA (RGB aurait aussi été suffisant). Comme avec les VBO de sortie, on peut passer nullptr comme données ou passer une image de départ pour le débogage.
-		glTexImage2D(
-			GL_TEXTURE_2D, 0, GL_RGBA,
-			texRender.size.x, texRender.size.y, 0,
-			GL_RGBA, GL_UNSIGNED_BYTE, nullptr
-		);
-		// Configurer la texture pour les filtres usuels et pas de répétition.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		// Créer un tampon de rendu qui servira de tampon de profondeur. En effet, avec un framebuffer un z-buffer dédié doit être créé.
-		glGenRenderbuffers(1, &camZBuffer);
-		glBindRenderbuffer(GL_RENDERBUFFER, camZBuffer);
-		// Définir ce tampon comme tampon de profondeur.
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, camZBuffer);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, texRender.size.x, texRender.size.y);
-		// Lier le framebuffer à la texture de rendu.
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texRender.id, 0);
+		// Pas de texture de rendu ni de framebuffer à créer ici : le graphe de trame les alloue (dans son bassin de textures) à la première trame où une passe en a besoin.
+		// L'état commun à toutes les passes. Chaque passe ne précise que ce qui diffère.
+		frameGraph.setDefaultState({.depthTest = true, .depthWrite = true, .colorWrite = true, .polygonMode = GL_FILL});
+		// Chaque passe exécutée par le graphe (caméra de surveillance, résolution MSAA, caméra principale) est mesurée sous son nom.
+		frameGraph.setProfiler(&gpuProfiler);
 
 		// Appliquer la caméra et perspective habituelle.
 		camera.updateProgram(basicProg, view);
 		applyPerspective(50, getWindowAspect());
 	}
 
-	// Appelée à chaque trame. Le buffer swap est fait juste après.
-	void drawFrame() override {
-		basicProg.use();
-
-		// Calculer l'angle de la caméra de surveillance selon le temps écoulé depuis la dernière trame.
+	// Appelée à fréquence fixe avant les trames. Faire avancer l'angle de la caméra de surveillance et de la théière d'un pas de temps.
+	void update(float dt) override {
+		previousScanAngle = currentScanAngle;
 		if (not scanPaused) {
-			scanValue += getFrameDeltaTime();
+			scanValue += dt;
 			scanValue = fmodf(scanValue, 10.0f);
-			scanAngle = 40 * sin(scanValue / 10.0f * 2 * std::numbers::pi_v<float>);
+			currentScanAngle = 40 * sin(scanValue / 10.0f * 2 * std::numbers::pi_v<float>);
 		}
-		teapotValue += getFrameDeltaTime();
+		previousTeapotAngle = currentTeapotAngle;
+		teapotValue += dt;
 		teapotValue = fmodf(teapotValue, 5.0f);
+		currentTeapotAngle = 20 * sin(teapotValue / 5 * 2 * std::numbers::pi_v<float>);
+	}
 
-		// 1. Dessiner la scène selon le point de vue de la caméra de surveillance dans le framebuffer.
-		// 2. Dessiner la scène normalement avec la caméra orbitale principale dans le tampon de la fenêtre.
-
-		// Lier le framebuffer de la caméra secondaire.
-		glBindFramebuffer(GL_FRAMEBUFFER, camFrameBuffer);
-		// Il faut faire le glClear() pour chaque buffer, car il s'applique sur le buffer de trame actuel, qui est lié par glBindFramebuffer.
-		// On peut choisir une couleur de fond différente pour le rendu de la caméra secondaire.
-		glClearColor(0.2f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		// Lire le viewport actuel pour le restaurer plus tard.
-		struct { GLint x, y, width, height; } viewport = {};
-		glGetIntegerv(GL_VIEWPORT, (GLint*)&viewport);
-		// Établir un viewport qui a les mêmes dimensions que la texture de rendu.
-		glViewport(0, 0, texRender.size.x, texRender.size.y);
-		// Positionner la caméra synthétique juste devant l'oeil. On se rappelle qu'il faut faire l'inverse des opérations quand on bouge la caméra synthétique à travers la matrice de visualisation.
-		view.pushIdentity(); {
-			view.translate({0, 0, 1.2});
-			view.rotate(180, {0, 1, 0});
-			view.rotate(-20, {1, 0, 0});
-			view.rotate(-scanAngle, {0, 1, 0});
-			view.translate({0, -6, 10});
-			basicProg.setMat(view);
-		} view.pop();
-		// Appliquer une perpective pour la caméra secondaire encore là selon les dimensions de la texture de rendu (dans notre cas 1024x768, donc aspect 4:3).
-		projection.push(); {
-			applyPerspective(40, (float)texRender.size.x / texRender.size.y);
-		} projection.pop();
-		// Dessiner la scène normalement.
-		drawScene();
-
-		// Restaurer la caméra normale.
-		basicProg.setMat(view);
-		// Restaurer le viewport.
-		glViewport(viewport.x, viewport.y, viewport.width, viewport.height);
-		// Restaurer la perspective habituelle.
-		basicProg.setMat(projection);
-		// Délier le framebuffer, donc utiliser le framebuffer de base qui est celui de la fenêtre.
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		// Faire le glClear avec le turquoise foncé qu'on utilise depuis le début de la session.
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		// Dessiner la scène normalement.
-		drawScene();
+	// En mode sur demande (--on-demand), la théière bouge toujours : on dessine donc toutes les trames, et update() continue d'avancer.
+	bool isAnimating() const override { return true; }
+
+	// Appelée à chaque trame. Le buffer swap est fait juste après.
+	void drawFrame(float alpha) override {
+		// Lire les temps GPU d'il y a quelques trames, puis mesurer toute la trame courante. Les passes du graphe sont imbriquées dans cette portée.
+		gpuProfiler.beginFrame();
+		GpuProfileScope frameScope(gpuProfiler, "Trame");
+
+		basicProg.use();
+
+		// Les angles dessinés, interpolés entre les deux derniers pas de update(). On interpole les angles plutôt que les temps, qui reviennent à 0 à la fin de chaque cycle.
+		scanAngle = mix(previousScanAngle, currentScanAngle, alpha);
+		teapotAngle = mix(previousTeapotAngle, currentTeapotAngle, alpha);
+
+		// 1. Dessiner la scène selon le point de vue de la caméra de surveillance dans une texture de rendu.
+		// 2. Dessiner la scène normalement avec la caméra orbitale principale dans le tampon de la fenêtre, en échantillonnant la texture de rendu pour l'écran de la TV.
+		// Plutôt que de lier le framebuffer, changer le viewport, effacer puis tout rétablir à la main, on décrit les deux passes et leurs ressources au graphe de trame. C'est lui qui lie le bon framebuffer, règle le viewport à la taille de la cible et fait l'effacement.
+
+		auto windowSize = getWindowSize();
+		frameGraph.reset({(int)windowSize.x, (int)windowSize.y});
+		// La résolution de la caméra suit la hauteur de la fenêtre (avec l'aspect de la TV). Redimensionner la fenêtre change donc la description des textures : le bassin du graphe en crée de nouvelles et détruit les anciennes après quelques trames.
+		int camHeight = frameGraph.getBackbufferSize().y;
+		ivec2 camResolution = {int(camHeight * camAspect), camHeight};
+		// Les tampons de couleur et de profondeur de la caméra secondaire. On reproduit essentiellement les tampons de fenêtre, avec de l'antialiasing multiéchantillon (MSAA) si camSamples > 1.
+		auto camColor = frameGraph.createTexture("Couleur caméra", {camResolution, GL_RGBA8});
+		auto camTarget = camColor;
+		if (camSamples > 1)
+			camTarget = frameGraph.createTexture("Couleur caméra MSAA", {camResolution, GL_RGBA8, camSamples});
+		auto camDepth = frameGraph.createTexture("Profondeur caméra", {camResolution, GL_DEPTH_COMPONENT24, camSamples});
+
+		// On peut choisir une couleur de fond différente pour le rendu de la caméra secondaire. Le tampon de profondeur n'est jamais lu, le graphe l'invalide donc après la passe.
+		frameGraph.addPass("Caméra de surveillance")
+			.writeColor(camTarget, vec4(0.2f, 0.1f, 0.1f, 1.0f))
+			.writeDepth(camDepth, 1.0f)
+			.setExecute([&](FrameGraphPassContext& context) {
+				// Positionner la caméra synthétique juste devant l'oeil. On se rappelle qu'il faut faire l'inverse des opérations quand on bouge la caméra synthétique à travers la matrice de visualisation.
+				mat4 surveillanceView;
+				view.pushIdentity(); {
+					view.translate({0, 0, 1.2});
+					view.rotate(180, {0, 1, 0});
+					view.rotate(-20, {1, 0, 0});
+					view.rotate(-scanAngle, {0, 1, 0});
+					view.translate({0, -6, 10});
+					basicProg.setMat(view);
+					surveillanceView = view.top();
+				} view.pop();
+				// Appliquer une perpective pour la caméra secondaire selon les dimensions de la cible de la passe (aspect 4:3), pas de la fenêtre.
+				projection.push(); {
+					applyPerspective(40, context.getAspect());
+				} projection.pop();
+				// Dessiner la scène normalement. L'écran de la TV n'est pas dessiné, car on ne peut pas échantillonner la texture dans laquelle on est en train de dessiner.
+				drawScene(surveillanceView, nullptr);
+
+				// Restaurer la caméra et la perspective habituelles.
+				basicProg.setMat(view);
+				basicProg.setMat(projection);
+			});
+
+		// Une texture multiéchantillonnée ne peut pas être échantillonnée comme une texture normale. On la résout (moyenne des échantillons de chaque pixel) vers la texture à un échantillon que la TV affiche.
+		if (camSamples > 1)
+			frameGraph.addResolve("Résolution MSAA", camTarget, camColor);
+
+		// Le turquoise foncé qu'on utilise depuis le début de la session. Si la TV est cachée, la passe ne lit plus la texture de la caméra, donc plus personne n'a besoin de la passe précédente et le graphe l'élimine.
+		auto& mainPass = frameGraph.addPass("Caméra principale")
+			.writeColor(frameGraph.getBackbuffer(), vec4(0.1f, 0.2f, 0.2f, 1.0f))
+			.writeDepth(frameGraph.getBackbuffer(), 1.0f)
+			.setExecute([&](FrameGraphPassContext& context) {
+				drawScene(view.top(), showingTv ? &context.getTexture(camColor) : nullptr);
+			});
+		if (showingTv)
+			mainPass.read(camColor);
+
+		frameGraph.compile();
+		frameGraph.execute();
 	}
 
 	// Appelée lorsque la fenêtre se ferme.
 	void onClose() override {
-		for (auto mesh : {&floor, &teapot, &cube, &pole, &sphere, &eye, &quad, &tv})
-			mesh->deleteObjects();
-		for (auto tex : {&texSteel, &texRust, &texEye, &texConcrete, &texBox, &texBuilding, &texRock, &texRender})
-			tex->deleteObject();
-		glDeleteFramebuffers(1, &camFrameBuffer);
-		glDeleteRenderbuffers(1, &camZBuffer);
+		frameGraph.deleteObjects();
+		gpuProfiler.deleteObjects();
 		basicProg.deleteShaders();
 		basicProg.deleteProgram();
 	}
@@ -212,6 +237,10 @@ struct App : public OpenGLApplication
 		// Les touches haut/bas change l'élévation ou la latitude de la caméra orbitale.
 		// Les touches gauche/droite change la longitude ou le roulement (avec shift) de la caméra orbitale.
 		// Espace met en pause le mouvement de la caméra de surveillance.
+		// T cache ou montre la TV.
+		// M active ou désactive le MSAA de la caméra de surveillance.
+		// G affiche le graphe de trame.
+		// P affiche périodiquement le temps GPU des passes.
 
 		camera.handleKeyEvent(key, 5, 0.5, {10, 15, 30, 0, {0, 2, -5}});
 		camera.updateProgram(basicProg, view);
@@ -222,6 +251,28 @@ struct App : public OpenGLApplication
 			scanPaused ^= 1;
 			std::cout << "Scan " << (scanPaused ? "pause" : "unpause") << "\n";
 			break;
+		case T:
+			showingTv ^= 1;
+			std::cout << "TV " << (showingTv ? "ON" : "OFF") << "\n";
+			break;
+		case M:
+			camSamples = camSamples > 1 ? 1 : 4;
+			std::cout << "MSAA caméra " << (camSamples > 1 ? "ON" : "OFF") << "\n";
+			break;
+		case G: {
+			auto& stats = frameGraph.getLastStats();
+			frameGraph.print(std::cout);
+			std::cout << stats.numPooledTextures << " cibles dans le bassin (" << stats.pooledBytes / 1024 << " Kio), "
+			          << stats.numResolves << " résolution(s), " << stats.numInvalidatedAttachments << " attache(s) invalidée(s)" << std::endl;
+			break;
+		}
+
+		case P:
+			reportingGpuTimes ^= 1;
+			// Afficher les temps toutes les 120 trames (environ 2 secondes à 60 FPS).
+			gpuProfiler.setReportInterval(reportingGpuTimes ? 120 : 0);
+			std::cout << "Temps GPU " << (reportingGpuTimes ? "ON" : "OFF") << "\n";
+			break;
 
 		case F5:
 			std::string path = saveScreenshot();
@@ -250,102 +301,95 @@ struct App : public OpenGLApplication
 		applyPerspective(50, getWindowAspect());
 	}
 
-	void drawScene() {
-		// Il ne se passe rien de spécial ici. En effet, une fois que le framebuffer et la texture de rendu sont configurée, on dessine la scène comme si de rien était, pas besoin d'un nuanceur différent (quoiqu'on pourrait choisir d'en utiliser un différent pour faire des effets). La seule petite particularité est la texture utilisée pour l'écran de la TV qui est en fait la texture de rendu.
+	// La matrice de visualisation sert seulement à trier les objets selon leur profondeur. La texture de l'écran est celle de la caméra de surveillance (nullptr = pas de TV, ou pas d'écran).
+	void drawScene(const mat4& viewMatrix, Texture* screenTexture) {
+		// Il ne se passe rien de spécial ici. En effet, une fois que le framebuffer et la texture de rendu sont configurée (par le graphe de trame), on dessine la scène comme si de rien était, pas besoin d'un nuanceur différent (quoiqu'on pourrait choisir d'en utiliser un différent pour faire des effets). La seule petite particularité est la texture utilisée pour l'écran de la TV qui est en fait la texture de rendu.
 
 		basicProg.use();
 
 		model.identity();
 		basicProg.setMat(model);
+		renderQueue.setViewMatrix(viewMatrix);
 
 		// Le plancher en ciment.
 		model.push(); {
 			model.translate({0, 0, -0.5});
-			basicProg.setMat(model);
+			submitDraw(floor, texConcrete);
 		} model.pop();
-		texConcrete.bindToTextureUnit(0);
-		floor.draw();
 
 		// Le cube qui ressemble à un bâtiment.
 		model.push(); {
 			model.translate({-5, 1.45, 5});
 			model.scale({1, 1.5, 1});
-			basicProg.setMat(model);
+			submitDraw(cube, texBuilding);
 		} model.pop();
-		texBuilding.bindToTextureUnit(0);
-		cube.draw();
 
 		// La grosse boîte de carton.
 		model.push(); {
 			model.translate({4, 1.45, 4});
 			model.rotate(180, {0, 1, 0});
 			model.scale({1.5, 1.5, 1.5});
-			basicProg.setMat(model);
+			submitDraw(cube, texBox);
 		} model.pop();
-		texBox.bindToTextureUnit(0);
-		cube.draw();
 
 		// Le pole de rotation de la théière.
 		model.push(); {
 			model.translate({-3.8, 2.8, 4.5});
 			model.rotate(90, {1, 0, 0});
 			model.scale({0.5, 0.2, 0.5});
-			basicProg.setMat(model);
+			submitDraw(pole, texRust);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		pole.draw();
 
 		// La théière qui bouge.
 		model.push(); {
-			float angle = 20 * sin(teapotValue / 5 * 2 * std::numbers::pi_v<float>);
 			model.translate({-3.7, 2.9, 5});
 			model.rotate(90, {0, 1, 0});
-			model.rotate(angle, {1, 0, 0});
+			model.rotate(teapotAngle, {1, 0, 0});
 			model.translate({0, -0.3, 1.5});
-			basicProg.setMat(model);
+			submitDraw(teapot, texRock);
 		} model.pop();
-		texRock.bindToTextureUnit(0);
-		teapot.draw();
 
 		// Le poteau au bout duquel se trouve l'oeil observateur.
 		model.push(); {
 			model.translate({0, 0, -10});
 			model.scale({0.75, 1, 0.75});
-			basicProg.setMat(model);
+			submitDraw(pole, texRust);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		pole.draw();
 
 		// La sphère autour de laquelle l'oeil tourne.
 		model.push(); {
 			model.translate({0, 6, -10});
-			basicProg.setMat(model);
+			submitDraw(sphere, texRust);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		sphere.draw();
 
 		// L'oeil observateur. On applique l'angle qui change dans le temps.
 		model.push(); {
 			model.translate({0, 6, -10});
 			model.rotate(scanAngle, {0, 1, 0});
 			model.rotate(20, {1, 0, 0});
-			basicProg.setMat(model);
+			submitDraw(eye, texEye);
 		} model.pop();
-		texEye.bindToTextureUnit(0);
-		eye.draw();
 
 		// La TV et l'écran (le quad texturé à l'intérieur de la TV). Ils ont le même positionnement et mise à l'échelle, donc même matrice de modélisation.
-		model.push(); {
-			model.translate({0, 2.5, -9.45});
-			model.scale({(float)texRender.size.x / texRender.size.y, 1, 1});
-			model.scale({2, 2, 1});
-			basicProg.setMat(model);
-		} model.pop();
-		texSteel.bindToTextureUnit(0);
-		tv.draw();
-		// Ici on utilise la texture de rendu comme texture de l'objet. C'est tout ça le but d'utiliser une texture comme sortie du framebuffer, pas besoin de lire vers le CPU pour ensuite renvoyer sur le GPU; tout reste dans la mémoire graphique.
-		texRender.bindToTextureUnit(0);
-		quad.draw();
+		if (showingTv) {
+			model.push(); {
+				model.translate({0, 2.5, -9.45});
+				model.scale({camAspect, 1, 1});
+				model.scale({2, 2, 1});
+				submitDraw(tv, texSteel);
+				// Ici on utilise la texture de rendu comme texture de l'objet. C'est tout ça le but d'utiliser une texture comme sortie du framebuffer, pas besoin de lire vers le CPU pour ensuite renvoyer sur le GPU; tout reste dans la mémoire graphique.
+				if (screenTexture != nullptr)
+					submitDraw(quad, *screenTexture);
+			} model.pop();
+		}
+
+		// Tout dessiner, trié par texture et mesh plutôt que dans l'ordre du code.
+		renderQueue.flush();
+	}
+
+	// Soumettre un objet à la file de rendu avec la matrice de modélisation courante.
+	void submitDraw(Mesh& mesh, Texture& tex) {
+		renderQueue.submit({&basicProg, &mesh, {&tex}, model.top()});
 	}
 
 	void applyPerspective(float fovy, float aspect) {
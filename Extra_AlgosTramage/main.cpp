@@ -65,11 +65,11 @@ struct App : public OpenGLApplication
 		);
 
 		// Pas de test de profondeur pour aujourd'hui, on fait tout en 2D.
-		glDisable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glClearColor(0.75, 0.75, 0.75, 1);
+		glState.disable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.clearColor(0.75, 0.75, 0.75, 1);
 
 		loadShaders();
 
@@ -90,7 +90,7 @@ struct App : public OpenGLApplication
 
 		gridPoints.bindVao();
 		glGenBuffers(1, &activeFragsVbo);
-		glBindBuffer(GL_ARRAY_BUFFER, activeFragsVbo);
+		glState.bindBuffer(GL_ARRAY_BUFFER, activeFragsVbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(activeFrags), activeFrags, GL_DYNAMIC_DRAW);
 		glVertexAttribPointer(3, 1, GL_UNSIGNED_BYTE, GL_FALSE, 1, 0);
 		glEnableVertexAttribArray(3);
@@ -162,7 +162,7 @@ struct App : public OpenGLApplication
 	void onClose() override {
 		gridLines.deleteObjects();
 		gridPoints.deleteObjects();
-		glDeleteBuffers(1, &activeFragsVbo);
+		glState.deleteBuffers(1, &activeFragsVbo);
 		activeFragsVbo = 0;
 		referenceLines.deleteObjects();
 		globalColorProg.deleteShaders();
@@ -320,8 +320,8 @@ struct App : public OpenGLApplication
 		static const float sectionAngle = 360.0f / numSections;
 
 		vec3 offset = vec3(center.x + 0.5, center.y + 0.5, 0);
-		TransformStack rotation;
-		rotation.rotate(sectionAngle, {0, 0, 1});
+		// Calculée une seule fois : un TransformStack (une std::stack) alloue de la mémoire à chaque construction, donc à chaque trame.
+		static const mat4 rotation = glm::rotate(mat4(1), radians(sectionAngle), vec3(0, 0, 1));
 
 		vec4 p0 = vec4(radius, 0, 0, 1);
 		vec4 p1 = p0;
@@ -336,7 +336,7 @@ struct App : public OpenGLApplication
 	void drawFragments() {
 		quadGenProg.use();
 		gridPoints.bindVao();
-		glBindBuffer(GL_ARRAY_BUFFER, activeFragsVbo);
+		glState.bindBuffer(GL_ARRAY_BUFFER, activeFragsVbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(activeFrags), activeFrags, GL_DYNAMIC_DRAW);
 		gridPoints.draw(GL_POINTS);
 	}
@@ -344,7 +344,7 @@ struct App : public OpenGLApplication
 	void drawReferenceLines() {
 		static const vec4 lineColor = {0.0, 0.0, 0.75, 1};
 
-		glEnable(GL_LINE_SMOOTH);
+		glState.enable(GL_LINE_SMOOTH);
 		glLineWidth(5);
 
 		referenceLines.updateBuffers();
@@ -357,8 +357,8 @@ struct App : public OpenGLApplication
 	}
 
 	void drawGrid() {
-		glDisable(GL_LINE_SMOOTH);
-		glEnable(GL_POINT_SMOOTH);
+		glState.disable(GL_LINE_SMOOTH);
+		glState.enable(GL_POINT_SMOOTH);
 		glLineWidth(2);
 		glPointSize(4);
 
@@ -0,0 +1,116 @@
+#include <cstddef>
+#include <cstdlib>
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <inf2705/AssetPack.hpp>
+
+
+// Outil qui regroupe les ressources d'un exemple (maillages, textures, nuanceurs) dans un seul paquet (voir inf2705/AssetPack.hpp), sans fenêtre ni OpenGL.
+// Les chemins dans le paquet sont relatifs au dossier donné, c'est-à-dire les mêmes que ceux que l'exemple passe à readFile, Texture::loadFromFile, etc. quand il roule dans son dossier.
+
+
+const char* usage =
+	"Utilisation :\n"
+	"    Extra_AssetPacker DOSSIER [--out=FICHIER] [--compress] [--align=N] [--ext=.png,.obj,...]\n"
+	"    Extra_AssetPacker --list FICHIER.pack";
+
+// Les dossiers d'un exemple qui ne contiennent pas de ressources, mais des sorties de l'application ou de la compilation.
+const std::vector<std::string> skippedFolders = {"doc", "build", "out", "screenshots", "frames", "recording", "traces", "benchmarks"};
+
+std::vector<std::string> splitExtensions(const std::string& list) {
+	std::vector<std::string> extensions;
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t end = std::min(list.find(',', start), list.size());
+		std::string extension = list.substr(start, end - start);
+		if (not extension.empty())
+			extensions.push_back(extension.starts_with(".") ? extension : "." + extension);
+		start = end + 1;
+	}
+	return extensions;
+}
+
+std::string formatBytes(uint64_t numBytes) {
+	if (numBytes < 1024)
+		return std::format("{} o", numBytes);
+	if (numBytes < 1024 * 1024)
+		return std::format("{:.1f} Kio", numBytes / 1024.0);
+	return std::format("{:.2f} Mio", numBytes / (1024.0 * 1024.0));
+}
+
+int listPack(const std::string& path) {
+	AssetPack pack;
+	if (not pack.open(path))
+		return 1;
+	std::cout << std::format("{:<48} {:>12} {:>12} {:>10} {:>6}", "fichier", "original", "stocké", "position", "lz4") << "\n";
+	for (auto&& entry : pack.getEntries()) {
+		bool isCompressed = entry.compression == AssetCompression::Lz4;
+		std::cout << std::format("{:<48} {:>12} {:>12} {:>10} {:>6}", entry.path, formatBytes(entry.originalSize), formatBytes(entry.storedSize), entry.offset, isCompressed ? "oui" : "") << "\n";
+	}
+	return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+	std::string folder;
+	std::string outputPath;
+	std::string listPath;
+	AssetPackBuildSettings settings;
+	std::vector<std::string> extensions = {
+		".obj", ".mtl",
+		".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif",
+		".glsl", ".vert", ".frag", ".geom", ".comp", ".tesc", ".tese",
+	};
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--list" and i + 1 < argc)
+			listPath = argv[++i];
+		else if (arg.starts_with("--out="))
+			outputPath = arg.substr(6);
+		else if (arg == "--compress")
+			settings.compress = true;
+		else if (arg.starts_with("--align="))
+			settings.alignment = (size_t)std::max(std::atoi(arg.c_str() + 8), 1);
+		else if (arg.starts_with("--ext="))
+			extensions = splitExtensions(arg.substr(6));
+		else if (not arg.starts_with("--") and folder.empty())
+			folder = arg;
+		else {
+			std::cout << usage << std::endl;
+			return 1;
+		}
+	}
+
+	if (not listPath.empty())
+		return listPack(listPath);
+	if (folder.empty() or not std::filesystem::is_directory(folder)) {
+		std::cout << usage << std::endl;
+		return 1;
+	}
+	if (outputPath.empty())
+		outputPath = (std::filesystem::path(folder) / "assets.pack").string();
+
+	AssetPackBuilder builder;
+	if (builder.addFolder(folder, extensions, skippedFolders) == 0) {
+		std::cerr << "Aucune ressource trouvée dans " << folder << std::endl;
+		return 1;
+	}
+	AssetPackBuildStats stats;
+	if (not builder.write(outputPath, settings, &stats))
+		return 1;
+
+	std::cout << std::format(
+		"{} : {} fichiers ({} compressés), {} -> {}",
+		outputPath,
+		stats.numFiles,
+		stats.numCompressed,
+		formatBytes(stats.originalBytes),
+		formatBytes(stats.packBytes)
+	) << std::endl;
+}
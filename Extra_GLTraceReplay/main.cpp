@@ -0,0 +1,173 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+#include <SFML/Window.hpp>
+
+#include <inf2705/Benchmark.hpp>
+#include <inf2705/Framebuffer.hpp>
+#include <inf2705/GLTrace.hpp>
+#include <inf2705/GpuProfiler.hpp>
+#include <inf2705/HeadlessContext.hpp>
+
+using namespace gl;
+using namespace glm;
+
+
+// Rejoue une trace enregistrée avec --gl-trace par n'importe quel exemple, sans fenêtre et aussi vite que possible.
+// La première trame (init() et la première trame dessinée) est rejouée une seule fois, puis les autres le sont --loops fois. Comme il n'y a plus de logique d'application, seul le coût des appels OpenGL (pilote et GPU) est mesuré.
+// Avec --compare=AUTRE, on compare plutôt le nombre d'appels de chaque fonction entre deux traces, par exemple avant et après une optimisation, sans rien exécuter.
+
+
+void printUsage() {
+	std::cout << "Utilisation : Extra_GLTraceReplay TRACE.gltrace [--loops=N] [--compare=AUTRE.gltrace]" << std::endl;
+}
+
+// Les fonctions triées par nombre d'appels décroissant.
+std::vector<std::pair<std::string, int>> sortByCount(const std::unordered_map<std::string, int>& counts) {
+	std::vector<std::pair<std::string, int>> sorted(counts.begin(), counts.end());
+	std::sort(sorted.begin(), sorted.end(), [](auto&& a, auto&& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+	return sorted;
+}
+
+void compareTraces(const GLTraceFile& trace, const GLTraceFile& other) {
+	auto counts = trace.countCalls();
+	auto otherCounts = other.countCalls();
+	for (auto&& [name, count] : otherCounts)
+		counts.try_emplace(name, 0);
+
+	int numFrames = std::max((int)trace.frames.size(), 1);
+	int otherNumFrames = std::max((int)other.frames.size(), 1);
+	std::cout << std::format("{:<36} {:>12} {:>12} {:>10}", "Appels par trame", "trace", "autre", "écart") << "\n";
+	int total = 0;
+	int otherTotal = 0;
+	for (auto&& [name, count] : sortByCount(counts)) {
+		int otherCount = otherCounts.contains(name) ? otherCounts.at(name) : 0;
+		total += count;
+		otherTotal += otherCount;
+		if (count * otherNumFrames == otherCount * numFrames)
+			continue;
+		float perFrame = (float)count / numFrames;
+		float otherPerFrame = (float)otherCount / otherNumFrames;
+		std::cout << std::format("{:<36} {:>12.1f} {:>12.1f} {:>+10.1f}", name, perFrame, otherPerFrame, otherPerFrame - perFrame) << "\n";
+	}
+	std::cout << std::format("{:<36} {:>12.1f} {:>12.1f} {:>+10.1f}", "Total", (float)total / numFrames, (float)otherTotal / otherNumFrames, (float)otherTotal / otherNumFrames - (float)total / numFrames) << std::endl;
+}
+
+
+int main(int argc, char* argv[]) {
+	std::string tracePath;
+	std::string comparePath;
+	int numLoops = 10;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.starts_with("--loops="))
+			numLoops = std::max(std::atoi(arg.c_str() + 8), 1);
+		else if (arg.starts_with("--compare="))
+			comparePath = arg.substr(10);
+		else if (not arg.starts_with("--"))
+			tracePath = arg;
+	}
+	if (tracePath.empty()) {
+		printUsage();
+		return 1;
+	}
+
+	GLTraceFile trace;
+	if (not trace.load(tracePath))
+		return 1;
+	int numCalls = 0;
+	for (auto&& frame : trace.frames)
+		numCalls += (int)frame.calls.size();
+	std::cout << std::format("{} : {} trames, {} appels, {}x{}, OpenGL {}.{} ({})", tracePath, trace.frames.size(), numCalls, trace.width, trace.height, trace.majorVersion, trace.minorVersion, trace.isCoreProfile() ? "core" : "compatibilité") << std::endl;
+
+	if (not comparePath.empty()) {
+		GLTraceFile other;
+		if (not other.load(comparePath))
+			return 1;
+		compareTraces(trace, other);
+		return 0;
+	}
+
+	// Un contexte de la même version, du même profil (les exemples sont en profil de compatibilité, le défaut de SFML) et avec les mêmes drapeaux que celui de l'enregistrement, pour que le pilote prenne les mêmes chemins.
+	sf::ContextSettings contextSettings;
+	contextSettings.majorVersion = trace.majorVersion;
+	contextSettings.minorVersion = trace.minorVersion;
+	contextSettings.attributeFlags = sf::ContextSettings::Default;
+	if (trace.isCoreProfile())
+		contextSettings.attributeFlags |= sf::ContextSettings::Core;
+	if (trace.isDebugContext())
+		contextSettings.attributeFlags |= sf::ContextSettings::Debug;
+	HeadlessContext context;
+	if (not context.create(contextSettings))
+		return 1;
+	context.initializeGLBinding();
+	glState.invalidate();
+
+	// Le framebuffer de la fenêtre d'origine est remplacé par un FBO de même taille.
+	ivec2 size = {(int)trace.width, (int)trace.height};
+	RenderTarget color = RenderTarget::create({size, GL_RGBA8});
+	RenderTarget depth = RenderTarget::create({size, GL_DEPTH24_STENCIL8});
+	Framebuffer framebuffer;
+	framebuffer.create();
+	framebuffer.attachColor(0, color);
+	framebuffer.attachDepth(depth);
+	if (not framebuffer.finalize())
+		return 1;
+	GLTracePlayer player;
+	player.setDefaultFramebuffer(framebuffer.getObject());
+
+	player.playFrame(trace, trace.frames[0]);
+	glFinish();
+
+	// Les trames suivantes en boucle, chronométrées une par une côté CPU (soumission) et GPU (exécution).
+	GpuProfiler gpuProfiler;
+	gpuProfiler.setup(4, numLoops * (int)trace.frames.size());
+	std::vector<float> cpuMs;
+	auto startTime = std::chrono::steady_clock::now();
+	for (int loop = 0; loop < numLoops; loop++) {
+		for (size_t i = 1; i < trace.frames.size(); i++) {
+			auto frameStart = std::chrono::steady_clock::now();
+			gpuProfiler.beginFrame();
+			gpuProfiler.begin("trame");
+			player.playFrame(trace, trace.frames[i]);
+			gpuProfiler.end();
+			glFlush();
+			cpuMs.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+		}
+	}
+	glFinish();
+	float totalSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+	// Quelques trames de plus pour lire les dernières requêtes du profileur.
+	for (int i = 0; i < 4; i++)
+		gpuProfiler.beginFrame();
+
+	std::cout << "\n" << std::format("{} trames rejouées en {:.3f} s ({:.1f} trames/s)", cpuMs.size(), totalSeconds, cpuMs.size() / std::max(totalSeconds, 1e-6f)) << "\n";
+	PercentileStats cpu = PercentileStats::compute(cpuMs);
+	std::cout << std::format("{:<24} {:>8} {:>8} {:>8} {:>8} {:>8}", "CPU (ms)", "p50", "p95", "p99", "max", "moy") << "\n";
+	std::cout << std::format("{:<24} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f}", "trame", cpu.p50, cpu.p95, cpu.p99, cpu.max, cpu.avg) << "\n";
+	gpuProfiler.print(std::cout);
+
+	std::unordered_map<std::string, int> counts;
+	for (size_t i = 0; i < player.getCallCounts().size(); i++)
+		counts[trace.functionNames[i]] = player.getCallCounts()[i];
+	std::cout << "\n" << std::format("{:<36} {:>12}", "Appels rejoués", "nombre") << "\n";
+	for (auto&& [name, count] : sortByCount(counts))
+		std::cout << std::format("{:<36} {:>12}{}", name, count, GLTraceFunctionTable::get().find(name) != nullptr ? "" : "  (sauté)") << "\n";
+	std::cout << std::format("Appels sautés : {}, objets renommés : {}", player.getNumSkippedCalls(), player.getNumRenamedObjects()) << std::endl;
+
+	gpuProfiler.deleteObjects();
+	framebuffer.deleteObject();
+	color.deleteObject();
+	depth.deleteObject();
+}
@@ -0,0 +1,17 @@
+#version 410
+
+
+in vec3 normal;
+flat in vec4 instanceColor;
+
+out vec4 fragColor;
+
+
+const vec3 lightDirection = normalize(vec3(0.3, 1, 0.5));
+
+
+void main() {
+	// Un éclairage diffus très simple, juste assez pour distinguer les faces des cubes.
+	float diffuse = max(dot(normalize(normal), lightDirection), 0);
+	fragColor = vec4(instanceColor.rgb * (0.3 + 0.7 * diffuse), instanceColor.a);
+}
@@ -0,0 +1,22 @@
+#version 410
+
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+// Attributs d'instance (voir InstanceData dans Mesh.hpp). La matrice occupe les locations 4 à 7.
+layout(location = 4) in mat4 a_model;
+layout(location = 8) in vec4 a_color;
+
+uniform mat4 view = mat4(1);
+uniform mat4 projection = mat4(1);
+
+out vec3 normal;
+flat out vec4 instanceColor;
+
+
+void main() {
+	gl_Position = projection * view * a_model * vec4(a_position, 1.0);
+	// Les cubes n'ont pas de mise à l'échelle, la partie 3x3 de la matrice suffit pour les normales.
+	normal = mat3(a_model) * a_normal;
+	instanceColor = a_color;
+}
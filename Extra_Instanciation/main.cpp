@@ -0,0 +1,459 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <inf2705/OpenGLApplication.hpp>
+#include <inf2705/CommandList.hpp>
+#include <inf2705/IndirectCulling.hpp>
+#include <inf2705/InstanceBuilder.hpp>
+#include <inf2705/Mesh.hpp>
+#include <inf2705/OrbitCamera.hpp>
+#include <inf2705/ShaderProgram.hpp>
+#include <inf2705/TransformStack.hpp>
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Un cube unitaire centré à l'origine, avec des normales par face (donc 24 sommets plutôt que 8).
+Mesh createCubeMesh() {
+	Mesh mesh;
+	vec3 normals[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+	for (vec3 n : normals) {
+		// Deux axes perpendiculaires à la normale pour placer les coins de la face.
+		vec3 u = vec3(n.y, n.z, n.x);
+		vec3 v = cross(n, u);
+		GLuint first = (GLuint)mesh.vertices.size();
+		vec2 corners[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+		for (vec2 c : corners)
+			mesh.vertices.push_back({0.5f * (n + c.x * u + c.y * v), n, c * 0.5f + 0.5f, vec4(1)});
+		for (GLuint i : {0, 1, 2, 0, 2, 3})
+			mesh.indices.push_back(first + i);
+	}
+	mesh.setup();
+	return mesh;
+}
+
+// Un octaèdre de même taille que le cube, aussi avec des normales par face.
+Mesh createOctahedronMesh() {
+	Mesh mesh;
+	for (int face = 0; face < 8; face++) {
+		// Chaque face touche un demi-axe de chaque dimension. Les bits du numéro de face donnent les signes.
+		vec3 s = {(face & 1) ? -1 : 1, (face & 2) ? -1 : 1, (face & 4) ? -1 : 1};
+		vec3 corners[] = {{s.x * 0.5f, 0, 0}, {0, s.y * 0.5f, 0}, {0, 0, s.z * 0.5f}};
+		// Garder le sens antihoraire vu de l'extérieur quand un nombre impair de signes est négatif.
+		if (s.x * s.y * s.z < 0)
+			std::swap(corners[1], corners[2]);
+		vec3 n = normalize(s);
+		GLuint first = (GLuint)mesh.vertices.size();
+		for (vec3 c : corners)
+			mesh.vertices.push_back({c, n, vec2(0), vec4(1)});
+		for (GLuint i : {0, 1, 2})
+			mesh.indices.push_back(first + i);
+	}
+	mesh.setup();
+	return mesh;
+}
+
+
+// Les façons de dessiner les objets qu'on compare.
+enum class DrawMethod
+{
+	Individual, // Un appel de dessin par objet.
+	Recorded,   // Un appel par objet aussi, mais enregistré en parallèle dans des listes de commandes puis rejoué.
+	Instanced,  // Un appel par mesh avec InstanceBuilder.
+	GpuCulling, // Élimination sur le GPU et glMultiDrawElementsIndirect.
+	CpuCulling, // Même chose, mais l'élimination est faite sur le CPU.
+};
+
+const char* drawMethodNames[] = {"individuel", "listes", "instances", "élim. GPU", "élim. CPU"};
+constexpr int numDrawMethods = 5;
+
+
+struct App : public OpenGLApplication
+{
+	static constexpr int minNumInstances = 10;
+	static constexpr int maxNumInstances = 1'000'000;
+
+	Mesh meshes[2]; // Cube et octaèdre.
+	MeshPack meshPack; // Les deux mêmes mesh, dans des tampons communs pour le dessin indirect.
+	IndirectCuller culler;
+	ShaderProgram instancedProg;
+	ShaderProgram singleProg;
+	ShaderProgram* programs[2] = {&instancedProg, &singleProg};
+	GLuint singleModelLoc = 0;
+	GLuint singleColorLoc = 0;
+
+	InstanceBuilder builder;
+	std::vector<CommandList> commandLists; // Une par fil d'enregistrement.
+	double statsRecordMs = 0;
+	std::vector<CullingObject> objects; // Tous les objets de la scène (refaits quand le nombre change).
+
+	TransformStack view = {"view"};
+	TransformStack projection = {"projection"};
+	mat4 projectionMatrix = mat4(1);
+	OrbitCamera camera = {60, 30, 30, 0};
+
+	int numInstances = 1000;
+	DrawMethod drawMethod = DrawMethod::Instanced;
+	bool animate = true;
+	float time = 0;
+
+	// Statistiques accumulées depuis le dernier affichage.
+	int statsNumFrames = 0;
+	double statsTotalMs = 0;
+	double statsMinMs = 0;
+	double statsMaxMs = 0;
+	double statsCpuMs = 0;
+	std::chrono::high_resolution_clock::time_point statsStart;
+
+	// Appelée avant la première trame.
+	void init() override {
+		setKeybindMessage(
+			"F5 : capture d'écran." "\n"
+			"R : réinitialiser la position de la caméra." "\n"
+			"+ et - :  rapprocher et éloigner la caméra orbitale." "\n"
+			"haut/bas : changer la latitude de la caméra orbitale." "\n"
+			"gauche/droite : changer la longitude ou le roulement (avec shift) de la caméra orbitale." "\n"
+			"clic droit ou central : bouger la caméra en glissant la souris." "\n"
+			"roulette : rapprocher et éloigner la caméra orbitale." "\n"
+			"page haut/bas : multiplier/diviser par 10 le nombre d'instances (de 10 à 1 000 000)." "\n"
+			"M : changer la méthode de dessin (individuel, listes de commandes, instances, élimination sur le GPU, élimination sur le CPU)." "\n"
+			"T : enregistrer les listes de commandes sur un seul fil ou sur tous les coeurs." "\n"
+			"A : activer/désactiver l'animation (les données d'instances sont alors refaites à chaque trame)." "\n"
+			"P : afficher le temps CPU de la dernière trame par portée et écrire la trace CPU des dernières trames (dossier traces)." "\n"
+			"V : comparer l'élimination du GPU à celle du CPU." "\n"
+		);
+
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_CULL_FACE);
+		glState.clearColor(0.1f, 0.1f, 0.15f, 1.0f);
+
+		loadShaders();
+		meshes[0] = createCubeMesh();
+		meshes[1] = createOctahedronMesh();
+		for (auto&& mesh : meshes)
+			meshPack.add(mesh);
+		meshPack.setup();
+		culler.setup(meshPack);
+		if (not culler.isGpuCullingSupported())
+			std::cout << "OpenGL 4.3 non disponible : l'élimination est toujours faite sur le CPU." << std::endl;
+		createObjects();
+		setNumRecordThreads(std::max(1u, std::thread::hardware_concurrency()));
+
+		for (auto&& prog : programs)
+			camera.updateProgram(*prog, view);
+		applyPerspective();
+
+		statsStart = std::chrono::high_resolution_clock::now();
+	}
+
+	// En mode sur demande (--on-demand), on dessine toutes les trames tant que les objets sont animés.
+	bool isAnimating() const override { return animate; }
+
+	// Appelée à chaque trame. Le buffer swap est fait juste après.
+	void drawFrame() override {
+		auto cpuStart = std::chrono::high_resolution_clock::now();
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		bool isCulling = drawMethod == DrawMethod::GpuCulling or drawMethod == DrawMethod::CpuCulling;
+		// Avec l'élimination, les objets sont statiques : les animer voudrait dire renvoyer toutes les sphères englobantes à chaque trame, ce qu'on veut justement éviter.
+		// Avec les listes de commandes, l'animation est faite pendant l'enregistrement, sur les fils de travail.
+		if (animate and not isCulling and drawMethod != DrawMethod::Recorded) {
+			time += getFrameDeltaTime();
+			animateObjects();
+		}
+
+		switch (drawMethod) {
+		case DrawMethod::Individual:
+			// La façon naïve : une mise à jour de variables uniformes et un appel de dessin par objet.
+			singleProg.use();
+			for (auto&& obj : objects) {
+				singleProg.setMat(singleModelLoc, obj.instance.model);
+				singleProg.setVec(singleColorLoc, obj.instance.color);
+				meshes[obj.meshIndex].draw();
+			}
+			break;
+		case DrawMethod::Recorded: {
+			// Le même travail qu'en mode individuel, mais séparé en deux. D'abord, chaque fil parcourt sa tranche d'objets, calcule leur matrice et enregistre les variables uniformes et l'appel de dessin dans sa liste, sans toucher à OpenGL. Ensuite, le fil d'OpenGL rejoue les listes dans l'ordre.
+			if (animate)
+				time += getFrameDeltaTime();
+			auto recordStart = std::chrono::high_resolution_clock::now();
+			recordInParallel(commandLists, objects.size(), [&](CommandList& list, size_t begin, size_t end) {
+				// Chaque fil a son propre anneau dans le profileur CPU : la trace montre les tranches côte à côte.
+				CPU_PROFILE_SCOPE("Enregistrement d'une tranche");
+				list.setProgram(singleProg);
+				for (size_t i = begin; i < end; i++) {
+					auto& obj = objects[i];
+					if (animate)
+						obj.instance.model = computeAnimatedModel(obj);
+					list.setUniform(singleModelLoc, obj.instance.model);
+					list.setUniform(singleColorLoc, obj.instance.color);
+					list.draw(meshes[obj.meshIndex]);
+				}
+			});
+			auto recordEnd = std::chrono::high_resolution_clock::now();
+			statsRecordMs += std::chrono::duration<double, std::milli>(recordEnd - recordStart).count();
+			CPU_PROFILE_SCOPE("Rejeu des listes");
+			CommandList::replay(commandLists);
+			break;
+		}
+		case DrawMethod::Instanced:
+			// Tout passe par le constructeur de lots, comme le ferait une vraie scène avec des objets soumis un par un. Il y a deux mesh, donc deux lots et deux appels de dessin.
+			instancedProg.use();
+			{
+				CPU_PROFILE_SCOPE("Collecte des instances");
+				for (auto&& obj : objects)
+					builder.add(meshes[obj.meshIndex], obj.instance);
+			}
+			builder.draw();
+			builder.clear();
+			break;
+		case DrawMethod::GpuCulling:
+		case DrawMethod::CpuCulling:
+			// Le CPU ne touche plus aux objets : quelques appels pour l'élimination, puis un seul glMultiDrawElementsIndirect.
+			culler.cull(projectionMatrix * view.top());
+			instancedProg.use();
+			culler.draw();
+			break;
+		}
+
+		auto cpuEnd = std::chrono::high_resolution_clock::now();
+		statsCpuMs += std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count();
+		updateStats();
+	}
+
+	// Appelée lorsque la fenêtre se ferme.
+	void onClose() override {
+		for (auto&& mesh : meshes)
+			mesh.deleteObjects();
+		meshPack.deleteObjects();
+		culler.deleteObjects();
+		for (auto prog : programs) {
+			prog->deleteShaders();
+			prog->deleteProgram();
+		}
+	}
+
+	// Appelée lors d'une touche de clavier.
+	void onKeyPress(const sf::Event::KeyPressed& key) override {
+		camera.handleKeyEvent(key, 5, 2, {60, 30, 30, 0});
+
+		using enum sf::Keyboard::Key;
+		switch (key.code) {
+		case PageUp:
+			setNumInstances(numInstances * 10);
+			break;
+		case PageDown:
+			setNumInstances(numInstances / 10);
+			break;
+		case M:
+			setDrawMethod(DrawMethod(((int)drawMethod + 1) % numDrawMethods));
+			break;
+		case T:
+			setNumRecordThreads(commandLists.size() > 1 ? 1 : std::max(1u, std::thread::hardware_concurrency()));
+			break;
+		case V:
+			if (culler.isGpuCullingSupported() and culler.fitsInStorageBlocks()) {
+				bool ok = culler.validate(projectionMatrix * view.top());
+				std::cout << std::format(
+					"Validation de l'élimination : {} ({} objets visibles selon le CPU)",
+					ok ? "identique" : "DIFFÉRENTE", culler.getLastStats().numVisible
+				) << std::endl;
+			}
+			break;
+		case A:
+			animate = not animate;
+			std::cout << "Animation " << (animate ? "activée" : "désactivée") << std::endl;
+			resetStats();
+			break;
+
+		case P: {
+			std::cout << "Temps CPU de la dernière trame :" << "\n";
+			cpuProfiler.printLastFrame(std::cout);
+			saveCpuTrace();
+			break;
+		}
+
+		case F5:
+			std::string path = saveScreenshot();
+			std::cout << "Capture d'écran dans " << path << std::endl;
+			break;
+		}
+
+		for (auto&& prog : programs)
+			camera.updateProgram(*prog, view);
+	}
+
+	// Appelée lors d'un mouvement de souris.
+	void onMouseMove(const sf::Event::MouseMoved& mouseDelta) override {
+		auto mouse = getMouse();
+		camera.handleMouseMoveEvent(mouseDelta, mouse, deltaTime_ / (0.7f/30));
+		for (auto&& prog : programs)
+			camera.updateProgram(*prog, view);
+	}
+
+	// Appelée lors d'un défilement de souris.
+	void onMouseScroll(const sf::Event::MouseWheelScrolled& mouseScroll) override {
+		camera.altitude -= mouseScroll.delta * 5;
+		for (auto&& prog : programs)
+			camera.updateProgram(*prog, view);
+	}
+
+	// Appelée lorsque la fenêtre se redimensionne (juste après le redimensionnement).
+	void onResize(const sf::Event::Resized& event) override {
+		applyPerspective();
+	}
+
+	void setNumInstances(int n) {
+		n = std::clamp(n, minNumInstances, maxNumInstances);
+		if (n == numInstances)
+			return;
+		numInstances = n;
+		createObjects();
+		std::cout << std::format("{} instances", numInstances) << std::endl;
+		resetStats();
+	}
+
+	void setNumRecordThreads(size_t n) {
+		commandLists.resize(n);
+		std::cout << std::format("{} fil(s) d'enregistrement", n) << std::endl;
+		resetStats();
+	}
+
+	void setDrawMethod(DrawMethod method) {
+		drawMethod = method;
+		if (drawMethod == DrawMethod::GpuCulling or drawMethod == DrawMethod::CpuCulling) {
+			culler.setUseGpu(drawMethod == DrawMethod::GpuCulling);
+			// Prendre la position actuelle des objets (qui ont peut-être été animés).
+			culler.setObjects(objects);
+		}
+		std::cout << "Méthode de dessin : " << drawMethodNames[(int)drawMethod] << std::endl;
+		resetStats();
+	}
+
+	// Placer les objets dans une grille 3D à peu près cubique, centrée à l'origine, en alternant cubes et octaèdres. La couleur dépend de la position dans la grille et le ID est simplement l'index (commençant à 1, 0 étant le fond pour la sélection).
+	void createObjects() {
+		int side = (int)std::ceil(std::cbrt((double)numInstances));
+		float spacing = 1.5f;
+		float offset = (side - 1) * spacing / 2;
+		objects.resize(numInstances);
+		for (int i = 0; i < numInstances; i++) {
+			ivec3 cell = {i % side, (i / side) % side, i / (side * side)};
+			vec3 position = vec3(cell) * spacing - offset;
+			auto& obj = objects[i];
+			obj.meshIndex = (cell.x + cell.y + cell.z) % 2;
+			obj.instance.model = translate(mat4(1), position);
+			obj.instance.color = vec4(vec3(cell) / (float)std::max(side - 1, 1) * 0.8f + 0.2f, 1);
+			obj.instance.objectID = (uint32_t)i + 1;
+		}
+		// Reculer la caméra pour voir toute la grille. En rapprochant la caméra (roulette), une partie des objets sort du champ de vision et l'élimination commence à servir.
+		camera.altitude = std::max(10.0f, side * spacing * 1.5f);
+		animateObjects();
+		culler.setObjects(objects);
+	}
+
+	// Faire tourner chaque objet sur lui-même. On refait toutes les matrices à chaque trame, ce qui représente le cas où les données d'instances changent tout le temps.
+	void animateObjects() {
+		CPU_PROFILE_SCOPE("Animation");
+		for (auto&& obj : objects)
+			obj.instance.model = computeAnimatedModel(obj);
+	}
+
+	// Ne lit et ne modifie que l'objet donné, donc on peut l'appeler en parallèle sur des objets différents.
+	mat4 computeAnimatedModel(const CullingObject& obj) const {
+		vec3 position = vec3(obj.instance.model[3]);
+		float angle = time + position.x * 0.1f + position.z * 0.1f;
+		return rotate(translate(mat4(1), position), angle, {0, 1, 0});
+	}
+
+	void resetStats() {
+		statsNumFrames = 0;
+		statsTotalMs = 0;
+		statsMinMs = 0;
+		statsMaxMs = 0;
+		statsCpuMs = 0;
+		statsRecordMs = 0;
+		statsStart = std::chrono::high_resolution_clock::now();
+	}
+
+	// Accumuler le temps de trame et afficher la moyenne (et le min/max) à chaque seconde. Le temps de trame inclut l'attente du GPU faite par le buffer swap, le temps CPU seulement le code de drawFrame.
+	void updateStats() {
+		double frameMs = getFrameDeltaTime() * 1000.0;
+		statsMinMs = statsNumFrames == 0 ? frameMs : std::min(statsMinMs, frameMs);
+		statsMaxMs = statsNumFrames == 0 ? frameMs : std::max(statsMaxMs, frameMs);
+		statsTotalMs += frameMs;
+		statsNumFrames++;
+
+		auto now = std::chrono::high_resolution_clock::now();
+		if (now - statsStart < std::chrono::seconds(1))
+			return;
+		std::string details;
+		if (drawMethod == DrawMethod::CpuCulling)
+			details = std::format(", {} visibles", culler.getLastStats().numVisible);
+		// Au-delà de la taille maximale d'un tampon de stockage, l'élimination « GPU » se fait en réalité sur le CPU : on le dit pour ne pas fausser la comparaison.
+		if (drawMethod == DrawMethod::GpuCulling and not culler.isUsingGpu())
+			details = std::format(", élimination sur le CPU (trop d'objets pour un SSBO), {} visibles", culler.getLastStats().numVisible);
+		if (drawMethod == DrawMethod::Recorded)
+			details = std::format(", dont {:.3f} ms d'enregistrement sur {} fil(s)", statsRecordMs / statsNumFrames, commandLists.size());
+		std::cout << std::format(
+			"{:>9} objets, {:<10} : trame {:8.3f} ms (min {:.3f}, max {:.3f}), CPU {:8.3f} ms, {:.1f} M objets/s{}",
+			numInstances,
+			drawMethodNames[(int)drawMethod],
+			statsTotalMs / statsNumFrames,
+			statsMinMs,
+			statsMaxMs,
+			statsCpuMs / statsNumFrames,
+			numInstances / (statsTotalMs / statsNumFrames) / 1000.0,
+			details
+		) << std::endl;
+		resetStats();
+	}
+
+	void loadShaders() {
+		instancedProg.create();
+		instancedProg.attachSourceFile(GL_VERTEX_SHADER, "instanced_vert.glsl");
+		instancedProg.attachSourceFile(GL_FRAGMENT_SHADER, "color_frag.glsl");
+		instancedProg.link();
+		singleProg.create();
+		singleProg.attachSourceFile(GL_VERTEX_SHADER, "single_vert.glsl");
+		singleProg.attachSourceFile(GL_FRAGMENT_SHADER, "color_frag.glsl");
+		singleProg.link();
+		singleModelLoc = singleProg.getUniformLocation("model");
+		singleColorLoc = singleProg.getUniformLocation("color");
+	}
+
+	void applyPerspective(float fovy = 50) {
+		projection.pushIdentity();
+		projection.perspective(fovy, getWindowAspect(), 0.1f, 1000.0f);
+		projectionMatrix = projection.top();
+		for (auto&& prog : programs) {
+			prog->use();
+			prog->setMat("projection", projection);
+		}
+		projection.pop();
+	}
+};
+
+
+int main(int argc, char* argv[]) {
+	WindowSettings settings = {};
+	// On veut mesurer le temps de trame, donc on ne limite pas vraiment le framerate.
+	settings.fps = 1000;
+	settings.context.antiAliasingLevel = 4;
+
+	App app;
+	app.run(argc, argv, "Exemple Extra: Dessin par instances", settings);
+}
@@ -0,0 +1,21 @@
+#version 410
+
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+
+uniform mat4 model = mat4(1);
+uniform vec4 color = vec4(1);
+uniform mat4 view = mat4(1);
+uniform mat4 projection = mat4(1);
+
+out vec3 normal;
+flat out vec4 instanceColor;
+
+
+void main() {
+	// Même résultat que instanced_vert.glsl, mais la matrice et la couleur sont des variables uniformes changées avant chaque dessin.
+	gl_Position = projection * view * model * vec4(a_position, 1.0);
+	normal = mat3(model) * a_normal;
+	instanceColor = color;
+}
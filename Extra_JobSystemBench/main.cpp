@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <inf2705/JobSystem.hpp>
+
+
+// Microbanc d'essai du système de tâches (voir inf2705/JobSystem.hpp), sans fenêtre ni OpenGL.
+// Pour chaque nombre de fils (le fil principal compte pour un, puisqu'il exécute aussi des tâches pendant qu'il attend), on mesure :
+//    - le débit de petites tâches vides soumises par le fil principal (le coût de submit et de l'ordonnancement) ;
+//    - le débit d'un arbre de tâches qui en créent d'autres, où presque tout le travail se répartit par vol ;
+//    - le temps d'un parallelFor qui calcule vraiment quelque chose, et l'accélération par rapport à un seul fil.
+// Chaque mesure est répétée et on garde la meilleure, pour ne pas compter un fil qui aurait été préempté par le système.
+
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Le meilleur temps (en secondes) de numRepeats exécutions.
+double bestOf(int numRepeats, const std::function<void()>& run) {
+	double best = 1e30;
+	for (int i = 0; i < numRepeats; i++) {
+		auto start = Clock::now();
+		run();
+		best = std::min(best, secondsSince(start));
+	}
+	return best;
+}
+
+// Chaque tâche en crée deux autres jusqu'à la profondeur 0 : 2^(depth+1) - 2 tâches en tout, créées presque toutes par les fils de travail.
+void spawnTree(JobSystem& jobs, int depth) {
+	if (depth == 0)
+		return;
+	jobs.submit([&jobs, depth] { spawnTree(jobs, depth - 1); });
+	jobs.submit([&jobs, depth] { spawnTree(jobs, depth - 1); });
+}
+
+// Un peu de calcul pour que le parallelFor ait du vrai travail : environ la même chose pour chaque indice.
+float computeItem(size_t i) {
+	float x = (float)i * 0.001f;
+	float sum = 0;
+	for (int k = 0; k < 64; k++)
+		sum += std::sqrt(x + k) * std::sin(x * k);
+	return sum;
+}
+
+// Une chaîne de continuations : chaque maillon attend le précédent. Ça mesure la latence de la libération d'une dépendance plutôt que le débit.
+double measureChainMicroseconds(JobSystem& jobs, int length) {
+	auto start = Clock::now();
+	JobHandle previous = jobs.submit([] {});
+	for (int i = 1; i < length; i++)
+		previous = jobs.then(previous, [] {});
+	jobs.wait(previous);
+	return secondsSince(start) * 1e6 / length;
+}
+
+
+int main(int argc, char* argv[]) {
+	int maxThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+	int numEmptyJobs = 200'000;
+	int treeDepth = 16;
+	size_t numItems = 1 << 20;
+	int numRepeats = 3;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.starts_with("--max-threads="))
+			maxThreads = std::max(std::atoi(arg.c_str() + 14), 1);
+		else if (arg.starts_with("--jobs="))
+			numEmptyJobs = std::max(std::atoi(arg.c_str() + 7), 1);
+		else if (arg.starts_with("--items="))
+			numItems = (size_t)std::max(std::atoll(arg.c_str() + 8), 1LL);
+		else if (arg.starts_with("--repeat="))
+			numRepeats = std::max(std::atoi(arg.c_str() + 9), 1);
+		else {
+			std::cout << "Utilisation : Extra_JobSystemBench [--max-threads=N] [--jobs=N] [--items=N] [--repeat=N]" << std::endl;
+			return 1;
+		}
+	}
+
+	// 1, 2, 4, ... fils, et toujours le maximum.
+	std::vector<int> threadCounts;
+	for (int n = 1; n < maxThreads; n *= 2)
+		threadCounts.push_back(n);
+	threadCounts.push_back(maxThreads);
+
+	int numTreeJobs = (1 << (treeDepth + 1)) - 2;
+	std::vector<float> results(numItems);
+	std::cout << std::format("{} cœurs, {} tâches vides, arbre de {} tâches, parallelFor de {} éléments, meilleur de {} essais", std::thread::hardware_concurrency(), numEmptyJobs, numTreeJobs, numItems, numRepeats) << "\n\n";
+	std::cout << std::format("{:>5} {:>16} {:>16} {:>16} {:>12} {:>10} {:>10} {:>14}", "fils", "vides (M/s)", "arbre (M/s)", "parallelFor (ms)", "accél.", "efficacité", "vols", "chaîne (µs)") << "\n";
+
+	double singleThreadSeconds = 0;
+	for (int numThreads : threadCounts) {
+		JobSystem jobs;
+		jobs.start(numThreads - 1);
+
+		double emptySeconds = bestOf(numRepeats, [&] {
+			for (int i = 0; i < numEmptyJobs; i++)
+				jobs.submit([] {});
+			jobs.waitIdle();
+		});
+
+		size_t stolenBefore = jobs.getStats().numStolen;
+		double treeSeconds = bestOf(numRepeats, [&] {
+			spawnTree(jobs, treeDepth);
+			jobs.waitIdle();
+		});
+		size_t numStolen = (jobs.getStats().numStolen - stolenBefore) / numRepeats;
+
+		double forSeconds = bestOf(numRepeats, [&] {
+			jobs.parallelFor(0, numItems, [&](size_t i) { results[i] = computeItem(i); });
+		});
+		if (numThreads == 1)
+			singleThreadSeconds = forSeconds;
+		double speedup = singleThreadSeconds / forSeconds;
+
+		double chainMicroseconds = measureChainMicroseconds(jobs, 10'000);
+
+		std::cout << std::format(
+			"{:>5} {:>16.2f} {:>16.2f} {:>16.2f} {:>11.2f}x {:>9.0f}% {:>10} {:>14.2f}",
+			numThreads,
+			numEmptyJobs / emptySeconds / 1e6,
+			numTreeJobs / treeSeconds / 1e6,
+			forSeconds * 1e3,
+			speedup,
+			speedup / numThreads * 100,
+			numStolen,
+			chainMicroseconds
+		) << std::endl;
+		jobs.shutdown();
+	}
+
+	// Vérification : le résultat ne dépend pas du découpage.
+	double checksum = 0;
+	for (float value : results)
+		checksum += value;
+	std::cout << std::format("\nSomme de contrôle du parallelFor : {:.6e}", checksum) << std::endl;
+}
@@ -0,0 +1,15 @@
+#version 410
+
+
+in vec2 texCoords;
+flat in vec4 instanceColor;
+
+uniform sampler2D texMain;
+
+out vec4 fragColor;
+
+
+void main() {
+	// Échantillonnage habituel de la texture, teintée par la couleur de l'instance (blanc = aucun changement).
+	fragColor = texture(texMain, texCoords) * instanceColor;
+}
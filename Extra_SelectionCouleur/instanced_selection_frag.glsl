@@ -0,0 +1,13 @@
+#version 410
+
+
+flat in uint objectID;
+
+out vec4 fragColor;
+
+
+void main() {
+	// Même encodage que uintToVec4 dans main.cpp : les trois octets du bas du ID donnent les composantes RGB. Chaque instance a donc sa propre couleur de sélection même si elles sont toutes dessinées en un seul appel.
+	uvec3 bytes = (uvec3(objectID) >> uvec3(0, 8, 16)) & 0xFFu;
+	fragColor = vec4(vec3(bytes) / 255.0, 1);
+}
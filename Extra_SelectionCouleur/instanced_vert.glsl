@@ -0,0 +1,31 @@
+#version 410
+
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec2 a_texCoords;
+// Attributs d'instance (un par instance plutôt qu'un par sommet, voir InstanceData). La matrice occupe les locations 4 à 7.
+layout(location = 4) in mat4 a_model;
+layout(location = 8) in vec4 a_color;
+layout(location = 9) in uint a_objectID;
+
+uniform mat4 view = mat4(1);
+uniform mat4 projection = mat4(1);
+
+out vec2 texCoords;
+// Pas d'interpolation : c'est la même valeur pour tous les sommets de l'instance (et un entier ne peut pas être interpolé de toute façon).
+flat out vec4 instanceColor;
+flat out uint objectID;
+
+
+void main() {
+	// Même chose que basic_vert.glsl, mais la matrice de modélisation vient de l'instance plutôt que d'une variable uniforme.
+	vec4 worldPosition = a_model * vec4(a_position, 1.0);
+	vec4 viewPosition = view * worldPosition;
+	vec4 clipPosition = projection * viewPosition;
+
+	gl_Position = clipPosition;
+	texCoords = a_texCoords;
+	instanceColor = a_color;
+	objectID = a_objectID;
+}
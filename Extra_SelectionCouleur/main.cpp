@@ -1,8 +1,10 @@
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 
 #include <array>
 #include <cmath>
+#include <future>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -19,31 +21,15 @@
 #include <inf2705/ShaderProgram.hpp>
 #include <inf2705/Texture.hpp>
 #include <inf2705/TransformStack.hpp>
+#include <inf2705/RenderQueue.hpp>
+#include <inf2705/InstanceBuilder.hpp>
+#include <inf2705/AsyncReadback.hpp>
 
 
 using namespace gl;
 using namespace glm;
 
 
-// Un objet dessinable dans la scène.
-struct SceneObject
-{
-	unsigned id = 0; // ID unique de l'objet
-	std::string name; // Nom usuel de l'objet
-	Mesh* mesh = nullptr; // Le mesh utilisé
-	std::vector<BoundTexture> textures; // Les textures utilisées
-	TransformStack modelMat; // La matrice de modélisation propre à l'objet
-
-	void draw(ShaderProgram& prog) {
-		prog.use();
-		for (auto&& tex : textures)
-			tex.bindToProgram(prog);
-		prog.setMat(modelMat);
-		mesh->draw();
-	}
-};
-
-
 vec4 uintToVec4(uint32_t i) {
 	auto bytes = (uint8_t*)&i;
 	return vec4(bytes[0] / 255.0f, bytes[1] / 255.0f, bytes[2] / 255.0f, 1);
@@ -57,6 +43,42 @@ uint32_t vec4ToUInt(vec4 v) {
 }
 
 
+// Un objet dessinable dans la scène.
+struct SceneObject
+{
+	unsigned id = 0; // ID unique de l'objet
+	std::string name; // Nom usuel de l'objet
+	Mesh* mesh = nullptr; // Le mesh utilisé
+	std::vector<BoundTexture> textures; // Les textures utilisées
+	TransformStack modelMat; // La matrice de modélisation propre à l'objet
+
+	// Soumettre l'objet à la file de rendu avec le programme nuanceur donné. La matrice parente est appliquée avant celle de l'objet.
+	void submit(RenderQueue& queue, ShaderProgram& prog, const mat4& parentModel) {
+		DrawPacket packet = {&prog, mesh};
+		for (auto&& tex : textures) {
+			int unit = tex.activeUnit.get();
+			assert(unit >= 0 and unit < DrawPacket::maxTextures);
+			packet.textures[unit] = tex.texture;
+		}
+		packet.model = parentModel * modelMat.top();
+		// Le ID et la couleur de l'objet, ainsi que les unités de texture des échantillonneurs, sont des variables uniformes propres à l'objet.
+		packet.setUniforms = [this](ShaderProgram& prog) {
+			prog.setUint("objectID", id);
+			prog.setVec("objectColor", uintToVec4(id));
+			for (auto&& tex : textures)
+				prog.setUniform(tex.activeUnit);
+		};
+		queue.submit(std::move(packet));
+	}
+
+	// Ajouter l'objet comme instance de son mesh. Le ID va dans les données d'instance, ce qui garde la sélection par couleur fonctionnelle.
+	void addInstance(InstanceBuilder& builder, const mat4& parentModel) {
+		Texture* texture = textures.empty() ? nullptr : textures[0].texture;
+		builder.add(*mesh, parentModel * modelMat.top(), vec4(1), id, texture);
+	}
+};
+
+
 struct App : public OpenGLApplication
 {
 	Mesh meshBoard;
@@ -72,7 +94,12 @@ struct App : public OpenGLApplication
 	ShaderProgram basicProg;
 	ShaderProgram selectionProg;
 	ShaderProgram flashingProg;
-	ShaderProgram* programs[3] = {&basicProg, &selectionProg, &flashingProg};
+	ShaderProgram instancedProg;
+	ShaderProgram instancedSelectionProg;
+	ShaderProgram* programs[5] = {&basicProg, &selectionProg, &flashingProg, &instancedProg, &instancedSelectionProg};
+	RenderQueue renderQueue;
+	InstanceBuilder pieceInstances;
+	AsyncReadback readback;
 
 	TransformStack model = {"model"};
 	TransformStack view = {"view"};
@@ -82,6 +109,8 @@ struct App : public OpenGLApplication
 
 	sf::Event::MouseButtonPressed lastMouseBtnEvent = {};
 	bool selecting = false;
+	// Le pixel sous la souris, lu après la trame de sélection. Il arrive une ou deux trames plus tard.
+	std::future<std::vector<std::array<uint8_t, 3>>> pickedPixel;
 	unsigned selectedObjectID = 0;
 	float flashingValue = 0;
 
@@ -100,12 +129,12 @@ struct App : public OpenGLApplication
 			"espace : annuler la sélection." "\n"
 		);
 
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glDisable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glClearColor(0.1f, 0.2f, 0.2f, 1.0f);
+		glState.enable(GL_DEPTH_TEST);
+		glState.enable(GL_BLEND);
+		glState.disable(GL_CULL_FACE);
+		glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glState.clearColor(0.1f, 0.2f, 0.2f, 1.0f);
 
 		loadShaders();
 
@@ -129,47 +158,43 @@ struct App : public OpenGLApplication
 		applyPerspective();
 	}
 
+	// En mode sur demande (--on-demand), l'objet sélectionné clignote : on dessine toutes les trames tant qu'il y a une sélection.
+	bool isAnimating() const override { return selectedObjectID != 0; }
+
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
 	void drawFrame() override {
+		// Compléter les lectures dont le GPU a fini les copies et traiter la sélection si elle est arrivée.
+		readback.update();
+		if (isReady(pickedPixel))
+			handlePickedPixel(pickedPixel.get());
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Si on est mode de sélection (la trame suivant un clic de souris).
 		if (selecting) {
-			// Sauvegarder la couleur de fond actuelle.
-			vec4 clearColor = {};
-			glGetFloatv(GL_COLOR_CLEAR_VALUE, glm::value_ptr(clearColor));
+			// Sauvegarder la couleur de fond actuelle (glState la connaît, pas besoin de glGetFloatv).
+			auto clearColor = glState.getClearColor();
 			// Mettre un fond noir.
-			glClearColor(0, 0, 0, 1);
+			glState.clearColor(0, 0, 0, 1);
 			// Vider les tampons de couleurs (avec du noir) et de profondeur.
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			// Désactiver la fusion de couleur. Pour la sélection, on veut des couleurs pleines, uniformes et distinctes. Donc pas de transparence non plus.
-			glDisable(GL_BLEND);
+			glState.disable(GL_BLEND);
 			// Désactiver l'anticrenélage. Ça permet de ne pas avoir des erreurs aux bordures des objets.
-			glDisable(GL_MULTISAMPLE);
+			glState.disable(GL_MULTISAMPLE);
 			// Si on avait de l'éclairage, on ne l'appliquerait pas non plus.
 
 			// Dessiner la scène.
 			drawScene();
 
-			// Avant de lire le buffer de couleurs, il faut attendre que le dessinage soit fait. glFinish bloque jusqu'à la complétion des commandes envoyées au GPU. Généralement, on n'a pas besoin de faire cet appel car le buffer swap (Window::display avec SFML) le fait pour nous.
-			glFinish();
-
-			// Obtenir la couleur du pixel cliqué avec la souris. Cet couleur est un nombre 24 bit (RGB8, on ne peut pas utiliser le alpha) qui correspond à notre identifiant d'objet de scène.
-			unsigned clickedObj = getObjectIDUnderMouse(lastMouseBtnEvent);
-			if (clickedObj != 0)
-				std::cout << std::format("Sélection de l'objet 0x{:04X}", clickedObj) << "\n";
-			// Chercher dans le dictionnaire de théières (pieces) si le ID est reconnu. On choisit de ne pas pouvoir sélectionner la planche.
-			if (clickedObj != selectedObjectID and pieces.contains(clickedObj)) {
-				// Sélectionner l'objet et réinitialiser l'animation de clignotement.
-				selectedObjectID = clickedObj;
-				flashingValue = 0;
-			}
+			// Demander la couleur du pixel cliqué avec la souris. La lecture est mise en file comme les autres commandes et le résultat arrive dans une trame suivante (voir handlePickedPixel) : un glReadPixels vers la mémoire du CPU devrait attendre que le GPU ait fini tout le dessin.
+			pickedPixel = readPixelUnderMouse(lastMouseBtnEvent);
 
 			// Rétablir la configuration régulière.
 			selecting = false;
-			glEnable(GL_MULTISAMPLE);
-			glEnable(GL_BLEND);
-			glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+			glState.enable(GL_MULTISAMPLE);
+			glState.enable(GL_BLEND);
+			glState.clearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		}
 
@@ -185,6 +210,7 @@ struct App : public OpenGLApplication
 
 	// Appelée lorsque la fenêtre se ferme.
 	void onClose() override {
+		readback.deleteObjects();
 		meshBoard.deleteObjects();
 		meshTeapot.deleteObjects();
 		texRock.deleteObject();
@@ -214,6 +240,8 @@ struct App : public OpenGLApplication
 		case Space:
 			selectedObjectID = 0;
 			selecting = false;
+			// Oublier une sélection encore en route.
+			pickedPixel = {};
 			break;
 		case A:
 			pieceTranslate = {1, 0, 0};
@@ -282,27 +310,33 @@ struct App : public OpenGLApplication
 	}
 
 	void drawScene() {
-		// Pour chaque objet dans la scène. On fait du beau C++17 avec de l'affectation structurée pour itérer sur un hash map (INF1015 to the MOON!).
+		renderQueue.setViewMatrix(view.top());
+		// Pour chaque objet dans la scène. On fait du beau C++17 avec de l'affectation structurée pour itérer sur un hash map (INF1015 to the MOON!). L'ordre du hash map n'a pas d'importance : la file de rendu trie les objets par programme, texture et mesh avant de les dessiner.
 		for (auto&& [objectID, obj] : objects) {
+			// Les théières qui ne clignotent pas sont toutes le même mesh. On les dessine par instances (un appel par texture plutôt qu'un par théière).
+			bool isFlashing = not selecting and obj.id == selectedObjectID;
+			if (pieces.contains(obj.id) and not isFlashing) {
+				obj.addInstance(pieceInstances, model.top());
+				continue;
+			}
+
 			// Choisir le programme nuanceur à utiliser (texturé, sélection, ou animation sélectionnée).
 			ShaderProgram* prog = &basicProg;
 			if (selecting)
 				prog = &selectionProg;
-			else if (not selecting and obj.id == selectedObjectID)
+			else if (isFlashing)
 				prog = &flashingProg;
 
-			// Passer au nuanceur le ID de l'objet et sa couleur convertie.
-			prog->use();
-			prog->setUint("objectID", obj.id);
-			prog->setVec("objectColor", uintToVec4(obj.id));
-
-			// Appliquer la matrice de modélisation globale à celle de l'objet (en restaurant après le dessin).
-			obj.modelMat.push();
-			obj.modelMat.top() = model * obj.modelMat;
-			// Dessiner l'objet normalement en passant le programme nuanceur à utiliser.
-			obj.draw(*prog);
-			obj.modelMat.pop();
+			// Soumettre l'objet en appliquant la matrice de modélisation globale à celle de l'objet.
+			obj.submit(renderQueue, *prog, model.top());
 		}
+		renderQueue.flush();
+
+		// En mode sélection, le nuanceur de fragments d'instances calcule la couleur à partir du ID de l'instance.
+		ShaderProgram& instancesProg = selecting ? instancedSelectionProg : instancedProg;
+		instancesProg.use();
+		pieceInstances.draw();
+		pieceInstances.clear();
 	}
 
 	void loadScene() {
@@ -348,19 +382,28 @@ struct App : public OpenGLApplication
 		board->modelMat.scale({4, 0.12f, 4});
 	}
 
-	unsigned getObjectIDUnderMouse(const sf::Event::MouseButtonPressed& mouseBtn) {
-		// Du bon vieux C où on crée une structure anonyme plutôt qu'un tableau bête.
-		struct { GLint x, y, width, height; } viewport = {};
-		// Obtenir le viewport pour convertir les coordonnées de souris (référentiel haut-gauche) au référentiel bas-gauche.
-		glGetIntegerv(GL_VIEWPORT, (GLint*)&viewport);
+	std::future<std::vector<std::array<uint8_t, 3>>> readPixelUnderMouse(const sf::Event::MouseButtonPressed& mouseBtn) {
+		// Obtenir le viewport (x, y, largeur, hauteur) pour convertir les coordonnées de souris (référentiel haut-gauche) au référentiel bas-gauche. glState le connaît déjà, ce qui évite un glGetIntegerv.
+		auto viewport = glState.getViewport();
 		GLint x = mouseBtn.position.x;
-		GLint y = viewport.height - mouseBtn.position.y;
+		GLint y = viewport[3] - mouseBtn.position.y;
 
-		// Lire la couleur sous la souris. On initialise un entier 32bit à 0 qu'on passe comme pointeur de données à glReadPixels. On demande les composantes RGB (pas le alpha), ce qui va remplir seulement les 24 premiers bits de objectID, nous donnant notre identifiant (couleur = ID dans notre cas).
-		unsigned objectID = 0;
-		glReadPixels(x, y, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, &objectID);
+		// Lire la couleur sous la souris. On demande les composantes RGB (pas le alpha), donc 3 octets pour le pixel.
+		return readback.readPixels<std::array<uint8_t, 3>>(x, y, 1, 1, GL_RGB, GL_UNSIGNED_BYTE);
+	}
 
-		return objectID;
+	void handlePickedPixel(const std::vector<std::array<uint8_t, 3>>& pixels) {
+		// La couleur lue est un nombre 24 bit (RGB8, on ne peut pas utiliser le alpha) qui correspond à notre identifiant d'objet de scène.
+		auto& rgb = pixels[0];
+		unsigned clickedObj = rgb[0] | (rgb[1] << 8) | (rgb[2] << 16);
+		if (clickedObj != 0)
+			std::cout << std::format("Sélection de l'objet 0x{:04X}", clickedObj) << "\n";
+		// Chercher dans le dictionnaire de théières (pieces) si le ID est reconnu. On choisit de ne pas pouvoir sélectionner la planche.
+		if (clickedObj != selectedObjectID and pieces.contains(clickedObj)) {
+			// Sélectionner l'objet et réinitialiser l'animation de clignotement.
+			selectedObjectID = clickedObj;
+			flashingValue = 0;
+		}
 	}
 
 	void loadShaders() {
@@ -376,6 +419,14 @@ struct App : public OpenGLApplication
 		flashingProg.attachSourceFile(GL_VERTEX_SHADER, "basic_vert.glsl");
 		flashingProg.attachSourceFile(GL_FRAGMENT_SHADER, "flashing_frag.glsl");
 		flashingProg.link();
+		instancedProg.create();
+		instancedProg.attachSourceFile(GL_VERTEX_SHADER, "instanced_vert.glsl");
+		instancedProg.attachSourceFile(GL_FRAGMENT_SHADER, "instanced_frag.glsl");
+		instancedProg.link();
+		instancedSelectionProg.create();
+		instancedSelectionProg.attachSourceFile(GL_VERTEX_SHADER, "instanced_vert.glsl");
+		instancedSelectionProg.attachSourceFile(GL_FRAGMENT_SHADER, "instanced_selection_frag.glsl");
+		instancedSelectionProg.link();
 	}
 
 	void applyPerspective(float fovy = 50) {
@@ -0,0 +1,521 @@
+#pragma once
+
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+	#include <Windows.h>
+	#undef near
+	#undef far
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+// Paquet de ressources (assets) : tous les fichiers d'un exemple (maillages, images, nuanceurs) dans un seul fichier.
+// Ouvrir des dizaines de petits fichiers un à un coûte cher sur un système de fichiers réseau ou quand la cache du disque est froide : chaque ouverture est un aller-retour. Avec un paquet, on ouvre un seul fichier et on le mappe en mémoire (mmap). Le système charge ensuite les pages au besoin, et les fichiers non compressés sont lus directement dans le mappage, sans copie (std::span).
+//
+// Format (petit-boutiste) :
+//     En-tête :  "I27PACK1" | u32 version | u32 nombre d'entrées | u64 position de l'index | u64 taille de l'index
+//     Données :  le contenu de chaque fichier, à une position multiple de l'alignement (64 par défaut, une ligne de cache)
+//     Index :    pour chaque entrée : u16 longueur du chemin | chemin (avec des /) | u8 compression | u64 position | u64 taille stockée | u64 taille originale
+// La compression facultative utilise le format de bloc de LZ4 : très rapide à décompresser, mais seulement utile pour le texte (nuanceurs, .obj). Les images PNG sont déjà compressées et restent donc telles quelles.
+
+
+enum class AssetCompression : uint8_t
+{
+	None = 0,
+	Lz4 = 1,
+};
+
+// Compresser un bloc au format de bloc de LZ4 : une suite de séquences (jeton, littéraux, distance d'une copie en arrière, longueur de la copie). Version gloutonne avec une table de hachage des 4 octets à chaque position : moins bonne que lz4 -9, mais compatible avec n'importe quel décodeur LZ4.
+inline std::vector<std::byte> compressLz4Block(std::span<const std::byte> input) {
+	const uint8_t* src = (const uint8_t*)input.data();
+	size_t size = input.size();
+	std::vector<std::byte> output;
+	output.reserve(size + size / 255 + 16);
+	auto push = [&](uint8_t value) { output.push_back((std::byte)value); };
+	auto pushLength = [&](size_t length) {
+		while (length >= 255) {
+			push(255);
+			length -= 255;
+		}
+		push((uint8_t)length);
+	};
+	auto read32 = [&](size_t pos) { uint32_t value; std::memcpy(&value, src + pos, 4); return value; };
+	auto pushLiterals = [&](size_t begin, size_t end, uint8_t matchNibble) {
+		size_t numLiterals = end - begin;
+		push((uint8_t)(std::min<size_t>(numLiterals, 15) << 4 | matchNibble));
+		if (numLiterals >= 15)
+			pushLength(numLiterals - 15);
+		output.insert(output.end(), input.begin() + begin, input.begin() + end);
+	};
+
+	// Règles du format : les 5 derniers octets sont toujours des littéraux et la dernière copie commence au moins 12 octets avant la fin.
+	constexpr size_t lastLiterals = 5;
+	constexpr size_t matchStartLimit = 12;
+	constexpr int hashBits = 16;
+	size_t anchor = 0;
+	if (size > matchStartLimit) {
+		std::vector<int64_t> table(size_t(1) << hashBits, -1);
+		size_t pos = 0;
+		while (pos < size - matchStartLimit) {
+			uint32_t sequence = read32(pos);
+			uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+			int64_t candidate = table[hash];
+			table[hash] = (int64_t)pos;
+			if (candidate < 0 or pos - candidate > 65535 or read32(candidate) != sequence) {
+				pos++;
+				continue;
+			}
+			size_t matchLength = 4;
+			while (pos + matchLength < size - lastLiterals and src[candidate + matchLength] == src[pos + matchLength])
+				matchLength++;
+			size_t offset = pos - candidate;
+			pushLiterals(anchor, pos, (uint8_t)std::min<size_t>(matchLength - 4, 15));
+			push((uint8_t)(offset & 0xFF));
+			push((uint8_t)(offset >> 8));
+			if (matchLength - 4 >= 15)
+				pushLength(matchLength - 4 - 15);
+			pos += matchLength;
+			anchor = pos;
+		}
+	}
+	pushLiterals(anchor, size, 0);
+	return output;
+}
+
+// Décompresser un bloc LZ4 dans `output`, qui doit avoir exactement la taille originale. Retourne faux si le bloc est invalide (on ne lit ni n'écrit jamais hors des tampons).
+inline bool decompressLz4Block(std::span<const std::byte> input, std::span<std::byte> output) {
+	const uint8_t* ip = (const uint8_t*)input.data();
+	const uint8_t* inEnd = ip + input.size();
+	uint8_t* op = (uint8_t*)output.data();
+	uint8_t* outBegin = op;
+	uint8_t* outEnd = op + output.size();
+	auto readLength = [&](size_t& length) {
+		uint8_t value = 255;
+		while (value == 255) {
+			if (ip >= inEnd)
+				return false;
+			value = *ip++;
+			length += value;
+		}
+		return true;
+	};
+
+	while (ip < inEnd) {
+		uint8_t token = *ip++;
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 and not readLength(numLiterals))
+			return false;
+		if (numLiterals > size_t(inEnd - ip) or numLiterals > size_t(outEnd - op))
+			return false;
+		if (numLiterals > 0)
+			std::memcpy(op, ip, numLiterals);
+		ip += numLiterals;
+		op += numLiterals;
+		// La dernière séquence n'a que des littéraux.
+		if (ip == inEnd)
+			break;
+
+		if (inEnd - ip < 2)
+			return false;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 or offset > size_t(op - outBegin))
+			return false;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 and not readLength(matchLength))
+			return false;
+		matchLength += 4;
+		if (matchLength > size_t(outEnd - op))
+			return false;
+		// La copie peut chevaucher ce qu'elle écrit (une distance de 1 répète le dernier octet), donc octet par octet.
+		const uint8_t* match = op - offset;
+		for (size_t i = 0; i < matchLength; i++)
+			op[i] = match[i];
+		op += matchLength;
+	}
+	return op == outEnd;
+}
+
+// Fichier mappé en lecture seule dans l'espace d'adressage du processus.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() {
+		close();
+	}
+
+	bool open(const std::filesystem::path& path) {
+		close();
+	#ifdef _WIN32
+		file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_ == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file_, &fileSize);
+		size_ = (size_t)fileSize.QuadPart;
+		if (size_ > 0) {
+			mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping_ != nullptr)
+				data_ = (const std::byte*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+		}
+	#else
+		fd_ = ::open(path.c_str(), O_RDONLY);
+		if (fd_ < 0)
+			return false;
+		struct stat info;
+		fstat(fd_, &info);
+		size_ = (size_t)info.st_size;
+		if (size_ > 0) {
+			void* address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+			data_ = address != MAP_FAILED ? (const std::byte*)address : nullptr;
+		}
+	#endif
+		if (data_ == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+	#ifdef _WIN32
+		if (data_ != nullptr)
+			UnmapViewOfFile(data_);
+		if (mapping_ != nullptr)
+			CloseHandle(mapping_);
+		if (file_ != INVALID_HANDLE_VALUE)
+			CloseHandle(file_);
+		mapping_ = nullptr;
+		file_ = INVALID_HANDLE_VALUE;
+	#else
+		if (data_ != nullptr)
+			munmap((void*)data_, size_);
+		if (fd_ >= 0)
+			::close(fd_);
+		fd_ = -1;
+	#endif
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	std::span<const std::byte> getData() const { return {data_, size_}; }
+
+private:
+	const std::byte* data_ = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+	HANDLE mapping_ = nullptr;
+#else
+	int fd_ = -1;
+#endif
+};
+
+// Le chemin tel qu'il est rangé dans l'index : relatif, normalisé ("./a/../b.png" devient "b.png") et avec des /.
+inline std::string normalizeAssetPath(std::string_view path) {
+	return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+struct AssetPackEntry
+{
+	std::string path;
+	AssetCompression compression = AssetCompression::None;
+	uint64_t offset = 0;
+	uint64_t storedSize = 0;
+	uint64_t originalSize = 0;
+};
+
+inline constexpr char assetPackMagic[8] = {'I', '2', '7', 'P', 'A', 'C', 'K', '1'};
+inline constexpr uint32_t assetPackVersion = 1;
+inline constexpr size_t assetPackHeaderSize = 32;
+
+// Un paquet ouvert en lecture.
+class AssetPack
+{
+public:
+	bool open(const std::filesystem::path& path) {
+		entries_.clear();
+		decompressed_.clear();
+		if (not file_.open(path)) {
+			std::cerr << "Impossible d'ouvrir le paquet " << path.string() << std::endl;
+			return false;
+		}
+		std::span<const std::byte> data = file_.getData();
+		if (data.size() < assetPackHeaderSize or std::memcmp(data.data(), assetPackMagic, 8) != 0 or read<uint32_t>(data, 8) != assetPackVersion) {
+			std::cerr << path.string() << " n'est pas un paquet de ressources valide" << std::endl;
+			file_.close();
+			return false;
+		}
+		uint32_t numEntries = read<uint32_t>(data, 12);
+		uint64_t pos = read<uint64_t>(data, 16);
+		uint64_t indexEnd = pos + read<uint64_t>(data, 24);
+		if (indexEnd > data.size()) {
+			std::cerr << path.string() << " : index tronqué" << std::endl;
+			file_.close();
+			return false;
+		}
+		for (uint32_t i = 0; i < numEntries; i++) {
+			AssetPackEntry entry;
+			uint16_t pathLength = read<uint16_t>(data, pos);
+			pos += 2;
+			if (pos + pathLength + 25 > indexEnd)
+				break;
+			entry.path.assign((const char*)data.data() + pos, pathLength);
+			pos += pathLength;
+			entry.compression = (AssetCompression)read<uint8_t>(data, pos);
+			entry.offset = read<uint64_t>(data, pos + 1);
+			entry.storedSize = read<uint64_t>(data, pos + 9);
+			entry.originalSize = read<uint64_t>(data, pos + 17);
+			pos += 25;
+			if (entry.offset + entry.storedSize > data.size())
+				continue;
+			entries_[entry.path] = entry;
+		}
+		return true;
+	}
+
+	bool isOpen() const { return not file_.getData().empty(); }
+
+	const AssetPackEntry* findEntry(std::string_view path) const {
+		auto it = entries_.find(normalizeAssetPath(path));
+		return it != entries_.end() ? &it->second : nullptr;
+	}
+
+	// Le contenu d'un fichier du paquet, ou rien s'il n'y est pas. Un fichier non compressé est une vue directe dans le mappage. Un fichier compressé est décompressé la première fois, puis gardé. Dans les deux cas, la vue reste valide tant que le paquet est ouvert.
+	std::optional<std::span<const std::byte>> find(std::string_view path) {
+		const AssetPackEntry* entry = findEntry(path);
+		if (entry == nullptr)
+			return std::nullopt;
+		std::span<const std::byte> stored = file_.getData().subspan(entry->offset, entry->storedSize);
+		if (entry->compression == AssetCompression::None)
+			return stored;
+
+		// Plusieurs fils peuvent charger des ressources en même temps (par exemple des tâches de JobSystem).
+		std::lock_guard lock(decompressMutex_);
+		auto& buffer = decompressed_[entry->path];
+		if (buffer == nullptr) {
+			auto data = std::make_unique<std::vector<std::byte>>(entry->originalSize);
+			if (not decompressLz4Block(stored, *data)) {
+				std::cerr << "Paquet de ressources : " << entry->path << " est corrompu" << std::endl;
+				decompressed_.erase(entry->path);
+				return std::nullopt;
+			}
+			buffer = std::move(data);
+		}
+		return std::span<const std::byte>(*buffer);
+	}
+
+	// Les entrées, triées par chemin.
+	std::vector<AssetPackEntry> getEntries() const {
+		std::vector<AssetPackEntry> entries;
+		for (auto&& [path, entry] : entries_)
+			entries.push_back(entry);
+		std::sort(entries.begin(), entries.end(), [](auto&& a, auto&& b) { return a.path < b.path; });
+		return entries;
+	}
+
+private:
+	template <typename T>
+	static T read(std::span<const std::byte> data, uint64_t pos) {
+		T value = {};
+		if (pos + sizeof(T) <= data.size())
+			std::memcpy(&value, data.data() + pos, sizeof(T));
+		return value;
+	}
+
+	MappedFile file_;
+	std::unordered_map<std::string, AssetPackEntry> entries_;
+	std::unordered_map<std::string, std::unique_ptr<std::vector<std::byte>>> decompressed_;
+	std::mutex decompressMutex_;
+};
+
+struct AssetPackBuildSettings
+{
+	size_t alignment = 64;
+	bool compress = false;
+	// Ne garder la version compressée que si elle est au moins ce ratio plus petite que l'originale.
+	float minCompressionRatio = 0.9f;
+};
+
+struct AssetPackBuildStats
+{
+	int numFiles = 0;
+	int numCompressed = 0;
+	uint64_t originalBytes = 0;
+	uint64_t packBytes = 0;
+};
+
+// Construit un paquet à partir de fichiers sur le disque (voir l'outil Extra_AssetPacker).
+class AssetPackBuilder
+{
+public:
+	// Ajouter un fichier sous le nom `packPath` (celui qu'on passe à readFile, Texture::loadFromFile, etc.).
+	bool addFile(const std::filesystem::path& diskPath, std::string_view packPath) {
+		std::ifstream file(diskPath, std::ios::binary);
+		if (not file) {
+			std::cerr << "Impossible de lire " << diskPath.string() << std::endl;
+			return false;
+		}
+		std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		Pending& pending = files_.emplace_back();
+		pending.path = normalizeAssetPath(packPath);
+		pending.data.resize(content.size());
+		std::memcpy(pending.data.data(), content.data(), content.size());
+		return true;
+	}
+
+	// Ajouter tous les fichiers d'un dossier (récursivement) dont l'extension est dans `extensions`, en sautant les sous-dossiers dans `skippedFolders`. Les chemins dans le paquet sont relatifs au dossier.
+	int addFolder(const std::filesystem::path& folder, const std::vector<std::string>& extensions, const std::vector<std::string>& skippedFolders = {}) {
+		using namespace std::filesystem;
+		int numAdded = 0;
+		for (auto it = recursive_directory_iterator(folder); it != recursive_directory_iterator(); ++it) {
+			std::string name = it->path().filename().string();
+			if (it->is_directory()) {
+				if (std::find(skippedFolders.begin(), skippedFolders.end(), name) != skippedFolders.end() or name.starts_with("."))
+					it.disable_recursion_pending();
+				continue;
+			}
+			std::string extension = it->path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower(c); });
+			if (std::find(extensions.begin(), extensions.end(), extension) == extensions.end())
+				continue;
+			if (addFile(it->path(), relative(it->path(), folder).generic_string()))
+				numAdded++;
+		}
+		return numAdded;
+	}
+
+	bool write(const std::filesystem::path& outputPath, const AssetPackBuildSettings& settings = {}, AssetPackBuildStats* stats = nullptr) {
+		std::sort(files_.begin(), files_.end(), [](auto&& a, auto&& b) { return a.path < b.path; });
+		std::vector<std::byte> pack(assetPackHeaderSize);
+		std::vector<AssetPackEntry> entries;
+		AssetPackBuildStats buildStats;
+		size_t alignment = std::max<size_t>(settings.alignment, 1);
+		for (auto&& file : files_) {
+			AssetPackEntry entry;
+			entry.path = file.path;
+			entry.originalSize = file.data.size();
+			std::span<const std::byte> stored = file.data;
+			std::vector<std::byte> compressed;
+			if (settings.compress and not file.data.empty()) {
+				compressed = compressLz4Block(file.data);
+				if (compressed.size() < file.data.size() * settings.minCompressionRatio) {
+					stored = compressed;
+					entry.compression = AssetCompression::Lz4;
+					buildStats.numCompressed++;
+				}
+			}
+			pack.resize((pack.size() + alignment - 1) / alignment * alignment);
+			entry.offset = pack.size();
+			entry.storedSize = stored.size();
+			pack.insert(pack.end(), stored.begin(), stored.end());
+			entries.push_back(entry);
+			buildStats.numFiles++;
+			buildStats.originalBytes += entry.originalSize;
+		}
+
+		uint64_t indexOffset = pack.size();
+		for (auto&& entry : entries) {
+			append(pack, (uint16_t)entry.path.size());
+			const std::byte* pathBytes = (const std::byte*)entry.path.data();
+			pack.insert(pack.end(), pathBytes, pathBytes + entry.path.size());
+			append(pack, (uint8_t)entry.compression);
+			append(pack, entry.offset);
+			append(pack, entry.storedSize);
+			append(pack, entry.originalSize);
+		}
+		uint64_t indexSize = pack.size() - indexOffset;
+		std::memcpy(pack.data(), assetPackMagic, 8);
+		std::memcpy(pack.data() + 8, &assetPackVersion, 4);
+		uint32_t numEntries = (uint32_t)entries.size();
+		std::memcpy(pack.data() + 12, &numEntries, 4);
+		std::memcpy(pack.data() + 16, &indexOffset, 8);
+		std::memcpy(pack.data() + 24, &indexSize, 8);
+
+		std::ofstream file(outputPath, std::ios::binary);
+		file.write((const char*)pack.data(), pack.size());
+		if (not file) {
+			std::cerr << "Impossible d'écrire " << outputPath.string() << std::endl;
+			return false;
+		}
+		buildStats.packBytes = pack.size();
+		if (stats != nullptr)
+			*stats = buildStats;
+		return true;
+	}
+
+private:
+	struct Pending
+	{
+		std::string path;
+		std::vector<std::byte> data;
+	};
+
+	template <typename T>
+	static void append(std::vector<std::byte>& output, T value) {
+		const std::byte* bytes = (const std::byte*)&value;
+		output.insert(output.end(), bytes, bytes + sizeof(T));
+	}
+
+	std::vector<Pending> files_;
+};
+
+// Les paquets montés, consultés par readFile, Texture::loadFromFile et Mesh::loadFromWavefrontFile avant le disque. OpenGLApplication monte assets.pack s'il existe dans le dossier courant (voir --pack et --no-pack).
+class AssetPackRegistry
+{
+public:
+	// Le dernier paquet monté a priorité sur les précédents.
+	bool mount(const std::filesystem::path& path) {
+		auto pack = std::make_unique<AssetPack>();
+		if (not pack->open(path))
+			return false;
+		packs_.insert(packs_.begin(), std::move(pack));
+		return true;
+	}
+
+	void unmountAll() {
+		packs_.clear();
+	}
+
+	bool isEmpty() const { return packs_.empty(); }
+
+	// Le contenu du fichier dans le premier paquet qui l'a, sinon rien (et l'appelant lit le disque comme d'habitude).
+	std::optional<std::span<const std::byte>> find(std::string_view path) {
+		for (auto&& pack : packs_) {
+			if (auto data = pack->find(path))
+				return data;
+		}
+		return std::nullopt;
+	}
+
+private:
+	std::vector<std::unique_ptr<AssetPack>> packs_;
+};
+
+inline AssetPackRegistry assetPacks;
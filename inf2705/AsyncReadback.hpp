@@ -0,0 +1,223 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "GLStateCache.hpp"
+
+
+using namespace gl;
+
+
+// Vrai si le futur a déjà sa valeur (sans bloquer). Les futurs d'AsyncReadback sont complétés par update() sur le fil d'OpenGL : appeler get() avant d'avoir vu isReady() bloquerait ce fil pour toujours.
+template <typename T>
+bool isReady(const std::future<T>& future) {
+	return future.valid() and future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+// Ce que les lectures ont coûté depuis le début.
+struct AsyncReadbackStats
+{
+	int numCompleted = 0;
+	int maxFramesWaited = 0; // Le plus grand nombre d'appels à update() avant qu'une lecture soit prête.
+	int numStagingBuffers = 0;
+};
+
+// Un service de lecture asynchrone des données du GPU (pixels, tampons, requêtes).
+// glReadPixels ou glGetBufferSubData directement dans la mémoire du CPU obligent le pilote à attendre que toutes les commandes précédentes soient exécutées : c'est un glFinish caché. Ici, la copie est plutôt faite par le GPU dans un tampon intermédiaire (GL_PIXEL_PACK_BUFFER pour les pixels, glCopyBufferSubData pour les tampons), puis on pose une clôture (glFenceSync). À chaque trame, update() regarde sans attendre (glClientWaitSync avec un délai de 0) quelles clôtures sont passées et complète les futurs correspondants. Le résultat arrive donc une ou deux trames plus tard, mais l'affichage ne bloque jamais.
+class AsyncReadback
+{
+public:
+	// Lire une région du framebuffer de lecture courant. T est le type d'un pixel dans le format demandé (vec4 pour GL_RGBA/GL_FLOAT, float pour GL_DEPTH_COMPONENT/GL_FLOAT, uint8_t pour GL_STENCIL_INDEX/GL_UNSIGNED_BYTE, etc.).
+	template <typename T>
+	std::future<std::vector<T>> readPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type) {
+		size_t count = (size_t)width * height;
+		auto [future, onReady] = makeVectorPromise<T>(count);
+		StagingBuffer staging = acquireStagingBuffer(count * sizeof(T));
+
+		glState.bindBuffer(GL_PIXEL_PACK_BUFFER, staging.buffer);
+		// Les lignes sont collées les unes aux autres dans notre tableau, peu importe la taille d'un pixel. On remet ensuite l'alignement de l'application (lire l'état ne fait pas attendre le GPU).
+		GLint packAlignment = 4;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		// Avec un PBO lié, le dernier paramètre est un décalage dans le tampon et non un pointeur : la copie est mise en file comme une commande normale.
+		glReadPixels(x, y, width, height, format, type, nullptr);
+		glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+		// Ne pas laisser le PBO lié, sinon les prochains glReadPixels (et glGetTexImage) de l'application écriraient dedans.
+		glState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		addRequest(staging, count * sizeof(T), std::move(onReady));
+		return std::move(future);
+	}
+
+	// Lire `count` éléments d'un tampon, à partir de l'octet `offset`. La copie est un instantané : on peut réécrire le tampon source dès la trame suivante.
+	template <typename T>
+	std::future<std::vector<T>> readBuffer(GLuint source, GLintptr offset, size_t count) {
+		auto [future, onReady] = makeVectorPromise<T>(count);
+		GLsizeiptr numBytes = count * sizeof(T);
+		StagingBuffer staging = acquireStagingBuffer(numBytes);
+
+		glState.bindBuffer(GL_COPY_READ_BUFFER, source);
+		glState.bindBuffer(GL_COPY_WRITE_BUFFER, staging.buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, numBytes);
+
+		addRequest(staging, numBytes, std::move(onReady));
+		return std::move(future);
+	}
+
+	// Lire le résultat d'un objet requête (glBeginQuery/glEndQuery) une fois qu'il est disponible. La requête ne doit pas être recommencée avant que le futur soit prêt, sinon on lirait le résultat de la nouvelle.
+	std::future<GLuint> readQuery(GLuint query) {
+		auto promise = std::make_shared<std::promise<GLuint>>();
+		auto future = promise->get_future();
+		// La clôture est posée après glEndQuery, donc le résultat est disponible quand elle est passée et GL_QUERY_RESULT ne bloque plus.
+		addRequest({}, 0, [promise, query](const std::byte*) {
+			GLuint result = 0;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
+			promise->set_value(result);
+		});
+		return future;
+	}
+
+	// À appeler une fois par trame sur le fil d'OpenGL (par exemple au début de drawFrame). Complète les lectures dont la clôture est passée.
+	void update() {
+		for (auto&& request : pending_)
+			request.framesWaited++;
+
+		// Les clôtures passent dans l'ordre où elles ont été posées, donc on arrête à la première qui n'est pas passée.
+		while (not pending_.empty()) {
+			Request& request = pending_.front();
+			// La première fois, on demande au pilote d'envoyer les commandes en attente, sinon la clôture pourrait ne jamais être soumise au GPU.
+			SyncObjectMask flags = request.isFlushed ? GL_NONE_BIT : GL_SYNC_FLUSH_COMMANDS_BIT;
+			GLenum status = glClientWaitSync(request.fence, flags, 0);
+			request.isFlushed = true;
+			if (status != GL_ALREADY_SIGNALED and status != GL_CONDITION_SATISFIED)
+				break;
+			complete(request);
+			pending_.pop_front();
+		}
+	}
+
+	// Attendre toutes les lectures en cours (bloquant). Utile avant de fermer l'application pour ne pas perdre une sauvegarde.
+	void waitAll() {
+		while (not pending_.empty()) {
+			Request& request = pending_.front();
+			GLenum status = glClientWaitSync(request.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+			if (status == GL_TIMEOUT_EXPIRED)
+				continue;
+			complete(request);
+			pending_.pop_front();
+		}
+	}
+
+	size_t getNumPending() const { return pending_.size(); }
+	const AsyncReadbackStats& getStats() const { return stats_; }
+
+	void deleteObjects() {
+		for (auto&& request : pending_) {
+			glDeleteSync(request.fence);
+			if (request.staging.buffer != 0)
+				freeBuffers_.push_back(request.staging);
+		}
+		pending_.clear();
+		for (auto&& staging : freeBuffers_)
+			glState.deleteBuffers(1, &staging.buffer);
+		freeBuffers_.clear();
+		stats_.numStagingBuffers = 0;
+	}
+
+private:
+	using OnReadyFunc = std::function<void(const std::byte*)>;
+
+	struct StagingBuffer
+	{
+		GLuint buffer = 0; // 0 si la lecture n'a pas de tampon intermédiaire (requêtes).
+		GLsizeiptr capacity = 0;
+	};
+
+	struct Request
+	{
+		GLsync fence = nullptr;
+		StagingBuffer staging;
+		GLsizeiptr numBytes = 0;
+		OnReadyFunc onReady;
+		int framesWaited = 0;
+		bool isFlushed = false;
+	};
+
+	// Créer la paire futur/fonction qui copie les octets lus dans un std::vector<T>.
+	template <typename T>
+	static std::pair<std::future<std::vector<T>>, OnReadyFunc> makeVectorPromise(size_t count) {
+		auto promise = std::make_shared<std::promise<std::vector<T>>>();
+		auto future = promise->get_future();
+		OnReadyFunc onReady = [promise, count](const std::byte* data) {
+			std::vector<T> values(count);
+			if (count != 0)
+				std::memcpy(values.data(), data, count * sizeof(T));
+			promise->set_value(std::move(values));
+		};
+		return {std::move(future), std::move(onReady)};
+	}
+
+	// Prendre un tampon intermédiaire libre assez grand, ou en créer un. Les tampons sont recyclés, donc on n'en crée plus une fois que les lectures ont trouvé leur rythme.
+	StagingBuffer acquireStagingBuffer(GLsizeiptr numBytes) {
+		for (size_t i = 0; i < freeBuffers_.size(); i++) {
+			if (freeBuffers_[i].capacity >= numBytes) {
+				StagingBuffer staging = freeBuffers_[i];
+				freeBuffers_.erase(freeBuffers_.begin() + i);
+				return staging;
+			}
+		}
+		// Au moins un octet : glBufferData accepte 0, mais glMapBufferRange refuse une étendue vide.
+		StagingBuffer staging = {0, std::max<GLsizeiptr>(numBytes, 1)};
+		glGenBuffers(1, &staging.buffer);
+		glResources.track(GLResourceType::Buffer, staging.buffer, "AsyncReadback (tampon intermédiaire)");
+		glState.bindBuffer(GL_COPY_WRITE_BUFFER, staging.buffer);
+		// GL_STREAM_READ : écrit une fois par le GPU, lu une fois par le CPU. Le pilote le place donc dans une mémoire que le CPU lit rapidement.
+		glBufferData(GL_COPY_WRITE_BUFFER, staging.capacity, nullptr, GL_STREAM_READ);
+		glResources.setSize(GLResourceType::Buffer, staging.buffer, staging.capacity);
+		stats_.numStagingBuffers++;
+		return staging;
+	}
+
+	void addRequest(StagingBuffer staging, GLsizeiptr numBytes, OnReadyFunc onReady) {
+		Request request;
+		request.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT);
+		request.staging = staging;
+		request.numBytes = numBytes;
+		request.onReady = std::move(onReady);
+		pending_.push_back(std::move(request));
+	}
+
+	void complete(Request& request) {
+		glDeleteSync(request.fence);
+		if (request.staging.buffer == 0 or request.numBytes == 0) {
+			request.onReady(nullptr);
+		} else {
+			// La clôture est passée : le mappage n'a plus rien à attendre.
+			glState.bindBuffer(GL_COPY_WRITE_BUFFER, request.staging.buffer);
+			const void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, request.numBytes, GL_MAP_READ_BIT);
+			request.onReady((const std::byte*)data);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+		if (request.staging.buffer != 0)
+			freeBuffers_.push_back(request.staging);
+		stats_.numCompleted++;
+		stats_.maxFramesWaited = std::max(stats_.maxFramesWaited, request.framesWaited);
+	}
+
+	std::deque<Request> pending_;
+	std::vector<StagingBuffer> freeBuffers_;
+	AsyncReadbackStats stats_;
+};
@@ -0,0 +1,402 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glbinding/AbstractFunction.h>
+#include <glbinding/Binding.h>
+#include <glbinding/CallbackMask.h>
+#include <glbinding/FunctionCall.h>
+#include <glbinding/gl/gl.h>
+
+#include "GLStateCache.hpp"
+#include "FrameArena.hpp"
+
+
+using namespace gl;
+
+
+// Les centiles d'une série de mesures (temps en ms ou compteurs par trame).
+struct PercentileStats
+{
+	float p50 = 0;
+	float p95 = 0;
+	float p99 = 0;
+	float max = 0;
+	float avg = 0;
+
+	static PercentileStats compute(std::vector<float> values) {
+		PercentileStats stats;
+		if (values.empty())
+			return stats;
+		std::sort(values.begin(), values.end());
+		auto percentile = [&](int percent) { return values[(values.size() - 1) * percent / 100]; };
+		stats.p50 = percentile(50);
+		stats.p95 = percentile(95);
+		stats.p99 = percentile(99);
+		stats.max = values.back();
+		double sum = 0;
+		for (float value : values)
+			sum += value;
+		stats.avg = (float)(sum / values.size());
+		return stats;
+	}
+};
+
+// Compte les appels de dessin (glDraw*, glMultiDraw*) et de transfert vers le GPU (glBufferData, glTexSubImage2D, etc.) avec les fonctions de rappel de glbinding.
+// Seules ces fonctions ont un rappel : les autres appels OpenGL ne coûtent rien de plus. Un appel compté coûte quand même une recherche dans une table, ce qui se voit un peu dans le temps CPU d'une scène avec des milliers de dessins.
+class GLCallCounter
+{
+public:
+	enum class Category { None, Draw, Upload };
+
+	void start() {
+		stop();
+		for (glbinding::AbstractFunction* function : glbinding::Binding::functions()) {
+			Category category = getCategory(function->name());
+			if (category == Category::None)
+				continue;
+			categories_[function] = category;
+			instrumentedFunctions_.push_back(function);
+			function->setCallbackMask(glbinding::CallbackMask::After);
+		}
+		glbinding::Binding::setAfterCallback([this](const glbinding::FunctionCall& call) {
+			auto it = categories_.find(call.function);
+			if (it == categories_.end())
+				return;
+			if (it->second == Category::Draw)
+				numDrawCalls_++;
+			else
+				numUploads_++;
+		});
+		resetCounts();
+	}
+
+	void stop() {
+		for (glbinding::AbstractFunction* function : instrumentedFunctions_)
+			function->setCallbackMask(glbinding::CallbackMask::None);
+		instrumentedFunctions_.clear();
+		categories_.clear();
+		glbinding::Binding::setAfterCallback({});
+	}
+
+	void resetCounts() {
+		numDrawCalls_ = 0;
+		numUploads_ = 0;
+	}
+
+	int getNumDrawCalls() const { return numDrawCalls_; }
+	int getNumUploads() const { return numUploads_; }
+
+	static Category getCategory(std::string_view name) {
+		if (name.starts_with("glDraw") or name.starts_with("glMultiDraw"))
+			return Category::Draw;
+		static const std::string_view uploadPrefixes[] = {
+			"glBufferData", "glBufferSubData", "glNamedBufferData", "glNamedBufferSubData",
+			"glTexImage", "glTexSubImage", "glTextureSubImage", "glCompressedTexImage", "glCompressedTexSubImage",
+		};
+		for (std::string_view prefix : uploadPrefixes) {
+			if (name.starts_with(prefix))
+				return Category::Upload;
+		}
+		return Category::None;
+	}
+
+private:
+	std::unordered_map<const glbinding::AbstractFunction*, Category> categories_;
+	std::vector<glbinding::AbstractFunction*> instrumentedFunctions_;
+	int numDrawCalls_ = 0;
+	int numUploads_ = 0;
+};
+
+struct BenchmarkSettings
+{
+	int warmupFrames = 60; // Trames ignorées au début (compilation des nuanceurs par le pilote, premiers transferts, etc.).
+	int numFrames = 600; // Trames mesurées après la mise en route.
+	std::string outputPath; // Fichier JSON des résultats.
+	std::string baselinePath; // Résultats de référence (un ancien fichier de sortie). Vide pour ne pas comparer.
+	float regressionThreshold = 0.10f; // Augmentation relative à partir de laquelle une mesure est une régression.
+	float minRegressionMs = 0.05f; // Sous cet écart absolu, une différence de temps est considérée comme du bruit.
+	int cameraPixelsPerFrame = 4; // Glissement de souris simulé à chaque trame pour faire tourner la caméra.
+};
+
+struct BenchmarkResult
+{
+	std::string name;
+	int numFrames = 0;
+	PercentileStats cpuMs;
+	PercentileStats gpuMs;
+	PercentileStats drawCalls;
+	PercentileStats uploads;
+	PercentileStats stateCalls;
+	PercentileStats heapAllocations; // Seulement avec INF2705_TRACK_HEAP_ALLOCATIONS.
+};
+
+// Un banc d'essai pour une application : après quelques trames de mise en route, mesure chaque trame (temps CPU, temps GPU, appels de dessin, transferts et changements d'état qui passent par glState), puis écrit les centiles en JSON et les compare à des résultats de référence.
+// Le temps CPU va du début de la trame (avant les tâches du fil principal, les mises à jour à pas fixe et drawFrame) à la fin de sa soumission (display ou glFlush) : il compte donc tout le travail d'une trame, pas seulement le dessin. Le temps GPU est mesuré avec deux estampilles (GL_TIMESTAMP) par trame. On garde les requêtes de toutes les trames et on lit les résultats seulement à la fin, pour ne jamais attendre le GPU pendant les mesures.
+// Pour des résultats comparables d'une exécution à l'autre, OpenGLApplication lance le banc d'essai avec un temps fixe entre les trames, sans limite de fps et avec une caméra scriptée.
+class Benchmark
+{
+public:
+	void start(const std::string& name, const BenchmarkSettings& settings) {
+		settings_ = settings;
+		result_ = {};
+		result_.name = name;
+		frame_ = 0;
+		isActive_ = true;
+		isFinished_ = false;
+		hasRegressions_ = false;
+		cpuMs_.clear();
+		drawCalls_.clear();
+		uploads_.clear();
+		stateCalls_.clear();
+		heapAllocations_.clear();
+		heapAllocations_.reserve(settings_.numFrames);
+		queries_.assign(2 * settings_.numFrames, 0);
+		glGenQueries((GLsizei)queries_.size(), queries_.data());
+		callCounter_.start();
+	}
+
+	bool isActive() const { return isActive_; }
+	bool isFinished() const { return isFinished_; }
+	bool hasRegressions() const { return hasRegressions_; }
+	const BenchmarkSettings& getSettings() const { return settings_; }
+	const BenchmarkResult& getResult() const { return result_; }
+	int getTotalNumFrames() const { return settings_.warmupFrames + settings_.numFrames; }
+
+	bool isMeasuring() const {
+		int measuredFrame = frame_ - settings_.warmupFrames;
+		return isActive_ and measuredFrame >= 0 and measuredFrame < settings_.numFrames;
+	}
+
+	// Au tout début de la trame, avant runMainThreadJobs, runFixedUpdates et drawFrame.
+	void beginFrame() {
+		callCounter_.resetCounts();
+		if (not isMeasuring())
+			return;
+		glQueryCounter(queries_[2 * (frame_ - settings_.warmupFrames)], GL_TIMESTAMP);
+		cpuBegin_ = std::chrono::steady_clock::now();
+		heapAllocationsBegin_ = numHeapAllocations;
+	}
+
+	// Juste après la soumission de la trame, avant glState.endFrame().
+	void endFrame() {
+		if (not isActive_)
+			return;
+		if (isMeasuring()) {
+			size_t numAllocations = numHeapAllocations - heapAllocationsBegin_;
+			glQueryCounter(queries_[2 * (frame_ - settings_.warmupFrames) + 1], GL_TIMESTAMP);
+			std::chrono::duration<float, std::milli> cpuTime = std::chrono::steady_clock::now() - cpuBegin_;
+			cpuMs_.push_back(cpuTime.count());
+			drawCalls_.push_back((float)callCounter_.getNumDrawCalls());
+			uploads_.push_back((float)callCounter_.getNumUploads());
+			stateCalls_.push_back((float)glState.getCurrentFrameStats().issuedCalls);
+			if constexpr (isHeapAllocationTrackingEnabled)
+				heapAllocations_.push_back((float)numAllocations);
+		}
+		frame_++;
+		if (frame_ == getTotalNumFrames())
+			finish();
+	}
+
+	// Arrêter sans résultat (par exemple si la fenêtre est fermée avant la fin).
+	void cancel() {
+		if (not isActive_)
+			return;
+		std::cerr << "Banc d'essai interrompu après " << frame_ << " trame(s) sur " << getTotalNumFrames() << std::endl;
+		deleteObjects();
+	}
+
+	// Écrire les résultats en JSON. Le format est plat et stable pour servir de référence à une prochaine exécution.
+	void writeJson(const std::string& path) const {
+		std::filesystem::path parent = std::filesystem::path(path).parent_path();
+		if (not parent.empty())
+			std::filesystem::create_directories(parent);
+		std::ofstream file(path);
+		if (not file) {
+			std::cerr << "Benchmark: impossible d'écrire dans " << path << std::endl;
+			return;
+		}
+		auto writeStats = [&](std::string_view key, const PercentileStats& stats, bool isLast = false) {
+			file << std::format("  \"{}\": {{\"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f}, \"avg\": {:.4f}}}{}\n",
+				key, stats.p50, stats.p95, stats.p99, stats.max, stats.avg, isLast ? "" : ",");
+		};
+		file << "{\n";
+		file << std::format("  \"name\": \"{}\",\n", escapeJson(result_.name));
+		file << std::format("  \"renderer\": \"{}\",\n", escapeJson((const char*)glGetString(GL_RENDERER)));
+		file << std::format("  \"warmup_frames\": {},\n", settings_.warmupFrames);
+		file << std::format("  \"frames\": {},\n", result_.numFrames);
+		writeStats("cpu_ms", result_.cpuMs);
+		writeStats("gpu_ms", result_.gpuMs);
+		writeStats("draw_calls", result_.drawCalls);
+		writeStats("uploads", result_.uploads);
+		if constexpr (isHeapAllocationTrackingEnabled)
+			writeStats("heap_allocations", result_.heapAllocations);
+		writeStats("gl_state_calls", result_.stateCalls, true);
+		file << "}\n";
+	}
+
+	// Comparer aux résultats de référence. Retourne vrai s'il y a au moins une régression.
+	bool compareToBaseline(const std::string& path) {
+		std::ifstream file(path);
+		if (not file) {
+			std::cerr << "Benchmark: référence introuvable (" << path << ")" << std::endl;
+			return false;
+		}
+		std::string baseline = (std::stringstream() << file.rdbuf()).str();
+
+		struct Metric
+		{
+			std::string_view section;
+			std::string_view key;
+			float current;
+			bool isTime;
+		};
+		const Metric metrics[] = {
+			{"cpu_ms", "p50", result_.cpuMs.p50, true},
+			{"cpu_ms", "p95", result_.cpuMs.p95, true},
+			{"cpu_ms", "p99", result_.cpuMs.p99, true},
+			{"gpu_ms", "p50", result_.gpuMs.p50, true},
+			{"gpu_ms", "p95", result_.gpuMs.p95, true},
+			{"gpu_ms", "p99", result_.gpuMs.p99, true},
+			{"draw_calls", "avg", result_.drawCalls.avg, false},
+			{"uploads", "avg", result_.uploads.avg, false},
+			{"gl_state_calls", "avg", result_.stateCalls.avg, false},
+			{"heap_allocations", "avg", result_.heapAllocations.avg, false},
+		};
+
+		std::cout << std::format("{:<22} {:>10} {:>10} {:>8}", "Comparaison", "référence", "actuel", "écart") << "\n";
+		bool hasRegressions = false;
+		for (auto&& metric : metrics) {
+			// Sans le compteur, on n'a pas de mesure à comparer (et pas zéro allocation).
+			if (metric.section == "heap_allocations" and not isHeapAllocationTrackingEnabled)
+				continue;
+			std::optional<float> reference = findJsonNumber(baseline, metric.section, metric.key);
+			if (not reference.has_value())
+				continue;
+			float difference = metric.current - *reference;
+			float relative = *reference > 0 ? difference / *reference : 0;
+			bool isRegression = relative > settings_.regressionThreshold;
+			if (metric.isTime)
+				isRegression = isRegression and difference > settings_.minRegressionMs;
+			else if (*reference == 0)
+				isRegression = metric.current > 0;
+			hasRegressions = hasRegressions or isRegression;
+			std::string name = std::format("{}.{}", metric.section, metric.key);
+			std::cout << std::format("{:<22} {:>10.3f} {:>10.3f} {:>+7.1f}%{}", name, *reference, metric.current, relative * 100, isRegression ? "  RÉGRESSION" : "") << "\n";
+		}
+		std::cout << std::flush;
+		return hasRegressions;
+	}
+
+	void print(std::ostream& out) const {
+		auto printStats = [&](std::string_view name, const PercentileStats& stats) {
+			out << std::format("{:<16} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f}", name, stats.p50, stats.p95, stats.p99, stats.max, stats.avg) << "\n";
+		};
+		out << std::format("Banc d'essai {} ({} trames)", result_.name, result_.numFrames) << "\n";
+		out << std::format("{:<16} {:>9} {:>9} {:>9} {:>9} {:>9}", "", "p50", "p95", "p99", "max", "moy") << "\n";
+		printStats("CPU (ms)", result_.cpuMs);
+		printStats("GPU (ms)", result_.gpuMs);
+		printStats("Dessins", result_.drawCalls);
+		printStats("Transferts", result_.uploads);
+		printStats("États GL", result_.stateCalls);
+		if constexpr (isHeapAllocationTrackingEnabled)
+			printStats("Allocations", result_.heapAllocations);
+		out << std::flush;
+	}
+
+	void deleteObjects() {
+		if (not queries_.empty())
+			glDeleteQueries((GLsizei)queries_.size(), queries_.data());
+		queries_.clear();
+		callCounter_.stop();
+		isActive_ = false;
+	}
+
+private:
+	void finish() {
+		// Les résultats des dernières requêtes arrivent avec la fin des commandes. On peut attendre ici, les mesures sont terminées.
+		glFinish();
+		std::vector<float> gpuMs(settings_.numFrames);
+		for (int i = 0; i < settings_.numFrames; i++) {
+			GLuint64 beginNs = 0;
+			GLuint64 endNs = 0;
+			glGetQueryObjectui64v(queries_[2 * i], GL_QUERY_RESULT, &beginNs);
+			glGetQueryObjectui64v(queries_[2 * i + 1], GL_QUERY_RESULT, &endNs);
+			gpuMs[i] = (endNs - beginNs) / 1e6f;
+		}
+		deleteObjects();
+
+		result_.numFrames = settings_.numFrames;
+		result_.cpuMs = PercentileStats::compute(cpuMs_);
+		result_.gpuMs = PercentileStats::compute(gpuMs);
+		result_.drawCalls = PercentileStats::compute(drawCalls_);
+		result_.uploads = PercentileStats::compute(uploads_);
+		result_.stateCalls = PercentileStats::compute(stateCalls_);
+		result_.heapAllocations = PercentileStats::compute(heapAllocations_);
+		isFinished_ = true;
+
+		print(std::cout);
+		if (not settings_.outputPath.empty()) {
+			writeJson(settings_.outputPath);
+			std::cout << "Résultats dans " << settings_.outputPath << std::endl;
+		}
+		if (not settings_.baselinePath.empty())
+			hasRegressions_ = compareToBaseline(settings_.baselinePath);
+	}
+
+	// Lire "key" dans l'objet "section" d'un fichier écrit par writeJson. Ce n'est pas un lecteur JSON général : il suffit pour le format plat qu'on écrit.
+	static std::optional<float> findJsonNumber(const std::string& json, std::string_view section, std::string_view key) {
+		size_t sectionPos = json.find(std::format("\"{}\"", section));
+		if (sectionPos == std::string::npos)
+			return std::nullopt;
+		size_t sectionEnd = json.find('}', sectionPos);
+		size_t keyPos = json.find(std::format("\"{}\"", key), sectionPos);
+		if (keyPos == std::string::npos or keyPos > sectionEnd)
+			return std::nullopt;
+		size_t colonPos = json.find(':', keyPos);
+		return std::strtof(json.c_str() + colonPos + 1, nullptr);
+	}
+
+	static std::string escapeJson(std::string_view text) {
+		std::string result;
+		for (char c : text) {
+			if (c == '"' or c == '\\')
+				result += '\\';
+			result += c;
+		}
+		return result;
+	}
+
+	BenchmarkSettings settings_;
+	BenchmarkResult result_;
+	int frame_ = 0;
+	bool isActive_ = false;
+	bool isFinished_ = false;
+	bool hasRegressions_ = false;
+
+	std::chrono::steady_clock::time_point cpuBegin_;
+	std::vector<float> cpuMs_;
+	std::vector<float> drawCalls_;
+	std::vector<float> uploads_;
+	std::vector<float> stateCalls_;
+	std::vector<float> heapAllocations_;
+	size_t heapAllocationsBegin_ = 0;
+	std::vector<GLuint> queries_; // Deux estampilles par trame mesurée.
+	GLCallCounter callCounter_;
+};
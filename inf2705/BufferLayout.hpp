@@ -0,0 +1,222 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <string_view>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+
+
+// Règles de disposition mémoire des blocs GLSL (std140 pour les blocs uniformes, std430 pour les tampons de stockage) calculées à la compilation.
+// Le but est de vérifier qu'une struct C++ qu'on copie telle quelle dans un tampon a exactement les mêmes décalages que le bloc GLSL correspondant. Sinon, les membres sont décalés en silence et les nuanceurs lisent n'importe quoi.
+//
+// Rappel des règles (section 7.6.2.2 de la spec OpenGL 4.6) :
+//   - Un scalaire (float, int, uint, bool) prend 4 octets et est aligné sur 4 octets. Un bool GLSL est donc un uint32_t en C++, pas un bool.
+//   - Un vec2 est aligné sur 8 octets, un vec3 et un vec4 sur 16 octets. Un vec3 prend quand même seulement 12 octets, donc un float peut le suivre directement.
+//   - Un tableau a un pas (stride) égal à la taille de l'élément arrondie à son alignement. En std140 (mais pas std430), le pas et l'alignement sont en plus arrondis à 16 octets, donc un float[4] std140 prend 64 octets.
+//   - Une matrice est un tableau de colonnes. Un mat3 std140 ou std430 prend donc 48 octets (3 colonnes vec3 avec un pas de 16) alors que glm::mat3 en prend 36.
+//
+// Avec glm (vecteurs « packed », alignés sur 4 octets en C++), le compilateur n'ajoute jamais le rembourrage que GLSL ajoute. La façon la plus simple d'avoir les mêmes décalages des deux côtés est d'ordonner les membres du plus aligné au moins aligné (vec4, puis vec3 suivis d'un scalaire, puis vec2, puis scalaires), ce qui donne en plus une disposition sans trou. Sinon, on peut aligner explicitement un membre avec alignas(std140Alignment_v<vec4>).
+
+
+enum class BufferLayout
+{
+	Std140,
+	Std430,
+};
+
+// Les types de base acceptés dans un bloc. Les entiers de 8 et 16 bits et les bool C++ n'existent pas en GLSL (sans extension).
+template <typename T>
+constexpr bool isBlockScalar_v = std::is_same_v<T, float> or std::is_same_v<T, int32_t> or std::is_same_v<T, uint32_t>;
+
+template <typename T>
+struct BlockTypeTraits
+{
+	static constexpr bool isSupported = isBlockScalar_v<T>;
+	static constexpr size_t size(BufferLayout) { return 4; }
+	static constexpr size_t alignment(BufferLayout) { return 4; }
+};
+
+template <glm::length_t L, typename T, glm::qualifier Q>
+struct BlockTypeTraits<glm::vec<L, T, Q>>
+{
+	static constexpr bool isSupported = isBlockScalar_v<T>;
+	static constexpr size_t size(BufferLayout) { return L * 4; }
+	// Un vec3 est aligné comme un vec4.
+	static constexpr size_t alignment(BufferLayout) { return (L == 2 ? 2 : 4) * 4; }
+};
+
+// Pas d'un tableau : taille de l'élément arrondie à son alignement (et à 16 en std140).
+template <typename E>
+constexpr size_t blockArrayAlignment(BufferLayout layout) {
+	size_t align = BlockTypeTraits<E>::alignment(layout);
+	return layout == BufferLayout::Std140 and align < 16 ? 16 : align;
+}
+
+template <typename E>
+constexpr size_t blockArrayStride(BufferLayout layout) {
+	size_t align = blockArrayAlignment<E>(layout);
+	return (BlockTypeTraits<E>::size(layout) + align - 1) / align * align;
+}
+
+template <typename E, size_t N>
+struct BlockTypeTraits<E[N]>
+{
+	static constexpr bool isSupported = BlockTypeTraits<E>::isSupported;
+	static constexpr size_t size(BufferLayout layout) { return N * blockArrayStride<E>(layout); }
+	static constexpr size_t alignment(BufferLayout layout) { return blockArrayAlignment<E>(layout); }
+};
+
+template <typename E, size_t N>
+struct BlockTypeTraits<std::array<E, N>> : BlockTypeTraits<E[N]> {};
+
+// Une matrice est un tableau de C colonnes de R composantes.
+template <glm::length_t C, glm::length_t R, typename T, glm::qualifier Q>
+struct BlockTypeTraits<glm::mat<C, R, T, Q>> : BlockTypeTraits<glm::vec<R, T, Q>[C]> {};
+
+
+template <BufferLayout L, typename T>
+constexpr size_t blockLayoutSize_v = BlockTypeTraits<T>::size(L);
+
+template <BufferLayout L, typename T>
+constexpr size_t blockLayoutAlignment_v = BlockTypeTraits<T>::alignment(L);
+
+// À utiliser avec alignas pour aligner un membre C++ comme GLSL le fait. Ex. : alignas(std140Alignment_v<vec4>) vec4 direction;
+template <typename T>
+constexpr size_t std140Alignment_v = blockLayoutAlignment_v<BufferLayout::Std140, T>;
+
+template <typename T>
+constexpr size_t std430Alignment_v = blockLayoutAlignment_v<BufferLayout::Std430, T>;
+
+
+// Vérifications de base qu'une struct peut être copiée telle quelle dans un tampon. Les membres sont tous des multiples de 4 octets (pas de bool ou char C++, c'est 4 octets en GLSL) et l'alignement le plus large en std140 est celui des vec4 (16 octets).
+template <typename T>
+constexpr bool isStd140Copyable_v =
+	std::is_trivially_copyable_v<T> and
+	std::is_standard_layout_v<T> and
+	sizeof(T) % 4 == 0 and
+	alignof(T) <= 16;
+
+
+// Un membre d'un bloc tel que vu des deux côtés : décalage et taille dans la struct C++, alignement et taille dans la disposition GLSL.
+struct BlockMemberInfo
+{
+	std::string_view name;
+	size_t offset = 0;
+	size_t cppSize = 0;
+	size_t glslSize = 0;
+	size_t glslAlignment = 0;
+	bool isSupported = false;
+};
+
+// Le résultat de la simulation de la disposition GLSL d'un bloc.
+struct BlockLayoutCheck
+{
+	bool isValid = true;
+	// Index du premier membre qui ne correspond pas (ou -1).
+	int firstBadMember = -1;
+	// Taille du bloc selon GLSL (avant l'arrondi final du bloc).
+	size_t glslSize = 0;
+	// Nombre d'octets de rembourrage que GLSL insère entre les membres.
+	size_t paddingBytes = 0;
+};
+
+// Description de la disposition d'une struct utilisée comme bloc. On la spécialise avec DECLARE_BLOCK_LAYOUT.
+template <typename T>
+struct BlockLayoutOf
+{
+	static constexpr bool isDeclared = false;
+	static constexpr BufferLayout layout = BufferLayout::Std140;
+	static constexpr std::array<BlockMemberInfo, 0> members = {};
+};
+
+template <typename T>
+constexpr bool hasBlockLayout_v = BlockLayoutOf<T>::isDeclared;
+
+// Refaire à la compilation le placement que ferait le compilateur GLSL, membre par membre dans l'ordre de déclaration, et le comparer aux décalages C++.
+template <typename T>
+constexpr BlockLayoutCheck checkBlockLayout() {
+	BlockLayoutCheck result;
+	size_t glslOffset = 0;
+	size_t maxAlignment = 4;
+	const auto& members = BlockLayoutOf<T>::members;
+	for (int i = 0; i < (int)members.size(); i++) {
+		const BlockMemberInfo& m = members[i];
+		size_t aligned = (glslOffset + m.glslAlignment - 1) / m.glslAlignment * m.glslAlignment;
+		result.paddingBytes += aligned - glslOffset;
+		bool ok = m.isSupported and m.offset == aligned and m.cppSize == m.glslSize;
+		if (not ok and result.isValid) {
+			result.isValid = false;
+			result.firstBadMember = i;
+		}
+		glslOffset = aligned + m.glslSize;
+		maxAlignment = m.glslAlignment > maxAlignment ? m.glslAlignment : maxAlignment;
+	}
+	result.glslSize = glslOffset;
+	if (sizeof(T) < glslOffset)
+		result.isValid = false;
+	// En std430, la struct sert d'élément de tableau (typiquement le tableau de taille variable d'un SSBO). Son pas en GLSL est sa taille arrondie à son alignement, et ça doit être sizeof(T) pour qu'on puisse copier un std::vector<T> directement.
+	if (BlockLayoutOf<T>::layout == BufferLayout::Std430) {
+		size_t stride = (glslOffset + maxAlignment - 1) / maxAlignment * maxAlignment;
+		if (sizeof(T) != stride)
+			result.isValid = false;
+	}
+	return result;
+}
+
+template <typename T>
+constexpr size_t blockLayoutPadding_v = checkBlockLayout<T>().paddingBytes;
+
+
+// Du beau préprocesseur pour appliquer une macro à chaque argument (jusqu'à 16). Le EXPAND est nécessaire avec le préprocesseur traditionnel de MSVC.
+#define BLOCK_LAYOUT_EXPAND(x) x
+#define BLOCK_LAYOUT_FOR_EACH_1(f, a, b, x) f(a, b, x)
+#define BLOCK_LAYOUT_FOR_EACH_2(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_1(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_3(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_2(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_4(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_3(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_5(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_4(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_6(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_5(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_7(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_6(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_8(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_7(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_9(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_8(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_10(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_9(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_11(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_10(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_12(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_11(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_13(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_12(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_14(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_13(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_15(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_14(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_FOR_EACH_16(f, a, b, x, ...) f(a, b, x), BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_FOR_EACH_15(f, a, b, __VA_ARGS__))
+#define BLOCK_LAYOUT_GET_FOR_EACH(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, NAME, ...) NAME
+#define BLOCK_LAYOUT_FOR_EACH(f, a, b, ...) BLOCK_LAYOUT_EXPAND(BLOCK_LAYOUT_GET_FOR_EACH(__VA_ARGS__, \
+	BLOCK_LAYOUT_FOR_EACH_16, BLOCK_LAYOUT_FOR_EACH_15, BLOCK_LAYOUT_FOR_EACH_14, BLOCK_LAYOUT_FOR_EACH_13, \
+	BLOCK_LAYOUT_FOR_EACH_12, BLOCK_LAYOUT_FOR_EACH_11, BLOCK_LAYOUT_FOR_EACH_10, BLOCK_LAYOUT_FOR_EACH_9, \
+	BLOCK_LAYOUT_FOR_EACH_8, BLOCK_LAYOUT_FOR_EACH_7, BLOCK_LAYOUT_FOR_EACH_6, BLOCK_LAYOUT_FOR_EACH_5, \
+	BLOCK_LAYOUT_FOR_EACH_4, BLOCK_LAYOUT_FOR_EACH_3, BLOCK_LAYOUT_FOR_EACH_2, BLOCK_LAYOUT_FOR_EACH_1)(f, a, b, __VA_ARGS__))
+
+#define BLOCK_MEMBER_INFO(layout, type, member) \
+	BlockMemberInfo{ \
+		#member, \
+		offsetof(type, member), \
+		sizeof(type::member), \
+		blockLayoutSize_v<layout, decltype(type::member)>, \
+		blockLayoutAlignment_v<layout, decltype(type::member)>, \
+		BlockTypeTraits<decltype(type::member)>::isSupported \
+	}
+
+// Déclarer la disposition d'une struct qui correspond à un bloc GLSL (ex. : DECLARE_BLOCK_LAYOUT(BufferLayout::Std140, Material, emissionColor, ambientColor, ...)). Les membres doivent être nommés comme dans le bloc GLSL et listés dans l'ordre de déclaration.
+// La compilation échoue si un décalage diffère. Les noms servent aussi à la vérification faite à l'édition de liens des nuanceurs (voir UniformBlock::bindToProgram).
+// À utiliser dans la portée globale, après la définition de la struct.
+#define DECLARE_BLOCK_LAYOUT(layout_, type, ...) \
+	template <> \
+	struct BlockLayoutOf<type> \
+	{ \
+		static constexpr bool isDeclared = true; \
+		static constexpr BufferLayout layout = layout_; \
+		static constexpr std::array members = {BLOCK_LAYOUT_FOR_EACH(BLOCK_MEMBER_INFO, layout_, type, __VA_ARGS__)}; \
+	}; \
+	static_assert(isStd140Copyable_v<type>, #type " doit être copiable tel quel dans un tampon (pas de pointeurs, de bool ni de conteneurs)"); \
+	static_assert(checkBlockLayout<type>().isValid, "La disposition C++ de " #type " ne correspond pas à la disposition GLSL (vérifier l'ordre des membres, les vec3, les tableaux et les mat3)")
@@ -0,0 +1,238 @@
+#pragma once
+
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLStateCache.hpp"
+#include "JobSystem.hpp"
+#include "Mesh.hpp"
+#include "ShaderProgram.hpp"
+#include "Texture.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Les types de variables uniformes qu'on peut enregistrer dans une liste de commandes.
+enum class UniformCommandType : uint8_t
+{
+	Float, Int, Uint, Vec2, Vec3, Vec4, Mat3, Mat4,
+};
+
+// Une variable uniforme enregistrée. La valeur est dans le tableau d'octets de la liste, à dataOffset.
+struct UniformCommand
+{
+	GLint location;
+	UniformCommandType type;
+	uint32_t dataOffset;
+};
+
+// Un appel de dessin enregistré, sous forme compacte : seulement des ID OpenGL et des nombres, pas de pointeurs vers les objets du framework. On peut donc le remplir sur n'importe quel fil d'exécution et le rejouer plus tard sur le fil d'OpenGL.
+struct DrawCommand
+{
+	static constexpr int maxTextures = 4;
+
+	GLuint program = 0;
+	GLuint vao = 0;
+	std::array<GLuint, maxTextures> textures = {}; // L'index est l'unité de texture. 0 = rien à lier.
+	GLenum drawMode = GL_TRIANGLES;
+	GLsizei count = 0; // Nombre d'indices (ou de sommets sans tableau d'indices).
+	GLuint first = 0; // Premier indice (ou premier sommet).
+	GLint baseVertex = 0;
+	bool isIndexed = false;
+	uint32_t firstUniform = 0; // Dans le tableau de variables uniformes de la liste.
+	uint32_t numUniforms = 0;
+};
+
+// Ce que le dernier replay() a coûté.
+struct CommandListStats
+{
+	int numDraws = 0;
+	int numUniforms = 0;
+	int programChanges = 0;
+	int textureChanges = 0;
+	int vaoChanges = 0;
+};
+
+// Une liste de commandes (command list). Les appels OpenGL doivent tous être faits sur le fil qui possède le contexte, mais le travail qui les précède (parcourir la scène, calculer les matrices, choisir le programme et les textures) n'a pas besoin d'OpenGL. On enregistre donc ce travail sur plusieurs fils, chacun dans sa propre liste, puis le fil d'OpenGL rejoue les listes dans l'ordre.
+// Tout est stocké dans des tableaux linéaires (commandes, variables uniformes, octets des valeurs). clear() les vide sans libérer leur mémoire, donc on n'alloue plus rien une fois la scène stable.
+// Une liste n'est jamais partagée entre fils pendant l'enregistrement. Le programme, les textures et les variables uniformes sont un état « courant » qui s'applique aux prochains draw().
+class CommandList
+{
+public:
+	void setProgram(const ShaderProgram& program) {
+		current_.program = program.getObject();
+	}
+
+	void setTexture(int unit, const Texture& texture) {
+		assert(unit >= 0 and unit < DrawCommand::maxTextures);
+		current_.textures[unit] = texture.id;
+	}
+
+	// La valeur est copiée tout de suite; elle sera envoyée juste avant le prochain draw().
+	template <typename T>
+	void setUniform(GLuint location, const T& value) {
+		UniformCommand uniform = {(GLint)location, getUniformCommandType<T>(), (uint32_t)data_.size()};
+		data_.resize(data_.size() + sizeof(T));
+		std::memcpy(data_.data() + uniform.dataOffset, &value, sizeof(T));
+		uniforms_.push_back(uniform);
+		pendingUniforms_++;
+	}
+
+	void draw(const Mesh& mesh, GLenum drawMode = GL_TRIANGLES) {
+		if (not mesh.indices.empty())
+			drawRange(mesh, drawMode, (GLsizei)mesh.indices.size(), 0, 0, true);
+		else
+			drawRange(mesh, drawMode, (GLsizei)mesh.vertices.size(), 0, 0, false);
+	}
+
+	// Dessiner une partie du mesh (par exemple un sous-mesh d'un tampon partagé).
+	void drawRange(const Mesh& mesh, GLenum drawMode, GLsizei count, GLuint first, GLint baseVertex, bool isIndexed) {
+		DrawCommand& command = commands_.emplace_back(current_);
+		command.vao = mesh.vao;
+		command.drawMode = drawMode;
+		command.count = count;
+		command.first = first;
+		command.baseVertex = baseVertex;
+		command.isIndexed = isIndexed;
+		command.firstUniform = (uint32_t)(uniforms_.size() - pendingUniforms_);
+		command.numUniforms = pendingUniforms_;
+		pendingUniforms_ = 0;
+	}
+
+	size_t size() const { return commands_.size(); }
+
+	void clear() {
+		commands_.clear();
+		uniforms_.clear();
+		data_.clear();
+		pendingUniforms_ = 0;
+		current_ = {};
+	}
+
+	// Exécuter les commandes sur le fil d'OpenGL. Les changements d'état passent par glState, mais on compare aussi avec la commande précédente pour ne pas refaire les appels à glState pour rien.
+	CommandListStats replay() const {
+		CommandListStats stats;
+		ReplayCursor cursor;
+		replay(stats, cursor);
+		return stats;
+	}
+
+	// Rejouer plusieurs listes dans l'ordre (l'ordre des listes est celui des partitions de la scène).
+	static CommandListStats replay(const std::vector<CommandList>& lists) {
+		CommandListStats stats;
+		ReplayCursor cursor;
+		for (auto&& list : lists)
+			list.replay(stats, cursor);
+		return stats;
+	}
+
+private:
+	template <typename T>
+	static constexpr UniformCommandType getUniformCommandType() {
+		if constexpr (std::is_same_v<T, float>) return UniformCommandType::Float;
+		else if constexpr (std::is_same_v<T, int>) return UniformCommandType::Int;
+		else if constexpr (std::is_same_v<T, unsigned>) return UniformCommandType::Uint;
+		else if constexpr (std::is_same_v<T, vec2>) return UniformCommandType::Vec2;
+		else if constexpr (std::is_same_v<T, vec3>) return UniformCommandType::Vec3;
+		else if constexpr (std::is_same_v<T, vec4>) return UniformCommandType::Vec4;
+		else if constexpr (std::is_same_v<T, mat3>) return UniformCommandType::Mat3;
+		else if constexpr (std::is_same_v<T, mat4>) return UniformCommandType::Mat4;
+		else static_assert(sizeof(T) == 0, "Type de variable uniforme non supporté dans une liste de commandes");
+	}
+
+	void applyUniform(const UniformCommand& uniform) const {
+		const std::byte* bytes = data_.data() + uniform.dataOffset;
+		// Les valeurs ont été copiées avec memcpy, elles ne sont donc pas forcément alignées. On les recopie dans une variable du bon type avant l'appel.
+		auto read = [bytes]<typename T>(T value) {
+			std::memcpy(&value, bytes, sizeof(T));
+			return value;
+		};
+		switch (uniform.type) {
+		case UniformCommandType::Float: glUniform1f(uniform.location, read(0.0f)); break;
+		case UniformCommandType::Int: glUniform1i(uniform.location, read(0)); break;
+		case UniformCommandType::Uint: glUniform1ui(uniform.location, read(0u)); break;
+		case UniformCommandType::Vec2: glUniform2fv(uniform.location, 1, value_ptr(read(vec2()))); break;
+		case UniformCommandType::Vec3: glUniform3fv(uniform.location, 1, value_ptr(read(vec3()))); break;
+		case UniformCommandType::Vec4: glUniform4fv(uniform.location, 1, value_ptr(read(vec4()))); break;
+		case UniformCommandType::Mat3: glUniformMatrix3fv(uniform.location, 1, GL_FALSE, value_ptr(read(mat3()))); break;
+		case UniformCommandType::Mat4: glUniformMatrix4fv(uniform.location, 1, GL_FALSE, value_ptr(read(mat4()))); break;
+		}
+	}
+
+	// L'état laissé par la commande précédente pendant un replay.
+	struct ReplayCursor
+	{
+		GLuint program = 0;
+		GLuint vao = 0;
+		std::array<GLuint, DrawCommand::maxTextures> textures = {};
+	};
+
+	void replay(CommandListStats& stats, ReplayCursor& cursor) const {
+		for (auto&& command : commands_) {
+			if (command.program != cursor.program) {
+				glState.useProgram(command.program);
+				cursor.program = command.program;
+				stats.programChanges++;
+			}
+			for (int unit = 0; unit < DrawCommand::maxTextures; unit++) {
+				if (command.textures[unit] != 0 and command.textures[unit] != cursor.textures[unit]) {
+					glState.bindTextureToUnit(unit, GL_TEXTURE_2D, command.textures[unit]);
+					cursor.textures[unit] = command.textures[unit];
+					stats.textureChanges++;
+				}
+			}
+			for (uint32_t i = command.firstUniform; i < command.firstUniform + command.numUniforms; i++)
+				applyUniform(uniforms_[i]);
+			stats.numUniforms += command.numUniforms;
+
+			if (command.vao != cursor.vao) {
+				glState.bindVertexArray(command.vao);
+				cursor.vao = command.vao;
+				stats.vaoChanges++;
+			}
+			if (command.isIndexed) {
+				const void* offset = (const void*)(command.first * sizeof(GLuint));
+				if (command.baseVertex != 0)
+					glDrawElementsBaseVertex(command.drawMode, command.count, GL_UNSIGNED_INT, offset, command.baseVertex);
+				else
+					glDrawElements(command.drawMode, command.count, GL_UNSIGNED_INT, offset);
+			} else {
+				glDrawArrays(command.drawMode, (GLint)command.first, command.count);
+			}
+			stats.numDraws++;
+		}
+	}
+
+	std::vector<DrawCommand> commands_;
+	std::vector<UniformCommand> uniforms_;
+	std::vector<std::byte> data_;
+	DrawCommand current_;
+	uint32_t pendingUniforms_ = 0;
+};
+
+// Enregistrer `numItems` éléments en parallèle : les éléments sont partagés en autant de tranches contiguës qu'il y a de listes, et chaque tranche est enregistrée dans sa liste par une tâche du système de tâches (plutôt qu'un fil créé à chaque trame). L'ordre des listes suit donc l'ordre des éléments.
+// record(list, begin, end) est appelée sur un autre fil que celui d'OpenGL : elle ne doit faire aucun appel OpenGL, seulement lire la scène et remplir la liste. Le fil courant enregistre aussi des tranches en attendant les autres.
+template <typename RecordFunc>
+void recordInParallel(std::vector<CommandList>& lists, size_t numItems, RecordFunc&& record) {
+	size_t numLists = lists.size();
+	jobSystem.parallelFor(0, numLists, [&](size_t i) {
+		size_t begin = numItems * i / numLists;
+		size_t end = numItems * (i + 1) / numLists;
+		lists[i].clear();
+		record(lists[i], begin, end);
+	}, 1);
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+// Définir INF2705_DISABLE_CPU_PROFILER (avant d'inclure les entêtes ou dans les options du compilateur) pour que les marqueurs CPU_PROFILE_SCOPE disparaissent complètement du code compilé.
+#ifdef INF2705_DISABLE_CPU_PROFILER
+constexpr bool isCpuProfilerEnabled = false;
+#else
+constexpr bool isCpuProfilerEnabled = true;
+#endif
+
+
+// Une portée mesurée sur le CPU. Le nom doit être une chaîne littérale (ou vivre au moins aussi longtemps que le profileur) : on garde seulement le pointeur, ce qui évite toute allocation par marqueur.
+struct CpuProfileEvent
+{
+	const char* name = nullptr;
+	int64_t beginNs = 0;
+	int64_t endNs = 0;
+	int depth = 0;
+};
+
+// Le total d'une portée dans une trame, tous fils confondus.
+struct CpuScopeFrameStats
+{
+	std::string_view name;
+	double totalMs = 0;
+	int count = 0;
+};
+
+// Les événements d'un fil d'exécution, dans un anneau de taille fixe. Seul le fil propriétaire écrit (pas de verrou), le fil principal lit entre les trames.
+struct CpuProfilerThreadBuffer
+{
+	static constexpr size_t capacity = 1 << 16;
+
+	std::vector<CpuProfileEvent> events = std::vector<CpuProfileEvent>(capacity);
+	// Nombre total d'événements écrits. Le prochain va dans events[writeCount % capacity].
+	std::atomic<uint64_t> writeCount = 0;
+	uint64_t aggregatedCount = 0; // Jusqu'où endFrame() a lu (fil principal seulement).
+	int depth = 0;
+	int threadIndex = 0;
+	std::atomic<bool> isInUse = false;
+};
+
+// Un profileur CPU léger. Chaque marqueur (CPU_PROFILE_SCOPE) prend l'heure au début et à la fin de sa portée et écrit un événement dans l'anneau de son fil. Il n'y a ni verrou ni allocation sur ce chemin : deux lectures d'horloge et une écriture en mémoire, donc quelques dizaines de nanosecondes.
+// Une fois par trame, endFrame() additionne les événements de la trame par nom (getLastFrameStats). Les anneaux gardent les dernières dizaines de milliers d'événements de chaque fil, qu'on peut écrire en format Chrome trace (JSON) pour les ouvrir dans chrome://tracing ou ui.perfetto.dev.
+class CpuProfiler
+{
+public:
+	CpuProfiler() : epoch_(std::chrono::steady_clock::now()) { }
+
+	// Arrêter ou reprendre l'enregistrement. Arrêté, un marqueur coûte une lecture de booléen.
+	void setEnabled(bool enabled) { isEnabled_.store(enabled, std::memory_order_relaxed); }
+	bool isEnabled() const { return isEnabled_.load(std::memory_order_relaxed); }
+
+	int64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count();
+	}
+
+	// L'anneau du fil courant, créé (ou recyclé d'un fil terminé) au premier marqueur du fil.
+	CpuProfilerThreadBuffer& getThreadBuffer() {
+		thread_local ThreadBufferHandle handle;
+		if (handle.buffer == nullptr)
+			handle.buffer = acquireThreadBuffer();
+		return *handle.buffer;
+	}
+
+	void record(CpuProfilerThreadBuffer& buffer, const char* name, int64_t beginNs, int64_t endNs, int depth) {
+		uint64_t index = buffer.writeCount.load(std::memory_order_relaxed);
+		buffer.events[index % CpuProfilerThreadBuffer::capacity] = {name, beginNs, endNs, depth};
+		// Publier l'événement : un lecteur qui voit le nouveau compte voit aussi l'événement écrit.
+		buffer.writeCount.store(index + 1, std::memory_order_release);
+	}
+
+	// Écrire la trace automatiquement après les `numFrames` prochaines trames. Elle contient tout ce que les anneaux ont gardé, donc aussi ce qui précède (chargements dans init() par exemple).
+	void captureFrames(int numFrames, std::string path) {
+		captureFramesLeft_ = numFrames;
+		capturePath_ = std::move(path);
+	}
+
+	// À appeler sur le fil principal entre deux trames (OpenGLApplication::run le fait). Additionne les événements terminés depuis l'appel précédent.
+	void endFrame() {
+		if constexpr (not isCpuProfilerEnabled)
+			return;
+
+		for (auto&& scope : frameTotals_)
+			scope.second = {scope.first, 0, 0};
+
+		std::lock_guard lock(buffersMutex_);
+		for (auto&& buffer : buffers_) {
+			uint64_t writeCount = buffer->writeCount.load(std::memory_order_acquire);
+			uint64_t first = std::max(buffer->aggregatedCount, getFirstReadable(writeCount));
+			for (uint64_t i = first; i < writeCount; i++) {
+				const CpuProfileEvent& event = buffer->events[i % CpuProfilerThreadBuffer::capacity];
+				CpuScopeFrameStats& stats = frameTotals_[event.name];
+				stats.name = event.name;
+				stats.totalMs += (event.endNs - event.beginNs) / 1e6;
+				stats.count++;
+			}
+			buffer->aggregatedCount = writeCount;
+		}
+
+		lastFrameStats_.clear();
+		for (auto&& [name, stats] : frameTotals_) {
+			if (stats.count != 0)
+				lastFrameStats_.push_back(stats);
+		}
+		std::sort(lastFrameStats_.begin(), lastFrameStats_.end(), [](auto& a, auto& b) { return a.totalMs > b.totalMs; });
+
+		if (captureFramesLeft_ > 0 and --captureFramesLeft_ == 0)
+			writeChromeTraceLocked(capturePath_);
+	}
+
+	// Les portées de la dernière trame, de la plus coûteuse à la moins coûteuse.
+	const std::vector<CpuScopeFrameStats>& getLastFrameStats() const { return lastFrameStats_; }
+
+	void printLastFrame(std::ostream& out) const {
+		for (auto&& scope : lastFrameStats_)
+			out << std::format("  {:<28} {:>8.3f} ms  ({}x)", scope.name, scope.totalMs, scope.count) << "\n";
+		out << std::flush;
+	}
+
+	// Écrire ce qui reste dans les anneaux (les derniers événements de chaque fil) en format Chrome trace.
+	bool writeChromeTrace(const std::string& path) {
+		std::lock_guard lock(buffersMutex_);
+		return writeChromeTraceLocked(path);
+	}
+
+	// Le coût moyen d'un marqueur en nanosecondes, mesuré en en faisant plein d'affilée. Utile pour vérifier que le profilage ne fausse pas ce qu'il mesure.
+	double measureMarkerCostNs(int numMarkers = 100'000) {
+		CpuProfilerThreadBuffer& buffer = getThreadBuffer();
+		int64_t start = now();
+		for (int i = 0; i < numMarkers; i++) {
+			int64_t beginNs = now();
+			record(buffer, "calibration", beginNs, now(), buffer.depth);
+		}
+		return double(now() - start) / numMarkers;
+	}
+
+private:
+	// Remet l'anneau dans le bassin quand le fil se termine. Les événements restent lisibles jusqu'à ce qu'un autre fil le reprenne.
+	struct ThreadBufferHandle
+	{
+		CpuProfilerThreadBuffer* buffer = nullptr;
+		~ThreadBufferHandle() {
+			if (buffer != nullptr)
+				buffer->isInUse.store(false, std::memory_order_release);
+		}
+	};
+
+	CpuProfilerThreadBuffer* acquireThreadBuffer() {
+		std::lock_guard lock(buffersMutex_);
+		// Un fil créé après la fin d'un autre reprend l'anneau du fil terminé, donc la mémoire reste bornée par le nombre de fils simultanés.
+		for (auto&& buffer : buffers_) {
+			bool expected = false;
+			if (buffer->isInUse.compare_exchange_strong(expected, true))
+				return buffer.get();
+		}
+		auto& buffer = buffers_.emplace_back(std::make_unique<CpuProfilerThreadBuffer>());
+		buffer->threadIndex = (int)buffers_.size() - 1;
+		buffer->isInUse = true;
+		return buffer.get();
+	}
+
+	// On ne lit pas les plus vieux événements d'un anneau : un fil qui écrit pendant la lecture pourrait être en train de les écraser.
+	static uint64_t getFirstReadable(uint64_t writeCount) {
+		constexpr uint64_t margin = CpuProfilerThreadBuffer::capacity / 16;
+		constexpr uint64_t readable = CpuProfilerThreadBuffer::capacity - margin;
+		return writeCount > readable ? writeCount - readable : 0;
+	}
+
+	bool writeChromeTraceLocked(const std::string& path) {
+		std::ofstream file(path);
+		if (not file) {
+			std::cerr << "CpuProfiler: impossible d'écrire dans " << path << std::endl;
+			return false;
+		}
+		// Format « Trace Event » : un objet par événement complet (ph = X), temps en microsecondes. Les portées imbriquées sont reconstruites par l'outil à partir des temps.
+		file << "{\"traceEvents\":[\n";
+		bool isFirst = true;
+		for (auto&& buffer : buffers_) {
+			std::string threadName = buffer->threadIndex == 0 ? "principal" : std::format("fil {}", buffer->threadIndex);
+			file << (isFirst ? "" : ",\n")
+			     << std::format(R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})", buffer->threadIndex, threadName);
+			isFirst = false;
+
+			uint64_t writeCount = buffer->writeCount.load(std::memory_order_acquire);
+			for (uint64_t i = getFirstReadable(writeCount); i < writeCount; i++) {
+				const CpuProfileEvent& event = buffer->events[i % CpuProfilerThreadBuffer::capacity];
+				file << ",\n" << std::format(
+					R"({{"name":"{}","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+					event.name, buffer->threadIndex, event.beginNs / 1e3, (event.endNs - event.beginNs) / 1e3
+				);
+			}
+		}
+		file << "\n]}\n";
+		std::cout << "Trace CPU écrite dans " << path << " (ouvrir avec chrome://tracing ou ui.perfetto.dev)" << std::endl;
+		return true;
+	}
+
+	std::chrono::steady_clock::time_point epoch_;
+	std::atomic<bool> isEnabled_ = true;
+
+	std::mutex buffersMutex_;
+	std::vector<std::unique_ptr<CpuProfilerThreadBuffer>> buffers_;
+
+	std::unordered_map<std::string_view, CpuScopeFrameStats> frameTotals_;
+	std::vector<CpuScopeFrameStats> lastFrameStats_;
+
+	int captureFramesLeft_ = 0;
+	std::string capturePath_;
+};
+
+// Le profileur partagé par tout le programme, comme glState.
+inline CpuProfiler cpuProfiler;
+
+// Mesure sa portée, de la construction jusqu'à la fin du bloc. Utiliser plutôt la macro CPU_PROFILE_SCOPE, qui disparaît quand le profileur est désactivé à la compilation.
+class CpuProfileScope
+{
+public:
+	explicit CpuProfileScope(const char* name) {
+		if (not cpuProfiler.isEnabled())
+			return;
+		buffer_ = &cpuProfiler.getThreadBuffer();
+		name_ = name;
+		depth_ = buffer_->depth++;
+		beginNs_ = cpuProfiler.now();
+	}
+
+	~CpuProfileScope() {
+		if (buffer_ == nullptr)
+			return;
+		cpuProfiler.record(*buffer_, name_, beginNs_, cpuProfiler.now(), depth_);
+		buffer_->depth--;
+	}
+
+	CpuProfileScope(const CpuProfileScope&) = delete;
+	CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+private:
+	CpuProfilerThreadBuffer* buffer_ = nullptr;
+	const char* name_ = nullptr;
+	int64_t beginNs_ = 0;
+	int depth_ = 0;
+};
+
+#define CPU_PROFILE_CONCAT_IMPL(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_IMPL(a, b)
+#ifdef INF2705_DISABLE_CPU_PROFILER
+	#define CPU_PROFILE_SCOPE(name) ((void)0)
+#else
+	// Mesurer le reste du bloc courant sous le nom donné (une chaîne littérale).
+	#define CPU_PROFILE_SCOPE(name) CpuProfileScope CPU_PROFILE_CONCAT(cpuProfileScope_, __LINE__)(name)
+#endif
@@ -0,0 +1,226 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <cmath>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "GLObject.hpp"
+#include "GLStateCache.hpp"
+#include "ShaderProgram.hpp"
+#include "Texture.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+enum class UpscaleFilter
+{
+	Bilinear, // Interpolation bilinéaire simple : l'image devient floue quand l'échelle baisse.
+	EdgeAware, // Bilinéaire suivi d'un rehaussement qui s'adapte au contraste local (voir Upscaler).
+};
+
+struct DynamicResolutionSettings
+{
+	float targetFrameMs = 1000.0f / 60; // Le budget de temps GPU par trame.
+	float minScale = 0.5f; // Échelle de chaque dimension par rapport à la fenêtre (0.5 = un quart des pixels).
+	float maxScale = 1.0f;
+	float scaleStep = 1.0f / 16; // Les échelles sont arrondies à ce pas : les textures du graphe de trame ne changent de taille qu'aux vrais changements.
+	// Bande d'hystérésis, en fraction du budget : on baisse l'échelle au-dessus de decreaseThreshold, on ne la monte qu'après framesBeforeIncrease trames de suite sous increaseThreshold. Entre les deux, on ne touche à rien.
+	float decreaseThreshold = 1.0f;
+	float increaseThreshold = 0.8f;
+	int framesBeforeIncrease = 30;
+	// Trames ignorées après un changement. Les temps GPU arrivent quelques trames en retard (voir GpuProfiler) : juste après un changement, ils mesurent encore l'ancienne échelle.
+	int cooldownFrames = 6;
+	float smoothing = 0.2f; // Poids de la nouvelle mesure dans la moyenne mobile exponentielle.
+};
+
+// Choisit l'échelle de rendu de la scène selon le temps GPU des trames précédentes, pour rester dans un budget (par exemple 16.7 ms pour 60 Hz).
+// Le coût d'une scène limitée par le remplissage est à peu près proportionnel au nombre de pixels, donc au carré de l'échelle. Quand on dépasse le budget, on descend donc d'un coup à l'échelle qui devrait ramener le temps au milieu de la bande. Pour remonter, on y va plutôt un pas à la fois, et seulement si le pas suivant devrait rester sous le budget : sinon on oscillerait entre deux échelles à chaque changement.
+class DynamicResolutionController
+{
+public:
+	DynamicResolutionController() = default;
+
+	DynamicResolutionController(const DynamicResolutionSettings& settings)
+	: settings_(settings), scale_(settings.maxScale) { }
+
+	const DynamicResolutionSettings& getSettings() const { return settings_; }
+
+	void setSettings(const DynamicResolutionSettings& settings) {
+		settings_ = settings;
+		scale_ = std::clamp(scale_, settings_.minScale, settings_.maxScale);
+		restart();
+	}
+
+	bool isEnabled() const { return isEnabled_; }
+
+	// Désactivé, on rend à l'échelle maximale.
+	void setEnabled(bool enabled) {
+		isEnabled_ = enabled;
+		scale_ = settings_.maxScale;
+		restart();
+	}
+
+	float getScale() const { return scale_; }
+	float getSmoothedMs() const { return hasSample_ ? smoothedMs_ : 0; }
+	int getNumChanges() const { return numChanges_; }
+
+	// La taille de la cible de la scène pour une fenêtre de taille nativeSize. Les deux dimensions suivent la même échelle, l'aspect ne change donc pas.
+	ivec2 getRenderSize(ivec2 nativeSize) const {
+		return glm::max(ivec2(vec2(nativeSize) * scale_ + 0.5f), ivec2(1));
+	}
+
+	// À chaque trame, avec le dernier temps GPU mesuré (0 ou moins s'il n'y en a pas encore). Retourne true si l'échelle a changé.
+	bool update(float gpuMs) {
+		if (not isEnabled_ or gpuMs <= 0)
+			return false;
+		if (cooldown_ > 0) {
+			cooldown_--;
+			return false;
+		}
+		smoothedMs_ = hasSample_ ? mix(smoothedMs_, gpuMs, settings_.smoothing) : gpuMs;
+		hasSample_ = true;
+
+		float ratio = smoothedMs_ / settings_.targetFrameMs;
+		float newScale = scale_;
+		if (ratio > settings_.decreaseThreshold) {
+			float targetRatio = (settings_.decreaseThreshold + settings_.increaseThreshold) / 2;
+			newScale = quantize(scale_ * std::sqrt(targetRatio / ratio));
+			newScale = std::min(newScale, scale_ - settings_.scaleStep);
+			framesUnderBudget_ = 0;
+		} else if (ratio < settings_.increaseThreshold) {
+			if (++framesUnderBudget_ >= settings_.framesBeforeIncrease) {
+				float nextScale = scale_ + settings_.scaleStep;
+				float predictedRatio = ratio * (nextScale * nextScale) / (scale_ * scale_);
+				if (predictedRatio < settings_.decreaseThreshold)
+					newScale = nextScale;
+				framesUnderBudget_ = 0;
+			}
+		} else {
+			framesUnderBudget_ = 0;
+		}
+
+		newScale = std::clamp(newScale, settings_.minScale, settings_.maxScale);
+		if (std::abs(newScale - scale_) < 1e-4f)
+			return false;
+		scale_ = newScale;
+		numChanges_++;
+		restart();
+		return true;
+	}
+
+private:
+	float quantize(float scale) const {
+		return std::floor(scale / settings_.scaleStep + 1e-4f) * settings_.scaleStep;
+	}
+
+	// Après un changement, les mesures passées ne valent plus rien : on attend le délai et on repart la moyenne.
+	void restart() {
+		cooldown_ = settings_.cooldownFrames;
+		hasSample_ = false;
+		framesUnderBudget_ = 0;
+	}
+
+	DynamicResolutionSettings settings_;
+	bool isEnabled_ = true;
+	float scale_ = 1.0f;
+	float smoothedMs_ = 0;
+	bool hasSample_ = false;
+	int cooldown_ = 0;
+	int framesUnderBudget_ = 0;
+	int numChanges_ = 0;
+};
+
+
+// Agrandit une texture (la scène rendue à échelle réduite) vers toute la cible courante en dessinant un triangle qui couvre l'écran.
+// Le triangle est généré dans le nuanceur de sommets à partir de gl_VertexID : pas de tampon de sommets, seulement un VAO vide (obligatoire en profil core).
+// Le filtre EdgeAware s'inspire du rehaussement adaptatif au contraste (CAS d'AMD) : on compare le texel à ses quatre voisins, et on rehausse fort là où le contraste est faible (les bords adoucis par l'agrandissement) et peu là où il est déjà fort, pour ne pas créer de halos. Le résultat est borné par le min et le max des voisins.
+// La texture source doit être filtrée linéairement (c'est le cas des textures du graphe de trame). L'alpha écrit vaut 1, le mélange peut donc rester actif.
+class Upscaler
+{
+public:
+	void setup() {
+		prog_.create("Upscaler");
+		prog_.attachSource(GL_VERTEX_SHADER, vertexSource, "Upscaler (nuanceur de sommets)");
+		prog_.attachSource(GL_FRAGMENT_SHADER, fragmentSource, "Upscaler (nuanceur de fragments)");
+		prog_.link();
+		prog_.use();
+		prog_.setInt("source", 0);
+		vao_ = GLVertexArray::create("Upscaler");
+	}
+
+	// sharpness entre 0 et 1, seulement pour EdgeAware.
+	void draw(Texture& source, UpscaleFilter filter, float sharpness = 0.5f) {
+		prog_.use();
+		prog_.setBool("edgeAware", filter == UpscaleFilter::EdgeAware);
+		prog_.setFloat("sharpness", std::clamp(sharpness, 0.0f, 1.0f));
+		source.bindToTextureUnit(0);
+		glState.bindVertexArray(vao_.get());
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	void deleteObjects() {
+		prog_.deleteShaders();
+		prog_.deleteProgram();
+		vao_.reset();
+	}
+
+private:
+	static constexpr const char* vertexSource = R"glsl(
+		#version 410
+
+		out vec2 texCoords;
+
+		void main() {
+			// Sommets (0,0), (2,0) et (0,2) en coordonnées de texture : le triangle déborde et couvre tout l'écran.
+			vec2 uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+			texCoords = uv;
+			gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+		}
+	)glsl";
+
+	static constexpr const char* fragmentSource = R"glsl(
+		#version 410
+
+		uniform sampler2D source;
+		uniform bool edgeAware;
+		uniform float sharpness;
+
+		in vec2 texCoords;
+
+		out vec4 fragColor;
+
+		void main() {
+			vec3 center = texture(source, texCoords).rgb;
+			if (!edgeAware) {
+				fragColor = vec4(center, 1.0);
+				return;
+			}
+
+			// Les voisins à un texel de la source (pas de la fenêtre), là où l'agrandissement a adouci les bords.
+			vec2 texel = 1.0 / vec2(textureSize(source, 0));
+			vec3 north = texture(source, texCoords + vec2(0.0, texel.y)).rgb;
+			vec3 south = texture(source, texCoords - vec2(0.0, texel.y)).rgb;
+			vec3 east = texture(source, texCoords + vec2(texel.x, 0.0)).rgb;
+			vec3 west = texture(source, texCoords - vec2(texel.x, 0.0)).rgb;
+			vec3 minColor = min(center, min(min(north, south), min(east, west)));
+			vec3 maxColor = max(center, max(max(north, south), max(east, west)));
+
+			// Proche de 1 quand le contraste local est faible, proche de 0 sur un bord déjà franc.
+			vec3 amount = sqrt(clamp(min(minColor, 1.0 - maxColor) / max(maxColor, vec3(1e-4)), 0.0, 1.0));
+			vec3 weight = -amount * mix(1.0 / 8.0, 1.0 / 5.0, sharpness);
+			vec3 result = (center + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+			fragColor = vec4(clamp(result, minColor, maxColor), 1.0);
+		}
+	)glsl";
+
+	ShaderProgram prog_;
+	GLVertexArray vao_;
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+// Allocateur linéaire (bump allocator) : chaque allocation avance un pointeur dans un grand bloc, et tout est libéré d'un coup par reset(). deallocate() ne fait rien.
+// S'utilise avec les conteneurs std::pmr (std::pmr::vector, std::pmr::string) : on passe l'arène au constructeur du conteneur, qui lui demande sa mémoire au lieu du tas.
+// Si le bloc est plein, l'allocation va dans un bloc de débordement pris sur le tas. Au reset(), le bloc principal est agrandi à ce qui a été utilisé en tout (jusqu'à maxCapacity), pour qu'après quelques trames plus rien ne déborde.
+class LinearArena : public std::pmr::memory_resource
+{
+public:
+	LinearArena(size_t initialCapacity = 64 * 1024, size_t maxCapacity = 16 * 1024 * 1024)
+	: maxCapacity_(maxCapacity) {
+		reserve(initialCapacity);
+	}
+
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	// Tout libérer. Les pointeurs obtenus depuis le dernier reset() ne sont plus valides.
+	void reset() {
+		size_t totalUsed = getNumUsedBytes();
+		peakBytes_ = std::max(peakBytes_, totalUsed);
+		if (not overflowBlocks_.empty()) {
+			overflowBlocks_.clear();
+			if (totalUsed > capacity_ and capacity_ < maxCapacity_)
+				reserve(std::min(std::bit_ceil(totalUsed), maxCapacity_));
+		}
+		offset_ = 0;
+		overflowBytes_ = 0;
+	}
+
+	size_t getCapacity() const { return capacity_; }
+	size_t getNumUsedBytes() const { return offset_ + overflowBytes_; }
+	size_t getPeakBytes() const { return std::max(peakBytes_, getNumUsedBytes()); }
+	// Nombre d'allocations qui n'ont pas tenu dans le bloc principal depuis le début.
+	size_t getNumOverflows() const { return numOverflows_; }
+
+private:
+	void reserve(size_t capacity) {
+		block_ = std::make_unique<std::byte[]>(capacity);
+		capacity_ = capacity;
+		offset_ = 0;
+	}
+
+	void* do_allocate(size_t numBytes, size_t alignment) override {
+		// Aligner l'adresse elle-même, pas seulement la position dans le bloc : new[] n'aligne le bloc que sur max_align_t.
+		uintptr_t base = (uintptr_t)block_.get();
+		size_t begin = ((base + offset_ + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+		if (begin + numBytes <= capacity_) {
+			offset_ = begin + numBytes;
+			return block_.get() + begin;
+		}
+		// Le bloc de débordement est alloué par la ressource standard, avec l'alignement demandé.
+		numOverflows_++;
+		overflowBytes_ += numBytes;
+		auto& overflow = overflowBlocks_.emplace_back(std::pmr::new_delete_resource(), numBytes, alignment);
+		return overflow.data;
+	}
+
+	void do_deallocate(void*, size_t, size_t) override {}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+
+	struct OverflowBlock
+	{
+		OverflowBlock(std::pmr::memory_resource* upstream, size_t size, size_t alignment)
+		: upstream(upstream), data(upstream->allocate(size, alignment)), size(size), alignment(alignment) { }
+		OverflowBlock(const OverflowBlock&) = delete;
+		OverflowBlock(OverflowBlock&& other) noexcept
+		: upstream(other.upstream), data(std::exchange(other.data, nullptr)), size(other.size), alignment(other.alignment) { }
+		~OverflowBlock() {
+			if (data != nullptr)
+				upstream->deallocate(data, size, alignment);
+		}
+
+		std::pmr::memory_resource* upstream;
+		void* data;
+		size_t size;
+		size_t alignment;
+	};
+
+	std::unique_ptr<std::byte[]> block_;
+	size_t capacity_ = 0;
+	size_t offset_ = 0;
+	size_t maxCapacity_ = 0;
+	std::vector<OverflowBlock> overflowBlocks_;
+	size_t overflowBytes_ = 0;
+	size_t peakBytes_ = 0;
+	size_t numOverflows_ = 0;
+};
+
+// Les conteneurs qui prennent leur mémoire dans l'arène de trame. Par exemple :
+//    FrameVector<vec3> points(frameArena.get());
+//    FrameString label = frameFormat("{} objets", numObjects);
+template <typename T>
+using FrameVector = std::pmr::vector<T>;
+using FrameString = std::pmr::string;
+
+// Arène pour les données temporaires d'une trame, remise à zéro par OpenGLApplication à la fin de chaque trame.
+// Il y a deux arènes qui alternent d'une trame à l'autre (double tampon) : ce qui est alloué pendant la trame N reste valide pendant toute la trame N+1. Un consommateur asynchrone (une tâche de JobSystem, une lecture de PBO, etc.) qui finit à la trame suivante peut donc encore lire ses données sans les copier.
+// L'arène n'est pas protégée par un mutex : on ne s'en sert que sur le fil principal. Les fils de travail allouent normalement (ou ont leur propre LinearArena).
+class FrameArena
+{
+public:
+	// L'arène de la trame courante, à passer aux conteneurs std::pmr.
+	std::pmr::memory_resource* get() { return &arenas_[current_]; }
+
+	// Changer d'arène et vider celle qui sert à la trame qui commence (celle d'il y a deux trames).
+	void endFrame() {
+		current_ = 1 - current_;
+		arenas_[current_].reset();
+	}
+
+	size_t getPeakBytes() const { return std::max(arenas_[0].getPeakBytes(), arenas_[1].getPeakBytes()); }
+	size_t getNumOverflows() const { return arenas_[0].getNumOverflows() + arenas_[1].getNumOverflows(); }
+
+private:
+	LinearArena arenas_[2];
+	int current_ = 0;
+};
+
+inline FrameArena frameArena;
+
+// Comme std::format, mais la chaîne est dans l'arène de trame.
+template <typename... Args>
+FrameString frameFormat(std::format_string<Args...> format, Args&&... args) {
+	FrameString result(frameArena.get());
+	std::format_to(std::back_inserter(result), format, std::forward<Args>(args)...);
+	return result;
+}
+
+
+// Compteur d'allocations sur le tas, pour vérifier qu'une trame en régime permanent n'alloue (presque) plus rien.
+// Il faut remplacer les opérateurs new et delete globaux, ce qui coûte un peu à chaque allocation du programme. C'est donc optionnel : avec INF2705_TRACK_HEAP_ALLOCATIONS (option CMake du même nom), OpenGLApplication affiche les allocations par trame à la fermeture et le banc d'essai les ajoute à ses résultats.
+// Les opérateurs sont définis ici plutôt que dans un .cpp puisque chaque exemple n'a qu'une unité de compilation (main.cpp). Les versions [] et nothrow appellent celles-ci par défaut. Les versions alignées (align_val_t) ne sont pas comptées.
+inline std::atomic<size_t> numHeapAllocations = 0;
+
+#ifdef INF2705_TRACK_HEAP_ALLOCATIONS
+inline constexpr bool isHeapAllocationTrackingEnabled = true;
+
+void* operator new(size_t size) {
+	numHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size != 0 ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+#else
+inline constexpr bool isHeapAllocationTrackingEnabled = false;
+#endif
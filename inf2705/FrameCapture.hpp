@@ -0,0 +1,401 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <SFML/Graphics.hpp>
+
+#include "GLStateCache.hpp"
+
+
+using namespace gl;
+
+
+// Un petit bassin de fils d'exécution avec une file de tâches bornée.
+// Créer un fil détaché par tâche (comme le faisait saveScreenshot) ne borne rien : si on produit des images plus vite que le disque les écrit, la mémoire et le nombre de fils augmentent sans fin. Ici, submit() bloque quand la file est pleine (contre-pression), ce qui ralentit le producteur au rythme des fils.
+class BoundedWorkerPool
+{
+public:
+	BoundedWorkerPool() = default;
+	BoundedWorkerPool(const BoundedWorkerPool&) = delete;
+	BoundedWorkerPool& operator=(const BoundedWorkerPool&) = delete;
+
+	~BoundedWorkerPool() {
+		shutdown();
+	}
+
+	void start(int numThreads, int maxQueuedTasks) {
+		shutdown();
+		maxQueuedTasks_ = std::max(maxQueuedTasks, 1);
+		isStopping_ = false;
+		for (int i = 0; i < std::max(numThreads, 1); i++)
+			threads_.emplace_back([this] { workerLoop(); });
+	}
+
+	// Ajouter une tâche. Bloque tant que la file est pleine.
+	void submit(std::function<void()> task) {
+		if (threads_.empty())
+			start(1, 4);
+		std::unique_lock lock(mutex_);
+		if ((int)tasks_.size() >= maxQueuedTasks_)
+			numBlockedSubmits_++;
+		hasRoom_.wait(lock, [&] { return (int)tasks_.size() < maxQueuedTasks_; });
+		tasks_.push_back(std::move(task));
+		hasTasks_.notify_one();
+	}
+
+	// Attendre que toutes les tâches soumises soient terminées.
+	void waitIdle() {
+		std::unique_lock lock(mutex_);
+		isIdle_.wait(lock, [&] { return tasks_.empty() and numRunning_ == 0; });
+	}
+
+	// Terminer les tâches en file, puis arrêter les fils.
+	void shutdown() {
+		{
+			std::lock_guard lock(mutex_);
+			isStopping_ = true;
+		}
+		hasTasks_.notify_all();
+		for (auto&& thread : threads_)
+			thread.join();
+		threads_.clear();
+	}
+
+	// Nombre de fois où submit() a dû attendre une place dans la file.
+	int getNumBlockedSubmits() const { return numBlockedSubmits_; }
+
+private:
+	void workerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock lock(mutex_);
+				hasTasks_.wait(lock, [&] { return isStopping_ or not tasks_.empty(); });
+				if (tasks_.empty())
+					return;
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+				numRunning_++;
+			}
+			hasRoom_.notify_one();
+			task();
+			{
+				std::lock_guard lock(mutex_);
+				numRunning_--;
+			}
+			isIdle_.notify_all();
+		}
+	}
+
+	std::vector<std::thread> threads_;
+	std::deque<std::function<void()>> tasks_;
+	std::mutex mutex_;
+	std::condition_variable hasTasks_;
+	std::condition_variable hasRoom_;
+	std::condition_variable isIdle_;
+	int maxQueuedTasks_ = 4;
+	int numRunning_ = 0;
+	int numBlockedSubmits_ = 0;
+	bool isStopping_ = false;
+};
+
+// Format des images écrites. PNG compresse bien mais l'encodage est lent (plusieurs dizaines de ms pour une image 1080p). Pour enregistrer une séquence à pleine vitesse, PPM (brut, sans compression) ou QOI (compression légère sans perte, environ 20 fois plus rapide que PNG) suivent beaucoup mieux. ffmpeg lit les trois.
+enum class ImageFileFormat
+{
+	Png,
+	Ppm,
+	Qoi,
+};
+
+inline const char* getImageFileExtension(ImageFileFormat format) {
+	switch (format) {
+	case ImageFileFormat::Ppm: return "ppm";
+	case ImageFileFormat::Qoi: return "qoi";
+	default: return "png";
+	}
+}
+
+inline bool parseImageFileFormat(const std::string& name, ImageFileFormat& format) {
+	if (name == "png")
+		format = ImageFileFormat::Png;
+	else if (name == "ppm")
+		format = ImageFileFormat::Ppm;
+	else if (name == "qoi")
+		format = ImageFileFormat::Qoi;
+	else
+		return false;
+	return true;
+}
+
+// Écrire des pixels RGBA lus par glReadPixels. La première ligne est celle du bas (origine d'OpenGL), alors que les formats d'image commencent par celle du haut.
+inline bool writeImageFile(const std::string& path, const std::vector<uint8_t>& pixels, int width, int height, ImageFileFormat format) {
+	size_t rowSize = (size_t)width * 4;
+	if (format == ImageFileFormat::Png) {
+		sf::Image image;
+		image.resize({(unsigned)width, (unsigned)height}, pixels.data());
+		image.flipVertically();
+		return image.saveToFile(path);
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (not file)
+		return false;
+	if (format == ImageFileFormat::Ppm) {
+		// En-tête texte, puis les pixels en RGB sans alpha.
+		file << "P6\n" << width << " " << height << "\n255\n";
+		std::vector<uint8_t> row(width * 3);
+		for (int y = height - 1; y >= 0; y--) {
+			const uint8_t* source = pixels.data() + y * rowSize;
+			for (int x = 0; x < width; x++)
+				std::memcpy(&row[x * 3], &source[x * 4], 3);
+			file.write((const char*)row.data(), row.size());
+		}
+		return bool(file);
+	}
+
+	// QOI (https://qoiformat.org) : chaque pixel est codé par rapport au précédent (répétition, petite différence ou pixel récent d'une table de 64), sinon en entier.
+	std::vector<uint8_t> bytes = {'q', 'o', 'i', 'f'};
+	auto writeBigEndian = [&](uint32_t value) {
+		for (int shift = 24; shift >= 0; shift -= 8)
+			bytes.push_back((uint8_t)(value >> shift));
+	};
+	writeBigEndian(width);
+	writeBigEndian(height);
+	bytes.push_back(4); // RGBA
+	bytes.push_back(0); // sRGB
+	bytes.reserve(bytes.size() + pixels.size() / 2);
+
+	struct Pixel { uint8_t r, g, b, a; bool operator==(const Pixel&) const = default; };
+	std::array<Pixel, 64> recent = {};
+	Pixel previous = {0, 0, 0, 255};
+	int run = 0;
+	for (int y = height - 1; y >= 0; y--) {
+		for (int x = 0; x < width; x++) {
+			Pixel pixel;
+			std::memcpy(&pixel, pixels.data() + y * rowSize + x * 4, 4);
+			bool isLast = y == 0 and x == width - 1;
+			if (pixel == previous) {
+				run++;
+				if (run == 62 or isLast) {
+					bytes.push_back(0xC0 | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0) {
+				bytes.push_back(0xC0 | (run - 1));
+				run = 0;
+			}
+			int hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+			if (recent[hash] == pixel) {
+				bytes.push_back((uint8_t)hash);
+			} else {
+				recent[hash] = pixel;
+				if (pixel.a == previous.a) {
+					int8_t dr = (int8_t)(pixel.r - previous.r);
+					int8_t dg = (int8_t)(pixel.g - previous.g);
+					int8_t db = (int8_t)(pixel.b - previous.b);
+					int drg = dr - dg;
+					int dbg = db - dg;
+					if (dr >= -2 and dr <= 1 and dg >= -2 and dg <= 1 and db >= -2 and db <= 1) {
+						bytes.push_back(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+					} else if (dg >= -32 and dg <= 31 and drg >= -8 and drg <= 7 and dbg >= -8 and dbg <= 7) {
+						bytes.push_back(0x80 | (dg + 32));
+						bytes.push_back((uint8_t)((drg + 8) << 4 | (dbg + 8)));
+					} else {
+						bytes.insert(bytes.end(), {0xFE, pixel.r, pixel.g, pixel.b});
+					}
+				} else {
+					bytes.insert(bytes.end(), {0xFF, pixel.r, pixel.g, pixel.b, pixel.a});
+				}
+			}
+			previous = pixel;
+		}
+	}
+	bytes.insert(bytes.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+	file.write((const char*)bytes.data(), bytes.size());
+	return bool(file);
+}
+
+struct FrameCaptureStats
+{
+	int numCaptured = 0;
+	int numWritten = 0;
+	int numFailed = 0;
+	int numStalls = 0; // Captures qui ont dû attendre le GPU parce que toutes les cases de l'anneau étaient occupées.
+	int numBlockedSubmits = 0; // Fois où l'encodage n'a pas suivi et a ralenti la boucle principale.
+};
+
+// Capture asynchrone de trames vers des fichiers d'image.
+// capture() demande au GPU de copier le framebuffer de lecture dans un PBO (GL_PIXEL_PACK_BUFFER) d'un anneau : glReadPixels retourne tout de suite au lieu d'attendre la fin du rendu. update(), appelée à chaque trame, mappe les PBO capturés deux trames plus tôt (la copie est alors terminée depuis longtemps), copie les pixels et confie l'encodage du fichier au bassin de fils.
+class FrameCapture
+{
+public:
+	FrameCapture() = default;
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	~FrameCapture() {
+		writers_.shutdown();
+	}
+
+	// numSlots : nombre de PBO dans l'anneau (au moins latency + 1). latency : trames entre la copie et la lecture. Les PBO, créés au besoin, sont attribués à `where` dans le registre des ressources.
+	void setup(int numSlots = 3, int latency = 2, int numWriterThreads = 2, int maxQueuedImages = 4, std::source_location where = std::source_location::current()) {
+		deleteObjects();
+		where_ = where;
+		latency_ = latency;
+		slots_.assign(std::max(numSlots, latency + 1), {});
+		writers_.start(numWriterThreads, maxQueuedImages);
+	}
+
+	// Mettre en file la copie d'une région du framebuffer de lecture courant (et de son glReadBuffer). Le fichier est écrit quelques trames plus tard.
+	void capture(int x, int y, int width, int height, const std::string& path, ImageFileFormat format) {
+		if (slots_.empty())
+			setup();
+		Slot& slot = slots_[nextSlot_];
+		nextSlot_ = (nextSlot_ + 1) % slots_.size();
+		// Toutes les cases sont occupées (plusieurs captures dans la même trame) : il faut finir la plus vieille avant de la réutiliser.
+		if (slot.fence != nullptr) {
+			stats_.numStalls++;
+			complete(slot);
+		}
+
+		GLsizeiptr size = (GLsizeiptr)width * height * 4;
+		if (slot.buffer == 0) {
+			glGenBuffers(1, &slot.buffer);
+			glResources.track(GLResourceType::Buffer, slot.buffer, "FrameCapture (PBO)", where_);
+		}
+		glState.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		if (slot.capacity < size) {
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+			slot.capacity = size;
+			glResources.setSize(GLResourceType::Buffer, slot.buffer, size);
+		}
+		GLint packAlignment = 4;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+		glState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT);
+		slot.width = width;
+		slot.height = height;
+		slot.path = path;
+		slot.format = format;
+		slot.frameIssued = frame_;
+		stats_.numCaptured++;
+	}
+
+	// À appeler une fois par trame, sur le fil d'OpenGL.
+	void update() {
+		frame_++;
+		for (auto&& slot : slots_) {
+			if (slot.fence != nullptr and frame_ - slot.frameIssued >= latency_)
+				complete(slot);
+		}
+		stats_.numBlockedSubmits = writers_.getNumBlockedSubmits();
+	}
+
+	// Lire toutes les captures en cours et attendre que leurs fichiers soient écrits (bloquant), par exemple avant de fermer.
+	void finish() {
+		// Dans l'ordre de capture, pour que les fichiers d'une séquence soient écrits dans l'ordre.
+		for (size_t i = 0; i < slots_.size(); i++) {
+			Slot& slot = slots_[(nextSlot_ + i) % slots_.size()];
+			if (slot.fence != nullptr)
+				complete(slot);
+		}
+		writers_.waitIdle();
+		stats_.numBlockedSubmits = writers_.getNumBlockedSubmits();
+	}
+
+	size_t getNumPending() const {
+		return std::count_if(slots_.begin(), slots_.end(), [](const Slot& slot) { return slot.fence != nullptr; });
+	}
+
+	// Les compteurs d'écriture sont mis à jour par les fils : on en fait une copie.
+	FrameCaptureStats getStats() const {
+		std::lock_guard lock(statsMutex_);
+		return stats_;
+	}
+
+	void deleteObjects() {
+		finish();
+		for (auto&& slot : slots_) {
+			if (slot.buffer != 0)
+				glState.deleteBuffers(1, &slot.buffer);
+		}
+		slots_.clear();
+		nextSlot_ = 0;
+	}
+
+private:
+	struct Slot
+	{
+		GLuint buffer = 0;
+		GLsizeiptr capacity = 0;
+		GLsync fence = nullptr;
+		int width = 0;
+		int height = 0;
+		std::string path;
+		ImageFileFormat format = ImageFileFormat::Png;
+		int frameIssued = 0;
+	};
+
+	void complete(Slot& slot) {
+		// Normalement, la clôture est passée depuis longtemps et l'attente ne coûte rien.
+		while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000) == GL_TIMEOUT_EXPIRED) {}
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		// On copie les pixels pour libérer le PBO tout de suite : l'encodage peut prendre plus d'une trame.
+		size_t size = (size_t)slot.width * slot.height * 4;
+		std::vector<uint8_t> pixels(size);
+		glState.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+		if (mapped != nullptr) {
+			std::memcpy(pixels.data(), mapped, size);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		if (mapped == nullptr) {
+			std::lock_guard lock(statsMutex_);
+			stats_.numFailed++;
+			return;
+		}
+
+		writers_.submit([this, pixels = std::move(pixels), width = slot.width, height = slot.height, path = slot.path, format = slot.format] {
+			bool ok = writeImageFile(path, pixels, width, height, format);
+			if (not ok)
+				std::cerr << "Impossible d'écrire " << path << std::endl;
+			std::lock_guard lock(statsMutex_);
+			(ok ? stats_.numWritten : stats_.numFailed)++;
+		});
+	}
+
+	std::vector<Slot> slots_;
+	size_t nextSlot_ = 0;
+	int latency_ = 2;
+	int frame_ = 0;
+	std::source_location where_;
+	BoundedWorkerPool writers_;
+	mutable std::mutex statsMutex_;
+	FrameCaptureStats stats_;
+};
@@ -0,0 +1,688 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "FrameArena.hpp"
+#include "Framebuffer.hpp"
+#include "GLStateCache.hpp"
+#include "GpuProfiler.hpp"
+#include "Texture.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Description d'une texture transitoire : ses dimensions, son format interne et son nombre d'échantillons. Elle est allouée dans un bassin de cibles de rendu (voir Framebuffer.hpp).
+using FrameGraphTextureDesc = RenderTargetDesc;
+
+// Une poignée vers une ressource du graphe. L'index 0 est toujours le tampon de la fenêtre (backbuffer).
+struct FrameGraphResource
+{
+	int index = -1;
+
+	bool isValid() const { return index >= 0; }
+};
+
+struct StencilFuncState
+{
+	GLenum func = GL_ALWAYS;
+	GLint ref = 0;
+	GLuint mask = 0xFF;
+};
+
+struct StencilOpState
+{
+	GLenum sfail = GL_KEEP;
+	GLenum dpfail = GL_KEEP;
+	GLenum dppass = GL_KEEP;
+};
+
+// L'état de rendu d'une passe. Les champs vides (std::nullopt) prennent la valeur de l'état par défaut du graphe. On n'a donc plus de paires « changer l'état / rétablir l'état » autour des dessins : chaque passe dit ce dont elle a besoin et le graphe l'applique à travers glState (qui filtre les appels redondants).
+// Avec les initialiseurs désignés de C++20, on n'écrit que ce qui change : {.depthTest = false, .depthWrite = false}.
+struct FrameGraphPassState
+{
+	std::optional<bool> depthTest;
+	std::optional<bool> depthWrite;
+	std::optional<bool> stencilTest;
+	std::optional<StencilFuncState> stencilFunc;
+	std::optional<StencilOpState> stencilOp;
+	std::optional<bool> colorWrite;
+	std::optional<bool> colorLogicOp;
+	std::optional<bool> faceCulling;
+	std::optional<GLenum> frontFace;
+	std::optional<GLenum> polygonMode;
+
+	// Les champs de `over` remplacent ceux de *this.
+	FrameGraphPassState overriddenBy(const FrameGraphPassState& over) const {
+		FrameGraphPassState result = *this;
+		overrideField(result.depthTest, over.depthTest);
+		overrideField(result.depthWrite, over.depthWrite);
+		overrideField(result.stencilTest, over.stencilTest);
+		overrideField(result.stencilFunc, over.stencilFunc);
+		overrideField(result.stencilOp, over.stencilOp);
+		overrideField(result.colorWrite, over.colorWrite);
+		overrideField(result.colorLogicOp, over.colorLogicOp);
+		overrideField(result.faceCulling, over.faceCulling);
+		overrideField(result.frontFace, over.frontFace);
+		overrideField(result.polygonMode, over.polygonMode);
+		return result;
+	}
+
+	void apply() const {
+		if (depthTest)
+			glState.setEnabled(GL_DEPTH_TEST, *depthTest);
+		if (depthWrite)
+			glState.depthMask(*depthWrite ? GL_TRUE : GL_FALSE);
+		if (stencilTest)
+			glState.setEnabled(GL_STENCIL_TEST, *stencilTest);
+		if (stencilFunc)
+			glState.stencilFunc(stencilFunc->func, stencilFunc->ref, stencilFunc->mask);
+		if (stencilOp)
+			glState.stencilOp(stencilOp->sfail, stencilOp->dpfail, stencilOp->dppass);
+		if (colorWrite) {
+			GLboolean flag = *colorWrite ? GL_TRUE : GL_FALSE;
+			glState.colorMask(flag, flag, flag, flag);
+		}
+		if (colorLogicOp)
+			glState.setEnabled(GL_COLOR_LOGIC_OP, *colorLogicOp);
+		if (faceCulling)
+			glState.setEnabled(GL_CULL_FACE, *faceCulling);
+		if (frontFace)
+			glState.frontFace(*frontFace);
+		if (polygonMode)
+			glState.polygonMode(GL_FRONT_AND_BACK, *polygonMode);
+	}
+
+private:
+	template <typename T>
+	static void overrideField(std::optional<T>& field, const std::optional<T>& over) {
+		if (over.has_value())
+			field = over;
+	}
+};
+
+// Une écriture d'une passe dans une ressource, avec l'effacement optionnel à faire avant la passe.
+struct FrameGraphAttachment
+{
+	FrameGraphResource resource;
+	std::optional<vec4> clearColor;
+	std::optional<float> clearDepth;
+	std::optional<GLint> clearStencil;
+};
+
+// Ce que la dernière compilation du graphe a donné.
+struct FrameGraphStats
+{
+	int numPasses = 0;
+	int numDisabledPasses = 0;
+	int numCulledPasses = 0;
+	int numTransientTextures = 0; // Textures logiques utilisées par les passes gardées.
+	int numPooledTextures = 0; // Textures réellement allouées (après le partage des textures dont les durées de vie ne se chevauchent pas).
+	size_t pooledBytes = 0;
+	int numClears = 0;
+	int numResolves = 0;
+	int numInvalidatedAttachments = 0;
+};
+
+class FrameGraph;
+class FrameGraphPassContext;
+
+// Une passe de rendu : ce qu'elle lit, ce qu'elle écrit, son état de rendu et la fonction qui dessine. On la construit par chaînage :
+//   graph.addPass("Scène").read(shadowMap).writeColor(graph.getBackbuffer(), vec4(0, 0, 0, 1)).setExecute([&](auto& ctx) { ... });
+class FrameGraphPass
+{
+public:
+	explicit FrameGraphPass(std::string name) : name_(std::move(name)) { }
+
+	// Déclarer une texture échantillonnée par la passe. C'est ce qui crée les dépendances entre passes.
+	FrameGraphPass& read(FrameGraphResource resource) {
+		reads_.push_back(resource);
+		return *this;
+	}
+
+	// Écrire dans une attache de couleur. Sans valeur d'effacement, l'ancien contenu est préservé (et la passe dépend donc de ceux qui ont écrit avant elle).
+	FrameGraphPass& writeColor(FrameGraphResource resource, std::optional<vec4> clearColor = std::nullopt) {
+		colorWrites_.push_back({resource, clearColor, std::nullopt, std::nullopt});
+		return *this;
+	}
+
+	// Écrire dans l'attache de profondeur (et de stencil si le format en a un).
+	FrameGraphPass& writeDepth(FrameGraphResource resource, std::optional<float> clearDepth = std::nullopt, std::optional<GLint> clearStencil = std::nullopt) {
+		depthWrite_ = {resource, std::nullopt, clearDepth, clearStencil};
+		return *this;
+	}
+
+	FrameGraphPass& setState(const FrameGraphPassState& state) {
+		state_ = state;
+		return *this;
+	}
+
+	FrameGraphPass& setExecute(std::function<void(FrameGraphPassContext&)> execute) {
+		execute_ = std::move(execute);
+		return *this;
+	}
+
+	// Une passe désactivée est retirée du graphe, mais ses effacements sont reportés à la prochaine passe qui écrit dans les mêmes ressources. On peut donc mettre l'effacement sur la première passe et quand même la désactiver.
+	FrameGraphPass& setEnabled(bool enabled) {
+		isEnabled_ = enabled;
+		return *this;
+	}
+
+	// Garder la passe même si personne ne lit ce qu'elle écrit (par exemple une passe qui fait une lecture vers le CPU).
+	FrameGraphPass& setSideEffect() {
+		hasSideEffect_ = true;
+		return *this;
+	}
+
+	const std::string& getName() const { return name_; }
+	bool isCulled() const { return isCulled_; }
+
+private:
+	friend class FrameGraph;
+
+	bool writesBackbuffer() const {
+		if (colorWrites_.empty() and not depthWrite_.has_value())
+			return true;
+		for (auto&& attachment : colorWrites_) {
+			if (attachment.resource.index == 0)
+				return true;
+		}
+		return depthWrite_.has_value() and depthWrite_->resource.index == 0;
+	}
+
+	std::string name_;
+	std::vector<FrameGraphResource> reads_;
+	std::vector<FrameGraphAttachment> colorWrites_;
+	std::optional<FrameGraphAttachment> depthWrite_;
+	FrameGraphPassState state_;
+	std::function<void(FrameGraphPassContext&)> execute_;
+	bool isEnabled_ = true;
+	bool hasSideEffect_ = false;
+	bool isCulled_ = false;
+	bool isResolve_ = false;
+};
+
+// Ce qu'une passe reçoit pendant son exécution : les textures des ressources qu'elle lit et les dimensions de sa cible (pour la projection).
+class FrameGraphPassContext
+{
+public:
+	FrameGraphPassContext(FrameGraph& graph, const FrameGraphPass& pass, ivec2 size)
+	: graph_(graph), pass_(pass), size_(size) { }
+
+	Texture& getTexture(FrameGraphResource resource);
+	const FrameGraphPass& getPass() const { return pass_; }
+	ivec2 getSize() const { return size_; }
+	float getAspect() const { return (float)size_.x / size_.y; }
+
+private:
+	FrameGraph& graph_;
+	const FrameGraphPass& pass_;
+	ivec2 size_;
+};
+
+// Un graphe de trame (frame graph). Plutôt que d'enchaîner à la main les glBindFramebuffer, glViewport, glClear et changements d'état entre les passes d'un rendu multi-passe, on déclare les passes et leurs ressources à chaque trame, puis le graphe :
+//   - retire les passes dont personne n'utilise le résultat (en remontant depuis la fenêtre et les passes à effet de bord);
+//   - alloue les textures transitoires dans un bassin qui persiste d'une trame à l'autre, et fait partager la même texture à des ressources dont les durées de vie ne se chevauchent pas;
+//   - fait un seul glClear par passe pour toutes ses attaches (couleur, profondeur, stencil);
+//   - invalide (glInvalidateFramebuffer) les attaches après leur dernière utilisation, puisque personne ne relira leur contenu;
+//   - règle le viewport et l'état de chaque passe à travers glState, donc sans jamais relire l'état avec glGet*.
+// Utilisation à chaque trame : reset(taille de la fenêtre), createTexture(), addPass()..., compile(), execute().
+class FrameGraph
+{
+public:
+	// Recommencer la description du graphe. backbufferSize est la taille de la fenêtre (OpenGLApplication::getWindowSize()). On ne la déduit pas du viewport courant, qui est celui que la trame précédente a laissé (souvent la taille de sa dernière cible).
+	void reset(ivec2 backbufferSize) {
+		backbufferSize_ = backbufferSize;
+		passes_.clear();
+		resources_.clear();
+		executionOrder_.clear();
+		backbufferClear_ = {};
+		resources_.push_back({"backbuffer", {backbufferSize, GL_RGBA8}, nullptr});
+	}
+
+	FrameGraphResource getBackbuffer() const { return {0}; }
+	ivec2 getBackbufferSize() const { return backbufferSize_; }
+
+	// Déclarer une texture transitoire. Elle n'existe réellement (dans le bassin) que si une passe gardée s'en sert.
+	FrameGraphResource createTexture(std::string name, const FrameGraphTextureDesc& desc) {
+		resources_.push_back({std::move(name), desc, nullptr});
+		return {(int)resources_.size() - 1};
+	}
+
+	FrameGraphPass& addPass(std::string name) {
+		return passes_.emplace_back(std::move(name));
+	}
+
+	// Résoudre une texture multiéchantillonnée (MSAA) vers une texture à un échantillon de même taille et format, qu'on peut ensuite lire dans une passe. C'est une passe comme les autres (donc éliminée si personne ne lit la destination), mais qui fait un glBlitFramebuffer plutôt que de dessiner.
+	FrameGraphPass& addResolve(std::string name, FrameGraphResource source, FrameGraphResource destination) {
+		FrameGraphPass& pass = addPass(std::move(name)).read(source);
+		if (resources_[destination.index].desc.isDepth())
+			pass.writeDepth(destination);
+		else
+			pass.writeColor(destination);
+		pass.isResolve_ = true;
+		return pass;
+	}
+
+	// L'état appliqué aux passes qui ne précisent pas un champ.
+	void setDefaultState(const FrameGraphPassState& state) { defaultState_ = state; }
+
+	// Mesurer le temps GPU de chaque passe exécutée (une portée par passe, au nom de la passe). nullptr pour arrêter.
+	void setProfiler(GpuProfiler* profiler) { profiler_ = profiler; }
+
+	void compile() {
+		stats_ = {};
+		stats_.numPasses = (int)passes_.size();
+
+		// Le graphe est refait à chaque trame : ses tableaux temporaires sont pris dans l'arène de trame plutôt que sur le tas.
+		FrameVector<FrameGraphPass*> activePasses = removeDisabledPasses();
+		cullPasses(activePasses);
+		allocateTextures();
+		// Les cibles qui n'ont pas servi depuis quelques trames (par exemple l'ancienne taille après un redimensionnement) sont détruites, avec les framebuffers qui s'en servent.
+		pool_.endFrame([&](const RenderTarget& target) { forgetFramebuffers(&target); });
+
+		stats_.numPooledTextures = (int)pool_.size();
+		stats_.pooledBytes = pool_.getNumBytes();
+	}
+
+	void execute() {
+		if (backbufferClear_.clearColor or backbufferClear_.clearDepth or backbufferClear_.clearStencil) {
+			glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+			glState.viewport(0, 0, backbufferSize_.x, backbufferSize_.y);
+			FrameVector<FrameGraphAttachment> colors(frameArena.get());
+			if (backbufferClear_.clearColor)
+				colors.push_back(backbufferClear_);
+			clearAttachments(colors, backbufferClear_);
+		}
+
+		for (int k = 0; k < (int)executionOrder_.size(); k++) {
+			FrameGraphPass* pass = executionOrder_[k];
+			if (profiler_ != nullptr)
+				profiler_->begin(pass->name_);
+			if (pass->isResolve_)
+				executeResolve(*pass, k);
+			else
+				executePass(*pass, k);
+			if (profiler_ != nullptr)
+				profiler_->end();
+		}
+
+		// Revenir au tampon de la fenêtre pour le code qui suit (interface, capture d'écran, etc.).
+		glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		glState.viewport(0, 0, backbufferSize_.x, backbufferSize_.y);
+	}
+
+	// La texture réellement utilisée pour une ressource transitoire. Valide seulement entre compile() et le prochain reset().
+	Texture& getTexture(FrameGraphResource resource) {
+		RenderTarget& target = getTarget(resource);
+		if (target.isRenderbuffer())
+			std::cerr << "Frame graph: '" << resources_[resource.index].name << "' est multiéchantillonnée, il faut la résoudre avant de l'échantillonner." << std::endl;
+		return target.texture;
+	}
+
+	const FrameGraphStats& getLastStats() const { return stats_; }
+
+	// Afficher l'ordre d'exécution, les passes éliminées et les textures partagées.
+	void print(std::ostream& out) const {
+		for (auto&& pass : passes_) {
+			out << (not pass.isEnabled_ ? "  [désactivée] " : pass.isCulled_ ? "  [éliminée]   " : "  ") << pass.name_ << "\n";
+		}
+		for (size_t i = 1; i < resources_.size(); i++) {
+			auto&& resource = resources_[i];
+			out << "  " << resource.name << " -> ";
+			if (resource.physical == nullptr)
+				out << "non allouée\n";
+			else if (resource.physical->isRenderbuffer())
+				out << "renderbuffer " << resource.physical->renderbuffer << " (" << resource.desc.samples << " échantillons)\n";
+			else
+				out << "texture " << resource.physical->texture.id << "\n";
+		}
+	}
+
+	void deleteObjects() {
+		for (auto&& [key, framebuffer] : framebuffers_)
+			framebuffer.deleteObject();
+		framebuffers_.clear();
+		pool_.deleteObjects();
+		for (auto&& resource : resources_)
+			resource.physical = nullptr;
+	}
+
+private:
+	struct ResourceNode
+	{
+		std::string name;
+		FrameGraphTextureDesc desc;
+		RenderTarget* physical = nullptr;
+		int firstUse = -1;
+		int lastUse = -1;
+	};
+
+	// Retirer les passes désactivées en reportant leurs effacements à la prochaine passe qui écrit dans la même ressource.
+	FrameVector<FrameGraphPass*> removeDisabledPasses() {
+		FrameVector<FrameGraphAttachment> pending(resources_.size(), frameArena.get());
+		FrameVector<FrameGraphPass*> activePasses(frameArena.get());
+		for (auto&& pass : passes_) {
+			if (not pass.isEnabled_) {
+				stats_.numDisabledPasses++;
+				for (FrameGraphAttachment* attachment : getWrites(pass)) {
+					FrameGraphAttachment& p = pending[attachment->resource.index];
+					if (attachment->clearColor)
+						p.clearColor = attachment->clearColor;
+					if (attachment->clearDepth)
+						p.clearDepth = attachment->clearDepth;
+					if (attachment->clearStencil)
+						p.clearStencil = attachment->clearStencil;
+				}
+				continue;
+			}
+			for (auto&& attachment : pass.colorWrites_) {
+				FrameGraphAttachment& p = pending[attachment.resource.index];
+				if (not attachment.clearColor)
+					attachment.clearColor = p.clearColor;
+				p.clearColor.reset();
+			}
+			if (pass.depthWrite_) {
+				FrameGraphAttachment& p = pending[pass.depthWrite_->resource.index];
+				if (not pass.depthWrite_->clearDepth)
+					pass.depthWrite_->clearDepth = p.clearDepth;
+				if (not pass.depthWrite_->clearStencil)
+					pass.depthWrite_->clearStencil = p.clearStencil;
+				p.clearDepth.reset();
+				p.clearStencil.reset();
+			}
+			activePasses.push_back(&pass);
+		}
+		// Des effacements de la fenêtre qui n'ont trouvé aucune passe sont faits seuls au début de execute().
+		backbufferClear_ = pending[0];
+		return activePasses;
+	}
+
+	// Remonter les passes à rebours. Une passe est gardée si elle a un effet de bord ou si elle écrit dans une ressource dont une passe gardée plus loin a besoin.
+	void cullPasses(std::span<FrameGraphPass* const> activePasses) {
+		FrameVector<bool> isNeeded(resources_.size(), false, frameArena.get());
+		isNeeded[0] = true;
+		FrameVector<FrameGraphPass*> kept(frameArena.get());
+		for (auto it = activePasses.rbegin(); it != activePasses.rend(); ++it) {
+			FrameGraphPass* pass = *it;
+			auto attachments = getWrites(*pass);
+			bool needed = pass->hasSideEffect_ or pass->writesBackbuffer();
+			for (FrameGraphAttachment* attachment : attachments)
+				needed = needed or isNeeded[attachment->resource.index];
+			pass->isCulled_ = not needed;
+			if (not needed) {
+				stats_.numCulledPasses++;
+				continue;
+			}
+			// Une écriture qui efface complètement la ressource n'a pas besoin de ce qu'il y avait avant. Sinon, c'est comme une lecture.
+			for (FrameGraphAttachment* attachment : attachments) {
+				int index = attachment->resource.index;
+				if (index != 0)
+					isNeeded[index] = not isFullyCleared(*pass, *attachment);
+			}
+			for (FrameGraphResource resource : pass->reads_)
+				isNeeded[resource.index] = true;
+			kept.push_back(pass);
+		}
+		executionOrder_.assign(kept.rbegin(), kept.rend());
+	}
+
+	// Calculer la durée de vie de chaque ressource (première et dernière passe qui s'en sert), puis lui donner une texture du bassin pour cette durée seulement.
+	void allocateTextures() {
+		pool_.releaseAll();
+		for (auto&& resource : resources_) {
+			resource.physical = nullptr;
+			resource.firstUse = -1;
+			resource.lastUse = -1;
+		}
+
+		for (int k = 0; k < (int)executionOrder_.size(); k++) {
+			FrameGraphPass& pass = *executionOrder_[k];
+			auto use = [&](FrameGraphResource resource, bool isRead) {
+				ResourceNode& node = resources_[resource.index];
+				if (resource.index == 0)
+					return;
+				if (node.firstUse < 0) {
+					node.firstUse = k;
+					if (isRead)
+						std::cerr << "Frame graph: '" << node.name << "' est lue par '" << pass.name_ << "' avant d'être écrite." << std::endl;
+				}
+				node.lastUse = k;
+			};
+			for (FrameGraphResource resource : pass.reads_)
+				use(resource, true);
+			for (FrameGraphAttachment* attachment : getWrites(pass))
+				use(attachment->resource, false);
+		}
+
+		for (int k = 0; k < (int)executionOrder_.size(); k++) {
+			for (auto&& node : resources_) {
+				if (node.firstUse == k) {
+					node.physical = pool_.acquire(node.desc);
+					stats_.numTransientTextures++;
+				}
+			}
+			for (auto&& node : resources_) {
+				if (node.lastUse == k)
+					pool_.release(node.physical);
+			}
+		}
+	}
+
+	// Les framebuffers sont gardés selon la combinaison de cibles attachées. Comme le bassin réutilise les mêmes cibles d'une trame à l'autre, on ne crée un framebuffer qu'à la première trame.
+	Framebuffer& getFramebuffer(const FrameGraphPass& pass) {
+		FrameVector<const RenderTarget*> colors(frameArena.get());
+		for (auto&& attachment : pass.colorWrites_)
+			colors.push_back(&getTarget(attachment.resource));
+		const RenderTarget* depth = pass.depthWrite_ ? &getTarget(pass.depthWrite_->resource) : nullptr;
+		return getFramebuffer(colors, depth);
+	}
+
+	Framebuffer& getFramebuffer(std::span<const RenderTarget* const> colors, const RenderTarget* depth) {
+		// La clé n'est copiée dans un std::vector que pour un nouveau framebuffer. Pour chercher, la comparaison transparente accepte la clé temporaire.
+		FrameVector<const RenderTarget*> key(colors.begin(), colors.end(), frameArena.get());
+		key.push_back(depth);
+		auto it = framebuffers_.find(key);
+		if (it != framebuffers_.end())
+			return it->second;
+
+		Framebuffer& framebuffer = framebuffers_[std::vector<const RenderTarget*>(key.begin(), key.end())];
+		framebuffer.create();
+		for (int i = 0; i < (int)colors.size(); i++)
+			framebuffer.attachColor(i, *colors[i]);
+		if (depth != nullptr)
+			framebuffer.attachDepth(*depth);
+		framebuffer.finalize();
+		return framebuffer;
+	}
+
+	// Le framebuffer d'une seule cible, attachée comme couleur ou comme profondeur selon son format.
+	Framebuffer& getFramebuffer(const RenderTarget& target) {
+		if (target.desc.isDepth())
+			return getFramebuffer({}, &target);
+		const RenderTarget* color = &target;
+		return getFramebuffer({&color, 1}, nullptr);
+	}
+
+	void forgetFramebuffers(const RenderTarget* target) {
+		for (auto it = framebuffers_.begin(); it != framebuffers_.end();) {
+			if (std::find(it->first.begin(), it->first.end(), target) != it->first.end()) {
+				it->second.deleteObject();
+				it = framebuffers_.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	// Lier le framebuffer de la passe (ou celui de la fenêtre), effacer ses attaches, appliquer son état, puis appeler sa fonction de dessin.
+	void executePass(FrameGraphPass& pass, int passIndex) {
+		GLuint framebuffer = 0;
+		ivec2 size = backbufferSize_;
+		if (not pass.writesBackbuffer()) {
+			framebuffer = getFramebuffer(pass).getObject();
+			const FrameGraphAttachment& first = pass.colorWrites_.empty() ? *pass.depthWrite_ : pass.colorWrites_[0];
+			size = getTarget(first.resource).desc.size;
+		}
+		glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glState.viewport(0, 0, size.x, size.y);
+
+		// Effacer avant d'appliquer l'état de la passe, car glClear respecte les masques d'écriture.
+		clearAttachments(pass.colorWrites_, pass.depthWrite_.value_or(FrameGraphAttachment{}));
+		defaultState_.overriddenBy(pass.state_).apply();
+
+		if (pass.execute_) {
+			FrameGraphPassContext context(*this, pass, size);
+			pass.execute_(context);
+		}
+
+		if (framebuffer != 0)
+			invalidateDeadAttachments(pass, framebuffer, passIndex);
+	}
+
+	// Copier la source (résolue si multiéchantillonnée) vers la destination, chacune dans son propre framebuffer.
+	void executeResolve(FrameGraphPass& pass, int passIndex) {
+		const RenderTarget& source = getTarget(pass.reads_[0]);
+		const FrameGraphAttachment& destinationAttachment = pass.colorWrites_.empty() ? *pass.depthWrite_ : pass.colorWrites_[0];
+		const RenderTarget& destination = getTarget(destinationAttachment.resource);
+		bool isDepth = source.desc.isDepth();
+		Framebuffer& sourceFramebuffer = getFramebuffer(source);
+		Framebuffer& destinationFramebuffer = getFramebuffer(destination);
+
+		ClearBufferMask mask = GL_COLOR_BUFFER_BIT;
+		if (isDepth)
+			mask = GL_DEPTH_BUFFER_BIT;
+		if (source.desc.hasStencil())
+			mask |= GL_STENCIL_BUFFER_BIT;
+		sourceFramebuffer.resolveTo(destinationFramebuffer, mask);
+		stats_.numResolves++;
+
+		// La source multiéchantillonnée n'est habituellement plus lue après sa résolution.
+		if (resources_[pass.reads_[0].index].lastUse == passIndex) {
+			GLenum attachment = source.getAttachmentPoint();
+			Framebuffer::invalidate(sourceFramebuffer.getObject(), {&attachment, 1});
+			stats_.numInvalidatedAttachments++;
+		}
+		glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Invalider les attaches de la passe dont c'est la dernière utilisation (par exemple un tampon de profondeur qui n'est jamais lu).
+	void invalidateDeadAttachments(const FrameGraphPass& pass, GLuint framebuffer, int passIndex) {
+		FrameVector<GLenum> attachments(frameArena.get());
+		for (int i = 0; i < (int)pass.colorWrites_.size(); i++) {
+			if (resources_[pass.colorWrites_[i].resource.index].lastUse == passIndex)
+				attachments.push_back(getTarget(pass.colorWrites_[i].resource).getAttachmentPoint(i));
+		}
+		if (pass.depthWrite_ and resources_[pass.depthWrite_->resource.index].lastUse == passIndex)
+			attachments.push_back(getTarget(pass.depthWrite_->resource).getAttachmentPoint());
+		Framebuffer::invalidate(framebuffer, attachments);
+		stats_.numInvalidatedAttachments += (int)attachments.size();
+	}
+
+	// Un seul glClear pour toutes les attaches de la passe. Si les attaches de couleur n'ont pas toutes la même valeur d'effacement, on efface chacune avec glClearBuffer.
+	void clearAttachments(std::span<const FrameGraphAttachment> colors, const FrameGraphAttachment& depth) {
+		ClearBufferMask mask = GL_NONE_BIT;
+		bool isSameColor = true;
+		for (auto&& attachment : colors) {
+			if (attachment.clearColor != colors[0].clearColor)
+				isSameColor = false;
+		}
+
+		bool hasColorClear = false;
+		for (auto&& attachment : colors)
+			hasColorClear = hasColorClear or attachment.clearColor.has_value();
+		if (hasColorClear) {
+			glState.colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			if (isSameColor) {
+				vec4 color = *colors[0].clearColor;
+				glState.clearColor(color.r, color.g, color.b, color.a);
+				mask |= GL_COLOR_BUFFER_BIT;
+			} else {
+				for (int i = 0; i < (int)colors.size(); i++) {
+					if (colors[i].clearColor) {
+						glClearBufferfv(GL_COLOR, i, &colors[i].clearColor->x);
+						stats_.numClears++;
+					}
+				}
+			}
+		}
+		if (depth.clearDepth) {
+			glState.depthMask(GL_TRUE);
+			glState.clearDepth(*depth.clearDepth);
+			mask |= GL_DEPTH_BUFFER_BIT;
+		}
+		if (depth.clearStencil) {
+			glState.stencilMask(0xFF);
+			glState.clearStencil(*depth.clearStencil);
+			mask |= GL_STENCIL_BUFFER_BIT;
+		}
+
+		if (mask != GL_NONE_BIT) {
+			glClear(mask);
+			stats_.numClears++;
+		}
+	}
+
+	// Une résolution remplace aussi tout le contenu de sa destination.
+	bool isFullyCleared(const FrameGraphPass& pass, const FrameGraphAttachment& attachment) const {
+		const FrameGraphTextureDesc& desc = resources_[attachment.resource.index].desc;
+		if (pass.isResolve_)
+			return true;
+		if (not desc.isDepth())
+			return attachment.clearColor.has_value();
+		return attachment.clearDepth.has_value() and (not desc.hasStencil() or attachment.clearStencil.has_value());
+	}
+
+	static FrameVector<FrameGraphAttachment*> getWrites(FrameGraphPass& pass) {
+		FrameVector<FrameGraphAttachment*> result(frameArena.get());
+		for (auto&& attachment : pass.colorWrites_)
+			result.push_back(&attachment);
+		if (pass.depthWrite_)
+			result.push_back(&*pass.depthWrite_);
+		return result;
+	}
+
+	RenderTarget& getTarget(FrameGraphResource resource) {
+		return *resources_[resource.index].physical;
+	}
+
+	std::deque<FrameGraphPass> passes_;
+	std::vector<ResourceNode> resources_;
+	std::vector<FrameGraphPass*> executionOrder_;
+	RenderTargetPool pool_;
+	// Comparaison transparente : on peut chercher avec une clé dans l'arène de trame (FrameVector) sans la copier dans un std::vector.
+	struct FramebufferKeyLess
+	{
+		using is_transparent = void;
+		bool operator()(std::span<const RenderTarget* const> a, std::span<const RenderTarget* const> b) const {
+			return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+		}
+	};
+	std::map<std::vector<const RenderTarget*>, Framebuffer, FramebufferKeyLess> framebuffers_;
+	FrameGraphAttachment backbufferClear_;
+	FrameGraphPassState defaultState_;
+	ivec2 backbufferSize_ = {};
+	FrameGraphStats stats_;
+	GpuProfiler* profiler_ = nullptr;
+};
+
+inline Texture& FrameGraphPassContext::getTexture(FrameGraphResource resource) {
+	return graph_.getTexture(resource);
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+
+#include <cmath>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "Benchmark.hpp"
+
+
+using namespace gl;
+
+
+// Façon d'attendre entre les trames.
+enum class FramePacingMode
+{
+	// Attendre l'échéance de la trame (1/fps) en dormant, puis en faisant une courte boucle active pour la fin. C'est le mode par défaut.
+	Precise,
+	// Laisser le buffer swap attendre la synchronisation verticale de l'écran, puis attendre que le GPU ait vraiment fini pour ne pas accumuler de trames d'avance (ce qui ajouterait une trame de latence par trame en file).
+	VSync,
+	// Ne jamais attendre : les trames s'enchaînent aussi vite que possible (banc d'essai, mode sans fenêtre).
+	Uncapped,
+};
+
+inline bool parseFramePacingMode(const std::string& name, FramePacingMode& mode) {
+	if (name == "precise")
+		mode = FramePacingMode::Precise;
+	else if (name == "vsync")
+		mode = FramePacingMode::VSync;
+	else if (name == "uncapped")
+		mode = FramePacingMode::Uncapped;
+	else
+		return false;
+	return true;
+}
+
+// Statistiques de cadence, en millisecondes.
+// La gigue (jitter) est l'écart entre la durée de chaque trame et la durée médiane. La latence est le temps entre le dernier échantillonnage des entrées (événements ou latchInput()) et la fin du buffer swap, une borne inférieure du temps entre un mouvement de souris et son affichage.
+struct FramePacingStats
+{
+	PercentileStats frameMs;
+	PercentileStats jitterMs;
+	PercentileStats latencyMs;
+	int numMissedDeadlines = 0;
+};
+
+// Cadence les trames plus précisément que sf::Window::setFramerateLimit().
+// SFML attend avec un seul sf::sleep, dont la précision dépend de l'ordonnanceur du système (jusqu'à ~15 ms sur Windows sans timeBeginPeriod). Les trames arrivent donc en retard d'une durée variable. Ici, on dort par petits coups de 1 ms tant qu'il reste plus de temps que ce qu'un sommeil dépasse habituellement (estimé en continu), puis on termine par une boucle active jusqu'à l'échéance.
+// Les échéances sont espacées de 1/fps à partir de la précédente et non du moment où l'attente commence, pour que les erreurs ne s'accumulent pas. Une trame trop lente pour son échéance la rate ; on repart alors de maintenant au lieu d'enchaîner des trames sans attente pour rattraper.
+class FramePacer
+{
+public:
+	void setup(FramePacingMode mode, float fps) {
+		mode_ = mode;
+		framePeriod_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / std::max(fps, 1.0f)));
+		nextDeadline_ = lastFrameEnd_ = lastInputTime_ = Clock::now();
+		frameMs_.clear();
+		latencyMs_.clear();
+		numMissedDeadlines_ = 0;
+	}
+
+	FramePacingMode getMode() const { return mode_; }
+
+	// Repartir de maintenant sans compter d'échéance ratée, par exemple après une pause voulue (dessin sur demande).
+	void resync() {
+		nextDeadline_ = lastFrameEnd_ = Clock::now();
+	}
+
+	// Noter le moment où les entrées (clavier, souris) ont été lues pour la trame en cours.
+	void markInputSampled() {
+		lastInputTime_ = Clock::now();
+	}
+
+	// À appeler juste après le buffer swap.
+	void markPresented() {
+		if (mode_ == FramePacingMode::VSync)
+			glFinish();
+		auto now = Clock::now();
+		addSample(latencyMs_, toMs(now - lastInputTime_));
+	}
+
+	// Attendre l'échéance de la trame suivante (rien à faire avec VSync ou Uncapped), puis mesurer la durée de la trame.
+	void wait() {
+		if (mode_ == FramePacingMode::Precise) {
+			nextDeadline_ += framePeriod_;
+			if (Clock::now() > nextDeadline_) {
+				numMissedDeadlines_++;
+				nextDeadline_ = Clock::now();
+			} else {
+				sleepUntil(nextDeadline_);
+			}
+		}
+		auto now = Clock::now();
+		addSample(frameMs_, toMs(now - lastFrameEnd_));
+		lastFrameEnd_ = now;
+	}
+
+	FramePacingStats computeStats() const {
+		FramePacingStats stats;
+		stats.frameMs = PercentileStats::compute(frameMs_);
+		stats.latencyMs = PercentileStats::compute(latencyMs_);
+		std::vector<float> jitterMs;
+		jitterMs.reserve(frameMs_.size());
+		for (float ms : frameMs_)
+			jitterMs.push_back(std::abs(ms - stats.frameMs.p50));
+		stats.jitterMs = PercentileStats::compute(jitterMs);
+		stats.numMissedDeadlines = numMissedDeadlines_;
+		return stats;
+	}
+
+	void print(std::ostream& out) const {
+		FramePacingStats stats = computeStats();
+		static const char* modeNames[] = {"précis", "vsync", "sans limite"};
+		out << std::format("{:<24} {:>8} {:>8} {:>8} {:>8} {:>8}", std::format("Cadence ({}, ms)", modeNames[(int)mode_]), "p50", "p95", "p99", "max", "moy") << "\n";
+		auto printRow = [&](std::string_view name, const PercentileStats& s) {
+			out << std::format("{:<24} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f}", name, s.p50, s.p95, s.p99, s.max, s.avg) << "\n";
+		};
+		printRow("trame", stats.frameMs);
+		printRow("gigue", stats.jitterMs);
+		printRow("latence entrée", stats.latencyMs);
+		if (mode_ == FramePacingMode::Precise)
+			out << std::format("Échéances ratées : {}", stats.numMissedDeadlines) << "\n";
+		out << std::flush;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Dormir par tranches de 1 ms tant que le temps qui reste dépasse la durée estimée d'un sommeil (moyenne + écart type des sommeils observés, algorithme de Welford), puis attendre activement le reste.
+	void sleepUntil(Clock::time_point deadline) {
+		while (true) {
+			double remainingMs = toMs(deadline - Clock::now());
+			if (remainingMs <= sleepEstimateMs_)
+				break;
+			auto start = Clock::now();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			double observedMs = toMs(Clock::now() - start);
+			numSleeps_++;
+			double delta = observedMs - sleepMeanMs_;
+			sleepMeanMs_ += delta / numSleeps_;
+			sleepM2_ += delta * (observedMs - sleepMeanMs_);
+			sleepEstimateMs_ = sleepMeanMs_ + std::sqrt(sleepM2_ / std::max(numSleeps_ - 1, 1LL));
+		}
+		while (Clock::now() < deadline)
+			;
+	}
+
+	// On garde les dernières trames seulement pour que la mémoire reste bornée.
+	static void addSample(std::vector<float>& samples, float value) {
+		if (samples.size() >= maxSamples)
+			samples.erase(samples.begin(), samples.begin() + maxSamples / 2);
+		samples.push_back(value);
+	}
+
+	static float toMs(Clock::duration duration) {
+		return std::chrono::duration<float, std::milli>(duration).count();
+	}
+
+	static constexpr size_t maxSamples = 20000;
+
+	FramePacingMode mode_ = FramePacingMode::Precise;
+	Clock::duration framePeriod_ = {};
+	Clock::time_point nextDeadline_;
+	Clock::time_point lastFrameEnd_;
+	Clock::time_point lastInputTime_;
+	std::vector<float> frameMs_;
+	std::vector<float> latencyMs_;
+	int numMissedDeadlines_ = 0;
+	// Estimation de la durée réelle d'un sommeil de 1 ms. On commence pessimiste, l'estimation s'ajuste dès les premières trames.
+	double sleepEstimateMs_ = 5;
+	double sleepMeanMs_ = 5;
+	double sleepM2_ = 0;
+	long long numSleeps_ = 0;
+};
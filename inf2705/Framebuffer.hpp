@@ -0,0 +1,327 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <source_location>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "GLStateCache.hpp"
+#include "Texture.hpp"
+#include "utils.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Description d'une cible de rendu : dimensions, format interne et nombre d'échantillons par pixel. Deux cibles avec la même description sont interchangeables.
+struct RenderTargetDesc
+{
+	ivec2 size = {};
+	GLenum internalFormat = GL_RGBA8;
+	int samples = 1;
+
+	bool operator==(const RenderTargetDesc&) const = default;
+
+	bool isDepth() const {
+		return internalFormat == GL_DEPTH_COMPONENT16 or internalFormat == GL_DEPTH_COMPONENT24
+			or internalFormat == GL_DEPTH_COMPONENT32F or hasStencil();
+	}
+
+	bool hasStencil() const {
+		return internalFormat == GL_DEPTH24_STENCIL8 or internalFormat == GL_DEPTH32F_STENCIL8;
+	}
+
+	bool isMultisampled() const { return samples > 1; }
+
+	// Taille approximative en mémoire graphique (le pilote peut ajouter du remplissage ou de la compression).
+	size_t getNumBytes() const {
+		return estimateTextureBytes(internalFormat, size, 1, samples);
+	}
+};
+
+// Une cible de rendu. Avec un seul échantillon, c'est une texture qu'on peut ensuite échantillonner dans un nuanceur. Avec plusieurs échantillons (MSAA), c'est un renderbuffer : on ne peut pas l'échantillonner directement, il faut d'abord le résoudre (blit) vers une cible à un échantillon.
+// Le stockage est immuable (glTexStorage2D, glRenderbufferStorageMultisample) : les dimensions et le format ne changent plus après la création. Pour une autre taille, on prend une autre cible (voir RenderTargetPool).
+struct RenderTarget
+{
+	RenderTargetDesc desc;
+	Texture texture; // Vide (id = 0) si la cible est un renderbuffer.
+	GLuint renderbuffer = 0;
+
+	static RenderTarget create(const RenderTargetDesc& desc, std::string_view label = "cible de rendu", std::source_location where = std::source_location::current()) {
+		RenderTarget target;
+		target.desc = desc;
+		target.texture.size = desc.size;
+
+		if (desc.isMultisampled()) {
+			glGenRenderbuffers(1, &target.renderbuffer);
+			glResources.track(GLResourceType::Renderbuffer, target.renderbuffer, label, where);
+			glResources.setSize(GLResourceType::Renderbuffer, target.renderbuffer, desc.getNumBytes());
+			glBindRenderbuffer(GL_RENDERBUFFER, target.renderbuffer);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples, desc.internalFormat, desc.size.x, desc.size.y);
+			glBindRenderbuffer(GL_RENDERBUFFER, 0);
+			return target;
+		}
+
+		target.texture.numLevels = 1;
+		glGenTextures(1, &target.texture.id);
+		glResources.track(GLResourceType::Texture, target.texture.id, label, where);
+		glResources.setSize(GLResourceType::Texture, target.texture.id, desc.getNumBytes());
+		glState.bindTexture(GL_TEXTURE_2D, target.texture.id);
+		// glTexStorage2D est dans le noyau depuis OpenGL 4.2. Sans lui, on donne quand même un seul niveau et on ne change plus jamais la texture, ce qui revient au même pour le pilote.
+		if (isTextureStorageSupported()) {
+			glTexStorage2D(GL_TEXTURE_2D, 1, desc.internalFormat, desc.size.x, desc.size.y);
+		} else {
+			auto [format, type] = getPixelTransferFormat(desc);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+			glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.size.x, desc.size.y, 0, format, type, nullptr);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return target;
+	}
+
+	bool isRenderbuffer() const { return renderbuffer != 0; }
+
+	// Le point d'attache dans un framebuffer (colorIndex est ignoré pour la profondeur).
+	GLenum getAttachmentPoint(int colorIndex = 0) const {
+		if (desc.hasStencil())
+			return GL_DEPTH_STENCIL_ATTACHMENT;
+		if (desc.isDepth())
+			return GL_DEPTH_ATTACHMENT;
+		return GLenum((int)GL_COLOR_ATTACHMENT0 + colorIndex);
+	}
+
+	void deleteObject() {
+		if (renderbuffer != 0) {
+			glDeleteRenderbuffers(1, &renderbuffer);
+			glResources.untrack(GLResourceType::Renderbuffer, renderbuffer);
+		}
+		renderbuffer = 0;
+		if (texture.id != 0)
+			texture.deleteObject();
+	}
+
+	// Pour GLOwned (voir GLObject.hpp).
+	template <typename F>
+	void forEachGLObject(F&& f) const {
+		f(GLResourceType::Renderbuffer, renderbuffer);
+		texture.forEachGLObject(f);
+	}
+
+	static bool isTextureStorageSupported() {
+		static bool isSupported = isGLVersionAtLeast(4, 2) or isGLExtensionSupported("GL_ARB_texture_storage");
+		return isSupported;
+	}
+
+private:
+	// Le format et le type des pixels à passer à glTexImage2D (même si on ne passe pas de données, ils doivent être compatibles avec le format interne).
+	static std::pair<GLenum, GLenum> getPixelTransferFormat(const RenderTargetDesc& desc) {
+		if (desc.internalFormat == GL_DEPTH32F_STENCIL8)
+			return {GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV};
+		if (desc.hasStencil())
+			return {GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8};
+		if (desc.isDepth())
+			return {GL_DEPTH_COMPONENT, GL_FLOAT};
+		if (desc.internalFormat == GL_RGBA16F or desc.internalFormat == GL_RGBA32F)
+			return {GL_RGBA, GL_FLOAT};
+		return {GL_RGBA, GL_UNSIGNED_BYTE};
+	}
+};
+
+// Un objet de tampon de trame (framebuffer object) avec ses cibles de rendu attachées.
+class Framebuffer
+{
+public:
+	void create(std::string_view label = "framebuffer", std::source_location where = std::source_location::current()) {
+		glGenFramebuffers(1, &id_);
+		glResources.track(GLResourceType::Framebuffer, id_, label, where);
+	}
+
+	void attachColor(int index, const RenderTarget& target) {
+		bind();
+		attach(target.getAttachmentPoint(index), target);
+		if ((int)drawBuffers_.size() <= index)
+			drawBuffers_.resize(index + 1, GL_NONE);
+		drawBuffers_[index] = target.getAttachmentPoint(index);
+		size_ = target.desc.size;
+	}
+
+	void attachDepth(const RenderTarget& target) {
+		bind();
+		attach(target.getAttachmentPoint(), target);
+		hasDepth_ = true;
+		size_ = target.desc.size;
+	}
+
+	// Choisir les tampons de dessin et vérifier que le framebuffer est complet. À appeler après les attach*().
+	bool finalize() {
+		bind();
+		if (drawBuffers_.empty()) {
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+		} else {
+			glDrawBuffers((GLsizei)drawBuffers_.size(), drawBuffers_.data());
+		}
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "Framebuffer " << id_ << " incomplet (status " << (int)status << ")." << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void bind(GLenum target = GL_FRAMEBUFFER) const {
+		glState.bindFramebuffer(target, id_);
+	}
+
+	GLuint getObject() const { return id_; }
+	ivec2 getSize() const { return size_; }
+	int getNumColorAttachments() const { return (int)drawBuffers_.size(); }
+	bool hasDepth() const { return hasDepth_; }
+
+	// Dire au pilote que le contenu de ces attaches ne sera plus lu. Sur les GPU à tuiles (mobiles) et les rastériseurs logiciels, ça évite de réécrire les tuiles en mémoire. Sinon, ça ne coûte rien.
+	// Les attaches sont GL_COLOR_ATTACHMENTi, GL_DEPTH_ATTACHMENT, GL_STENCIL_ATTACHMENT ou GL_DEPTH_STENCIL_ATTACHMENT (ou GL_COLOR, GL_DEPTH et GL_STENCIL pour le framebuffer de la fenêtre).
+	void invalidate(std::initializer_list<GLenum> attachments) const {
+		invalidate(id_, std::span<const GLenum>(attachments.begin(), attachments.size()));
+	}
+
+	static void invalidate(GLuint framebuffer, std::span<const GLenum> attachments) {
+		if (not isInvalidateSupported() or attachments.empty())
+			return;
+		glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glInvalidateFramebuffer(GL_FRAMEBUFFER, (GLsizei)attachments.size(), attachments.data());
+	}
+
+	// Copier (et résoudre les échantillons si la source est multiéchantillonnée) vers un autre framebuffer de mêmes dimensions. Avec une source MSAA, le filtre doit être GL_NEAREST et les dimensions doivent être égales.
+	void resolveTo(const Framebuffer& destination, ClearBufferMask mask = GL_COLOR_BUFFER_BIT) const {
+		blit(id_, size_, destination.id_, destination.size_, mask, GL_NEAREST);
+	}
+
+	// Le framebuffer 0 est celui de la fenêtre.
+	static void blit(GLuint source, ivec2 sourceSize, GLuint destination, ivec2 destinationSize, ClearBufferMask mask, GLenum filter) {
+		glState.bindFramebuffer(GL_READ_FRAMEBUFFER, source);
+		glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, destination);
+		glBlitFramebuffer(
+			0, 0, sourceSize.x, sourceSize.y,
+			0, 0, destinationSize.x, destinationSize.y,
+			mask, filter
+		);
+	}
+
+	void deleteObject() {
+		glState.deleteFramebuffers(1, &id_);
+		id_ = 0;
+		drawBuffers_.clear();
+		hasDepth_ = false;
+	}
+
+	// glInvalidateFramebuffer est dans le noyau depuis OpenGL 4.3 (ou avec l'extension ARB_invalidate_subdata). Sans elle, on n'invalide rien, ce qui est toujours correct.
+	static bool isInvalidateSupported() {
+		static bool isSupported = isGLVersionAtLeast(4, 3) or isGLExtensionSupported("GL_ARB_invalidate_subdata");
+		return isSupported;
+	}
+
+private:
+	void attach(GLenum attachmentPoint, const RenderTarget& target) {
+		if (target.isRenderbuffer())
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachmentPoint, GL_RENDERBUFFER, target.renderbuffer);
+		else
+			glFramebufferTexture2D(GL_FRAMEBUFFER, attachmentPoint, GL_TEXTURE_2D, target.texture.id, 0);
+	}
+
+	GLuint id_ = 0;
+	ivec2 size_ = {};
+	std::vector<GLenum> drawBuffers_;
+	bool hasDepth_ = false;
+};
+
+// Un bassin de cibles de rendu. On demande une cible d'une certaine description avec acquire() et on la rend avec release() quand on n'en a plus besoin pour la trame. Une cible libre de même description est réutilisée plutôt que d'en créer une nouvelle.
+// Les cibles qui ne servent plus (par exemple l'ancienne taille après un redimensionnement de fenêtre) sont détruites par endFrame() après quelques trames. On ne garde donc jamais plus que ce que les dernières trames ont utilisé.
+class RenderTargetPool
+{
+public:
+	static constexpr int maxUnusedFrames = 3;
+
+	RenderTarget* acquire(const RenderTargetDesc& desc) {
+		for (auto&& entry : entries_) {
+			if (entry.isFree and entry.target->desc == desc) {
+				entry.isFree = false;
+				entry.isUsedThisFrame = true;
+				return entry.target.get();
+			}
+		}
+		auto& entry = entries_.emplace_back();
+		entry.target = std::make_unique<RenderTarget>(RenderTarget::create(desc));
+		entry.isFree = false;
+		entry.isUsedThisFrame = true;
+		return entry.target.get();
+	}
+
+	void release(const RenderTarget* target) {
+		for (auto&& entry : entries_) {
+			if (entry.target.get() == target)
+				entry.isFree = true;
+		}
+	}
+
+	void releaseAll() {
+		for (auto&& entry : entries_)
+			entry.isFree = true;
+	}
+
+	// Détruire les cibles inutilisées depuis maxUnusedFrames trames. onDelete est appelée juste avant la destruction de chacune (par exemple pour oublier les framebuffers qui s'en servent).
+	void endFrame(const std::function<void(const RenderTarget&)>& onDelete = {}) {
+		for (auto it = entries_.begin(); it != entries_.end();) {
+			it->unusedFrames = it->isUsedThisFrame ? 0 : it->unusedFrames + 1;
+			it->isUsedThisFrame = false;
+			if (it->unusedFrames <= maxUnusedFrames) {
+				++it;
+				continue;
+			}
+			if (onDelete)
+				onDelete(*it->target);
+			it->target->deleteObject();
+			it = entries_.erase(it);
+		}
+	}
+
+	size_t size() const { return entries_.size(); }
+
+	size_t getNumBytes() const {
+		size_t total = 0;
+		for (auto&& entry : entries_)
+			total += entry.target->desc.getNumBytes();
+		return total;
+	}
+
+	void deleteObjects() {
+		for (auto&& entry : entries_)
+			entry.target->deleteObject();
+		entries_.clear();
+	}
+
+private:
+	struct Entry
+	{
+		std::unique_ptr<RenderTarget> target;
+		bool isFree = true;
+		bool isUsedThisFrame = false;
+		int unusedFrames = 0;
+	};
+
+	std::vector<Entry> entries_;
+};
@@ -0,0 +1,330 @@
+#pragma once
+
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <format>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "utils.hpp"
+#include "GLStateCache.hpp"
+
+
+using namespace gl;
+
+
+// Un message de débogage tel que reçu par le rappel. Le texte est copié (tronqué) dans la struct pour que le rappel n'alloue rien.
+struct GLDebugMessage
+{
+	static constexpr size_t maxLength = 256;
+
+	GLenum source = GL_DONT_CARE;
+	GLenum type = GL_DONT_CARE;
+	GLenum severity = GL_DONT_CARE;
+	GLuint id = 0;
+	size_t length = 0;
+	std::array<char, maxLength> text = {};
+
+	std::string_view getText() const { return {text.data(), length}; }
+};
+
+// File bornée sans verrou à plusieurs producteurs et un seul consommateur (l'algorithme de file bornée de Dmitry Vyukov). Chaque case a un numéro de séquence qui dit si elle est libre pour le prochain producteur ou prête pour le consommateur.
+// Capacity doit être une puissance de 2.
+template <typename T, size_t Capacity>
+class BoundedMessageQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "La capacité doit être une puissance de 2");
+
+public:
+	BoundedMessageQueue() {
+		for (size_t i = 0; i < Capacity; i++)
+			slots_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	// Retourne faux si la file est pleine. Peut être appelée de n'importe quel fil.
+	bool tryPush(const T& value) {
+		Slot* slot = nullptr;
+		size_t position = enqueuePosition_.load(std::memory_order_relaxed);
+		while (true) {
+			slot = &slots_[position & (Capacity - 1)];
+			size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+			if (difference == 0) {
+				if (enqueuePosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = enqueuePosition_.load(std::memory_order_relaxed);
+			}
+		}
+		slot->value = value;
+		slot->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Seulement sur le fil consommateur.
+	bool tryPop(T& value) {
+		Slot& slot = slots_[dequeuePosition_ & (Capacity - 1)];
+		size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if ((intptr_t)sequence - (intptr_t)(dequeuePosition_ + 1) < 0)
+			return false;
+		value = slot.value;
+		slot.sequence.store(dequeuePosition_ + Capacity, std::memory_order_release);
+		dequeuePosition_++;
+		return true;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	std::array<Slot, Capacity> slots_;
+	alignas(64) std::atomic<size_t> enqueuePosition_ = 0;
+	alignas(64) size_t dequeuePosition_ = 0;
+};
+
+// Les avertissements de performance d'une trame, classés selon leur texte. Chaque pilote formule les siens à sa façon, le classement par mots-clés est donc approximatif (le reste va dans other).
+struct GLDebugPerformanceCounts
+{
+	int bufferStalls = 0; // Attente du GPU sur un tampon (glMapBuffer, glBufferSubData sur un tampon en cours d'utilisation, etc.).
+	int shaderRecompiles = 0; // Nuanceur recompilé selon l'état courant.
+	int redundantState = 0; // Changement d'état redondant.
+	int other = 0;
+
+	int getTotal() const { return bufferStalls + shaderRecompiles + redundantState + other; }
+};
+
+// Sortie de débogage d'OpenGL (KHR_debug, dans le noyau depuis OpenGL 4.3). Le pilote appelle un rappel pour chaque erreur, avertissement ou conseil de performance, avec un texte bien plus précis que les codes de glGetError et sans le point de synchronisation d'un glGetError après chaque appel.
+// Le rappel peut venir d'un fil du pilote (sauf en mode synchrone) : il ne fait que copier le message dans une file sans verrou. flush() (appelée par endFrame() à chaque trame) vide la file sur le fil principal, affiche la première occurrence de chaque message (un même ID n'est affiché qu'une fois, les suivantes sont comptées) et compte les avertissements de performance de la trame. printSummary() fait le bilan à la fermeture.
+// Les messages sont plus nombreux avec un contexte de débogage (sf::ContextSettings::Debug, que OpenGLApplication demande avec --gl-debug).
+class GLDebugOutput
+{
+public:
+	static constexpr size_t queueCapacity = 512;
+
+	// Avec breakOnError, le rappel est synchrone (appelé pendant la commande fautive, sur le fil principal) et arrête le programme dans le débogueur à la première erreur. La pile d'appels montre alors la ligne qui l'a causée.
+	bool enable(bool breakOnError = false) {
+		if (not isSupported()) {
+			std::cerr << "La sortie de débogage OpenGL demande OpenGL 4.3 ou l'extension GL_KHR_debug" << std::endl;
+			return false;
+		}
+		GLint contextFlags = 0;
+		glGetIntegerv(GL_CONTEXT_FLAGS, &contextFlags);
+		isDebugContext_ = (contextFlags & (GLint)GL_CONTEXT_FLAG_DEBUG_BIT) != 0;
+		if (not isDebugContext_)
+			std::cerr << "Le contexte OpenGL n'est pas un contexte de débogage : le pilote peut envoyer peu de messages" << std::endl;
+
+		breakOnError_ = breakOnError;
+		glState.enable(GL_DEBUG_OUTPUT);
+		glState.setEnabled(GL_DEBUG_OUTPUT_SYNCHRONOUS, breakOnError);
+		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+		// Les groupes (glPushDebugGroup, pour structurer une capture dans RenderDoc par exemple) reviennent aussi comme messages. Ce n'est pas utile ici.
+		glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+		glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+		glDebugMessageCallback(&callback, this);
+		isEnabled_ = true;
+		return true;
+	}
+
+	void disable() {
+		if (not isEnabled_)
+			return;
+		glDebugMessageCallback(nullptr, nullptr);
+		glState.disable(GL_DEBUG_OUTPUT);
+		flush();
+		isEnabled_ = false;
+	}
+
+	bool isEnabled() const { return isEnabled_; }
+	bool isDebugContext() const { return isDebugContext_; }
+
+	// Traiter les messages en attente. Seulement sur le fil principal.
+	void flush() {
+		GLDebugMessage message;
+		while (queue_.tryPop(message))
+			process(message);
+	}
+
+	// À la fin de chaque trame (OpenGLApplication le fait).
+	void endFrame() {
+		if (not isEnabled_)
+			return;
+		flush();
+		lastFrameCounts_ = currentFrameCounts_;
+		currentFrameCounts_ = {};
+		int numWarnings = lastFrameCounts_.getTotal();
+		if (numWarnings > 0)
+			numFramesWithWarnings_++;
+		maxWarningsPerFrame_ = std::max(maxWarningsPerFrame_, numWarnings);
+		frame_++;
+	}
+
+	const GLDebugPerformanceCounts& getLastFramePerformanceCounts() const { return lastFrameCounts_; }
+	const GLDebugPerformanceCounts& getTotalPerformanceCounts() const { return totalCounts_; }
+	size_t getNumMessages() const { return numMessages_; }
+	size_t getNumDropped() const { return numDropped_.load(std::memory_order_relaxed); }
+
+	void printSummary(std::ostream& out) const {
+		if (numMessages_ == 0 and getNumDropped() == 0)
+			return;
+		out << std::format("Messages de débogage OpenGL : {} reçus, {} distincts", numMessages_, entries_.size());
+		if (getNumDropped() > 0)
+			out << std::format(", {} perdus (file pleine)", getNumDropped());
+		out << "\n";
+
+		std::vector<const Entry*> sorted;
+		for (auto&& [key, entry] : entries_)
+			sorted.push_back(&entry);
+		std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->count > b->count; });
+		out << std::format("    {:>8} {:<12} {:<12} {:>8}  {}", "nombre", "type", "sévérité", "id", "message") << "\n";
+		for (auto entry : sorted) {
+			std::string_view text = entry->text;
+			text = text.substr(0, std::min(text.find('\n'), (size_t)100));
+			out << std::format("    {:>8} {:<12} {:<12} {:>8}  {}", entry->count, getTypeName(entry->type), getSeverityName(entry->severity), entry->id, text) << "\n";
+		}
+
+		if (totalCounts_.getTotal() > 0) {
+			out << std::format(
+				"Avertissements de performance : {} attentes de tampon, {} recompilations de nuanceur, {} états redondants, {} autres",
+				totalCounts_.bufferStalls, totalCounts_.shaderRecompiles, totalCounts_.redundantState, totalCounts_.other
+			) << "\n";
+			out << std::format("    dans {} trames sur {} (maximum {} par trame)", numFramesWithWarnings_, frame_, maxWarningsPerFrame_) << "\n";
+		}
+		out << std::flush;
+	}
+
+	static bool isSupported() {
+		static bool isSupported = isGLVersionAtLeast(4, 3) or isGLExtensionSupported("GL_KHR_debug");
+		return isSupported;
+	}
+
+	static const char* getTypeName(GLenum type) {
+		switch (type) {
+		case GL_DEBUG_TYPE_ERROR: return "erreur";
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "désuet";
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "indéfini";
+		case GL_DEBUG_TYPE_PORTABILITY: return "portabilité";
+		case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+		case GL_DEBUG_TYPE_MARKER: return "marqueur";
+		default: return "autre";
+		}
+	}
+
+	static const char* getSeverityName(GLenum severity) {
+		switch (severity) {
+		case GL_DEBUG_SEVERITY_HIGH: return "haute";
+		case GL_DEBUG_SEVERITY_MEDIUM: return "moyenne";
+		case GL_DEBUG_SEVERITY_LOW: return "basse";
+		default: return "info";
+		}
+	}
+
+private:
+	struct Entry
+	{
+		GLenum type = GL_DONT_CARE;
+		GLenum severity = GL_DONT_CARE;
+		GLuint id = 0;
+		std::string text; // Le texte de la première occurrence.
+		size_t count = 0;
+		int firstFrame = 0;
+	};
+
+	static void callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* text, const void* userParam) {
+		auto self = (GLDebugOutput*)userParam;
+		GLDebugMessage message;
+		message.source = source;
+		message.type = type;
+		message.severity = severity;
+		message.id = id;
+		size_t textLength = length >= 0 ? (size_t)length : std::strlen(text);
+		message.length = std::min(textLength, GLDebugMessage::maxLength);
+		std::memcpy(message.text.data(), text, message.length);
+		if (not self->queue_.tryPush(message))
+			self->numDropped_.fetch_add(1, std::memory_order_relaxed);
+
+		if (type == GL_DEBUG_TYPE_ERROR and self->breakOnError_ and not self->hasBroken_.exchange(true)) {
+			std::cerr << "Erreur OpenGL : " << message.getText() << std::endl;
+			debugBreak();
+		}
+	}
+
+	static void debugBreak() {
+		#if defined(_MSC_VER)
+			__debugbreak();
+		#elif defined(SIGTRAP)
+			std::raise(SIGTRAP);
+		#else
+			std::abort();
+		#endif
+	}
+
+	void process(const GLDebugMessage& message) {
+		numMessages_++;
+		Entry& entry = entries_[{message.source, message.type, message.id}];
+		if (entry.count++ == 0) {
+			entry.type = message.type;
+			entry.severity = message.severity;
+			entry.id = message.id;
+			entry.text = message.getText();
+			entry.firstFrame = frame_;
+			// Les notifications sont seulement comptées : certains pilotes en envoient une pour chaque tampon créé.
+			if (message.severity != GL_DEBUG_SEVERITY_NOTIFICATION) {
+				std::cerr << std::format("OpenGL {} ({}, id {}) : {}", getTypeName(message.type), getSeverityName(message.severity), message.id, message.getText()) << std::endl;
+			}
+		}
+		if (message.type == GL_DEBUG_TYPE_PERFORMANCE) {
+			getCategoryCount(currentFrameCounts_, message.getText())++;
+			getCategoryCount(totalCounts_, message.getText())++;
+		}
+	}
+
+	static int& getCategoryCount(GLDebugPerformanceCounts& counts, std::string_view text) {
+		std::string lower(text);
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		auto contains = [&](std::string_view word) { return lower.find(word) != std::string::npos; };
+		if (contains("recompil"))
+			return counts.shaderRecompiles;
+		if (contains("redundant"))
+			return counts.redundantState;
+		if (contains("stall") or contains("synchroniz") or contains("wait") or contains("block"))
+			return counts.bufferStalls;
+		return counts.other;
+	}
+
+	BoundedMessageQueue<GLDebugMessage, queueCapacity> queue_;
+	std::atomic<size_t> numDropped_ = 0;
+	std::atomic<bool> hasBroken_ = false;
+	bool breakOnError_ = false;
+	bool isEnabled_ = false;
+	bool isDebugContext_ = false;
+	std::map<std::tuple<GLenum, GLenum, GLuint>, Entry> entries_;
+	size_t numMessages_ = 0;
+	GLDebugPerformanceCounts currentFrameCounts_;
+	GLDebugPerformanceCounts lastFrameCounts_;
+	GLDebugPerformanceCounts totalCounts_;
+	int numFramesWithWarnings_ = 0;
+	int maxWarningsPerFrame_ = 0;
+	int frame_ = 0;
+};
+
+inline GLDebugOutput glDebugOutput;
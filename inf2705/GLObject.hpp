@@ -0,0 +1,277 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <deque>
+#include <source_location>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "GLResources.hpp"
+#include "GLStateCache.hpp"
+
+
+using namespace gl;
+
+
+// File de suppression différée des objets OpenGL.
+// Un objet possédé par un GLObject ou un GLOwned peut être détruit n'importe quand, par exemple au milieu d'une trame alors que des commandes déjà soumises s'en servent encore. OpenGL l'accepte (l'objet n'est vraiment libéré qu'après ces commandes), mais l'ID peut être redonné tout de suite par glGen* et certains pilotes bloquent pour attendre le GPU. On met donc plutôt l'objet dans la file : à la fin de la trame, on pose une clôture (glFenceSync) derrière ses dernières commandes, et on le supprime quelques trames plus tard, quand le GPU a passé la clôture.
+class GLDeletionQueue
+{
+public:
+	void push(GLResourceType type, GLuint id) {
+		// Après shutdown(), les objets possédés ont déjà été supprimés (et le contexte n'existe peut-être plus). Les destructeurs des membres de l'application arrivent ici après la fermeture.
+		if (id == 0 or isShutDown_)
+			return;
+		pending_.push_back({type, id});
+	}
+
+	// À la fin de chaque trame (OpenGLApplication le fait) : clôturer les objets de la trame et supprimer ceux dont la clôture est passée. On ne fait qu'interroger les clôtures (délai de 0), sans jamais attendre.
+	void endFrame() {
+		if (not pending_.empty()) {
+			Batch& batch = batches_.emplace_back();
+			batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT);
+			batch.objects.swap(pending_);
+		}
+		while (not batches_.empty()) {
+			GLenum status = glClientWaitSync(batches_.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (status != GL_ALREADY_SIGNALED and status != GL_CONDITION_SATISFIED)
+				break;
+			deleteBatch(batches_.front());
+			batches_.pop_front();
+		}
+	}
+
+	// À la fermeture, avant la destruction du contexte : attendre le GPU, vider la file et supprimer les objets encore possédés par un GLObject ou un GLOwned. Ce qui reste ensuite dans glResources n'a pas de propriétaire (une fuite).
+	void shutdown() {
+		if (isShutDown_)
+			return;
+		glFinish();
+		for (auto&& batch : batches_)
+			deleteBatch(batch);
+		batches_.clear();
+		for (auto&& object : pending_)
+			deleteObject(object.type, object.id);
+		pending_.clear();
+		for (auto&& info : glResources.getResources()) {
+			if (info.isOwned)
+				deleteObject(info.type, info.id);
+		}
+		isShutDown_ = true;
+	}
+
+	// Nombre d'objets qui attendent leur suppression.
+	size_t size() const {
+		size_t total = pending_.size();
+		for (auto&& batch : batches_)
+			total += batch.objects.size();
+		return total;
+	}
+
+	// Supprimer tout de suite, en passant par glState pour que la cache d'état et le registre restent à jour.
+	static void deleteObject(GLResourceType type, GLuint id) {
+		switch (type) {
+		case GLResourceType::Buffer: glState.deleteBuffers(1, &id); break;
+		case GLResourceType::Texture: glState.deleteTextures(1, &id); break;
+		case GLResourceType::VertexArray: glState.deleteVertexArrays(1, &id); break;
+		case GLResourceType::Framebuffer: glState.deleteFramebuffers(1, &id); break;
+		case GLResourceType::Program: glState.deleteProgram(id); break;
+		case GLResourceType::Renderbuffer:
+			glDeleteRenderbuffers(1, &id);
+			glResources.untrack(type, id);
+			break;
+		case GLResourceType::Query:
+			glDeleteQueries(1, &id);
+			glResources.untrack(type, id);
+			break;
+		}
+	}
+
+private:
+	struct PendingObject
+	{
+		GLResourceType type;
+		GLuint id;
+	};
+
+	struct Batch
+	{
+		GLsync fence = nullptr;
+		std::vector<PendingObject> objects;
+	};
+
+	static void deleteBatch(Batch& batch) {
+		for (auto&& object : batch.objects)
+			deleteObject(object.type, object.id);
+		glDeleteSync(batch.fence);
+		batch.fence = nullptr;
+	}
+
+	std::vector<PendingObject> pending_;
+	std::deque<Batch> batches_;
+	bool isShutDown_ = false;
+};
+
+inline GLDeletionQueue glDeletionQueue;
+
+
+// Poignée (handle) RAII d'un seul objet OpenGL : créé par create(), enregistré dans glResources, et envoyé à glDeletionQueue quand la poignée est détruite ou réassignée. On peut la déplacer mais pas la copier, il n'y a donc toujours qu'un seul propriétaire.
+//    GLBuffer particles = GLBuffer::create("particules");
+//    glState.bindBuffer(GL_ARRAY_BUFFER, particles.get());
+template <GLResourceType Type>
+class GLObject
+{
+public:
+	GLObject() = default;
+
+	GLObject(const GLObject&) = delete;
+	GLObject& operator=(const GLObject&) = delete;
+
+	GLObject(GLObject&& other) noexcept
+	: id_(std::exchange(other.id_, 0)) { }
+
+	GLObject& operator=(GLObject&& other) noexcept {
+		if (this != &other) {
+			reset();
+			id_ = std::exchange(other.id_, 0);
+		}
+		return *this;
+	}
+
+	~GLObject() {
+		reset();
+	}
+
+	static GLObject create(std::string_view label = {}, std::source_location where = std::source_location::current()) {
+		GLObject object;
+		object.id_ = generate();
+		glResources.track(Type, object.id_, label, where);
+		glResources.setOwned(Type, object.id_, true);
+		return object;
+	}
+
+	// Prendre possession d'un objet déjà créé (et enregistré) ailleurs.
+	static GLObject adopt(GLuint id) {
+		GLObject object;
+		object.id_ = id;
+		glResources.setOwned(Type, id, true);
+		return object;
+	}
+
+	GLuint get() const { return id_; }
+	explicit operator bool() const { return id_ != 0; }
+
+	// La taille des données, pour le rapport de glResources (après un glBufferData ou un glTexStorage2D par exemple).
+	void setSize(size_t numBytes) {
+		glResources.setSize(Type, id_, numBytes);
+	}
+
+	void reset() {
+		glDeletionQueue.push(Type, std::exchange(id_, 0));
+	}
+
+	// Abandonner la possession sans supprimer l'objet. C'est alors à l'appelant de le supprimer.
+	GLuint release() {
+		glResources.setOwned(Type, id_, false);
+		return std::exchange(id_, 0);
+	}
+
+private:
+	static GLuint generate() {
+		GLuint id = 0;
+		if constexpr (Type == GLResourceType::Buffer)
+			glGenBuffers(1, &id);
+		else if constexpr (Type == GLResourceType::Texture)
+			glGenTextures(1, &id);
+		else if constexpr (Type == GLResourceType::Renderbuffer)
+			glGenRenderbuffers(1, &id);
+		else if constexpr (Type == GLResourceType::VertexArray)
+			glGenVertexArrays(1, &id);
+		else if constexpr (Type == GLResourceType::Framebuffer)
+			glGenFramebuffers(1, &id);
+		else if constexpr (Type == GLResourceType::Program)
+			id = glCreateProgram();
+		else if constexpr (Type == GLResourceType::Query)
+			glGenQueries(1, &id);
+		return id;
+	}
+
+	GLuint id_ = 0;
+};
+
+using GLBuffer = GLObject<GLResourceType::Buffer>;
+using GLTexture = GLObject<GLResourceType::Texture>;
+using GLRenderbuffer = GLObject<GLResourceType::Renderbuffer>;
+using GLVertexArray = GLObject<GLResourceType::VertexArray>;
+using GLFramebuffer = GLObject<GLResourceType::Framebuffer>;
+using GLProgramObject = GLObject<GLResourceType::Program>;
+using GLQuery = GLObject<GLResourceType::Query>;
+
+
+// Possède une ressource du cadriciel qui a plusieurs objets OpenGL (Mesh, Texture, RenderTarget) : à la destruction ou à la réassignation, ses objets vont à glDeletionQueue. Ça remplace les listes de deleteObjects() dans onClose().
+// Mesh et Texture restent des valeurs copiables (les exemples font par exemple `mesh = Mesh::loadFromWavefrontFile(...)[0]`) : c'est le GLOwned qui est propriétaire, pas les copies. T doit avoir une méthode forEachGLObject(f) qui appelle f(type, id) pour chacun de ses objets.
+//    GLOwned<Mesh> teapot;
+//    teapot = Mesh::loadFromWavefrontFile("teapot.obj")[0];
+//    teapot->draw();
+template <typename T>
+class GLOwned
+{
+public:
+	GLOwned() = default;
+
+	GLOwned(T value)
+	: value_(std::move(value)) {
+		setOwned(true);
+	}
+
+	GLOwned(const GLOwned&) = delete;
+	GLOwned& operator=(const GLOwned&) = delete;
+
+	GLOwned(GLOwned&& other) noexcept
+	: value_(std::exchange(other.value_, T{})) { }
+
+	GLOwned& operator=(GLOwned&& other) noexcept {
+		if (this != &other) {
+			reset();
+			value_ = std::exchange(other.value_, T{});
+		}
+		return *this;
+	}
+
+	GLOwned& operator=(T value) {
+		reset();
+		value_ = std::move(value);
+		setOwned(true);
+		return *this;
+	}
+
+	~GLOwned() {
+		reset();
+	}
+
+	T& get() { return value_; }
+	const T& get() const { return value_; }
+	T* operator->() { return &value_; }
+	const T* operator->() const { return &value_; }
+	T& operator*() { return value_; }
+	const T& operator*() const { return value_; }
+	operator T&() { return value_; }
+	operator const T&() const { return value_; }
+
+	void reset() {
+		value_.forEachGLObject([](GLResourceType type, GLuint id) { glDeletionQueue.push(type, id); });
+		value_ = T{};
+	}
+
+private:
+	void setOwned(bool isOwned) {
+		value_.forEachGLObject([isOwned](GLResourceType type, GLuint id) { glResources.setOwned(type, id, isOwned); });
+	}
+
+	T value_ = {};
+};
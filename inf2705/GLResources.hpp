@@ -0,0 +1,275 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+
+
+using namespace gl;
+
+
+enum class GLResourceType
+{
+	Buffer,
+	Texture,
+	Renderbuffer,
+	VertexArray,
+	Framebuffer,
+	Program,
+	Query,
+};
+
+inline constexpr int numGLResourceTypes = 7;
+
+inline const char* getGLResourceTypeName(GLResourceType type) {
+	static const char* names[] = {"tampons", "textures", "renderbuffers", "VAO", "framebuffers", "programmes", "requêtes"};
+	return names[(int)type];
+}
+
+// Un objet OpenGL connu du registre.
+struct GLResourceInfo
+{
+	GLResourceType type = GLResourceType::Buffer;
+	GLuint id = 0;
+	std::string label;
+	size_t numBytes = 0; // Taille approximative en mémoire graphique (0 pour les objets sans données : VAO, framebuffers, programmes).
+	std::source_location where; // Le code qui a créé l'objet.
+	int creationFrame = 0;
+	bool isOwned = false; // Possédé par un GLObject (voir GLObject.hpp), qui le supprimera lui-même.
+};
+
+struct GLResourceCategoryStats
+{
+	int count = 0;
+	size_t numBytes = 0;
+};
+
+// Taille approximative d'une texture selon son format interne, en comptant tous ses niveaux de mipmap et ses échantillons.
+inline size_t estimateTextureBytes(GLenum internalFormat, glm::ivec2 size, int numLevels = 1, int samples = 1) {
+	size_t bytesPerPixel = 4;
+	switch (internalFormat) {
+	case GL_R8: bytesPerPixel = 1; break;
+	case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: bytesPerPixel = 2; break;
+	case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: bytesPerPixel = 8; break;
+	case GL_RGBA32F: bytesPerPixel = 16; break;
+	default: break; // GL_RGBA, GL_RGBA8, GL_RGB8 (généralement rembourré à 4 octets), GL_R32F, GL_DEPTH24_STENCIL8, etc.
+	}
+	size_t total = 0;
+	glm::ivec2 levelSize = size;
+	for (int level = 0; level < std::max(numLevels, 1); level++) {
+		total += bytesPerPixel * levelSize.x * levelSize.y;
+		levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+	}
+	return total * std::max(samples, 1);
+}
+
+// Registre central des objets OpenGL : pour chaque objet encore vivant, son type, sa taille, son nom et l'endroit dans le code où il a été créé.
+// Les classes du cadriciel (Mesh, Texture, ShaderProgram, RenderTarget, etc.) y enregistrent leurs objets à la création. Les suppressions passent toutes par glState (deleteBuffers, deleteTextures, etc.), qui les retire du registre. On peut donc, à tout moment, compter les objets et les octets par catégorie (voir --gl-resources), et à la fermeture lister les objets qu'onClose a oublié de supprimer.
+// Le nom est aussi donné au pilote avec glObjectLabel (OpenGL 4.3 ou KHR_debug) : il apparaît dans les messages de débogage et dans les outils comme RenderDoc.
+// Tout se passe sur le fil du contexte OpenGL, il n'y a donc pas de mutex.
+class GLResourceRegistry
+{
+public:
+	// Enregistrer un objet qui vient d'être créé.
+	void track(GLResourceType type, GLuint id, std::string_view label, std::source_location where = std::source_location::current()) {
+		if (id == 0)
+			return;
+		GLResourceInfo& info = resources_[makeKey(type, id)];
+		info = {type, id, std::string(label), 0, where, frame_, false};
+		applyLabel(info);
+	}
+
+	void setSize(GLResourceType type, GLuint id, size_t numBytes) {
+		if (auto it = resources_.find(makeKey(type, id)); it != resources_.end())
+			it->second.numBytes = numBytes;
+	}
+
+	void setOwned(GLResourceType type, GLuint id, bool isOwned) {
+		if (auto it = resources_.find(makeKey(type, id)); it != resources_.end())
+			it->second.isOwned = isOwned;
+	}
+
+	// Oublier des objets supprimés. Appelée par glState. Les ID inconnus (objets créés sans track) sont ignorés.
+	void untrack(GLResourceType type, GLsizei n, const GLuint* ids) {
+		for (GLsizei i = 0; i < n; i++)
+			resources_.erase(makeKey(type, ids[i]));
+	}
+
+	void untrack(GLResourceType type, GLuint id) {
+		untrack(type, 1, &id);
+	}
+
+	const GLResourceInfo* find(GLResourceType type, GLuint id) const {
+		auto it = resources_.find(makeKey(type, id));
+		return it != resources_.end() ? &it->second : nullptr;
+	}
+
+	// Les objets vivants, du plus gros au plus petit.
+	std::vector<GLResourceInfo> getResources() const {
+		std::vector<GLResourceInfo> result;
+		result.reserve(resources_.size());
+		for (auto&& [key, info] : resources_)
+			result.push_back(info);
+		std::sort(result.begin(), result.end(), [](auto&& a, auto&& b) { return a.numBytes != b.numBytes ? a.numBytes > b.numBytes : a.id < b.id; });
+		return result;
+	}
+
+	std::array<GLResourceCategoryStats, numGLResourceTypes> getStats() const {
+		std::array<GLResourceCategoryStats, numGLResourceTypes> stats = {};
+		for (auto&& [key, info] : resources_) {
+			stats[(int)info.type].count++;
+			stats[(int)info.type].numBytes += info.numBytes;
+		}
+		return stats;
+	}
+
+	size_t getTotalBytes() const {
+		size_t total = 0;
+		for (auto&& [key, info] : resources_)
+			total += info.numBytes;
+		return total;
+	}
+
+	// À la fin de chaque trame (OpenGLApplication le fait).
+	void endFrame() {
+		frame_++;
+		// Un tampon ou un VAO qui vient de glGen* n'existe vraiment qu'à sa première liaison : glObjectLabel échoue avant. On réessaie donc les noms en attente aux trames suivantes, mais seulement quelques fois : un objet jamais lié (oublié, ou lié beaucoup plus tard) n'a pas à coûter des glIs* à chaque trame pour toujours.
+		if (pendingLabels_.empty())
+			return;
+		std::vector<PendingLabel> pending;
+		pending.swap(pendingLabels_);
+		for (auto&& [key, numAttempts] : pending) {
+			if (auto it = resources_.find(key); it != resources_.end())
+				applyLabel(it->second, numAttempts + 1);
+		}
+	}
+
+	// Nombre d'objets et octets par catégorie, avec l'écart depuis le rapport précédent pour voir une croissance (fuite) au fil d'une longue exécution.
+	void printReport(std::ostream& out) {
+		auto stats = getStats();
+		out << std::format("{:<24} {:>8} {:>12} {:>12}", std::format("Ressources GL (trame {})", frame_), "nombre", "Kio", "écart (Kio)") << "\n";
+		size_t totalBytes = 0;
+		int totalCount = 0;
+		for (int i = 0; i < numGLResourceTypes; i++) {
+			if (stats[i].count == 0 and lastReportStats_[i].count == 0)
+				continue;
+			double deltaKib = ((double)stats[i].numBytes - (double)lastReportStats_[i].numBytes) / 1024.0;
+			out << std::format("{:<24} {:>8} {:>12.1f} {:>+12.1f}", getGLResourceTypeName((GLResourceType)i), stats[i].count, stats[i].numBytes / 1024.0, deltaKib) << "\n";
+			totalBytes += stats[i].numBytes;
+			totalCount += stats[i].count;
+		}
+		double totalDeltaKib = ((double)totalBytes - (double)lastReportTotalBytes_) / 1024.0;
+		out << std::format("{:<24} {:>8} {:>12.1f} {:>+12.1f}", "total", totalCount, totalBytes / 1024.0, totalDeltaKib) << std::endl;
+		lastReportStats_ = stats;
+		lastReportTotalBytes_ = totalBytes;
+	}
+
+	// Lister les objets encore vivants qui ne sont pas possédés par un GLObject : OpenGLApplication l'appelle après onClose(), ce sont donc des objets qu'on a oublié de supprimer. Retourne leur nombre.
+	int printLeaks(std::ostream& out, int maxLines = 20) const {
+		std::vector<GLResourceInfo> leaks;
+		for (auto&& info : getResources()) {
+			if (not info.isOwned)
+				leaks.push_back(info);
+		}
+		if (leaks.empty())
+			return 0;
+		size_t numBytes = 0;
+		for (auto&& info : leaks)
+			numBytes += info.numBytes;
+		out << std::format("{} objet(s) OpenGL pas supprimé(s) à la fermeture ({:.1f} Kio) :", leaks.size(), numBytes / 1024.0) << "\n";
+		for (int i = 0; i < (int)leaks.size() and i < maxLines; i++) {
+			const GLResourceInfo& info = leaks[i];
+			std::string file = std::filesystem::path(info.where.file_name()).filename().string();
+			out << std::format("    {} {} '{}', {:.1f} Kio, créé à la trame {} ({}:{})", getGLResourceTypeName(info.type), info.id, info.label, info.numBytes / 1024.0, info.creationFrame, file, info.where.line()) << "\n";
+		}
+		if ((int)leaks.size() > maxLines)
+			out << std::format("    ... et {} autre(s)", leaks.size() - maxLines) << "\n";
+		out << std::flush;
+		return (int)leaks.size();
+	}
+
+	void clear() {
+		resources_.clear();
+		pendingLabels_.clear();
+	}
+
+	static bool isObjectLabelSupported() {
+		static bool isSupported = isGLVersionAtLeast(4, 3) or isGLExtensionSupported("GL_KHR_debug");
+		return isSupported;
+	}
+
+private:
+	static uint64_t makeKey(GLResourceType type, GLuint id) {
+		return ((uint64_t)type << 32) | id;
+	}
+
+	static GLenum getLabelIdentifier(GLResourceType type) {
+		switch (type) {
+		case GLResourceType::Buffer: return GL_BUFFER;
+		case GLResourceType::Texture: return GL_TEXTURE;
+		case GLResourceType::Renderbuffer: return GL_RENDERBUFFER;
+		case GLResourceType::VertexArray: return GL_VERTEX_ARRAY;
+		case GLResourceType::Framebuffer: return GL_FRAMEBUFFER;
+		case GLResourceType::Program: return GL_PROGRAM;
+		case GLResourceType::Query: return GL_QUERY;
+		}
+		return GL_NONE;
+	}
+
+	static bool exists(GLResourceType type, GLuint id) {
+		switch (type) {
+		case GLResourceType::Buffer: return glIsBuffer(id) == GL_TRUE;
+		case GLResourceType::Texture: return glIsTexture(id) == GL_TRUE;
+		case GLResourceType::Renderbuffer: return glIsRenderbuffer(id) == GL_TRUE;
+		case GLResourceType::VertexArray: return glIsVertexArray(id) == GL_TRUE;
+		case GLResourceType::Framebuffer: return glIsFramebuffer(id) == GL_TRUE;
+		case GLResourceType::Program: return glIsProgram(id) == GL_TRUE;
+		case GLResourceType::Query: return glIsQuery(id) == GL_TRUE;
+		}
+		return false;
+	}
+
+	void applyLabel(const GLResourceInfo& info, int numAttempts = 1) {
+		if (info.label.empty() or not isObjectLabelSupported())
+			return;
+		if (not exists(info.type, info.id)) {
+			if (numAttempts < maxLabelAttempts)
+				pendingLabels_.push_back({makeKey(info.type, info.id), numAttempts});
+			return;
+		}
+		glObjectLabel(getLabelIdentifier(info.type), info.id, (GLsizei)info.label.size(), info.label.data());
+	}
+
+	struct PendingLabel
+	{
+		uint64_t key = 0;
+		int numAttempts = 0;
+	};
+
+	// Nombre d'essais de glObjectLabel (à la création, puis à la fin des trames suivantes) avant d'abandonner le nom d'un objet jamais lié.
+	static constexpr int maxLabelAttempts = 4;
+
+	std::unordered_map<uint64_t, GLResourceInfo> resources_;
+	std::vector<PendingLabel> pendingLabels_;
+	int frame_ = 0;
+	std::array<GLResourceCategoryStats, numGLResourceTypes> lastReportStats_ = {};
+	size_t lastReportTotalBytes_ = 0;
+};
+
+inline GLResourceRegistry glResources;
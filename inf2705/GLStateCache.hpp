@@ -0,0 +1,468 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+#include <glbinding/gl/gl.h>
+
+#include "GLResources.hpp"
+
+
+using namespace gl;
+
+
+// Définir INF2705_DISABLE_GL_STATE_CACHE (avant d'inclure les entêtes ou dans les options du compilateur) pour que chaque méthode de GLStateCache fasse directement l'appel OpenGL. Le compilateur élimine alors tout le suivi d'état.
+#ifdef INF2705_DISABLE_GL_STATE_CACHE
+constexpr bool isGLStateCacheEnabled = false;
+#else
+constexpr bool isGLStateCacheEnabled = true;
+#endif
+
+
+// Nombre d'appels de changement d'état passés au pilote ou évités pendant une trame.
+struct GLStateCacheStats
+{
+	int issuedCalls = 0;
+	int filteredCalls = 0;
+};
+
+// Une couche mince de suivi de l'état d'OpenGL. OpenGL est une grosse machine à états : chaque glBind*, glEnable, glBlendFunc, etc. change une variable globale du contexte. Le pilote doit valider chacun de ces appels, même quand on remet la valeur qui y est déjà (ce qu'on fait souvent, par exemple en liant le même programme avant chaque objet).
+// Ici, on se rappelle de la dernière valeur de chaque état et on n'appelle OpenGL que si elle change. Pour que ça fonctionne, il faut que TOUS les changements d'état passent par glState. Si du code externe touche à l'état directement, il faut appeler invalidate() après.
+// Un état « inconnu » (std::nullopt ou absent des tables) fait toujours un vrai appel.
+class GLStateCache
+{
+public:
+	// Oublier tout l'état connu. Le prochain appel de chaque état sera passé à OpenGL.
+	void invalidate() {
+		program_.reset();
+		vao_.reset();
+		buffers_.clear();
+		elementBuffers_.clear();
+		indexedBuffers_.clear();
+		activeTexture_.reset();
+		textures_.clear();
+		drawFramebuffer_.reset();
+		readFramebuffer_.reset();
+		caps_.clear();
+		blendFunc_.reset();
+		blendEquation_.reset();
+		depthFunc_.reset();
+		depthMask_.reset();
+		stencilFunc_.reset();
+		stencilOp_.reset();
+		stencilMask_.reset();
+		polygonMode_.reset();
+		cullFace_.reset();
+		frontFace_.reset();
+		colorMask_.reset();
+		viewport_.reset();
+		clearColor_.reset();
+		clearDepth_.reset();
+		clearStencil_.reset();
+	}
+
+	// À appeler à la fin de chaque trame (fait par OpenGLApplication::run).
+	void endFrame() {
+		lastFrameStats_ = currentStats_;
+		currentStats_ = {};
+	}
+
+	const GLStateCacheStats& getLastFrameStats() const { return lastFrameStats_; }
+	const GLStateCacheStats& getCurrentFrameStats() const { return currentStats_; }
+
+	void useProgram(GLuint program) {
+		if (update(program_, program))
+			glUseProgram(program);
+	}
+
+	void bindVertexArray(GLuint vao) {
+		if (update(vao_, vao))
+			glBindVertexArray(vao);
+	}
+
+	void bindBuffer(GLenum target, GLuint buffer) {
+		if constexpr (not isGLStateCacheEnabled) {
+			glBindBuffer(target, buffer);
+			return;
+		}
+		// Le tampon d'indices fait partie de l'état du VAO, pas du contexte. On s'en rappelle donc pour chaque VAO.
+		if (target == GL_ELEMENT_ARRAY_BUFFER) {
+			if (not vao_.has_value()) {
+				issueUntracked();
+				glBindBuffer(target, buffer);
+			} else if (update(elementBuffers_[*vao_], buffer)) {
+				glBindBuffer(target, buffer);
+			}
+			return;
+		}
+		if (update(buffers_[target], buffer))
+			glBindBuffer(target, buffer);
+	}
+
+	// glBindBufferBase et glBindBufferRange lient aussi le tampon à la cible générique.
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+		if constexpr (not isGLStateCacheEnabled) {
+			glBindBufferBase(target, index, buffer);
+			return;
+		}
+		// Les liaisons indexées de rétroaction font partie de l'objet de rétroaction (glBindTransformFeedback) qu'on ne suit pas.
+		if (target == GL_TRANSFORM_FEEDBACK_BUFFER) {
+			issueUntracked();
+			glBindBufferBase(target, index, buffer);
+			return;
+		}
+		if (update(indexedBuffers_[{target, index}], {buffer, 0, 0}))
+			glBindBufferBase(target, index, buffer);
+		buffers_[target] = buffer;
+	}
+
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+		if constexpr (not isGLStateCacheEnabled) {
+			glBindBufferRange(target, index, buffer, offset, size);
+			return;
+		}
+		// Les liaisons indexées de rétroaction font partie de l'objet de rétroaction (glBindTransformFeedback) qu'on ne suit pas.
+		if (target == GL_TRANSFORM_FEEDBACK_BUFFER) {
+			issueUntracked();
+			glBindBufferRange(target, index, buffer, offset, size);
+			return;
+		}
+		if (update(indexedBuffers_[{target, index}], {buffer, offset, size}))
+			glBindBufferRange(target, index, buffer, offset, size);
+		buffers_[target] = buffer;
+	}
+
+	// `unit` est GL_TEXTURE0 + i, comme avec glActiveTexture.
+	void activeTexture(GLenum unit) {
+		if (update(activeTexture_, unit))
+			glActiveTexture(unit);
+	}
+
+	// Lier une texture à l'unité active.
+	void bindTexture(GLenum target, GLuint texture) {
+		if (not activeTexture_.has_value()) {
+			issueUntracked();
+			glBindTexture(target, texture);
+			return;
+		}
+		if (update(textures_[*activeTexture_][target], texture))
+			glBindTexture(target, texture);
+	}
+
+	// Raccourci pour glActiveTexture + glBindTexture. `unit` est l'index (0, 1, 2...) et pas le GL_TEXTURE*.
+	void bindTextureToUnit(int unit, GLenum target, GLuint texture) {
+		GLenum unitEnum = GL_TEXTURE0 + unit;
+		// Si la texture est déjà liée à cette unité, même pas besoin de changer l'unité active.
+		if constexpr (isGLStateCacheEnabled) {
+			auto unitIt = textures_.find(unitEnum);
+			if (unitIt != textures_.end()) {
+				auto it = unitIt->second.find(target);
+				if (it != unitIt->second.end() and it->second == texture) {
+					currentStats_.filteredCalls += 2;
+					return;
+				}
+			}
+		}
+		activeTexture(unitEnum);
+		bindTexture(target, texture);
+	}
+
+	void bindFramebuffer(GLenum target, GLuint framebuffer) {
+		if (framebuffer == 0)
+			framebuffer = defaultFramebuffer_;
+		if constexpr (not isGLStateCacheEnabled) {
+			glBindFramebuffer(target, framebuffer);
+			return;
+		}
+		bool changed = false;
+		if (target == GL_FRAMEBUFFER) {
+			// GL_FRAMEBUFFER change les deux liaisons, il faut donc éviter l'appel seulement si les deux sont déjà bonnes.
+			changed = readFramebuffer_ != framebuffer;
+			changed = update(drawFramebuffer_, framebuffer) or changed;
+			readFramebuffer_ = framebuffer;
+		} else if (target == GL_DRAW_FRAMEBUFFER) {
+			changed = update(drawFramebuffer_, framebuffer);
+		} else {
+			changed = update(readFramebuffer_, framebuffer);
+		}
+		if (changed)
+			glBindFramebuffer(target, framebuffer);
+	}
+
+	// Le framebuffer qui remplace celui de la fenêtre quand on lie 0. En mode sans fenêtre, OpenGLApplication y met son FBO : le code qui lie 0 pour revenir à l'écran (FrameGraph, Framebuffer::blit, etc.) dessine alors dedans sans rien changer.
+	void setDefaultFramebuffer(GLuint framebuffer) {
+		defaultFramebuffer_ = framebuffer;
+		drawFramebuffer_.reset();
+		readFramebuffer_.reset();
+	}
+
+	GLuint getDefaultFramebuffer() const { return defaultFramebuffer_; }
+
+	void enable(GLenum cap) {
+		if constexpr (not isGLStateCacheEnabled) {
+			glEnable(cap);
+			return;
+		}
+		if (update(caps_[cap], true))
+			glEnable(cap);
+	}
+
+	void disable(GLenum cap) {
+		if constexpr (not isGLStateCacheEnabled) {
+			glDisable(cap);
+			return;
+		}
+		if (update(caps_[cap], false))
+			glDisable(cap);
+	}
+
+	void setEnabled(GLenum cap, bool enabled) {
+		if (enabled)
+			enable(cap);
+		else
+			disable(cap);
+	}
+
+	void blendFunc(GLenum sfactor, GLenum dfactor) {
+		if (update(blendFunc_, {sfactor, dfactor}))
+			glBlendFunc(sfactor, dfactor);
+	}
+
+	void blendEquation(GLenum mode) {
+		if (update(blendEquation_, mode))
+			glBlendEquation(mode);
+	}
+
+	void depthFunc(GLenum func) {
+		if (update(depthFunc_, func))
+			glDepthFunc(func);
+	}
+
+	void depthMask(GLboolean flag) {
+		if (update(depthMask_, flag))
+			glDepthMask(flag);
+	}
+
+	void stencilFunc(GLenum func, GLint ref, GLuint mask) {
+		if (update(stencilFunc_, {func, ref, mask}))
+			glStencilFunc(func, ref, mask);
+	}
+
+	void stencilOp(GLenum sfail, GLenum dpfail, GLenum dppass) {
+		if (update(stencilOp_, {sfail, dpfail, dppass}))
+			glStencilOp(sfail, dpfail, dppass);
+	}
+
+	void stencilMask(GLuint mask) {
+		if (update(stencilMask_, mask))
+			glStencilMask(mask);
+	}
+
+	// En profil core, seul GL_FRONT_AND_BACK est accepté pour `face`.
+	void polygonMode(GLenum face, GLenum mode) {
+		if (update(polygonMode_, {face, mode}))
+			glPolygonMode(face, mode);
+	}
+
+	void cullFace(GLenum mode) {
+		if (update(cullFace_, mode))
+			glCullFace(mode);
+	}
+
+	void frontFace(GLenum mode) {
+		if (update(frontFace_, mode))
+			glFrontFace(mode);
+	}
+
+	void colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) {
+		if (update(colorMask_, {red, green, blue, alpha}))
+			glColorMask(red, green, blue, alpha);
+	}
+
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+		if (update(viewport_, {x, y, width, height}))
+			glViewport(x, y, width, height);
+	}
+
+	// Le viewport courant, sans glGetIntegerv (qui force souvent une synchronisation avec le pilote) sauf la première fois s'il est inconnu.
+	std::array<GLint, 4> getViewport() {
+		if (not isGLStateCacheEnabled or not viewport_.has_value()) {
+			std::array<GLint, 4> values = {};
+			glGetIntegerv(GL_VIEWPORT, values.data());
+			if constexpr (isGLStateCacheEnabled)
+				viewport_ = values;
+			return values;
+		}
+		return *viewport_;
+	}
+
+	// Les valeurs de glClear font aussi partie de l'état.
+	void clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) {
+		if (update(clearColor_, {red, green, blue, alpha}))
+			glClearColor(red, green, blue, alpha);
+	}
+
+	void clearDepth(GLdouble depth) {
+		if (update(clearDepth_, depth))
+			glClearDepth(depth);
+	}
+
+	void clearStencil(GLint s) {
+		if (update(clearStencil_, s))
+			glClearStencil(s);
+	}
+
+	// La couleur de fond courante, sans glGetFloatv sauf la première fois si elle est inconnue.
+	std::array<GLfloat, 4> getClearColor() {
+		if (not isGLStateCacheEnabled or not clearColor_.has_value()) {
+			std::array<GLfloat, 4> values = {};
+			glGetFloatv(GL_COLOR_CLEAR_VALUE, values.data());
+			if constexpr (isGLStateCacheEnabled)
+				clearColor_ = values;
+			return values;
+		}
+		return *clearColor_;
+	}
+
+	// Les glDelete* passent aussi par ici : OpenGL délie un objet supprimé et peut réutiliser son ID pour le prochain glGen*. Sans ça, on croirait qu'un nouvel objet avec le même ID est déjà lié.
+	// C'est aussi ici que les objets sont retirés du registre glResources.
+	void deleteBuffers(GLsizei n, const GLuint* buffers) {
+		glDeleteBuffers(n, buffers);
+		glResources.untrack(GLResourceType::Buffer, n, buffers);
+		if constexpr (isGLStateCacheEnabled) {
+			for (int i = 0; i < n; i++) {
+				for (auto&& [target, bound] : buffers_)
+					forgetIfEqual(bound, buffers[i]);
+				for (auto&& [key, binding] : indexedBuffers_) {
+					if (binding.has_value() and std::get<0>(*binding) == buffers[i])
+						binding.reset();
+				}
+				// Un tampon d'indices est délié seulement du VAO courant. Pour les autres, on ne sait plus.
+				for (auto it = elementBuffers_.begin(); it != elementBuffers_.end();) {
+					if (it->second == buffers[i])
+						it = elementBuffers_.erase(it);
+					else
+						++it;
+				}
+			}
+		}
+	}
+
+	void deleteVertexArrays(GLsizei n, const GLuint* arrays) {
+		glDeleteVertexArrays(n, arrays);
+		glResources.untrack(GLResourceType::VertexArray, n, arrays);
+		if constexpr (isGLStateCacheEnabled) {
+			for (int i = 0; i < n; i++) {
+				if (vao_ == arrays[i])
+					vao_ = 0;
+				elementBuffers_.erase(arrays[i]);
+			}
+		}
+	}
+
+	void deleteTextures(GLsizei n, const GLuint* textures) {
+		glDeleteTextures(n, textures);
+		glResources.untrack(GLResourceType::Texture, n, textures);
+		if constexpr (isGLStateCacheEnabled) {
+			for (int i = 0; i < n; i++) {
+				for (auto&& [unit, targets] : textures_) {
+					for (auto&& [target, bound] : targets) {
+						if (bound == textures[i])
+							bound = 0;
+					}
+				}
+			}
+		}
+	}
+
+	void deleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+		glDeleteFramebuffers(n, framebuffers);
+		glResources.untrack(GLResourceType::Framebuffer, n, framebuffers);
+		if constexpr (isGLStateCacheEnabled) {
+			for (int i = 0; i < n; i++) {
+				if (drawFramebuffer_ == framebuffers[i])
+					drawFramebuffer_ = 0;
+				if (readFramebuffer_ == framebuffers[i])
+					readFramebuffer_ = 0;
+			}
+		}
+	}
+
+	void deleteProgram(GLuint program) {
+		glDeleteProgram(program);
+		glResources.untrack(GLResourceType::Program, program);
+		// Un programme en cours d'utilisation est seulement marqué pour suppression, on ne sait donc plus vraiment ce qui est lié.
+		if (isGLStateCacheEnabled and program_ == program)
+			program_.reset();
+	}
+
+private:
+	using IndexedBinding = std::tuple<GLuint, GLintptr, GLsizeiptr>;
+
+	// Retourne vrai s'il faut faire l'appel OpenGL.
+	template <typename T>
+	bool update(std::optional<T>& cached, const T& value) {
+		if constexpr (not isGLStateCacheEnabled) {
+			return true;
+		} else {
+			if (cached.has_value() and *cached == value) {
+				currentStats_.filteredCalls++;
+				return false;
+			}
+			cached = value;
+			currentStats_.issuedCalls++;
+			return true;
+		}
+	}
+
+	void issueUntracked() {
+		if constexpr (isGLStateCacheEnabled)
+			currentStats_.issuedCalls++;
+	}
+
+	static void forgetIfEqual(std::optional<GLuint>& bound, GLuint id) {
+		if (bound == id)
+			bound = 0;
+	}
+
+	std::optional<GLuint> program_;
+	std::optional<GLuint> vao_;
+	std::unordered_map<GLenum, std::optional<GLuint>> buffers_;
+	std::unordered_map<GLuint, std::optional<GLuint>> elementBuffers_; // Par VAO.
+	std::map<std::pair<GLenum, GLuint>, std::optional<IndexedBinding>> indexedBuffers_;
+	std::optional<GLenum> activeTexture_;
+	std::unordered_map<GLenum, std::unordered_map<GLenum, std::optional<GLuint>>> textures_; // Par unité, puis par cible.
+	std::optional<GLuint> drawFramebuffer_;
+	std::optional<GLuint> readFramebuffer_;
+	GLuint defaultFramebuffer_ = 0;
+	std::unordered_map<GLenum, std::optional<bool>> caps_;
+	std::optional<std::pair<GLenum, GLenum>> blendFunc_;
+	std::optional<GLenum> blendEquation_;
+	std::optional<GLenum> depthFunc_;
+	std::optional<GLboolean> depthMask_;
+	std::optional<std::tuple<GLenum, GLint, GLuint>> stencilFunc_;
+	std::optional<std::tuple<GLenum, GLenum, GLenum>> stencilOp_;
+	std::optional<GLuint> stencilMask_;
+	std::optional<std::pair<GLenum, GLenum>> polygonMode_;
+	std::optional<GLenum> cullFace_;
+	std::optional<GLenum> frontFace_;
+	std::optional<std::array<GLboolean, 4>> colorMask_;
+	std::optional<std::array<GLint, 4>> viewport_;
+	std::optional<std::array<GLfloat, 4>> clearColor_;
+	std::optional<GLdouble> clearDepth_;
+	std::optional<GLint> clearStencil_;
+
+	GLStateCacheStats currentStats_;
+	GLStateCacheStats lastFrameStats_;
+};
+
+// L'état du contexte OpenGL de l'application (il n'y en a qu'un).
+inline GLStateCache glState;
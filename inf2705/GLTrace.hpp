@@ -0,0 +1,1121 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <glbinding/AbstractFunction.h>
+#include <glbinding/Binding.h>
+#include <glbinding/CallbackMask.h>
+#include <glbinding/FunctionCall.h>
+#include <glbinding/gl/gl.h>
+
+
+using namespace gl;
+
+
+// Trace des appels OpenGL : on enregistre chaque appel (avec ses arguments et les données qu'il envoie au GPU) dans un fichier binaire compact, puis on peut le rejouer sans l'application, par exemple pour comparer deux versions d'un pilote ou du code avec exactement la même charge de travail.
+// L'enregistrement passe par les fonctions de rappel de glbinding : chaque fonction d'OpenGL peut appeler un rappel après son exécution avec ses paramètres et sa valeur de retour. Ça ne coûte rien quand la trace est arrêtée.
+//
+// Format du fichier (petit-boutiste) :
+//   En-tête : "INF2705T", version (u32), largeur et hauteur du framebuffer par défaut (u32), version d'OpenGL (u16, u16),
+//             profil (GL_CONTEXT_PROFILE_MASK, u32) et drapeaux du contexte (GL_CONTEXT_FLAGS, u32).
+//   Enregistrements, qui commencent par un type (u8) :
+//     Fonction : identifiant (u16), rejouable (u8), longueur du nom (u16), nom. Écrit la première fois qu'une fonction est appelée.
+//     Appel    : identifiant (u16), nombre d'arguments (u8), arguments (u64 chacun), a une valeur de retour (u8) [valeur (u64)],
+//                nombre de données (u8), puis pour chacune : argument (u8), taille (u32), octets.
+//     Fin de trame.
+
+
+// Les arguments sont gardés tels quels dans 64 bits (entiers, énumérations, float, pointeurs), sans conversion. Le format suppose donc un processeur petit-boutiste, comme x86 et ARM.
+template <typename T>
+uint64_t toTraceBits(const T& value) {
+	static_assert(std::is_trivially_copyable_v<T> and sizeof(T) <= sizeof(uint64_t));
+	uint64_t bits = 0;
+	std::memcpy(&bits, &value, sizeof(T));
+	return bits;
+}
+
+template <typename T>
+T fromTraceBits(uint64_t bits) {
+	T value;
+	std::memcpy(&value, &bits, sizeof(T));
+	return value;
+}
+
+// Les sortes de noms d'objets OpenGL. En rejouant, les noms créés ne sont pas forcément les mêmes qu'à l'enregistrement : on traduit donc chaque nom enregistré vers celui qui a été créé à la place.
+enum class GLTraceObjectKind : uint8_t
+{
+	Buffer,
+	Texture,
+	VertexArray,
+	Framebuffer,
+	Renderbuffer,
+	Query,
+	TransformFeedback,
+	Shader,
+	Program,
+	UniformLocation,
+	Count,
+};
+
+// Comment trouver les données qu'un argument pointeur envoie à OpenGL.
+enum class GLTracePayloadKind : uint8_t
+{
+	None,
+	Bytes, // Taille en octets donnée par un autre argument (glBufferData).
+	Elements, // Nombre d'éléments donné par un autre argument (glUniform4fv, glDrawBuffers).
+	Image, // Pixels d'une image (glTexImage2D). Rien si un GL_PIXEL_UNPACK_BUFFER est lié : le pointeur est alors un décalage.
+	CString, // Chaîne terminée par un zéro (glGetUniformLocation).
+	StringArray, // Tableau de chaînes (glShaderSource).
+	ClearValue, // Valeur d'effacement de glClearBuffer*, 4 composantes pour GL_COLOR et une sinon.
+	PixelsOut, // Destination de glReadPixels : rien à enregistrer, on lit dans un tampon temporaire en rejouant.
+	Offset, // Décalage dans un tampon lié (glVertexAttribPointer, glDrawElements) : la valeur est rejouée telle quelle.
+};
+
+// Ce qu'il faut suivre en plus des arguments pour certaines fonctions.
+enum class GLTraceSpecial : uint8_t
+{
+	None,
+	UseProgram,
+	BindBuffer,
+	BindBufferIndexed,
+	MapBufferRange,
+	MapBuffer,
+	UnmapBuffer,
+	PixelStore,
+	GenNames,
+	DeleteNames,
+	DeleteSync,
+};
+
+// Un argument « spécial » dans les données d'un appel : le contenu d'un tampon mappé, écrit par le CPU directement en mémoire (donc sans appel OpenGL). Les 8 premiers octets sont le décalage dans le tampon.
+constexpr uint8_t glTraceMappedDataArg = 0xFE;
+
+struct GLTracePayload
+{
+	uint8_t argIndex = 0;
+	std::vector<std::byte> data;
+};
+
+struct GLTraceCall
+{
+	uint16_t functionId = 0;
+	std::vector<uint64_t> args;
+	bool hasReturnValue = false;
+	uint64_t returnValue = 0;
+	std::vector<GLTracePayload> payloads;
+
+	const GLTracePayload* findPayload(int argIndex) const {
+		for (auto&& payload : payloads) {
+			if (payload.argIndex == argIndex)
+				return &payload;
+		}
+		return nullptr;
+	}
+};
+
+// Ce qu'on sait d'une fonction rejouable : sa signature (pour convertir les arguments) et comment traiter ses noms d'objets et ses pointeurs.
+struct GLTraceFunctionInfo
+{
+	struct NameArg
+	{
+		int argIndex = 0; // -1 pour la valeur de retour.
+		GLTraceObjectKind kind = GLTraceObjectKind::Buffer;
+	};
+
+	struct PayloadRule
+	{
+		int argIndex = -1;
+		GLTracePayloadKind kind = GLTracePayloadKind::None;
+		int countArg = -1; // Taille, nombre d'éléments ou de chaînes, ou type d'effacement.
+		int elementSize = 0;
+		std::array<int, 5> imageArgs = {-1, -1, -1, -1, -1}; // Largeur, hauteur, profondeur, format et type.
+		int lengthArg = -1; // Longueurs des chaînes (glShaderSource), remplacées par nullptr en rejouant.
+	};
+
+	std::string name;
+	int numArgs = 0;
+	std::vector<bool> isPointerArg;
+	std::vector<bool> isSyncArg;
+	bool returnsSync = false;
+	std::vector<NameArg> names;
+	std::vector<PayloadRule> payloads;
+	GLTraceSpecial special = GLTraceSpecial::None;
+	GLTraceObjectKind arrayKind = GLTraceObjectKind::Buffer; // Pour GenNames et DeleteNames.
+	// Lire les arguments et la valeur de retour d'un appel intercepté par glbinding.
+	std::function<void(const glbinding::FunctionCall&, GLTraceCall&)> encode;
+	// Appeler la fonction avec des arguments déjà traduits. Retourne la valeur de retour (0 pour void).
+	std::function<uint64_t(const std::vector<uint64_t>&)> invoke;
+
+	GLTraceFunctionInfo& objectName(int argIndex, GLTraceObjectKind kind) {
+		names.push_back({argIndex, kind});
+		return *this;
+	}
+
+	GLTraceFunctionInfo& returnName(GLTraceObjectKind kind) {
+		return objectName(-1, kind);
+	}
+
+	GLTraceFunctionInfo& bytes(int argIndex, int sizeArg) {
+		return payload({argIndex, GLTracePayloadKind::Bytes, sizeArg});
+	}
+
+	GLTraceFunctionInfo& elements(int argIndex, int countArg, int elementSize) {
+		return payload({argIndex, GLTracePayloadKind::Elements, countArg, elementSize});
+	}
+
+	GLTraceFunctionInfo& image(int argIndex, int widthArg, int heightArg, int depthArg, int formatArg, int typeArg) {
+		return payload({argIndex, GLTracePayloadKind::Image, -1, 0, {widthArg, heightArg, depthArg, formatArg, typeArg}});
+	}
+
+	GLTraceFunctionInfo& cString(int argIndex) {
+		return payload({argIndex, GLTracePayloadKind::CString});
+	}
+
+	GLTraceFunctionInfo& stringArray(int argIndex, int countArg, int lengthArg = -1) {
+		PayloadRule rule = {argIndex, GLTracePayloadKind::StringArray, countArg};
+		rule.lengthArg = lengthArg;
+		return payload(rule);
+	}
+
+	GLTraceFunctionInfo& clearValue(int argIndex, int bufferArg) {
+		return payload({argIndex, GLTracePayloadKind::ClearValue, bufferArg});
+	}
+
+	GLTraceFunctionInfo& pixelsOut(int argIndex, int widthArg, int heightArg, int formatArg, int typeArg) {
+		return payload({argIndex, GLTracePayloadKind::PixelsOut, -1, 0, {widthArg, heightArg, -1, formatArg, typeArg}});
+	}
+
+	GLTraceFunctionInfo& offset(int argIndex) {
+		return payload({argIndex, GLTracePayloadKind::Offset});
+	}
+
+	// glGen* (n, noms) : les noms sont dans les données de l'appel, on les associe à ceux créés en rejouant.
+	GLTraceFunctionInfo& genNames(GLTraceObjectKind kind) {
+		special = GLTraceSpecial::GenNames;
+		arrayKind = kind;
+		return elements(1, 0, sizeof(GLuint));
+	}
+
+	// glDelete* (n, noms) : les noms sont traduits avant l'appel.
+	GLTraceFunctionInfo& deleteNames(GLTraceObjectKind kind) {
+		special = GLTraceSpecial::DeleteNames;
+		arrayKind = kind;
+		return elements(1, 0, sizeof(GLuint));
+	}
+
+	GLTraceFunctionInfo& track(GLTraceSpecial value) {
+		special = value;
+		return *this;
+	}
+
+	GLTraceFunctionInfo& payload(const PayloadRule& rule) {
+		payloads.push_back(rule);
+		return *this;
+	}
+
+	const PayloadRule* findPayloadRule(int argIndex) const {
+		for (auto&& rule : payloads) {
+			if (rule.argIndex == argIndex)
+				return &rule;
+		}
+		return nullptr;
+	}
+};
+
+// Les fonctions qu'on sait rejouer : celles qu'utilisent les exemples et le cadriciel. Les autres sont quand même enregistrées (pour compter les appels), mais sans arguments, et sont sautées en rejouant.
+class GLTraceFunctionTable
+{
+public:
+	static const GLTraceFunctionTable& get() {
+		static GLTraceFunctionTable table;
+		return table;
+	}
+
+	const GLTraceFunctionInfo* find(std::string_view name) const {
+		auto it = functions_.find(std::string(name));
+		return it != functions_.end() ? &it->second : nullptr;
+	}
+
+private:
+	GLTraceFunctionTable() {
+		using enum GLTraceObjectKind;
+		using enum GLTraceSpecial;
+		#define INF2705_GL_TRACE(function) add(#function, &gl::function)
+
+		// Objets.
+		INF2705_GL_TRACE(glGenBuffers).genNames(Buffer);
+		INF2705_GL_TRACE(glDeleteBuffers).deleteNames(Buffer);
+		INF2705_GL_TRACE(glGenTextures).genNames(Texture);
+		INF2705_GL_TRACE(glDeleteTextures).deleteNames(Texture);
+		INF2705_GL_TRACE(glGenVertexArrays).genNames(VertexArray);
+		INF2705_GL_TRACE(glDeleteVertexArrays).deleteNames(VertexArray);
+		INF2705_GL_TRACE(glGenFramebuffers).genNames(Framebuffer);
+		INF2705_GL_TRACE(glDeleteFramebuffers).deleteNames(Framebuffer);
+		INF2705_GL_TRACE(glGenRenderbuffers).genNames(Renderbuffer);
+		INF2705_GL_TRACE(glDeleteRenderbuffers).deleteNames(Renderbuffer);
+		INF2705_GL_TRACE(glGenQueries).genNames(Query);
+		INF2705_GL_TRACE(glDeleteQueries).deleteNames(Query);
+		INF2705_GL_TRACE(glGenTransformFeedbacks).genNames(TransformFeedback);
+		INF2705_GL_TRACE(glDeleteTransformFeedbacks).deleteNames(TransformFeedback);
+
+		// Nuanceurs et programmes.
+		INF2705_GL_TRACE(glCreateShader).returnName(Shader);
+		INF2705_GL_TRACE(glShaderSource).objectName(0, Shader).stringArray(2, 1, 3);
+		INF2705_GL_TRACE(glCompileShader).objectName(0, Shader);
+		INF2705_GL_TRACE(glDeleteShader).objectName(0, Shader);
+		INF2705_GL_TRACE(glCreateProgram).returnName(Program);
+		INF2705_GL_TRACE(glAttachShader).objectName(0, Program).objectName(1, Shader);
+		INF2705_GL_TRACE(glDetachShader).objectName(0, Program).objectName(1, Shader);
+		INF2705_GL_TRACE(glBindAttribLocation).objectName(0, Program).cString(2);
+		INF2705_GL_TRACE(glTransformFeedbackVaryings).objectName(0, Program).stringArray(2, 1);
+		INF2705_GL_TRACE(glLinkProgram).objectName(0, Program);
+		INF2705_GL_TRACE(glDeleteProgram).objectName(0, Program);
+		INF2705_GL_TRACE(glUseProgram).objectName(0, Program).track(UseProgram);
+		// Les index de blocs et d'attributs sont supposés les mêmes en rejouant (même programme, même pilote). Les positions des uniformes sont traduites.
+		INF2705_GL_TRACE(glGetUniformLocation).objectName(0, Program).cString(1).returnName(UniformLocation);
+		INF2705_GL_TRACE(glGetAttribLocation).objectName(0, Program).cString(1);
+		INF2705_GL_TRACE(glGetUniformBlockIndex).objectName(0, Program).cString(1);
+		INF2705_GL_TRACE(glUniformBlockBinding).objectName(0, Program);
+		INF2705_GL_TRACE(glShaderStorageBlockBinding).objectName(0, Program);
+
+		// Uniformes.
+		INF2705_GL_TRACE(glUniform1f).objectName(0, UniformLocation);
+		INF2705_GL_TRACE(glUniform1i).objectName(0, UniformLocation);
+		INF2705_GL_TRACE(glUniform1ui).objectName(0, UniformLocation);
+		INF2705_GL_TRACE(glUniform2fv).objectName(0, UniformLocation).elements(2, 1, 2 * sizeof(GLfloat));
+		INF2705_GL_TRACE(glUniform3fv).objectName(0, UniformLocation).elements(2, 1, 3 * sizeof(GLfloat));
+		INF2705_GL_TRACE(glUniform4fv).objectName(0, UniformLocation).elements(2, 1, 4 * sizeof(GLfloat));
+		INF2705_GL_TRACE(glUniform2iv).objectName(0, UniformLocation).elements(2, 1, 2 * sizeof(GLint));
+		INF2705_GL_TRACE(glUniform3iv).objectName(0, UniformLocation).elements(2, 1, 3 * sizeof(GLint));
+		INF2705_GL_TRACE(glUniform4iv).objectName(0, UniformLocation).elements(2, 1, 4 * sizeof(GLint));
+		INF2705_GL_TRACE(glUniform2uiv).objectName(0, UniformLocation).elements(2, 1, 2 * sizeof(GLuint));
+		INF2705_GL_TRACE(glUniform3uiv).objectName(0, UniformLocation).elements(2, 1, 3 * sizeof(GLuint));
+		INF2705_GL_TRACE(glUniform4uiv).objectName(0, UniformLocation).elements(2, 1, 4 * sizeof(GLuint));
+		INF2705_GL_TRACE(glUniformMatrix2fv).objectName(0, UniformLocation).elements(3, 1, 4 * sizeof(GLfloat));
+		INF2705_GL_TRACE(glUniformMatrix3fv).objectName(0, UniformLocation).elements(3, 1, 9 * sizeof(GLfloat));
+		INF2705_GL_TRACE(glUniformMatrix4fv).objectName(0, UniformLocation).elements(3, 1, 16 * sizeof(GLfloat));
+
+		// Tampons.
+		INF2705_GL_TRACE(glBindBuffer).objectName(1, Buffer).track(BindBuffer);
+		INF2705_GL_TRACE(glBindBufferBase).objectName(2, Buffer).track(BindBufferIndexed);
+		INF2705_GL_TRACE(glBindBufferRange).objectName(2, Buffer).track(BindBufferIndexed);
+		INF2705_GL_TRACE(glBufferData).bytes(2, 1);
+		INF2705_GL_TRACE(glBufferSubData).bytes(3, 2);
+		INF2705_GL_TRACE(glBufferStorage).bytes(2, 1);
+		INF2705_GL_TRACE(glCopyBufferSubData);
+		INF2705_GL_TRACE(glMapBufferRange).track(MapBufferRange);
+		INF2705_GL_TRACE(glMapBuffer).track(MapBuffer);
+		INF2705_GL_TRACE(glUnmapBuffer).track(UnmapBuffer);
+
+		// Sommets et dessins.
+		INF2705_GL_TRACE(glBindVertexArray).objectName(0, VertexArray);
+		INF2705_GL_TRACE(glEnableVertexAttribArray);
+		INF2705_GL_TRACE(glVertexAttribPointer).offset(5);
+		INF2705_GL_TRACE(glVertexAttribIPointer).offset(4);
+		INF2705_GL_TRACE(glVertexAttribDivisor);
+		INF2705_GL_TRACE(glDrawArrays);
+		INF2705_GL_TRACE(glDrawArraysInstanced);
+		INF2705_GL_TRACE(glDrawElements).offset(3);
+		INF2705_GL_TRACE(glDrawElementsBaseVertex).offset(3);
+		INF2705_GL_TRACE(glDrawElementsInstanced).offset(3);
+		INF2705_GL_TRACE(glDrawElementsInstancedBaseVertex).offset(3);
+		INF2705_GL_TRACE(glMultiDrawElementsIndirect).offset(2);
+		INF2705_GL_TRACE(glDispatchCompute);
+		INF2705_GL_TRACE(glMemoryBarrier);
+		INF2705_GL_TRACE(glPatchParameteri);
+		INF2705_GL_TRACE(glBindTransformFeedback).objectName(1, TransformFeedback);
+		INF2705_GL_TRACE(glBeginTransformFeedback);
+		INF2705_GL_TRACE(glEndTransformFeedback);
+
+		// Textures.
+		INF2705_GL_TRACE(glActiveTexture);
+		INF2705_GL_TRACE(glBindTexture).objectName(1, Texture);
+		// glbinding surcharge glTexParameteri pour accepter aussi un GLenum : on choisit la signature d'origine.
+		add("glTexParameteri", static_cast<void (*)(GLenum, GLenum, GLint)>(&gl::glTexParameteri));
+		INF2705_GL_TRACE(glTexImage2D).image(8, 3, 4, -1, 6, 7);
+		INF2705_GL_TRACE(glTexStorage2D);
+		INF2705_GL_TRACE(glGenerateMipmap);
+		INF2705_GL_TRACE(glPixelStorei).track(PixelStore);
+
+		// Framebuffers.
+		INF2705_GL_TRACE(glBindFramebuffer).objectName(1, Framebuffer);
+		INF2705_GL_TRACE(glBindRenderbuffer).objectName(1, Renderbuffer);
+		INF2705_GL_TRACE(glRenderbufferStorageMultisample);
+		INF2705_GL_TRACE(glFramebufferTexture2D).objectName(3, Texture);
+		INF2705_GL_TRACE(glFramebufferRenderbuffer).objectName(3, Renderbuffer);
+		INF2705_GL_TRACE(glDrawBuffer);
+		INF2705_GL_TRACE(glDrawBuffers).elements(1, 0, sizeof(GLenum));
+		INF2705_GL_TRACE(glReadBuffer);
+		INF2705_GL_TRACE(glBlitFramebuffer);
+		INF2705_GL_TRACE(glInvalidateFramebuffer).elements(2, 1, sizeof(GLenum));
+		INF2705_GL_TRACE(glReadPixels).pixelsOut(6, 2, 3, 4, 5);
+		INF2705_GL_TRACE(glClear);
+		INF2705_GL_TRACE(glClearColor);
+		INF2705_GL_TRACE(glClearDepth);
+		INF2705_GL_TRACE(glClearStencil);
+		INF2705_GL_TRACE(glClearBufferfv).clearValue(2, 0);
+
+		// États.
+		INF2705_GL_TRACE(glEnable);
+		INF2705_GL_TRACE(glDisable);
+		INF2705_GL_TRACE(glBlendFunc);
+		INF2705_GL_TRACE(glBlendEquation);
+		INF2705_GL_TRACE(glDepthFunc);
+		INF2705_GL_TRACE(glDepthMask);
+		INF2705_GL_TRACE(glStencilFunc);
+		INF2705_GL_TRACE(glStencilOp);
+		INF2705_GL_TRACE(glStencilMask);
+		INF2705_GL_TRACE(glColorMask);
+		INF2705_GL_TRACE(glCullFace);
+		INF2705_GL_TRACE(glFrontFace);
+		INF2705_GL_TRACE(glPolygonMode);
+		INF2705_GL_TRACE(glLogicOp);
+		INF2705_GL_TRACE(glLineWidth);
+		INF2705_GL_TRACE(glPointSize);
+		INF2705_GL_TRACE(glViewport);
+
+		// Requêtes et synchronisation.
+		INF2705_GL_TRACE(glBeginQuery).objectName(1, Query);
+		INF2705_GL_TRACE(glEndQuery);
+		INF2705_GL_TRACE(glQueryCounter).objectName(0, Query);
+		INF2705_GL_TRACE(glFenceSync);
+		INF2705_GL_TRACE(glClientWaitSync);
+		INF2705_GL_TRACE(glDeleteSync).track(DeleteSync);
+		INF2705_GL_TRACE(glFlush);
+		INF2705_GL_TRACE(glFinish);
+
+		#undef INF2705_GL_TRACE
+	}
+
+	template <typename R, typename... Args>
+	GLTraceFunctionInfo& add(const std::string& name, R (*function)(Args...)) {
+		GLTraceFunctionInfo& info = functions_[name];
+		info.name = name;
+		info.numArgs = sizeof...(Args);
+		info.isPointerArg = {std::is_pointer_v<Args>...};
+		info.isSyncArg = {std::is_same_v<Args, GLsync>...};
+		info.returnsSync = std::is_same_v<R, GLsync>;
+		info.encode = [](const glbinding::FunctionCall& call, GLTraceCall& result) {
+			encodeArgs<Args...>(call, result, std::index_sequence_for<Args...>{});
+			if constexpr (not std::is_void_v<R>) {
+				result.hasReturnValue = true;
+				result.returnValue = toTraceBits(static_cast<const glbinding::Value<R>&>(*call.returnValue).value());
+			}
+		};
+		info.invoke = [function](const std::vector<uint64_t>& args) -> uint64_t {
+			return invokeWithArgs<R, Args...>(function, args, std::index_sequence_for<Args...>{});
+		};
+		return info;
+	}
+
+	template <typename... Args, size_t... I>
+	static void encodeArgs(const glbinding::FunctionCall& call, GLTraceCall& result, std::index_sequence<I...>) {
+		result.args = {toTraceBits(static_cast<const glbinding::Value<Args>&>(*call.parameters[I]).value())...};
+	}
+
+	template <typename R, typename... Args, size_t... I>
+	static uint64_t invokeWithArgs(R (*function)(Args...), const std::vector<uint64_t>& args, std::index_sequence<I...>) {
+		if constexpr (std::is_void_v<R>) {
+			function(fromTraceBits<Args>(args[I])...);
+			return 0;
+		} else {
+			return toTraceBits(function(fromTraceBits<Args>(args[I])...));
+		}
+	}
+
+	std::unordered_map<std::string, GLTraceFunctionInfo> functions_;
+};
+
+// Taille en octets des pixels d'une image en mémoire, avec l'alignement des lignes (GL_UNPACK_ALIGNMENT ou GL_PACK_ALIGNMENT).
+inline size_t getGLImageSize(int width, int height, int depth, GLenum format, GLenum type, int alignment) {
+	int numComponents = 4;
+	if (format == GL_RED or format == GL_RED_INTEGER or format == GL_DEPTH_COMPONENT or format == GL_STENCIL_INDEX or format == GL_DEPTH_STENCIL)
+		numComponents = 1;
+	else if (format == GL_RG or format == GL_RG_INTEGER)
+		numComponents = 2;
+	else if (format == GL_RGB or format == GL_BGR or format == GL_RGB_INTEGER)
+		numComponents = 3;
+
+	size_t pixelSize = numComponents * 4;
+	if (type == GL_UNSIGNED_BYTE or type == GL_BYTE)
+		pixelSize = numComponents;
+	else if (type == GL_UNSIGNED_SHORT or type == GL_SHORT or type == GL_HALF_FLOAT)
+		pixelSize = numComponents * 2;
+	else if (type == GL_UNSIGNED_INT_24_8)
+		pixelSize = 4; // Format compacté : un pixel entier dans 32 bits.
+
+	size_t rowSize = width * pixelSize;
+	rowSize = (rowSize + alignment - 1) / alignment * alignment;
+	return rowSize * height * std::max(depth, 1);
+}
+
+// L'enregistreur. Un seul peut être actif à la fois, puisque les rappels de glbinding sont globaux. Il remplace aussi ceux de GLCallCounter (banc d'essai).
+class GLTraceRecorder
+{
+public:
+	~GLTraceRecorder() {
+		stop();
+	}
+
+	// Commencer à enregistrer dans un fichier. Les dimensions sont celles du framebuffer par défaut, pour que la relecture dessine dans un FBO de même taille.
+	bool start(const std::string& path, int width, int height) {
+		stop();
+		file_.open(path, std::ios::binary);
+		if (not file_) {
+			std::cerr << "GLTrace: impossible d'écrire dans " << path << std::endl;
+			return false;
+		}
+		GLint majorVersion = 0;
+		GLint minorVersion = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+		glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+		// Le profil (compatibilité ou core) et les drapeaux changent le comportement du pilote (glLineWidth plus grand que 1, par exemple) : la relecture recrée le même genre de contexte.
+		GLint profileMask = 0;
+		GLint contextFlags = 0;
+		glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profileMask);
+		glGetIntegerv(GL_CONTEXT_FLAGS, &contextFlags);
+		buffer_.clear();
+		write("INF2705T", 8);
+		writeValue<uint32_t>(1);
+		writeValue<uint32_t>(width);
+		writeValue<uint32_t>(height);
+		writeValue<uint16_t>((uint16_t)majorVersion);
+		writeValue<uint16_t>((uint16_t)minorVersion);
+		writeValue<uint32_t>((uint32_t)profileMask);
+		writeValue<uint32_t>((uint32_t)contextFlags);
+
+		functionIds_.clear();
+		instrumentedFunctions_.clear();
+		boundBuffers_.clear();
+		mappings_.clear();
+		numCalls_ = 0;
+		numFrames_ = 0;
+		numBytes_ = 0;
+		const GLTraceFunctionTable& table = GLTraceFunctionTable::get();
+		for (glbinding::AbstractFunction* function : glbinding::Binding::functions()) {
+			std::string_view name = function->name();
+			// Les glGet* et glIs* ne changent rien : on ne garde que ceux dont on a besoin pour traduire les noms.
+			const GLTraceFunctionInfo* info = table.find(name);
+			if (info == nullptr and (name.starts_with("glGet") or name.starts_with("glIs") or name == "glCheckFramebufferStatus"))
+				continue;
+			auto mask = info != nullptr ? glbinding::CallbackMask::After | glbinding::CallbackMask::ParametersAndReturnValue : glbinding::CallbackMask::After;
+			if (info != nullptr and info->special == GLTraceSpecial::UnmapBuffer)
+				mask = mask | glbinding::CallbackMask::Before;
+			function->setCallbackMask(mask);
+			instrumentedFunctions_.push_back(function);
+		}
+		glbinding::Binding::setBeforeCallback([this](const glbinding::FunctionCall& call) { onBeforeCall(call); });
+		glbinding::Binding::setAfterCallback([this](const glbinding::FunctionCall& call) { onCall(call); });
+		isRecording_ = true;
+		return true;
+	}
+
+	// Marquer la fin d'une trame. La relecture mesure le temps par trame.
+	void endFrame() {
+		if (not isRecording_)
+			return;
+		writeValue<uint8_t>(RecordEndFrame);
+		numFrames_++;
+		flushIfNeeded();
+	}
+
+	void stop() {
+		if (not isRecording_)
+			return;
+		for (glbinding::AbstractFunction* function : instrumentedFunctions_)
+			function->setCallbackMask(glbinding::CallbackMask::None);
+		instrumentedFunctions_.clear();
+		glbinding::Binding::setBeforeCallback({});
+		glbinding::Binding::setAfterCallback({});
+		flush();
+		file_.close();
+		isRecording_ = false;
+	}
+
+	bool isRecording() const { return isRecording_; }
+	int getNumCalls() const { return numCalls_; }
+	int getNumFrames() const { return numFrames_; }
+	size_t getNumBytes() const { return numBytes_ + buffer_.size(); }
+
+	enum RecordType : uint8_t
+	{
+		RecordFunction = 1,
+		RecordCall = 2,
+		RecordEndFrame = 3,
+	};
+
+private:
+	struct Mapping
+	{
+		std::byte* pointer = nullptr;
+		GLintptr offset = 0;
+		GLsizeiptr length = 0;
+		bool isWrite = false;
+		bool isPersistent = false;
+	};
+
+	void onBeforeCall(const glbinding::FunctionCall& call) {
+		// Avant glUnmapBuffer, le pointeur est encore valide : on garde ce que le CPU a écrit dans le tampon.
+		GLenum target = fromTraceBits<GLenum>(toTraceBits(static_cast<const glbinding::Value<GLenum>&>(*call.parameters[0]).value()));
+		pendingMappedData_.reset();
+		auto it = mappings_.find(boundBuffers_[target]);
+		if (it != mappings_.end() and it->second.isWrite)
+			pendingMappedData_ = makeMappedPayload(it->second, it->second.offset, it->second.length);
+	}
+
+	void onCall(const glbinding::FunctionCall& call) {
+		numCalls_++;
+		auto [it, isNew] = functionIds_.try_emplace(call.function, (uint16_t)functionIds_.size());
+		const GLTraceFunctionInfo* info = GLTraceFunctionTable::get().find(call.function->name());
+		if (isNew)
+			writeFunction(it->second, call.function->name(), info != nullptr);
+
+		GLTraceCall traceCall;
+		traceCall.functionId = it->second;
+		if (info != nullptr) {
+			info->encode(call, traceCall);
+			capturePayloads(*info, traceCall);
+			trackState(*info, traceCall);
+		}
+		writeCall(traceCall);
+		flushIfNeeded();
+	}
+
+	void capturePayloads(const GLTraceFunctionInfo& info, GLTraceCall& call) {
+		auto argInt = [&](int i) { return fromTraceBits<GLint>(call.args[i]); };
+		for (auto&& rule : info.payloads) {
+			const std::byte* pointer = fromTraceBits<const std::byte*>(call.args[rule.argIndex]);
+			if (pointer == nullptr)
+				continue;
+			size_t size = 0;
+			switch (rule.kind) {
+			case GLTracePayloadKind::Bytes:
+				size = (size_t)fromTraceBits<GLsizeiptr>(call.args[rule.countArg]);
+				break;
+			case GLTracePayloadKind::Elements:
+				size = (size_t)argInt(rule.countArg) * rule.elementSize;
+				break;
+			case GLTracePayloadKind::ClearValue:
+				size = fromTraceBits<GLenum>(call.args[rule.countArg]) == GL_COLOR ? 4 * sizeof(GLfloat) : sizeof(GLfloat);
+				break;
+			case GLTracePayloadKind::Image: {
+				if (boundBuffers_[GL_PIXEL_UNPACK_BUFFER] != 0)
+					continue;
+				auto& args = rule.imageArgs;
+				int depth = args[2] >= 0 ? argInt(args[2]) : 1;
+				GLenum format = fromTraceBits<GLenum>(call.args[args[3]]);
+				GLenum type = fromTraceBits<GLenum>(call.args[args[4]]);
+				size = getGLImageSize(argInt(args[0]), argInt(args[1]), depth, format, type, unpackAlignment_);
+				break;
+			}
+			case GLTracePayloadKind::CString:
+				size = std::strlen((const char*)pointer) + 1;
+				break;
+			case GLTracePayloadKind::StringArray: {
+				// Les chaînes sont mises bout à bout, chacune terminée par un zéro.
+				auto strings = (const GLchar* const*)pointer;
+				auto lengths = rule.lengthArg >= 0 ? fromTraceBits<const GLint*>(call.args[rule.lengthArg]) : nullptr;
+				GLTracePayload payload = {(uint8_t)rule.argIndex, {}};
+				for (int i = 0; i < argInt(rule.countArg); i++) {
+					size_t length = lengths != nullptr and lengths[i] >= 0 ? lengths[i] : std::strlen(strings[i]);
+					auto first = (const std::byte*)strings[i];
+					payload.data.insert(payload.data.end(), first, first + length);
+					payload.data.push_back(std::byte(0));
+				}
+				call.payloads.push_back(std::move(payload));
+				continue;
+			}
+			default:
+				continue;
+			}
+			call.payloads.push_back({(uint8_t)rule.argIndex, std::vector<std::byte>(pointer, pointer + size)});
+		}
+	}
+
+	void trackState(const GLTraceFunctionInfo& info, GLTraceCall& call) {
+		switch (info.special) {
+		case GLTraceSpecial::BindBuffer:
+			boundBuffers_[fromTraceBits<GLenum>(call.args[0])] = fromTraceBits<GLuint>(call.args[1]);
+			break;
+		case GLTraceSpecial::BindBufferIndexed: {
+			// glBindBufferBase et glBindBufferRange lient aussi la cible générique.
+			GLuint buffer = fromTraceBits<GLuint>(call.args[2]);
+			boundBuffers_[fromTraceBits<GLenum>(call.args[0])] = buffer;
+			// Un tampon mappé de façon persistante (UniformBufferRing) n'est jamais démappé : on garde la partie qu'on lie, qui vient d'être écrite par le CPU.
+			auto it = mappings_.find(buffer);
+			if (call.args.size() == 5 and it != mappings_.end() and it->second.isWrite and it->second.isPersistent) {
+				auto payload = makeMappedPayload(it->second, fromTraceBits<GLintptr>(call.args[3]), fromTraceBits<GLsizeiptr>(call.args[4]));
+				if (payload.has_value())
+					call.payloads.push_back(std::move(*payload));
+			}
+			break;
+		}
+		case GLTraceSpecial::MapBufferRange: {
+			Mapping mapping;
+			mapping.pointer = fromTraceBits<std::byte*>(call.returnValue);
+			mapping.offset = fromTraceBits<GLintptr>(call.args[1]);
+			mapping.length = fromTraceBits<GLsizeiptr>(call.args[2]);
+			uint64_t access = call.args[3];
+			mapping.isWrite = (access & toTraceBits(GL_MAP_WRITE_BIT)) != 0;
+			mapping.isPersistent = (access & toTraceBits(GL_MAP_PERSISTENT_BIT)) != 0;
+			if (mapping.pointer != nullptr)
+				mappings_[boundBuffers_[fromTraceBits<GLenum>(call.args[0])]] = mapping;
+			break;
+		}
+		case GLTraceSpecial::MapBuffer: {
+			GLenum target = fromTraceBits<GLenum>(call.args[0]);
+			GLint size = 0;
+			glGetBufferParameteriv(target, GL_BUFFER_SIZE, &size);
+			Mapping mapping;
+			mapping.pointer = fromTraceBits<std::byte*>(call.returnValue);
+			mapping.length = size;
+			mapping.isWrite = fromTraceBits<GLenum>(call.args[1]) != GL_READ_ONLY;
+			if (mapping.pointer != nullptr)
+				mappings_[boundBuffers_[target]] = mapping;
+			break;
+		}
+		case GLTraceSpecial::UnmapBuffer:
+			mappings_.erase(boundBuffers_[fromTraceBits<GLenum>(call.args[0])]);
+			if (pendingMappedData_.has_value())
+				call.payloads.push_back(std::move(*pendingMappedData_));
+			pendingMappedData_.reset();
+			break;
+		case GLTraceSpecial::PixelStore:
+			if (fromTraceBits<GLenum>(call.args[0]) == GL_UNPACK_ALIGNMENT)
+				unpackAlignment_ = fromTraceBits<GLint>(call.args[1]);
+			break;
+		default:
+			break;
+		}
+	}
+
+	std::optional<GLTracePayload> makeMappedPayload(const Mapping& mapping, GLintptr offset, GLsizeiptr length) const {
+		if (offset < mapping.offset or offset + length > mapping.offset + mapping.length or length <= 0)
+			return std::nullopt;
+		GLTracePayload payload = {glTraceMappedDataArg, {}};
+		payload.data.resize(sizeof(uint64_t) + length);
+		uint64_t offsetBits = offset;
+		std::memcpy(payload.data.data(), &offsetBits, sizeof(uint64_t));
+		std::memcpy(payload.data.data() + sizeof(uint64_t), mapping.pointer + (offset - mapping.offset), length);
+		return payload;
+	}
+
+	void writeFunction(uint16_t id, std::string_view name, bool isReplayable) {
+		writeValue<uint8_t>(RecordFunction);
+		writeValue<uint16_t>(id);
+		writeValue<uint8_t>(isReplayable);
+		writeValue<uint16_t>((uint16_t)name.size());
+		write(name.data(), name.size());
+	}
+
+	void writeCall(const GLTraceCall& call) {
+		writeValue<uint8_t>(RecordCall);
+		writeValue<uint16_t>(call.functionId);
+		writeValue<uint8_t>((uint8_t)call.args.size());
+		write(call.args.data(), call.args.size() * sizeof(uint64_t));
+		writeValue<uint8_t>(call.hasReturnValue);
+		if (call.hasReturnValue)
+			writeValue<uint64_t>(call.returnValue);
+		writeValue<uint8_t>((uint8_t)call.payloads.size());
+		for (auto&& payload : call.payloads) {
+			writeValue<uint8_t>(payload.argIndex);
+			writeValue<uint32_t>((uint32_t)payload.data.size());
+			write(payload.data.data(), payload.data.size());
+		}
+	}
+
+	template <typename T>
+	void writeValue(T value) {
+		write(&value, sizeof(T));
+	}
+
+	void write(const void* data, size_t size) {
+		auto bytes = (const std::byte*)data;
+		buffer_.insert(buffer_.end(), bytes, bytes + size);
+	}
+
+	// On écrit par gros blocs : écrire chaque appel directement dans le fichier ralentirait beaucoup plus l'application.
+	void flushIfNeeded() {
+		if (buffer_.size() >= 4 << 20)
+			flush();
+	}
+
+	void flush() {
+		file_.write((const char*)buffer_.data(), buffer_.size());
+		numBytes_ += buffer_.size();
+		buffer_.clear();
+	}
+
+	std::ofstream file_;
+	std::vector<std::byte> buffer_;
+	bool isRecording_ = false;
+	int numCalls_ = 0;
+	int numFrames_ = 0;
+	size_t numBytes_ = 0;
+
+	std::unordered_map<const glbinding::AbstractFunction*, uint16_t> functionIds_;
+	std::vector<glbinding::AbstractFunction*> instrumentedFunctions_;
+	std::unordered_map<GLenum, GLuint> boundBuffers_;
+	std::unordered_map<GLuint, Mapping> mappings_;
+	std::optional<GLTracePayload> pendingMappedData_;
+	int unpackAlignment_ = 4;
+};
+
+struct GLTraceFrame
+{
+	std::vector<GLTraceCall> calls;
+};
+
+// Une trace chargée en mémoire au complet, pour que la lecture du disque ne fausse pas le temps de relecture.
+struct GLTraceFile
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint16_t majorVersion = 0;
+	uint16_t minorVersion = 0;
+	uint32_t profileMask = 0; // GL_CONTEXT_PROFILE_MASK du contexte enregistré.
+	uint32_t contextFlags = 0;
+	std::vector<std::string> functionNames;
+	std::vector<bool> isReplayable;
+	std::vector<GLTraceFrame> frames;
+
+	bool load(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		if (not file) {
+			std::cerr << "GLTrace: impossible de lire " << path << std::endl;
+			return false;
+		}
+		std::vector<char> bytes((std::istreambuf_iterator<char>(file)), {});
+		size_t position = 0;
+		auto read = [&](void* destination, size_t size) {
+			if (position + size > bytes.size())
+				return false;
+			std::memcpy(destination, bytes.data() + position, size);
+			position += size;
+			return true;
+		};
+		auto readValue = [&]<typename T>(T& value) { return read(&value, sizeof(T)); };
+
+		char magic[8] = {};
+		uint32_t version = 0;
+		read(magic, 8);
+		readValue(version);
+		if (std::string_view(magic, 8) != "INF2705T" or version != 1) {
+			std::cerr << "GLTrace: " << path << " n'est pas une trace valide" << std::endl;
+			return false;
+		}
+		readValue(width);
+		readValue(height);
+		readValue(majorVersion);
+		readValue(minorVersion);
+		readValue(profileMask);
+		readValue(contextFlags);
+
+		frames.assign(1, {});
+		uint8_t recordType = 0;
+		while (readValue(recordType)) {
+			if (recordType == GLTraceRecorder::RecordFunction) {
+				uint16_t id = 0;
+				uint8_t replayable = 0;
+				uint16_t length = 0;
+				readValue(id);
+				readValue(replayable);
+				readValue(length);
+				std::string name(length, '\0');
+				read(name.data(), length);
+				if (functionNames.size() <= id) {
+					functionNames.resize(id + 1);
+					isReplayable.resize(id + 1);
+				}
+				functionNames[id] = name;
+				isReplayable[id] = replayable != 0;
+			} else if (recordType == GLTraceRecorder::RecordCall) {
+				GLTraceCall call;
+				uint8_t numArgs = 0;
+				uint8_t hasReturnValue = 0;
+				uint8_t numPayloads = 0;
+				readValue(call.functionId);
+				readValue(numArgs);
+				call.args.resize(numArgs);
+				read(call.args.data(), numArgs * sizeof(uint64_t));
+				readValue(hasReturnValue);
+				call.hasReturnValue = hasReturnValue != 0;
+				if (call.hasReturnValue)
+					readValue(call.returnValue);
+				readValue(numPayloads);
+				call.payloads.resize(numPayloads);
+				for (auto&& payload : call.payloads) {
+					uint32_t size = 0;
+					readValue(payload.argIndex);
+					readValue(size);
+					payload.data.resize(size);
+					if (not read(payload.data.data(), size))
+						return truncated(path);
+				}
+				frames.back().calls.push_back(std::move(call));
+			} else if (recordType == GLTraceRecorder::RecordEndFrame) {
+				frames.emplace_back();
+			} else {
+				return truncated(path);
+			}
+		}
+		// La dernière trame est vide si la trace s'est terminée sur une fin de trame.
+		if (frames.size() > 1 and frames.back().calls.empty())
+			frames.pop_back();
+		return true;
+	}
+
+	bool isCoreProfile() const { return (profileMask & (uint32_t)GL_CONTEXT_CORE_PROFILE_BIT) != 0; }
+	bool isDebugContext() const { return (contextFlags & (uint32_t)GL_CONTEXT_FLAG_DEBUG_BIT) != 0; }
+
+	// Le nombre d'appels de chaque fonction dans toute la trace.
+	std::unordered_map<std::string, int> countCalls() const {
+		std::unordered_map<std::string, int> counts;
+		for (auto&& frame : frames) {
+			for (auto&& call : frame.calls)
+				counts[functionNames[call.functionId]]++;
+		}
+		return counts;
+	}
+
+private:
+	bool truncated(const std::string& path) const {
+		std::cerr << "GLTrace: " << path << " est tronquée ou corrompue" << std::endl;
+		return false;
+	}
+};
+
+// Le relecteur. Il réexécute les appels d'une trace dans le contexte courant, en traduisant les noms d'objets, les positions d'uniformes et les objets de synchronisation.
+class GLTracePlayer
+{
+public:
+	// Le framebuffer qui remplace celui de la fenêtre (0) de la trace, typiquement un FBO de la taille de la trace.
+	void setDefaultFramebuffer(GLuint framebuffer) {
+		defaultFramebuffer_ = framebuffer;
+	}
+
+	void playFrame(const GLTraceFile& trace, const GLTraceFrame& frame) {
+		if (functions_.size() != trace.functionNames.size()) {
+			functions_.resize(trace.functionNames.size());
+			for (size_t i = 0; i < functions_.size(); i++)
+				functions_[i] = trace.isReplayable[i] ? GLTraceFunctionTable::get().find(trace.functionNames[i]) : nullptr;
+			callCounts_.resize(functions_.size());
+		}
+		for (auto&& call : frame.calls) {
+			callCounts_[call.functionId]++;
+			const GLTraceFunctionInfo* info = functions_[call.functionId];
+			if (info == nullptr or (int)call.args.size() != info->numArgs) {
+				numSkippedCalls_++;
+				continue;
+			}
+			play(*info, call);
+		}
+	}
+
+	// Nombre de fois que chaque fonction (par identifiant de la trace) a été rencontrée.
+	const std::vector<int>& getCallCounts() const { return callCounts_; }
+	// Appels de fonctions qu'on ne sait pas rejouer.
+	int getNumSkippedCalls() const { return numSkippedCalls_; }
+	// Noms créés différents de ceux de la trace. Ce n'est pas une erreur (ils sont traduits), mais ça indique un autre pilote ou un autre état de départ.
+	int getNumRenamedObjects() const { return numRenamedObjects_; }
+
+private:
+	struct Mapping
+	{
+		std::byte* pointer = nullptr;
+		GLintptr offset = 0;
+	};
+
+	void play(const GLTraceFunctionInfo& info, const GLTraceCall& call) {
+		std::vector<uint64_t> args = call.args;
+		std::vector<std::vector<GLuint>> nameArrays;
+		std::vector<std::vector<const GLchar*>> stringArrays;
+		std::vector<std::byte> scratch;
+
+		for (int i = 0; i < info.numArgs; i++) {
+			if (info.isSyncArg[i]) {
+				args[i] = syncs_[call.args[i]];
+			} else if (info.isPointerArg[i]) {
+				args[i] = translatePointer(info, call, i, nameArrays, stringArrays, scratch);
+			}
+		}
+		for (auto&& nameArg : info.names) {
+			if (nameArg.argIndex >= 0)
+				args[nameArg.argIndex] = translateName(nameArg.kind, args[nameArg.argIndex]);
+		}
+
+		if (const GLTracePayload* mapped = call.findPayload(glTraceMappedDataArg))
+			writeMappedData(info, args, *mapped);
+		if (info.special == GLTraceSpecial::DeleteNames)
+			forgetNames(info.arrayKind, call);
+
+		uint64_t returnValue = info.invoke(args);
+
+		if (info.returnsSync)
+			syncs_[call.returnValue] = returnValue;
+		for (auto&& nameArg : info.names) {
+			if (nameArg.argIndex < 0)
+				rememberName(nameArg.kind, call.returnValue, returnValue, args);
+		}
+		trackState(info, call, args, returnValue, nameArrays);
+	}
+
+	uint64_t translatePointer(const GLTraceFunctionInfo& info, const GLTraceCall& call, int argIndex, std::vector<std::vector<GLuint>>& nameArrays, std::vector<std::vector<const GLchar*>>& stringArrays, std::vector<std::byte>& scratch) {
+		const GLTraceFunctionInfo::PayloadRule* rule = info.findPayloadRule(argIndex);
+		// Un pointeur sans règle ne peut pas être rejoué : c'était une adresse du processus enregistré.
+		if (rule == nullptr)
+			return 0;
+		if (rule->kind == GLTracePayloadKind::PixelsOut) {
+			if (boundBuffers_[GL_PIXEL_PACK_BUFFER] != 0)
+				return call.args[argIndex];
+			auto& imageArgs = rule->imageArgs;
+			size_t size = getGLImageSize(fromTraceBits<GLint>(call.args[imageArgs[0]]), fromTraceBits<GLint>(call.args[imageArgs[1]]), 1, fromTraceBits<GLenum>(call.args[imageArgs[3]]), fromTraceBits<GLenum>(call.args[imageArgs[4]]), 8);
+			scratch.resize(size);
+			return toTraceBits(scratch.data());
+		}
+		const GLTracePayload* payload = call.findPayload(argIndex);
+		if (payload == nullptr)
+			return call.args[argIndex]; // nullptr ou décalage dans un tampon lié.
+
+		if (rule->kind == GLTracePayloadKind::StringArray) {
+			std::vector<const GLchar*>& strings = stringArrays.emplace_back();
+			const char* text = (const char*)payload->data.data();
+			for (size_t position = 0; position < payload->data.size(); position += std::strlen(text + position) + 1)
+				strings.push_back(text + position);
+			return toTraceBits(strings.data());
+		}
+		if (info.special == GLTraceSpecial::DeleteNames or info.special == GLTraceSpecial::GenNames) {
+			std::vector<GLuint>& names = nameArrays.emplace_back(payload->data.size() / sizeof(GLuint));
+			std::memcpy(names.data(), payload->data.data(), names.size() * sizeof(GLuint));
+			if (info.special == GLTraceSpecial::DeleteNames) {
+				for (GLuint& name : names)
+					name = fromTraceBits<GLuint>(translateName(info.arrayKind, name));
+			}
+			return toTraceBits(names.data());
+		}
+		return toTraceBits(payload->data.data());
+	}
+
+	uint64_t translateName(GLTraceObjectKind kind, uint64_t recordedBits) {
+		if (kind == GLTraceObjectKind::UniformLocation) {
+			auto it = uniformLocations_.find({currentProgram_, fromTraceBits<GLint>(recordedBits)});
+			return it != uniformLocations_.end() ? toTraceBits(it->second) : recordedBits;
+		}
+		GLuint recorded = fromTraceBits<GLuint>(recordedBits);
+		if (recorded == 0)
+			return kind == GLTraceObjectKind::Framebuffer ? defaultFramebuffer_ : 0;
+		auto& names = names_[(int)kind];
+		auto it = names.find(recorded);
+		// Un nom inconnu vient d'un objet créé avant le début de la trace : on le garde tel quel.
+		return it != names.end() ? it->second : recorded;
+	}
+
+	void rememberName(GLTraceObjectKind kind, uint64_t recordedBits, uint64_t actualBits, const std::vector<uint64_t>& args) {
+		if (kind == GLTraceObjectKind::UniformLocation) {
+			uniformLocations_[{fromTraceBits<GLuint>(args[0]), fromTraceBits<GLint>(recordedBits)}] = fromTraceBits<GLint>(actualBits);
+			return;
+		}
+		GLuint recorded = fromTraceBits<GLuint>(recordedBits);
+		GLuint actual = fromTraceBits<GLuint>(actualBits);
+		names_[(int)kind][recorded] = actual;
+		if (recorded != actual)
+			numRenamedObjects_++;
+	}
+
+	void forgetNames(GLTraceObjectKind kind, const GLTraceCall& call) {
+		const GLTracePayload* payload = call.findPayload(1);
+		if (payload == nullptr)
+			return;
+		for (size_t i = 0; i < payload->data.size() / sizeof(GLuint); i++) {
+			GLuint recorded = 0;
+			std::memcpy(&recorded, payload->data.data() + i * sizeof(GLuint), sizeof(GLuint));
+			names_[(int)kind].erase(recorded);
+		}
+	}
+
+	void writeMappedData(const GLTraceFunctionInfo& info, const std::vector<uint64_t>& args, const GLTracePayload& payload) {
+		GLuint buffer = info.special == GLTraceSpecial::BindBufferIndexed ? fromTraceBits<GLuint>(args[2]) : boundBuffers_[fromTraceBits<GLenum>(args[0])];
+		auto it = mappings_.find(buffer);
+		if (it == mappings_.end() or payload.data.size() < sizeof(uint64_t))
+			return;
+		uint64_t offset = 0;
+		std::memcpy(&offset, payload.data.data(), sizeof(uint64_t));
+		std::memcpy(it->second.pointer + (offset - it->second.offset), payload.data.data() + sizeof(uint64_t), payload.data.size() - sizeof(uint64_t));
+	}
+
+	void trackState(const GLTraceFunctionInfo& info, const GLTraceCall& call, const std::vector<uint64_t>& args, uint64_t returnValue, const std::vector<std::vector<GLuint>>& nameArrays) {
+		switch (info.special) {
+		case GLTraceSpecial::UseProgram:
+			currentProgram_ = fromTraceBits<GLuint>(args[0]);
+			break;
+		case GLTraceSpecial::BindBuffer:
+			boundBuffers_[fromTraceBits<GLenum>(args[0])] = fromTraceBits<GLuint>(args[1]);
+			break;
+		case GLTraceSpecial::BindBufferIndexed:
+			boundBuffers_[fromTraceBits<GLenum>(args[0])] = fromTraceBits<GLuint>(args[2]);
+			break;
+		case GLTraceSpecial::MapBufferRange:
+			mappings_[boundBuffers_[fromTraceBits<GLenum>(args[0])]] = {fromTraceBits<std::byte*>(returnValue), fromTraceBits<GLintptr>(args[1])};
+			break;
+		case GLTraceSpecial::MapBuffer:
+			mappings_[boundBuffers_[fromTraceBits<GLenum>(args[0])]] = {fromTraceBits<std::byte*>(returnValue), 0};
+			break;
+		case GLTraceSpecial::UnmapBuffer:
+			mappings_.erase(boundBuffers_[fromTraceBits<GLenum>(args[0])]);
+			break;
+		case GLTraceSpecial::DeleteSync:
+			syncs_.erase(call.args[0]);
+			break;
+		case GLTraceSpecial::GenNames: {
+			const GLTracePayload* payload = call.findPayload(1);
+			if (payload == nullptr or nameArrays.empty())
+				break;
+			for (size_t i = 0; i < nameArrays[0].size(); i++) {
+				GLuint recorded = 0;
+				std::memcpy(&recorded, payload->data.data() + i * sizeof(GLuint), sizeof(GLuint));
+				rememberName(info.arrayKind, recorded, nameArrays[0][i], args);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	struct UniformKeyHash
+	{
+		size_t operator()(const std::pair<GLuint, GLint>& key) const {
+			return std::hash<uint64_t>()((uint64_t)key.first << 32 | (uint32_t)key.second);
+		}
+	};
+
+	std::vector<const GLTraceFunctionInfo*> functions_;
+	std::vector<int> callCounts_;
+	int numSkippedCalls_ = 0;
+	int numRenamedObjects_ = 0;
+
+	GLuint defaultFramebuffer_ = 0;
+	GLuint currentProgram_ = 0;
+	std::array<std::unordered_map<GLuint, GLuint>, (size_t)GLTraceObjectKind::Count> names_;
+	std::unordered_map<std::pair<GLuint, GLint>, GLint, UniformKeyHash> uniformLocations_;
+	std::unordered_map<uint64_t, uint64_t> syncs_;
+	std::unordered_map<GLenum, GLuint> boundBuffers_;
+	std::unordered_map<GLuint, Mapping> mappings_;
+};
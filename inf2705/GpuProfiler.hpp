@@ -0,0 +1,282 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <source_location>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "GLResources.hpp"
+
+
+using namespace gl;
+
+
+// Les statistiques d'une portée (scope) sur les dernières trames mesurées, en millisecondes de GPU.
+struct GpuScopeStats
+{
+	std::string name;
+	int depth = 0; // Niveau d'imbrication de la portée (0 = au niveau de la trame).
+	float lastMs = 0;
+	float minMs = 0;
+	float avgMs = 0;
+	float p99Ms = 0;
+	int numSamples = 0;
+};
+
+// Un profileur du temps GPU par portée (passe de rendu, calcul, etc.).
+// Mesurer le temps du GPU avec une horloge du CPU ne veut rien dire : les commandes OpenGL sont seulement mises en file, le GPU les exécute plus tard. On demande plutôt au GPU d'écrire son horloge (glQueryCounter avec GL_TIMESTAMP) au début et à la fin de chaque portée. Contrairement à GL_TIME_ELAPSED, les estampilles peuvent s'imbriquer.
+// Lire le résultat d'une requête tout de suite bloquerait jusqu'à ce que le GPU l'ait atteinte. On garde donc un anneau de requêtes sur plusieurs trames et on lit les résultats d'une trame quelques trames plus tard, quand ils sont disponibles.
+class GpuProfiler
+{
+public:
+	// numFramesLate : nombre de trames entre la mesure et la lecture. windowSize : nombre de trames gardées pour min/moy/p99. Les requêtes, créées au besoin, sont attribuées à `where` dans le registre des ressources.
+	void setup(int numFramesLate = 4, int windowSize = 240, std::source_location where = std::source_location::current()) {
+		deleteObjects();
+		where_ = where;
+		frames_.assign(numFramesLate, {});
+		windowSize_ = windowSize;
+		currentFrame_ = 0;
+	}
+
+	// Afficher les statistiques dans la console toutes les `numFrames` trames (0 pour ne jamais le faire).
+	void setReportInterval(int numFrames) { reportInterval_ = numFrames; }
+	// Ajouter aussi une ligne par portée dans un fichier CSV à chaque rapport (chemin vide pour arrêter).
+	void setCsvFile(const std::string& path) {
+		csvPath_ = path;
+		csvHeaderWritten_ = false;
+	}
+
+	// À appeler au début de chaque trame, avant la première portée. Lit les résultats de la trame qui réutilise la case de l'anneau.
+	void beginFrame() {
+		if (frames_.empty())
+			setup();
+		frameNumber_++;
+		currentFrame_ = (currentFrame_ + 1) % (int)frames_.size();
+		FrameQueries& frame = frames_[currentFrame_];
+		collect(frame);
+		frame.numUsedQueries = 0;
+		frame.markers.clear();
+		openMarkers_.clear();
+
+		if (reportInterval_ > 0 and frameNumber_ % reportInterval_ == 0) {
+			print(std::cout);
+			if (not csvPath_.empty())
+				appendCsv();
+		}
+	}
+
+	void begin(const std::string& name) {
+		if (frames_.empty())
+			setup();
+		FrameQueries& frame = frames_[currentFrame_];
+		Marker marker = {getScopeIndex(name), issueTimestamp(frame), -1};
+		openMarkers_.push_back((int)frame.markers.size());
+		frame.markers.push_back(marker);
+	}
+
+	void end() {
+		if (openMarkers_.empty()) {
+			std::cerr << "GpuProfiler: end() sans begin()" << std::endl;
+			return;
+		}
+		FrameQueries& frame = frames_[currentFrame_];
+		frame.markers[openMarkers_.back()].endQuery = issueTimestamp(frame);
+		openMarkers_.pop_back();
+	}
+
+	// Les portées, dans l'ordre où on les a vues la première fois.
+	const std::vector<GpuScopeStats>& getStats() const { return stats_; }
+
+	const GpuScopeStats* getStats(const std::string& name) const {
+		auto it = scopeIndices_.find(name);
+		return it != scopeIndices_.end() ? &stats_[it->second] : nullptr;
+	}
+
+	// Trames dont les résultats n'étaient pas encore prêts (on les saute plutôt que d'attendre).
+	int getNumDroppedFrames() const { return numDroppedFrames_; }
+
+	void print(std::ostream& out) const {
+		out << std::format("{:<24} {:>8} {:>8} {:>8} {:>8}", "GPU (ms)", "dernier", "min", "moy", "p99") << "\n";
+		for (auto&& scope : stats_) {
+			std::string name = std::string(scope.depth * 2, ' ') + scope.name;
+			out << std::format("{:<24} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f}", name, scope.lastMs, scope.minMs, scope.avgMs, scope.p99Ms) << "\n";
+		}
+		out << std::flush;
+	}
+
+	void deleteObjects() {
+		for (auto&& frame : frames_) {
+			if (not frame.queries.empty()) {
+				glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+				glResources.untrack(GLResourceType::Query, (GLsizei)frame.queries.size(), frame.queries.data());
+			}
+			frame = {};
+		}
+		openMarkers_.clear();
+	}
+
+private:
+	struct Marker
+	{
+		int scopeIndex = 0;
+		int beginQuery = -1;
+		int endQuery = -1;
+	};
+
+	// Les requêtes d'une case de l'anneau. On en crée de nouvelles seulement quand une trame a plus de portées que les précédentes.
+	struct FrameQueries
+	{
+		std::vector<GLuint> queries;
+		int numUsedQueries = 0;
+		std::vector<Marker> markers;
+	};
+
+	// Les dernières mesures d'une portée, dans un anneau de windowSize_ cases.
+	struct Samples
+	{
+		std::vector<float> values;
+		int next = 0;
+	};
+
+	int issueTimestamp(FrameQueries& frame) {
+		if (frame.numUsedQueries == (int)frame.queries.size()) {
+			GLuint query = 0;
+			glGenQueries(1, &query);
+			glResources.track(GLResourceType::Query, query, "GpuProfiler", where_);
+			frame.queries.push_back(query);
+		}
+		int index = frame.numUsedQueries++;
+		glQueryCounter(frame.queries[index], GL_TIMESTAMP);
+		return index;
+	}
+
+	int getScopeIndex(const std::string& name) {
+		auto [it, isNew] = scopeIndices_.try_emplace(name, (int)stats_.size());
+		if (isNew) {
+			stats_.push_back({name, (int)openMarkers_.size()});
+			samples_.emplace_back();
+		}
+		return it->second;
+	}
+
+	void collect(const FrameQueries& frame) {
+		if (frame.numUsedQueries == 0)
+			return;
+
+		// Les requêtes se terminent dans l'ordre, donc si la dernière est prête, toutes les autres le sont.
+		GLint isAvailable = 0;
+		glGetQueryObjectiv(frame.queries[frame.numUsedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+		if (not isAvailable) {
+			numDroppedFrames_++;
+			return;
+		}
+
+		// Une portée peut apparaître plusieurs fois dans une trame : on additionne ses durées.
+		std::vector<double> frameMs(stats_.size(), -1.0);
+		for (auto&& marker : frame.markers) {
+			if (marker.endQuery < 0)
+				continue;
+			GLuint64 beginNs = 0;
+			GLuint64 endNs = 0;
+			glGetQueryObjectui64v(frame.queries[marker.beginQuery], GL_QUERY_RESULT, &beginNs);
+			glGetQueryObjectui64v(frame.queries[marker.endQuery], GL_QUERY_RESULT, &endNs);
+			double& total = frameMs[marker.scopeIndex];
+			total = std::max(total, 0.0) + (endNs - beginNs) / 1e6;
+		}
+		for (size_t i = 0; i < frameMs.size(); i++) {
+			if (frameMs[i] >= 0)
+				addSample((int)i, (float)frameMs[i]);
+		}
+	}
+
+	void addSample(int scopeIndex, float ms) {
+		Samples& samples = samples_[scopeIndex];
+		if ((int)samples.values.size() < windowSize_)
+			samples.values.push_back(ms);
+		else
+			samples.values[samples.next] = ms;
+		samples.next = (samples.next + 1) % windowSize_;
+
+		GpuScopeStats& stats = stats_[scopeIndex];
+		stats.lastMs = ms;
+		stats.numSamples = (int)samples.values.size();
+		stats.minMs = *std::min_element(samples.values.begin(), samples.values.end());
+		double sum = 0;
+		for (float value : samples.values)
+			sum += value;
+		stats.avgMs = (float)(sum / samples.values.size());
+		// Le 99e centile : la valeur sous laquelle se trouvent 99 % des mesures. nth_element évite de tout trier.
+		sortedScratch_ = samples.values;
+		size_t p99Index = (sortedScratch_.size() - 1) * 99 / 100;
+		std::nth_element(sortedScratch_.begin(), sortedScratch_.begin() + p99Index, sortedScratch_.end());
+		stats.p99Ms = sortedScratch_[p99Index];
+	}
+
+	void appendCsv() {
+		std::ofstream file(csvPath_, csvHeaderWritten_ ? std::ios::app : std::ios::trunc);
+		if (not file) {
+			std::cerr << "GpuProfiler: impossible d'écrire dans " << csvPath_ << std::endl;
+			return;
+		}
+		if (not csvHeaderWritten_) {
+			file << "frame,scope,depth,last_ms,min_ms,avg_ms,p99_ms,samples" << "\n";
+			csvHeaderWritten_ = true;
+		}
+		for (auto&& scope : stats_) {
+			file << std::format("{},{},{},{:.4f},{:.4f},{:.4f},{:.4f},{}",
+				frameNumber_, scope.name, scope.depth, scope.lastMs, scope.minMs, scope.avgMs, scope.p99Ms, scope.numSamples
+			) << "\n";
+		}
+	}
+
+	std::vector<FrameQueries> frames_;
+	int currentFrame_ = 0;
+	std::source_location where_;
+	int frameNumber_ = 0;
+	std::vector<int> openMarkers_; // Index (dans la trame courante) des portées commencées mais pas terminées.
+
+	std::unordered_map<std::string, int> scopeIndices_;
+	std::vector<GpuScopeStats> stats_;
+	std::vector<Samples> samples_;
+	std::vector<float> sortedScratch_;
+	int windowSize_ = 240;
+	int numDroppedFrames_ = 0;
+
+	int reportInterval_ = 0;
+	std::string csvPath_;
+	bool csvHeaderWritten_ = false;
+};
+
+// Une portée mesurée par le profileur, de la construction jusqu'à la fin du bloc.
+//   {
+//       GpuProfileScope scope(profiler, "Miroir");
+//       ... dessins ...
+//   }
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler& profiler, const std::string& name)
+	: profiler_(profiler) {
+		profiler_.begin(name);
+	}
+
+	~GpuProfileScope() {
+		profiler_.end();
+	}
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler& profiler_;
+};
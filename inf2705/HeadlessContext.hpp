@@ -0,0 +1,153 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <glbinding/Binding.h>
+#include <SFML/Window.hpp>
+
+// Avec INF2705_HEADLESS_EGL (option CMake du même nom, Linux seulement), le contexte est créé avec EGL, sans fenêtre ni serveur d'affichage. Ça fonctionne aussi avec le rendu logiciel de Mesa (llvmpipe), donc sur une machine d'intégration continue ou un nœud de rendu.
+#ifdef INF2705_HEADLESS_EGL
+	#include <EGL/egl.h>
+	#include <EGL/eglext.h>
+#endif
+
+
+// Un contexte OpenGL sans fenêtre visible, pour le mode sans fenêtre (headless) d'OpenGLApplication. Comme il n'y a pas de tampon de fenêtre, l'application dessine dans un FBO.
+// Sans EGL, on se rabat sur un sf::Context. SFML crée alors son contexte caché habituel, ce qui demande quand même un serveur d'affichage sur Linux (Xvfb fait l'affaire).
+class HeadlessContext
+{
+public:
+	HeadlessContext() = default;
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	~HeadlessContext() {
+		destroy();
+	}
+
+	bool create(const sf::ContextSettings& settings) {
+		settings_ = settings;
+		#ifdef INF2705_HEADLESS_EGL
+			return createEgl();
+		#else
+			context_ = std::make_unique<sf::Context>(settings, sf::Vector2u(1, 1));
+			settings_ = context_->getSettings();
+			return context_->setActive(true);
+		#endif
+	}
+
+	// Initialiser glbinding avec la bonne fonction de résolution d'adresses.
+	void initializeGLBinding() const {
+		#ifdef INF2705_HEADLESS_EGL
+			glbinding::Binding::initialize([](const char* name) {
+				return reinterpret_cast<glbinding::ProcAddress>(eglGetProcAddress(name));
+			}, true);
+		#else
+			// Comme pour la fenêtre, glbinding trouve lui-même les fonctions du contexte courant.
+			glbinding::Binding::initialize(nullptr, true);
+		#endif
+	}
+
+	// Les paramètres réellement obtenus (version, profil). Les bits de profondeur et de stencil sont ceux du FBO, pas du contexte.
+	const sf::ContextSettings& getSettings() const { return settings_; }
+
+	std::string getBackendName() const {
+		#ifdef INF2705_HEADLESS_EGL
+			return "EGL";
+		#else
+			return "sf::Context";
+		#endif
+	}
+
+	void destroy() {
+		#ifdef INF2705_HEADLESS_EGL
+			if (display_ != EGL_NO_DISPLAY) {
+				eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+				if (context_ != EGL_NO_CONTEXT)
+					eglDestroyContext(display_, context_);
+				if (surface_ != EGL_NO_SURFACE)
+					eglDestroySurface(display_, surface_);
+				eglTerminate(display_);
+			}
+			display_ = EGL_NO_DISPLAY;
+			context_ = EGL_NO_CONTEXT;
+			surface_ = EGL_NO_SURFACE;
+		#else
+			context_.reset();
+		#endif
+	}
+
+private:
+	#ifdef INF2705_HEADLESS_EGL
+	bool createEgl() {
+		// Mesa offre une plateforme « surfaceless » : un contexte sans aucune surface, ce qui est exactement ce qu'on veut. Sinon, on prend l'affichage par défaut avec un petit pbuffer.
+		auto eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (eglGetPlatformDisplayEXT != nullptr)
+			display_ = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display_ == EGL_NO_DISPLAY)
+			display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		EGLint major = 0;
+		EGLint minor = 0;
+		if (display_ == EGL_NO_DISPLAY or not eglInitialize(display_, &major, &minor)) {
+			std::cerr << "EGL: impossible d'initialiser l'affichage" << std::endl;
+			return false;
+		}
+
+		const EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+			EGL_NONE
+		};
+		EGLConfig config = nullptr;
+		EGLint numConfigs = 0;
+		if (not eglChooseConfig(display_, configAttribs, &config, 1, &numConfigs) or numConfigs == 0) {
+			std::cerr << "EGL: aucune configuration OpenGL" << std::endl;
+			return false;
+		}
+		eglBindAPI(EGL_OPENGL_API);
+
+		bool isCore = (settings_.attributeFlags & sf::ContextSettings::Core) != 0;
+		bool isDebug = (settings_.attributeFlags & sf::ContextSettings::Debug) != 0;
+		const EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, (EGLint)settings_.majorVersion,
+			EGL_CONTEXT_MINOR_VERSION, (EGLint)settings_.minorVersion,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, isCore ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+			EGL_CONTEXT_OPENGL_DEBUG, isDebug ? EGL_TRUE : EGL_FALSE,
+			EGL_NONE
+		};
+		context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, contextAttribs);
+		if (context_ == EGL_NO_CONTEXT) {
+			std::cerr << "EGL: impossible de créer un contexte OpenGL " << settings_.majorVersion << "." << settings_.minorVersion << std::endl;
+			return false;
+		}
+
+		// Sans l'extension surfaceless, il faut une surface pour rendre le contexte courant. On ne dessine jamais dedans.
+		const char* extensions = eglQueryString(display_, EGL_EXTENSIONS);
+		bool isSurfaceless = extensions != nullptr and std::string(extensions).find("EGL_KHR_surfaceless_context") != std::string::npos;
+		if (not isSurfaceless) {
+			const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+			surface_ = eglCreatePbufferSurface(display_, config, pbufferAttribs);
+		}
+		if (not eglMakeCurrent(display_, surface_, surface_, context_)) {
+			std::cerr << "EGL: impossible de rendre le contexte courant" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	EGLDisplay display_ = EGL_NO_DISPLAY;
+	EGLContext context_ = EGL_NO_CONTEXT;
+	EGLSurface surface_ = EGL_NO_SURFACE;
+	#else
+	std::unique_ptr<sf::Context> context_;
+	#endif
+
+	sf::ContextSettings settings_;
+};
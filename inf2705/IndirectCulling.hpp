@@ -0,0 +1,457 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <iostream>
+#include <source_location>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+#include "BufferLayout.hpp"
+#include "GLStateCache.hpp"
+#include "Mesh.hpp"
+#include "ShaderProgram.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// La struct que lit glMultiDrawElementsIndirect (et glDrawElementsIndirect) pour chaque dessin. L'ordre et les types des membres sont imposés par OpenGL.
+struct DrawElementsIndirectCommand
+{
+	GLuint count;         // Nombre d'indices.
+	GLuint instanceCount; // Nombre d'instances (0 = rien à dessiner).
+	GLuint firstIndex;    // Premier indice dans le tampon d'indices.
+	GLint baseVertex;     // Ajouté à chaque indice.
+	GLuint baseInstance;  // Première instance lue dans les attributs qui ont un diviseur.
+};
+
+// Une sphère englobante. C'est moins serré qu'une boîte, mais le test contre un plan est un seul produit scalaire.
+struct BoundingSphere
+{
+	vec3 center = {};
+	float radius = 0;
+
+	// Sphère centrée sur la boîte englobante des sommets.
+	static BoundingSphere fromVertices(const std::vector<VertexData>& vertices) {
+		if (vertices.empty())
+			return {};
+		vec3 minPos = vertices[0].position;
+		vec3 maxPos = vertices[0].position;
+		for (auto&& v : vertices) {
+			minPos = min(minPos, v.position);
+			maxPos = max(maxPos, v.position);
+		}
+		BoundingSphere result = {(minPos + maxPos) / 2.0f, 0};
+		for (auto&& v : vertices)
+			result.radius = std::max(result.radius, distance(result.center, v.position));
+		return result;
+	}
+
+	// La sphère après une transformation. Avec une mise à l'échelle non uniforme, on prend le plus grand facteur pour qu'elle reste englobante.
+	BoundingSphere transformed(const mat4& m) const {
+		float scale = std::max({length(vec3(m[0])), length(vec3(m[1])), length(vec3(m[2]))});
+		return {vec3(m * vec4(center, 1)), radius * scale};
+	}
+};
+
+// Les six plans du volume de visualisation. Un plan est (a, b, c, d) avec la normale (a, b, c) vers l'intérieur, donc un point p est du bon côté si dot(abc, p) + d >= 0.
+struct Frustum
+{
+	std::array<vec4, 6> planes = {};
+
+	// Extraction des plans à partir de la matrice projection * vue (méthode de Gribb et Hartmann). Les plans sont en coordonnées de monde si la matrice ne contient pas la modélisation.
+	static Frustum fromMatrix(const mat4& viewProjection) {
+		// glm est en colonnes majeures, donc la rangée i est (m[0][i], m[1][i], m[2][i], m[3][i]).
+		auto row = [&](int i) { return vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]); };
+		Frustum result;
+		result.planes = {
+			row(3) + row(0), // Gauche
+			row(3) - row(0), // Droite
+			row(3) + row(1), // Bas
+			row(3) - row(1), // Haut
+			row(3) + row(2), // Avant (near)
+			row(3) - row(2), // Arrière (far)
+		};
+		// Normaliser pour que dot(abc, p) + d soit une vraie distance, comparable au rayon d'une sphère.
+		for (auto&& plane : result.planes)
+			plane /= length(vec3(plane));
+		return result;
+	}
+
+	bool intersectsSphere(const BoundingSphere& sphere) const {
+		for (auto&& plane : planes) {
+			if (dot(vec3(plane), sphere.center) + plane.w < -sphere.radius)
+				return false;
+		}
+		return true;
+	}
+};
+
+// Où se trouve un mesh dans un MeshPack.
+struct MeshRange
+{
+	GLuint numIndices = 0;
+	GLuint firstIndex = 0;
+	GLint baseVertex = 0;
+	BoundingSphere bounds; // Dans le référentiel du mesh.
+};
+
+// Plusieurs mesh mis bout à bout dans les mêmes VBO et EBO. Avec un seul VAO pour tous, un seul appel glMultiDrawElementsIndirect peut dessiner des objets de mesh différents.
+struct MeshPack
+{
+	Mesh mesh;
+	std::vector<MeshRange> ranges;
+
+	// Ajouter une copie des données du mesh et retourner son index dans le pack. Il faut appeler setup() après avoir tout ajouté.
+	uint32_t add(const Mesh& source) {
+		MeshRange range;
+		range.baseVertex = (GLint)mesh.vertices.size();
+		range.firstIndex = (GLuint)mesh.indices.size();
+		range.bounds = BoundingSphere::fromVertices(source.vertices);
+
+		mesh.vertices.insert(mesh.vertices.end(), source.vertices.begin(), source.vertices.end());
+		// Les indices sont relatifs au début du mesh (baseVertex les décale). Un mesh sans indices en reçoit des triviaux.
+		if (not source.indices.empty()) {
+			mesh.indices.insert(mesh.indices.end(), source.indices.begin(), source.indices.end());
+		} else {
+			for (GLuint i = 0; i < (GLuint)source.vertices.size(); i++)
+				mesh.indices.push_back(i);
+		}
+		range.numIndices = (GLuint)mesh.indices.size() - range.firstIndex;
+
+		ranges.push_back(range);
+		return (uint32_t)ranges.size() - 1;
+	}
+
+	void setup() { mesh.setup(GL_STATIC_DRAW, "MeshPack"); }
+	void deleteObjects() { mesh.deleteObjects(); }
+};
+
+// Un objet à éliminer ou dessiner : quel mesh du pack et ses données d'instance.
+struct CullingObject
+{
+	uint32_t meshIndex = 0;
+	InstanceData instance = {};
+};
+
+// La sphère englobante (dans le monde) telle que lue par le nuanceur de calcul.
+struct CullingBounds
+{
+	vec4 sphere;  // Centre (xyz) et rayon (w).
+	uint32_t meshIndex;
+	uint32_t padding[3]; // En std430, un tableau de struct qui contient un vec4 a un pas de 16 octets.
+};
+DECLARE_BLOCK_LAYOUT(BufferLayout::Std430, CullingBounds, sphere, meshIndex, padding);
+
+// Le nuanceur de calcul ne voit InstanceData que comme une suite de mots de 32 bits (on ne fait que la copier). Il faut changer wordsPerInstance dans cullComputeSource si la struct change.
+static_assert(sizeof(InstanceData) == 21 * 4);
+
+// Statistiques de la dernière élimination.
+struct CullingStats
+{
+	int numObjects = 0;
+	int numVisible = -1; // -1 si l'élimination a été faite sur le GPU (on ne relit pas le résultat).
+	int numDrawCommands = 0;
+};
+
+// Élimination des objets hors du volume de visualisation, faite sur le GPU, suivie du dessin de tous les objets visibles sans intervention du CPU.
+// Chaque trame :
+//   1. On remet à zéro le nombre d'instances des commandes de dessin (une par mesh du pack, une vingtaine d'octets chacune).
+//   2. Un nuanceur de calcul teste chaque objet contre les plans du volume de visualisation. Les survivants sont copiés de façon compacte dans le tampon d'instances du mesh, dans la zone réservée à leur mesh (baseInstance), et le nombre d'instances de la commande est incrémenté atomiquement.
+//   3. glMultiDrawElementsIndirect lit directement les commandes dans le GL_DRAW_INDIRECT_BUFFER.
+// Le CPU ne fait donc qu'un nombre constant d'appels, peu importe le nombre d'objets, et ne relit jamais le résultat.
+// Le nuanceur de calcul et glMultiDrawElementsIndirect demandent OpenGL 4.3. Le nuanceur voit aussi tous les objets d'un coup dans des tampons de stockage (SSBO), qui ne peuvent pas dépasser GL_MAX_SHADER_STORAGE_BLOCK_SIZE (au moins 16 Mo, soit environ 200 000 objets). Sinon (ou si on le demande avec setUseGpu(false)), la même élimination est faite sur le CPU. Le résultat est alors envoyé dans les mêmes tampons quand le dessin indirect est disponible, ou dessiné avec un glDrawElementsInstancedBaseVertex par mesh sous OpenGL 4.1.
+class IndirectCuller
+{
+public:
+	static constexpr GLuint workGroupSize = 64;
+
+	bool isGpuCullingSupported() const { return isGpuCullingSupported_; }
+	// Faux si les objets de setObjects ne tiennent pas dans un tampon de stockage : l'élimination se fait alors sur le CPU.
+	bool fitsInStorageBlocks() const { return fitsInStorageBlocks_; }
+	bool isUsingGpu() const { return useGpu_ and isGpuCullingSupported_ and fitsInStorageBlocks_; }
+	void setUseGpu(bool useGpu) { useGpu_ = useGpu; }
+	const CullingStats& getLastStats() const { return stats_; }
+
+	// Le pack doit déjà avoir été configuré (MeshPack::setup). Son mesh reçoit le tampon d'instances.
+	void setup(MeshPack& pack, std::source_location where = std::source_location::current()) {
+		pack_ = &pack;
+		isGpuCullingSupported_ = isGLVersionAtLeast(4, 3);
+		if (isGpuCullingSupported_) {
+			cullProg_.attachSource(GL_COMPUTE_SHADER, cullComputeSource, "IndirectCuller (nuanceur de calcul)");
+			cullProg_.link();
+			glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxStorageBlockSize_);
+			glGenBuffers(1, &boundsSsbo_);
+			glGenBuffers(1, &instancesSsbo_);
+			glGenBuffers(1, &indirectBuffer_);
+			glResources.track(GLResourceType::Buffer, boundsSsbo_, "IndirectCuller (sphères englobantes)", where);
+			glResources.track(GLResourceType::Buffer, instancesSsbo_, "IndirectCuller (instances)", where);
+			glResources.track(GLResourceType::Buffer, indirectBuffer_, "IndirectCuller (commandes indirectes)", where);
+		}
+	}
+
+	// Remplacer les objets. Les sphères englobantes sont calculées ici à partir des matrices de modélisation : on suppose que les objets ne bougent pas d'une trame à l'autre (sinon il faut rappeler setObjects).
+	void setObjects(const std::vector<CullingObject>& objects) {
+		size_t numObjects = objects.size();
+		size_t numMeshes = pack_->ranges.size();
+
+		// Chaque mesh reçoit une zone du tampon d'instances assez grande pour que tous ses objets soient visibles.
+		std::vector<GLuint> objectsPerMesh(numMeshes, 0);
+		for (auto&& obj : objects)
+			objectsPerMesh[obj.meshIndex]++;
+		commandTemplate_.resize(numMeshes);
+		GLuint baseInstance = 0;
+		for (size_t m = 0; m < numMeshes; m++) {
+			auto& range = pack_->ranges[m];
+			commandTemplate_[m] = {range.numIndices, 0, range.firstIndex, range.baseVertex, baseInstance};
+			baseInstance += objectsPerMesh[m];
+		}
+
+		bounds_.resize(numObjects);
+		instances_.resize(numObjects);
+		for (size_t i = 0; i < numObjects; i++) {
+			auto& obj = objects[i];
+			BoundingSphere sphere = pack_->ranges[obj.meshIndex].bounds.transformed(obj.instance.model);
+			bounds_[i] = {vec4(sphere.center, sphere.radius), obj.meshIndex, {}};
+			instances_[i] = obj.instance;
+		}
+		visibleInstances_.resize(numObjects);
+		commands_ = commandTemplate_;
+
+		// Réserver le tampon d'instances du mesh (les attributs 4 à 9 sont configurés en même temps).
+		pack_->mesh.bindVao();
+		pack_->mesh.updateInstanceBuffer(instances_.data(), numObjects);
+
+		if (isGpuCullingSupported_) {
+			// Le plus gros bloc que le nuanceur de calcul lit ou écrit : les instances (en entrée, et le tampon d'instances du mesh en sortie).
+			GLint64 largestBlockSize = (GLint64)(numObjects * sizeof(InstanceData));
+			fitsInStorageBlocks_ = largestBlockSize <= maxStorageBlockSize_;
+			if (not fitsInStorageBlocks_) {
+				std::cerr << std::format(
+					"IndirectCuller: {} objets demandent un tampon de stockage de {:.1f} Mo (maximum {:.1f} Mo), élimination sur le CPU",
+					numObjects, largestBlockSize / 1e6, maxStorageBlockSize_ / 1e6
+				) << std::endl;
+			}
+			// Les sphères et les instances d'entrée ne servent qu'au nuanceur de calcul.
+			size_t numSsboObjects = fitsInStorageBlocks_ ? numObjects : 0;
+			glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, boundsSsbo_);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, numSsboObjects * sizeof(CullingBounds), bounds_.data(), GL_STATIC_DRAW);
+			glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, instancesSsbo_);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, numSsboObjects * sizeof(InstanceData), instances_.data(), GL_STATIC_DRAW);
+			glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, numMeshes * sizeof(DrawElementsIndirectCommand), commandTemplate_.data(), GL_DYNAMIC_DRAW);
+			glResources.setSize(GLResourceType::Buffer, boundsSsbo_, numSsboObjects * sizeof(CullingBounds));
+			glResources.setSize(GLResourceType::Buffer, instancesSsbo_, numSsboObjects * sizeof(InstanceData));
+			glResources.setSize(GLResourceType::Buffer, indirectBuffer_, numMeshes * sizeof(DrawElementsIndirectCommand));
+		}
+
+		stats_ = {(int)numObjects, -1, (int)numMeshes};
+	}
+
+	// Éliminer les objets invisibles pour la matrice projection * vue donnée.
+	void cull(const mat4& viewProjection) {
+		Frustum frustum = Frustum::fromMatrix(viewProjection);
+		if (isUsingGpu())
+			cullOnGpu(frustum);
+		else
+			cullOnCpu(frustum);
+	}
+
+	// Dessiner les objets visibles avec le programme présentement utilisé (son nuanceur de sommets lit les attributs de InstanceData).
+	void draw() {
+		Mesh& mesh = pack_->mesh;
+		mesh.bindVao();
+		mesh.bindEbo();
+
+		if (isGpuCullingSupported_) {
+			glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)commands_.size(), 0);
+			return;
+		}
+
+		// OpenGL 4.1 : pas de baseInstance. On envoie donc les instances de chaque mesh au début du tampon avant son dessin.
+		for (auto&& cmd : commands_) {
+			if (cmd.instanceCount == 0)
+				continue;
+			mesh.updateInstanceBuffer(&visibleInstances_[cmd.baseInstance], cmd.instanceCount);
+			glDrawElementsInstancedBaseVertex(
+				GL_TRIANGLES,
+				(GLsizei)cmd.count,
+				GL_UNSIGNED_INT,
+				(const void*)(cmd.firstIndex * sizeof(GLuint)),
+				(GLsizei)cmd.instanceCount,
+				cmd.baseVertex
+			);
+		}
+	}
+
+	// Comparer le résultat du GPU à celui du CPU pour la même matrice. Ça relit les commandes (et attend donc le GPU) : c'est pour le débogage seulement.
+	bool validate(const mat4& viewProjection) {
+		if (not isGpuCullingSupported_ or not fitsInStorageBlocks_)
+			return true;
+
+		Frustum frustum = Frustum::fromMatrix(viewProjection);
+		cullOnGpu(frustum);
+		std::vector<DrawElementsIndirectCommand> gpuCommands(commands_.size());
+		glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_);
+		glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, gpuCommands.size() * sizeof(DrawElementsIndirectCommand), gpuCommands.data());
+
+		computeVisibleOnCpu(frustum);
+		bool ok = true;
+		for (size_t m = 0; m < commands_.size(); m++) {
+			if (gpuCommands[m].instanceCount != commands_[m].instanceCount) {
+				std::cerr << std::format(
+					"IndirectCuller: mesh {} : {} objets visibles selon le GPU, {} selon le CPU",
+					m, gpuCommands[m].instanceCount, commands_[m].instanceCount
+				) << std::endl;
+				ok = false;
+			}
+		}
+		// Les tampons contiennent toujours le résultat du GPU, c'est lui que draw() va utiliser.
+		commands_ = gpuCommands;
+		return ok;
+	}
+
+	void deleteObjects() {
+		cullProg_.deleteShaders();
+		cullProg_.deleteProgram();
+		glState.deleteBuffers(1, &boundsSsbo_);
+		glState.deleteBuffers(1, &instancesSsbo_);
+		glState.deleteBuffers(1, &indirectBuffer_);
+		boundsSsbo_ = instancesSsbo_ = indirectBuffer_ = 0;
+	}
+
+private:
+	void cullOnGpu(const Frustum& frustum) {
+		// Remettre les compteurs d'instances à zéro. C'est une petite copie (une commande par mesh), pas une copie par objet.
+		glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commandTemplate_.size() * sizeof(DrawElementsIndirectCommand), commandTemplate_.data());
+
+		cullProg_.use();
+		glUniform4fv(cullProg_.getUniformLocation("frustumPlanes"), 6, &frustum.planes[0].x);
+		cullProg_.setUint("numObjects", (GLuint)bounds_.size());
+		glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boundsSsbo_);
+		glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, instancesSsbo_);
+		glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, pack_->mesh.instanceVbo);
+		glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, indirectBuffer_);
+
+		GLuint numGroups = ((GLuint)bounds_.size() + workGroupSize - 1) / workGroupSize;
+		if (numGroups > 0)
+			glDispatchCompute(numGroups, 1, 1);
+		// Les écritures du nuanceur de calcul doivent être visibles par la lecture des commandes et des attributs d'instances.
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+		stats_.numVisible = -1;
+	}
+
+	void cullOnCpu(const Frustum& frustum) {
+		computeVisibleOnCpu(frustum);
+
+		// Avec le dessin indirect, on envoie le résultat dans les mêmes tampons que le nuanceur de calcul aurait remplis.
+		if (isGpuCullingSupported_) {
+			glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_);
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawElementsIndirectCommand), commands_.data());
+			// Seulement les instances visibles de chaque mesh, au début de sa zone : le reste de la zone n'est pas lu par la commande. Envoyer tout visibleInstances_ coûterait la bande passante de la scène entière à chaque trame.
+			glState.bindBuffer(GL_ARRAY_BUFFER, pack_->mesh.instanceVbo);
+			for (auto&& cmd : commands_) {
+				if (cmd.instanceCount == 0)
+					continue;
+				glBufferSubData(GL_ARRAY_BUFFER, cmd.baseInstance * sizeof(InstanceData), cmd.instanceCount * sizeof(InstanceData), &visibleInstances_[cmd.baseInstance]);
+			}
+		}
+	}
+
+	// Le même algorithme que le nuanceur de calcul.
+	void computeVisibleOnCpu(const Frustum& frustum) {
+		commands_ = commandTemplate_;
+		int numVisible = 0;
+		for (size_t i = 0; i < bounds_.size(); i++) {
+			vec4 sphere = bounds_[i].sphere;
+			if (not frustum.intersectsSphere({vec3(sphere), sphere.w}))
+				continue;
+			auto& cmd = commands_[bounds_[i].meshIndex];
+			visibleInstances_[cmd.baseInstance + cmd.instanceCount] = instances_[i];
+			cmd.instanceCount++;
+			numVisible++;
+		}
+		stats_.numVisible = numVisible;
+	}
+
+	static constexpr const char* cullComputeSource = R"glsl(
+		#version 430
+
+		layout(local_size_x = 64) in;
+
+		struct CullingBounds
+		{
+			vec4 sphere;
+			uint meshIndex;
+			uint padding[3];
+		};
+
+		struct DrawElementsIndirectCommand
+		{
+			uint count;
+			uint instanceCount;
+			uint firstIndex;
+			int baseVertex;
+			uint baseInstance;
+		};
+
+		layout(std430, binding = 0) readonly buffer BoundsBlock { CullingBounds bounds[]; };
+		// Les InstanceData, vues comme des mots de 32 bits. On les lit en uint plutôt qu'en float pour copier les bits tels quels (l'ID est un entier).
+		layout(std430, binding = 1) readonly buffer InstancesInBlock { uint instancesIn[]; };
+		layout(std430, binding = 2) writeonly buffer InstancesOutBlock { uint instancesOut[]; };
+		layout(std430, binding = 3) buffer CommandsBlock { DrawElementsIndirectCommand commands[]; };
+
+		uniform vec4 frustumPlanes[6];
+		uniform uint numObjects;
+
+		const uint wordsPerInstance = 21u; // sizeof(InstanceData) / 4
+
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			if (i >= numObjects)
+				return;
+
+			vec4 sphere = bounds[i].sphere;
+			for (int p = 0; p < 6; p++) {
+				if (dot(frustumPlanes[p].xyz, sphere.xyz) + frustumPlanes[p].w < -sphere.w)
+					return;
+			}
+
+			// Réserver une place dans la zone du mesh et y copier l'instance.
+			uint m = bounds[i].meshIndex;
+			uint slot = commands[m].baseInstance + atomicAdd(commands[m].instanceCount, 1u);
+			for (uint w = 0u; w < wordsPerInstance; w++)
+				instancesOut[slot * wordsPerInstance + w] = instancesIn[i * wordsPerInstance + w];
+		}
+	)glsl";
+
+	MeshPack* pack_ = nullptr;
+	bool isGpuCullingSupported_ = false;
+	bool useGpu_ = true;
+	GLint64 maxStorageBlockSize_ = 0;
+	bool fitsInStorageBlocks_ = true;
+	ShaderProgram cullProg_;
+	GLuint boundsSsbo_ = 0;
+	GLuint instancesSsbo_ = 0;
+	GLuint indirectBuffer_ = 0;
+
+	std::vector<CullingBounds> bounds_;
+	std::vector<InstanceData> instances_;
+	std::vector<InstanceData> visibleInstances_; // Résultat de l'élimination sur le CPU.
+	std::vector<DrawElementsIndirectCommand> commandTemplate_; // Commandes avec 0 instance.
+	std::vector<DrawElementsIndirectCommand> commands_;
+	CullingStats stats_;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.hpp"
+#include "Texture.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Un lot d'instances : toutes les copies d'un même mesh (avec la même texture) qui seront dessinées en un seul drawInstanced.
+struct InstanceBatch
+{
+	Mesh* mesh = nullptr;
+	Texture* texture = nullptr; // Liée à l'unité 0 avant le dessin. nullptr = rien à lier.
+	std::vector<InstanceData> instances;
+};
+
+// Collecte les instances de la trame en les regroupant par mesh (et texture), puis les dessine avec un appel par lot.
+// On ajoute les objets avec add() pendant la trame, on appelle draw() avec le programme voulu déjà utilisé (son nuanceur de sommets doit lire les attributs de InstanceData), puis clear() avant la trame suivante.
+// Les lots ne sont pas détruits par clear(), seulement vidés. Les tableaux gardent donc leur mémoire d'une trame à l'autre et on n'alloue plus rien une fois la scène stable.
+class InstanceBuilder
+{
+public:
+	void add(Mesh& mesh, const InstanceData& instance, Texture* texture = nullptr) {
+		BatchKey key = {&mesh, texture};
+		auto it = batchIndices_.find(key);
+		if (it == batchIndices_.end()) {
+			it = batchIndices_.emplace(key, batches_.size()).first;
+			batches_.push_back({&mesh, texture, {}});
+		}
+		batches_[it->second].instances.push_back(instance);
+	}
+
+	void add(Mesh& mesh, const mat4& model, const vec4& color, uint32_t objectID, Texture* texture = nullptr) {
+		add(mesh, InstanceData{model, color, objectID}, texture);
+	}
+
+	// Dessiner tous les lots non vides avec le programme présentement utilisé.
+	void draw(GLenum drawMode = GL_TRIANGLES) {
+		for (auto&& batch : batches_) {
+			if (batch.instances.empty())
+				continue;
+			if (batch.texture != nullptr)
+				batch.texture->bindToTextureUnit(0);
+			batch.mesh->drawInstanced(batch.instances, drawMode);
+		}
+	}
+
+	void clear() {
+		for (auto&& batch : batches_)
+			batch.instances.clear();
+	}
+
+	const std::vector<InstanceBatch>& getBatches() const { return batches_; }
+
+	size_t getNumInstances() const {
+		size_t total = 0;
+		for (auto&& batch : batches_)
+			total += batch.instances.size();
+		return total;
+	}
+
+private:
+	using BatchKey = std::pair<const Mesh*, const Texture*>;
+
+	struct BatchKeyHash
+	{
+		size_t operator()(const BatchKey& key) const {
+			size_t h1 = std::hash<const void*>()(key.first);
+			size_t h2 = std::hash<const void*>()(key.second);
+			return h1 ^ (h2 * 0x9E3779B97F4A7C15ull);
+		}
+	};
+
+	std::vector<InstanceBatch> batches_;
+	std::unordered_map<BatchKey, size_t, BatchKeyHash> batchIndices_;
+};
@@ -0,0 +1,339 @@
+#pragma once
+
+
+#include <cstddef>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Une tâche du système de tâches. On la garde par JobHandle pour attendre sa fin ou en faire dépendre d'autres tâches.
+struct Job
+{
+	std::function<void()> function;
+	// Les tâches qui touchent à OpenGL doivent s'exécuter sur le fil du contexte (voir JobSystem::submitOnMainThread).
+	bool isMainThread = false;
+	// Dépendances pas encore terminées, plus un tant que submit() n'a pas fini d'enregistrer la tâche auprès de ses dépendances.
+	std::atomic<int> numPendingDependencies = 1;
+	std::atomic<bool> isDone = false;
+	// L'exception lancée par function, s'il y en a une. La tâche compte quand même comme terminée (sinon ses continuations et waitIdle attendraient pour toujours) ; JobSystem::wait la relance.
+	std::exception_ptr exception;
+	// Les tâches qui attendent celle-ci. Protégé par mutex, comme isDone au moment de le mettre à vrai.
+	std::vector<std::shared_ptr<Job>> continuations;
+	std::mutex mutex;
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+struct JobSystemStats
+{
+	size_t numExecuted = 0;
+	size_t numStolen = 0; // Tâches prises dans la file d'un autre fil.
+	size_t numMainThread = 0;
+};
+
+// Système de tâches avec vol de travail (work stealing).
+// Chaque fil de travail a sa propre file (deque). Un fil ajoute ses nouvelles tâches au bout de sa file et reprend la plus récente (LIFO : les données qu'elle utilise sont probablement encore dans la cache). Quand sa file est vide, il vole la plus vieille tâche d'une autre file (FIFO : c'est généralement la plus grosse, par exemple la première moitié d'un découpage). Les tâches soumises par un fil qui n'est pas un fil de travail (le fil principal) vont dans une file à part que les fils de travail se partagent de la même façon.
+// Les files sont protégées par un mutex chacune plutôt qu'écrites sans verrou : comme chaque fil passe presque tout son temps dans sa propre file, il y a très peu de contention, et c'est beaucoup plus simple à lire.
+// Un fil qui attend une tâche avec wait() ne fait pas qu'attendre : il exécute d'autres tâches en attendant, ce qui évite de bloquer un fil de travail qui attend une sous-tâche (et permet au fil principal de participer à parallelFor).
+class JobSystem
+{
+public:
+	JobSystem() = default;
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	~JobSystem() {
+		shutdown();
+	}
+
+	// Démarrer les fils de travail. Par défaut, un par cœur moins celui du fil principal, qui participe aux attentes. Avec 0, tout est exécuté par les fils qui attendent (wait, parallelFor).
+	void start(int numWorkers = -1) {
+		shutdown();
+		if (numWorkers < 0)
+			numWorkers = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+		mainThreadId_ = std::this_thread::get_id();
+		queues_ = std::vector<WorkQueue>(numWorkers + 1);
+		isStopping_ = false;
+		isStarted_ = true;
+		for (int i = 1; i <= numWorkers; i++)
+			workers_.emplace_back([this, i] { workerLoop(i); });
+	}
+
+	// Terminer toutes les tâches soumises (celles des fils de travail, puis celles du fil principal), puis arrêter les fils. OpenGLApplication l'appelle après onClose(), pendant que le contexte existe encore. Aucune tâche ne survit donc à l'application.
+	void shutdown() {
+		if (not isStarted_)
+			return;
+		waitIdle();
+		{
+			std::lock_guard lock(sleepMutex_);
+			isStopping_ = true;
+		}
+		hasWork_.notify_all();
+		for (auto&& worker : workers_)
+			worker.join();
+		workers_.clear();
+		runMainThreadJobs();
+		queues_.clear();
+		isStarted_ = false;
+	}
+
+	bool isRunning() const { return isStarted_; }
+
+	int getNumWorkers() const { return (int)workers_.size(); }
+
+	// Soumettre une tâche, exécutée par un fil de travail dès que toutes ses dépendances sont terminées. Ne doit pas toucher à OpenGL.
+	JobHandle submit(std::function<void()> function, const std::vector<JobHandle>& dependencies = {}) {
+		return submitJob(std::move(function), dependencies, false);
+	}
+
+	// Soumettre une tâche exécutée par le fil principal (celui du contexte OpenGL) au début d'une trame, par exemple pour envoyer au GPU des données préparées par une autre tâche.
+	JobHandle submitOnMainThread(std::function<void()> function, const std::vector<JobHandle>& dependencies = {}) {
+		return submitJob(std::move(function), dependencies, true);
+	}
+
+	// Continuation : une tâche qui commence quand `job` est terminée.
+	JobHandle then(const JobHandle& job, std::function<void()> function) {
+		return submit(std::move(function), {job});
+	}
+
+	// Attendre la fin d'une tâche en exécutant d'autres tâches en attendant. Relance l'exception de la tâche, s'il y en a une.
+	// Sur le fil principal, les tâches de submitOnMainThread ne sont exécutées ici que si on attend justement l'une d'elles : sinon, elles feraient leurs appels OpenGL au milieu de la trame (par exemple dans un parallelFor pendant une passe) et pourraient changer le framebuffer, le viewport ou le programme de la passe. Elles attendent alors le début de la trame suivante. Le fil principal ne doit donc pas attendre une tâche ordinaire qui dépend d'une tâche du fil principal pas encore exécutée.
+	void wait(const JobHandle& job) {
+		bool runsMainThreadJobs = job->isMainThread and isMainThread();
+		while (not job->isDone) {
+			if (not runOneJob(runsMainThreadJobs))
+				std::this_thread::yield();
+		}
+		if (job->exception)
+			std::rethrow_exception(job->exception);
+	}
+
+	// Attendre toutes les tâches avant de relancer la première exception : les autres peuvent encore utiliser des variables de l'appelant (le corps d'un parallelFor, par exemple).
+	void wait(const std::vector<JobHandle>& jobs) {
+		std::exception_ptr firstException;
+		for (auto&& job : jobs) {
+			try {
+				wait(job);
+			} catch (...) {
+				if (not firstException)
+					firstException = std::current_exception();
+			}
+		}
+		if (firstException)
+			std::rethrow_exception(firstException);
+	}
+
+	// Attendre que toutes les tâches soumises soient terminées, y compris celles du fil principal (exécutées ici si on est sur ce fil). À appeler entre les trames, pas pendant une passe.
+	void waitIdle() {
+		while (numUnfinished_ > 0) {
+			if (not runOneJob(isMainThread()))
+				std::this_thread::yield();
+		}
+	}
+
+	// Appeler body(i) pour chaque i de [begin, end[, en parallèle et par tranches de grainSize indices (par défaut, environ quatre tranches par fil pour que le vol de travail équilibre les tranches inégales). Retourne quand tout est fait ; le fil appelant exécute aussi des tranches.
+	template <typename Body>
+	void parallelFor(size_t begin, size_t end, Body&& body, size_t grainSize = 0) {
+		if (begin >= end)
+			return;
+		size_t numItems = end - begin;
+		if (not isStarted_)
+			start();
+		if (grainSize == 0)
+			grainSize = std::max<size_t>(numItems / (getNumWorkers() * 4 + 4), 1);
+		if (numItems <= grainSize) {
+			for (size_t i = begin; i < end; i++)
+				body(i);
+			return;
+		}
+		std::vector<JobHandle> chunks;
+		chunks.reserve((numItems + grainSize - 1) / grainSize);
+		for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize) {
+			size_t chunkEnd = std::min(chunkBegin + grainSize, end);
+			chunks.push_back(submit([&body, chunkBegin, chunkEnd] {
+				for (size_t i = chunkBegin; i < chunkEnd; i++)
+					body(i);
+			}));
+		}
+		wait(chunks);
+	}
+
+	// À appeler une fois par trame sur le fil principal (OpenGLApplication le fait avant update()). Retourne le nombre de tâches exécutées.
+	int runMainThreadJobs() {
+		std::vector<JobHandle> jobs;
+		{
+			std::lock_guard lock(mainThreadMutex_);
+			jobs.swap(mainThreadJobs_);
+		}
+		for (auto&& job : jobs)
+			execute(job);
+		numMainThread_ += jobs.size();
+		return (int)jobs.size();
+	}
+
+	JobSystemStats getStats() const {
+		return {numExecuted_, numStolen_, numMainThread_};
+	}
+
+private:
+	struct WorkQueue
+	{
+		std::deque<JobHandle> jobs;
+		std::mutex mutex;
+	};
+
+	JobHandle submitJob(std::function<void()> function, const std::vector<JobHandle>& dependencies, bool isMainThread) {
+		if (not isStarted_)
+			start();
+		auto job = std::make_shared<Job>();
+		job->function = std::move(function);
+		job->isMainThread = isMainThread;
+		numUnfinished_++;
+		for (auto&& dependency : dependencies) {
+			std::lock_guard lock(dependency->mutex);
+			if (dependency->isDone)
+				continue;
+			job->numPendingDependencies++;
+			dependency->continuations.push_back(job);
+		}
+		// Retirer le compte de submit() : si toutes les dépendances sont déjà terminées, la tâche est prête tout de suite.
+		if (--job->numPendingDependencies == 0)
+			enqueue(job);
+		return job;
+	}
+
+	void enqueue(const JobHandle& job) {
+		if (job->isMainThread) {
+			std::lock_guard lock(mainThreadMutex_);
+			mainThreadJobs_.push_back(job);
+			return;
+		}
+		WorkQueue& queue = queues_[getCurrentQueueIndex()];
+		{
+			std::lock_guard lock(queue.mutex);
+			queue.jobs.push_back(job);
+			numQueued_++;
+		}
+		// Réveiller un fil seulement s'il y en a un qui dort. Prendre le mutex (même sans rien faire) garantit qu'un fil qui s'apprêtait à dormir est bien dans wait() avant la notification, sinon elle serait perdue.
+		if (numSleeping_ > 0) {
+			{ std::lock_guard lock(sleepMutex_); }
+			hasWork_.notify_one();
+		}
+	}
+
+	void execute(const JobHandle& job) {
+		try {
+			job->function();
+		} catch (...) {
+			job->exception = std::current_exception();
+		}
+		job->function = nullptr;
+		std::vector<JobHandle> continuations;
+		{
+			std::lock_guard lock(job->mutex);
+			job->isDone = true;
+			continuations.swap(job->continuations);
+		}
+		for (auto&& continuation : continuations) {
+			if (--continuation->numPendingDependencies == 0)
+				enqueue(continuation);
+		}
+		numExecuted_++;
+		numUnfinished_--;
+	}
+
+	// Prendre une tâche dans sa propre file (la plus récente), sinon en voler une (la plus vieille) aux autres, en commençant par la file suivante pour ne pas que tous les voleurs visent la même.
+	JobHandle takeJob(int queueIndex) {
+		{
+			WorkQueue& own = queues_[queueIndex];
+			std::lock_guard lock(own.mutex);
+			if (not own.jobs.empty()) {
+				JobHandle job = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				numQueued_--;
+				return job;
+			}
+		}
+		for (size_t i = 1; i < queues_.size(); i++) {
+			size_t victimIndex = (queueIndex + i) % queues_.size();
+			WorkQueue& victim = queues_[victimIndex];
+			std::lock_guard lock(victim.mutex);
+			if (not victim.jobs.empty()) {
+				JobHandle job = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+				numQueued_--;
+				// La file 0 est partagée : y prendre une tâche n'est pas un vol.
+				if (victimIndex != 0)
+					numStolen_++;
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	// runsMainThreadJobs : le fil principal exécute aussi ses propres tâches en attendant (voir wait), sinon attendre une tâche du fil principal bloquerait pour toujours.
+	bool runOneJob(bool runsMainThreadJobs = false) {
+		if (runsMainThreadJobs and runMainThreadJobs() > 0)
+			return true;
+		JobHandle job = takeJob(getCurrentQueueIndex());
+		if (job == nullptr)
+			return false;
+		execute(job);
+		return true;
+	}
+
+	void workerLoop(int queueIndex) {
+		currentSystem_ = this;
+		currentQueueIndex_ = queueIndex;
+		while (true) {
+			if (runOneJob())
+				continue;
+			std::unique_lock lock(sleepMutex_);
+			numSleeping_++;
+			hasWork_.wait(lock, [&] { return isStopping_ or numQueued_ > 0; });
+			numSleeping_--;
+			if (isStopping_ and numQueued_ == 0)
+				return;
+		}
+	}
+
+	bool isMainThread() const {
+		return std::this_thread::get_id() == mainThreadId_;
+	}
+
+	// La file du fil courant : la sienne pour un fil de travail de ce système, la file partagée 0 pour les autres.
+	int getCurrentQueueIndex() const {
+		return currentSystem_ == this ? currentQueueIndex_ : 0;
+	}
+
+	static inline thread_local const JobSystem* currentSystem_ = nullptr;
+	static inline thread_local int currentQueueIndex_ = 0;
+
+	std::vector<std::thread> workers_;
+	std::vector<WorkQueue> queues_;
+	std::thread::id mainThreadId_;
+	std::mutex sleepMutex_;
+	std::condition_variable hasWork_;
+	// Tâches dans les files, et fils de travail endormis faute de tâches.
+	std::atomic<size_t> numQueued_ = 0;
+	std::atomic<int> numSleeping_ = 0;
+	bool isStopping_ = false;
+	bool isStarted_ = false;
+	std::atomic<size_t> numUnfinished_ = 0;
+	std::mutex mainThreadMutex_;
+	std::vector<JobHandle> mainThreadJobs_;
+	std::atomic<size_t> numExecuted_ = 0;
+	std::atomic<size_t> numStolen_ = 0;
+	size_t numMainThread_ = 0;
+};
+
+inline JobSystem jobSystem;
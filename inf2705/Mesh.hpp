@@ -4,7 +4,10 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <algorithm>
+#include <format>
 #include <fstream>
+#include <source_location>
 #include <string>
 #include <vector>
 
@@ -14,6 +17,8 @@
 #include <tiny_obj_loader.h>
 
 #include "utils.hpp"
+#include "GLStateCache.hpp"
+#include "CpuProfiler.hpp"
 
 
 using namespace gl;
@@ -48,6 +53,36 @@ using namespace glm;
 	glEnableVertexAttribArray(index);									\
 }																		\
 
+// Configurer l'attribut de sommets pour un membre entier `member` (uint32_t, int) d'une struct `elemType`. Avec glVertexAttribIPointer, la valeur reste entière dans le nuanceur plutôt que d'être convertie en float.
+#define SET_INT_VERTEX_ATTRIB_FROM_STRUCT_MEM(index, elemType, member)	\
+{																		\
+	glVertexAttribIPointer(												\
+		(GLuint)index,													\
+		1,																\
+		getTypeGLenum<decltype(elemType::member)>(),					\
+		(GLint)sizeof(elemType),										\
+		(const void*)offsetof(elemType, member)							\
+	);																	\
+	glEnableVertexAttribArray(index);									\
+}																		\
+
+// Configurer les attributs de sommets pour un membre matriciel `member` (mat4) d'une struct `elemType`. Une matrice occupe une location par colonne, donc `index` à `index + nbColonnes - 1`.
+#define SET_MAT_VERTEX_ATTRIB_FROM_STRUCT_MEM(index, elemType, member)				\
+{																					\
+	using MatType_ = decltype(elemType::member);									\
+	for (GLuint col_ = 0; col_ < (GLuint)MatType_::length(); col_++) {				\
+		glVertexAttribPointer(														\
+			(GLuint)index + col_,													\
+			(GLint)MatType_::col_type::length(),									\
+			getTypeGLenum<MatType_::value_type>(),									\
+			GL_FALSE,																\
+			(GLint)sizeof(elemType),												\
+			(const void*)(offsetof(elemType, member) + col_ * sizeof(MatType_::col_type))	\
+		);																			\
+		glEnableVertexAttribArray((GLuint)index + col_);							\
+	}																				\
+}																					\
+
 
 // Informations de base d'un sommet
 struct VertexData
@@ -58,6 +93,14 @@ struct VertexData
 	vec4 color;     // layout(location = 3)
 };
 
+// Informations propres à une instance d'un mesh dessiné avec Mesh::drawInstanced. Elles sont lues une fois par instance plutôt qu'une fois par sommet (glVertexAttribDivisor).
+struct InstanceData
+{
+	mat4 model;        // layout(location = 4) à 7 (une colonne par location)
+	vec4 color;        // layout(location = 8)
+	uint32_t objectID; // layout(location = 9), à lire comme un uint (pour la sélection par couleur).
+};
+
 // Un mesh (ou maillage) représente la géométrie d'un objet d'une façon traçable par OpenGL.
 struct Mesh
 {
@@ -66,15 +109,24 @@ struct Mesh
 	GLuint vao = 0;
 	GLuint vbo = 0;
 	GLuint ebo = 0;
+	GLuint instanceVbo = 0; // Créé au premier drawInstanced.
+	size_t instanceCapacity = 0; // Nombre d'instances que instanceVbo peut contenir.
 
-	void setup(GLenum usageMode = GL_STATIC_DRAW) {
+	// Le nom est donné aux objets OpenGL dans le registre glResources (voir GLResources.hpp), avec l'endroit d'où setup() a été appelée.
+	void setup(GLenum usageMode = GL_STATIC_DRAW, std::string_view label = "mesh", std::source_location where = std::source_location::current()) {
 		// Créer les buffer objects.
-		if (vao == 0)
+		if (vao == 0) {
 			glGenVertexArrays(1, &vao);
-		if (vbo == 0)
+			glResources.track(GLResourceType::VertexArray, vao, std::format("{} (VAO)", label), where);
+		}
+		if (vbo == 0) {
 			glGenBuffers(1, &vbo);
-		if (ebo == 0)
+			glResources.track(GLResourceType::Buffer, vbo, std::format("{} (sommets)", label), where);
+		}
+		if (ebo == 0) {
 			glGenBuffers(1, &ebo);
+			glResources.track(GLResourceType::Buffer, ebo, std::format("{} (indices)", label), where);
+		}
 
 		// Mettre les données dans les tampons en mémoire graphique.
 		updateBuffers(usageMode);
@@ -83,6 +135,7 @@ struct Mesh
 	}
 
 	void draw(GLenum drawMode = GL_TRIANGLES) {
+		// On laisse le VAO lié après le dessin. Comme les liaisons passent par glState, dessiner le même mesh plusieurs fois de suite ne refait pas le glBindVertexArray.
 		bindVao();
 
 		// Avoir un tableau d'indices vide ou non indique si on veut dessiner avec les données directement ou avec un tableau de connectivité.
@@ -90,24 +143,66 @@ struct Mesh
 			drawElements(drawMode, (GLsizei)indices.size());
 		else
 			drawArrays(drawMode);
-
-		unbindVao();
 	}
 
 	void drawArrays(GLenum drawMode, GLint offset = 0) {
-		// Techniquement, on n'a pas besoin de refaire les glBindBuffer, mais ça ne coûte pas cher et c'est plus fiable de les refaire.
+		// Techniquement, on n'a pas besoin de refaire les glBindBuffer. C'est plus fiable de les demander et glState ne fait l'appel que si le tampon lié a changé.
 		bindVbo();
 		// Tracer selon le tampon de données.
 		glDrawArrays(drawMode, offset, (GLsizei)vertices.size());
 	}
 
 	void drawElements(GLenum drawMode, GLsizei numIndices, GLsizei offset = 0) {
-		// Techniquement, on n'a pas besoin de refaire les glBindBuffer, mais ça ne coûte pas cher et c'est plus fiable de les refaire.
+		// Techniquement, on n'a pas besoin de refaire les glBindBuffer. C'est plus fiable de les demander et glState ne fait l'appel que si le tampon lié a changé.
 		bindEbo();
 		// Tracer selon le tampon d'indices.
 		glDrawElements(drawMode, numIndices, GL_UNSIGNED_INT, (const void*)(size_t)offset);
 	}
 
+	// Dessiner toutes les instances en un seul appel. Le mesh est le même pour chaque instance, seules les données de InstanceData changent (matrice de modélisation, couleur, ID). Ça remplace une boucle de draw() avec un glUniform de matrice chacun.
+	void drawInstanced(const InstanceData* instances, size_t numInstances, GLenum drawMode = GL_TRIANGLES) {
+		if (numInstances == 0)
+			return;
+		bindVao();
+		updateInstanceBuffer(instances, numInstances);
+
+		if (not indices.empty()) {
+			bindEbo();
+			glDrawElementsInstanced(drawMode, (GLsizei)indices.size(), GL_UNSIGNED_INT, nullptr, (GLsizei)numInstances);
+		} else {
+			glDrawArraysInstanced(drawMode, 0, (GLsizei)vertices.size(), (GLsizei)numInstances);
+		}
+	}
+
+	void drawInstanced(const std::vector<InstanceData>& instances, GLenum drawMode = GL_TRIANGLES) {
+		drawInstanced(instances.data(), instances.size(), drawMode);
+	}
+
+	// Copier les données d'instances dans instanceVbo. Le VAO doit être lié.
+	void updateInstanceBuffer(const InstanceData* instances, size_t numInstances) {
+		if (instanceVbo == 0) {
+			glGenBuffers(1, &instanceVbo);
+			// Le tampon d'instances est créé au premier dessin : on lui donne l'origine du VAO pour retrouver le mesh dans le rapport de glResources.
+			if (auto vaoInfo = glResources.find(GLResourceType::VertexArray, vao)) {
+				GLResourceInfo info = *vaoInfo;
+				glResources.track(GLResourceType::Buffer, instanceVbo, info.label.substr(0, info.label.rfind(" (VAO)")) + " (instances)", info.where);
+				// Si le mesh est possédé par un GLOwned (voir GLObject.hpp), le nouveau tampon l'est aussi.
+				glResources.setOwned(GLResourceType::Buffer, instanceVbo, info.isOwned);
+			} else
+				glResources.track(GLResourceType::Buffer, instanceVbo, "mesh (instances)");
+			glState.bindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+			setupInstanceAttribs();
+		}
+		glState.bindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+
+		// Les instances changent à chaque trame. Si le tampon est assez grand, on l'« orpheline » (glBufferData avec nullptr) avant de le remplir : le pilote nous donne alors une nouvelle zone mémoire sans attendre que les dessins de la trame précédente aient fini de lire l'ancienne. Sinon, on l'agrandit (en doublant pour ne pas réallouer à chaque nouvelle instance).
+		if (numInstances > instanceCapacity)
+			instanceCapacity = std::max(numInstances, instanceCapacity * 2);
+		glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+		glResources.setSize(GLResourceType::Buffer, instanceVbo, instanceCapacity * sizeof(InstanceData));
+		glBufferSubData(GL_ARRAY_BUFFER, 0, numInstances * sizeof(InstanceData), instances);
+	}
+
 	void updateBuffers(GLenum usageMode = GL_STATIC_DRAW) {
 		bindVao();
 		bindVbo();
@@ -116,10 +211,12 @@ struct Mesh
 		if (not vertices.empty()) {
 			auto numBytes = vertices.size() * sizeof(VertexData);
 			glBufferData(GL_ARRAY_BUFFER, numBytes, vertices.data(), usageMode);
+			glResources.setSize(GLResourceType::Buffer, vbo, numBytes);
 		}
 		if (not indices.empty()) {
 			auto numBytes = indices.size() * sizeof(GLuint);
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numBytes, indices.data(), usageMode);
+			glResources.setSize(GLResourceType::Buffer, ebo, numBytes);
 		}
 
 		unbindVao();
@@ -138,27 +235,55 @@ struct Mesh
 		unbindVao();
 	}
 
+	// Configurer les attributs d'instances selon la struct InstanceData. Le VAO et instanceVbo doivent être liés.
+	void setupInstanceAttribs() {
+		SET_MAT_VERTEX_ATTRIB_FROM_STRUCT_MEM(4, InstanceData, model);
+		SET_VEC_VERTEX_ATTRIB_FROM_STRUCT_MEM(8, InstanceData, color);
+		SET_INT_VERTEX_ATTRIB_FROM_STRUCT_MEM(9, InstanceData, objectID);
+		// Un diviseur de 1 veut dire qu'on avance d'un élément dans le tampon à chaque instance plutôt qu'à chaque sommet.
+		for (GLuint i = 4; i <= 9; i++)
+			glVertexAttribDivisor(i, 1);
+	}
+
 	void deleteObjects() {
-		glDeleteVertexArrays(1, &vao);
-		glDeleteBuffers(1, &vbo);
-		glDeleteBuffers(1, &ebo);
-		vao = vbo = ebo = 0;
+		glState.deleteVertexArrays(1, &vao);
+		glState.deleteBuffers(1, &vbo);
+		glState.deleteBuffers(1, &ebo);
+		glState.deleteBuffers(1, &instanceVbo);
+		vao = vbo = ebo = instanceVbo = 0;
+		instanceCapacity = 0;
 	}
 
-	void bindVao() { glBindVertexArray(vao); }
-	void unbindVao() { glBindVertexArray(0); }
-	void bindVbo() { glBindBuffer(GL_ARRAY_BUFFER, vbo); }
-	void bindEbo() { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo); }
+	// Pour GLOwned (voir GLObject.hpp).
+	template <typename F>
+	void forEachGLObject(F&& f) const {
+		f(GLResourceType::VertexArray, vao);
+		f(GLResourceType::Buffer, vbo);
+		f(GLResourceType::Buffer, ebo);
+		f(GLResourceType::Buffer, instanceVbo);
+	}
+
+	void bindVao() { glState.bindVertexArray(vao); }
+	void unbindVao() { glState.bindVertexArray(0); }
+	void bindVbo() { glState.bindBuffer(GL_ARRAY_BUFFER, vbo); }
+	void bindEbo() { glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo); }
 
 	// Charge des mesh d'objets à partir d'un fichier Wavefront (il peut y avoir plusieurs objets dans le même fichier). Les données sont chargées par sommet sans tableau d'indices.
-	static std::vector<Mesh> loadFromWavefrontFile(std::string_view filename, bool setupOnLoad = true) {
+	static std::vector<Mesh> loadFromWavefrontFile(std::string_view filename, bool setupOnLoad = true, std::source_location where = std::source_location::current()) {
+		CPU_PROFILE_SCOPE("Mesh::loadFromWavefrontFile");
 		// Code inspiré de l'exemple https://github.com/tinyobjloader/tinyobjloader/tree/release#example-code-new-object-oriented-api
 
 		// Lire le fichier et vérifier les erreurs. On le charge en spécifiant à tinyobjloader de faire la séparation en triangles des faces non triangulaires (des quadrilatères par exemple).
 		tinyobj::ObjReader reader;
 		tinyobj::ObjReaderConfig config = {};
 		config.triangulate = true;
-		if (not reader.ParseFromFile(filename.data(), config)) {
+		// Dans un paquet de ressources monté (voir AssetPack.hpp), le texte du fichier est déjà en mémoire. tinyobjloader veut une std::string, donc on en fait une copie, ce qui reste négligeable devant l'analyse du fichier.
+		bool isParsed = false;
+		if (auto data = assetPacks.find(filename))
+			isParsed = reader.ParseFromString(std::string((const char*)data->data(), data->size()), "", config);
+		else
+			isParsed = reader.ParseFromFile(filename.data(), config);
+		if (not isParsed) {
 			std::cerr << "ERROR tinyobj::ObjReader: " << reader.Error();
 			return {};
 		}
@@ -196,8 +321,10 @@ struct Mesh
 				index_offset += numVertices;
 			}
 
-			if (setupOnLoad)
-				mesh.setup();
+			if (setupOnLoad) {
+				std::string label = shape.name.empty() ? std::string(filename) : std::format("{}:{}", filename, shape.name);
+				mesh.setup(GL_STATIC_DRAW, label, where);
+			}
 			result.push_back(std::move(mesh));
 		}
 
@@ -3,8 +3,11 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <ctime>
 #include <format>
 #include <iostream>
@@ -15,6 +18,7 @@
 #include <chrono>
 #include <unordered_map>
 #include <thread>
+#include <vector>
 
 #ifdef _WIN32
 	#include <Windows.h>
@@ -29,6 +33,19 @@
 
 #include "sfml_utils.hpp"
 #include "utils.hpp"
+#include "AssetPack.hpp"
+#include "GLStateCache.hpp"
+#include "Benchmark.hpp"
+#include "CpuProfiler.hpp"
+#include "FrameCapture.hpp"
+#include "FrameArena.hpp"
+#include "FramePacer.hpp"
+#include "Framebuffer.hpp"
+#include "GLDebugOutput.hpp"
+#include "GLObject.hpp"
+#include "GLTrace.hpp"
+#include "HeadlessContext.hpp"
+#include "JobSystem.hpp"
 
 
 using namespace gl;
@@ -38,7 +55,31 @@ struct WindowSettings
 {
 	sf::VideoMode videoMode = sf::VideoMode({600, 600});
 	int fps = 30;
+	// Façon d'attendre entre les trames pour respecter le fps (--pacing=precise|vsync|uncapped), voir FramePacer. Le banc d'essai et le mode sans fenêtre sont toujours sans limite.
+	FramePacingMode framePacing = FramePacingMode::Precise;
 	sf::ContextSettings context = sf::ContextSettings(24, 8);
+
+	// Mode sans fenêtre (aussi --headless sur la ligne de commande) : pas de fenêtre ni d'événements, on dessine dans un FBO de la taille de videoMode. Le fps est ignoré, les trames s'enchaînent aussi vite que possible.
+	bool headless = false;
+	// Arrêter l'application après ce nombre de trames, 0 pour jamais (--frames=N).
+	int maxFrames = 0;
+	// Temps entre les trames donné par getFrameDeltaTime() au lieu du temps mesuré, 0 pour le temps mesuré (--fixed-dt=S). Les animations sont alors les mêmes d'une exécution à l'autre.
+	float fixedDeltaTime = 0;
+	// Numéros des trames à écrire en PNG dans framesFolder (--save-frames=0,10,20), et/ou une trame sur saveFrameInterval (--save-every=N).
+	std::vector<int> saveFrames;
+	int saveFrameInterval = 0;
+	std::string framesFolder = "frames"; // --frames-folder=DOSSIER
+	// Enregistrer une séquence d'images dès le départ, une trame sur recordInterval (--record[=N]), voir startRecording().
+	bool record = false;
+	int recordInterval = 1;
+	ImageFileFormat recordFormat = ImageFileFormat::Qoi; // --record-format=png|ppm|qoi
+	std::string recordFolder = "recording"; // --record-folder=DOSSIER
+	// Fréquence (en Hz) des appels à update(), indépendante du fps de l'affichage. Si les trames sont trop lentes, on fait au plus maxUpdatesPerFrame pas par trame et on laisse tomber le retard qui reste, sinon la simulation prendrait de plus en plus de retard (et de temps).
+	float updateRate = 60;
+	int maxUpdatesPerFrame = 5;
+	// Dessin sur demande (--on-demand) : une trame n'est dessinée que si un événement arrive, si isAnimating() est vrai ou si l'application appelle requestRedraw(). Sinon, la boucle dort dans waitEvent et ne se réveille qu'aux onDemandTimeout secondes (pour voir les requestRedraw() venant d'autres fils). Ignoré sans fenêtre et en banc d'essai.
+	bool renderOnDemand = false;
+	float onDemandTimeout = 0.25f;
 };
 
 // Classe de base pour les application OpenGL. Fait pour nous la création de fenêtre et la gestion des événements.
@@ -55,44 +96,177 @@ public:
 		argv_ = argv;
 
 		settings_ = settings;
-
-		// Créer la fenêtre et afficher les infos du contexte OpenGL.
-		createWindowAndContext(title);
+		parseHeadlessArgs();
+		parseBenchmarkArgs();
+		parseGLTraceArgs();
+		parseGLDebugArgs();
+		mountAssetPacks();
+
+		// Créer la fenêtre (ou le contexte sans fenêtre) et afficher les infos du contexte OpenGL.
+		if (settings_.headless) {
+			if (not createHeadlessContext())
+				return;
+		} else {
+			createWindowAndContext(title);
+		}
+		// On ne sait pas ce que la création du contexte a laissé comme état.
+		glState.invalidate();
+		if (isGLDebugRequested_)
+			glDebugOutput.enable(isGLDebugBreakRequested_);
+		// La trace commence avant le FBO sans fenêtre pour que la relecture puisse le recréer.
+		if (not glTracePath_.empty())
+			startGLTrace();
+		if (settings_.headless)
+			createHeadlessFramebuffer();
 		printGLInfo();
 		std::cout << std::endl;
 
-		init(); // À surcharger
+		// Les fils de travail sont prêts pour init(), qui peut déjà soumettre des tâches (chargements, etc.).
+		jobSystem.start();
+
+		{
+			CPU_PROFILE_SCOPE("init");
+			init(); // À surcharger
+		}
 
 		// Commencer le chronomètre qui mesure le temps des trames. C'est des fois plus pratique d'avoir le temps depuis la dernière trame que le numéro de trame.
 		startTime_ = std::chrono::system_clock::now();
-		lastFrameTime_ = std::chrono::high_resolution_clock::now();
-		deltaTime_ = 1.0f / settings_.fps;
+		lastFrameTime_ = std::chrono::steady_clock::now();
+		framePacer_.setup(settings_.headless ? FramePacingMode::Uncapped : settings_.framePacing, (float)settings_.fps);
+		deltaTime_ = settings_.fixedDeltaTime > 0 ? settings_.fixedDeltaTime : 1.0f / settings_.fps;
+		updateDeltaTime_ = 1.0f / std::max(settings_.updateRate, 1.0f);
+		updateAccumulator_ = 0;
 
-		// État initial de la souris avant la première trame.
-		currentMouseState_ = lastMouseState_ = getMouseState(window_);
+		// État initial de la souris avant la première trame. Sans fenêtre, la souris reste à son état par défaut.
+		if (not settings_.headless)
+			currentMouseState_ = lastMouseState_ = getMouseState(window_);
 
 		// Compteur de trames effectuées.
 		frame_ = 0;
 
+		parseCpuTraceArg();
+		parseGLResourcesArg();
+
 		printKeybinds();
 
+		frameCapture_.setup();
+		if (settings_.record)
+			startRecording(settings_.recordInterval, settings_.recordFormat);
+
+		if (isBenchmarkRequested_)
+			benchmark_.start(getExecutableName(), benchmarkSettings_);
+
 		// Tant que la fenêtre est ouverte (mis à jour dans la gestion d'événements) :
-		while (window_.isOpen()) {
-			drawFrame(); // À surcharger
+		while (isRunning()) {
+			size_t numHeapAllocationsBefore = numHeapAllocations;
+			if (benchmark_.isActive()) {
+				benchmark_.beginFrame();
+				injectScriptedCameraMove();
+			}
+
+			{
+				CPU_PROFILE_SCOPE("update");
+				// Les tâches qui doivent être faites sur le fil d'OpenGL (voir JobSystem::submitOnMainThread).
+				jobSystem.runMainThreadJobs();
+				onFrameStart();
+				runFixedUpdates();
+			}
+
+			{
+				CPU_PROFILE_SCOPE("drawFrame");
+				drawFrame(interpolationAlpha_); // À surcharger
+			}
+
+			// SFML fait le rafraîchissement de la fenêtre pour nous. La fonction display fait le buffer swap (comme glutSwapBuffers).
+			// Sans fenêtre, il n'y a rien à échanger : on soumet seulement les commandes de la trame au GPU.
+			{
+				CPU_PROFILE_SCOPE("display");
+				if (settings_.headless)
+					glFlush();
+				else
+					window_.display();
+				framePacer_.markPresented();
+			}
+			benchmark_.endFrame();
+			{
+				CPU_PROFILE_SCOPE("frameCapture");
+				recordFrameIfNeeded();
+				frameCapture_.update();
+			}
+			if (glTrace_.isRecording()) {
+				glTrace_.endFrame();
+				if (glTraceFrames_ > 0 and glTrace_.getNumFrames() >= glTraceFrames_)
+					stopGLTrace();
+			}
 
-			// SFML fait le rafraîchissement de la fenêtre ainsi que le contrôle du framerate pour nous.
-			// La fonction display fait le buffer swap (comme glutSwapBuffers) et attend à la prochaine trame selon le FPS qu'on a spécifié avec setFramerateLimit.
-			window_.display();
+			saveFrameIfSelected();
 
-			handleEvents();
+			// Attendre la prochaine trame selon le fps. On attend avant de lire les événements plutôt qu'après, pour que la trame suivante soit dessinée avec les entrées les plus récentes possible.
+			{
+				CPU_PROFILE_SCOPE("framePacing");
+				framePacer_.wait();
+			}
+
+			if (not settings_.headless) {
+				CPU_PROFILE_SCOPE("handleEvents");
+				handleEvents();
+			}
+			waitForRedraw();
 			updateDeltaTime();
 
+			// Remettre à zéro les compteurs d'appels de changement d'état (ceux de la trame qui finit restent accessibles avec glState.getLastFrameStats()).
+			glState.endFrame();
+			// Additionner les marqueurs CPU de la trame (voir cpuProfiler.getLastFrameStats()).
+			cpuProfiler.endFrame();
+			// Libérer d'un coup les données temporaires d'il y a deux trames (voir FrameArena.hpp).
+			frameArena.endFrame();
+			// Supprimer les objets OpenGL dont le GPU a fini de se servir et afficher le rapport périodique des ressources (voir GLObject.hpp et GLResources.hpp).
+			glDeletionQueue.endFrame();
+			glResources.endFrame();
+			// Traiter les messages de débogage OpenGL de la trame (voir GLDebugOutput.hpp).
+			glDebugOutput.endFrame();
+			printGLResourcesIfNeeded();
+			if constexpr (isHeapAllocationTrackingEnabled)
+				recordHeapAllocations(numHeapAllocations - numHeapAllocationsBefore);
 			frame_++;
+
+			if (settings_.maxFrames > 0 and frame_ >= settings_.maxFrames and isRunning())
+				close();
 		}
+
+		// Les main() des exemples ne retournent pas de code de sortie : on quitte directement pour qu'un script d'intégration continue voie la régression.
+		if (benchmark_.hasRegressions())
+			std::exit(1);
 	}
 
 	const sf::Window& getWindow() const { return window_; }
 
+	// Vrai tant que la fenêtre est ouverte (ou, sans fenêtre, jusqu'à la dernière trame).
+	bool isRunning() const {
+		return settings_.headless ? isHeadlessRunning_ : window_.isOpen();
+	}
+
+	bool isHeadless() const { return settings_.headless; }
+
+	// Dimensions de ce qu'on dessine : la fenêtre, ou le FBO en mode sans fenêtre. À utiliser plutôt que getWindow().getSize().
+	sf::Vector2u getWindowSize() const {
+		if (settings_.headless)
+			return {(unsigned)headlessSize_.x, (unsigned)headlessSize_.y};
+		return window_.getSize();
+	}
+
+	// Les paramètres du contexte obtenu. Sans fenêtre, les bits de profondeur, de stencil et l'antialiasing sont ceux du FBO.
+	sf::ContextSettings getContextSettings() const {
+		if (not settings_.headless)
+			return window_.getSettings();
+		sf::ContextSettings contextSettings = headlessContext_.getSettings();
+		bool hasDepth = settings_.context.depthBits > 0 or settings_.context.stencilBits > 0;
+		contextSettings.depthBits = hasDepth ? 24 : 0;
+		contextSettings.stencilBits = hasDepth ? 8 : 0;
+		contextSettings.antiAliasingLevel = settings_.context.antiAliasingLevel;
+		return contextSettings;
+	}
+
 	// État de la souris (mis à jour une fois par trame avant la gestion d'événements).
 	const MouseState& getMouse() const {
 		return currentMouseState_;
@@ -108,9 +282,52 @@ public:
 		return deltaTime_;
 	}
 
+	// Le pas de temps fixe passé à update() (1 / WindowSettings::updateRate).
+	float getUpdateDeltaTime() const {
+		return updateDeltaTime_;
+	}
+
+	// Nombre de pas de update() laissés tomber parce que les trames étaient trop lentes.
+	int getNumDroppedUpdates() const {
+		return numDroppedUpdates_;
+	}
+
+	// Demander une trame en mode sur demande (WindowSettings::renderOnDemand), par exemple quand un résultat calculé ailleurs est prêt. Peut être appelée de n'importe quel fil. Sans le mode sur demande, toutes les trames sont dessinées de toute façon.
+	void requestRedraw() {
+		isRedrawRequested_ = true;
+	}
+
+	bool isRenderingOnDemand() const {
+		return settings_.renderOnDemand and not settings_.headless and not isBenchmarkRequested_;
+	}
+
+	// Durée des trames, gigue et latence des entrées (aussi affichées à la fermeture).
+	FramePacingStats getFramePacingStats() const {
+		return framePacer_.computeStats();
+	}
+
+	// Rééchantillonnage tardif des entrées (late latching). À appeler dans drawFrame() juste avant d'envoyer la matrice de vue : les mouvements et défilements de souris arrivés depuis le début de la trame sont traités tout de suite (onMouseMove, onMouseScroll), donc la caméra est mise à jour avec l'état le plus récent au lieu de celui lu avant update(). Les autres événements (clavier, redimensionnement, fermeture) attendent la fin de la trame comme d'habitude, puisqu'ils pourraient changer des choses en plein dessin. Pour garder l'ordre des entrées, tout ce qui arrive après un événement mis en attente attend aussi (par exemple un clic puis des mouvements : les mouvements sont traités après le clic, à la fin de la trame).
+	void latchInput() {
+		if (settings_.headless or benchmark_.isActive())
+			return;
+		CPU_PROFILE_SCOPE("latchInput");
+		lastMouseState_ = currentMouseState_;
+		currentMouseState_ = getMouseState(window_);
+		bool isDeferring = not pendingEvents_.empty();
+		while (auto event = window_.pollEvent()) {
+			if (not event->is<sf::Event::MouseMoved>() and not event->is<sf::Event::MouseWheelScrolled>())
+				isDeferring = true;
+			if (isDeferring)
+				pendingEvents_.push_back(*event);
+			else
+				dispatchEvent(*event);
+		}
+		framePacer_.markInputSampled();
+	}
+
 	// Ratio des dimensions de la fenêtre (x/y).
 	float getWindowAspect() const {
-		auto windowSize = window_.getSize();
+		auto windowSize = getWindowSize();
 		float aspect = (float)windowSize.x / windowSize.y;
 		return aspect;
 	}
@@ -146,29 +363,42 @@ public:
 		auto openglVendor = glGetString(GL_VENDOR);
 		auto openglRenderer = glGetString(GL_RENDERER);
 		auto glslVersion = glGetString(GL_SHADING_LANGUAGE_VERSION);
-		auto& sfmlSettings = window_.getSettings();
+		sf::ContextSettings sfmlSettings = getContextSettings();
 		printf("OpenGL         %s\n", openglVersion);
 		printf("GPU            %s, %s\n", openglRenderer, openglVendor);
 		printf("GLSL           %s\n", glslVersion);
 		printf("SFML Context   %i.%i\n", sfmlSettings.majorVersion, sfmlSettings.minorVersion);
 		printf("Depth bits     %i\n", sfmlSettings.depthBits);
 		printf("Stencil bits   %i\n", sfmlSettings.stencilBits);
+		if (settings_.headless)
+			printf("Sans fenêtre   %s, FBO %ix%i\n", headlessContext_.getBackendName().c_str(), headlessSize_.x, headlessSize_.y);
 	}
 
 	sf::Image captureCurrentFrame(GLenum buffer = GL_FRONT) {
 		// Les dimensions de la fenêtre.
-		auto windowSize = window_.getSize();
+		auto windowSize = getWindowSize();
 		size_t numPixels = windowSize.x * windowSize.y;
-
-		// Obtenir la source actuelle de glReadBuffer.
-		GLint readBufferSrc;
-		glGetIntegerv(GL_READ_BUFFER, &readBufferSrc);
-		// Par défaut, lire du front buffer (le tampon d'affichage, donc ce qui est à l'écran). On remarque qu'on n'a pas besoin de faire glFinish(), vu que le tampon d'affichage est complet après le buffer swap.
-		glReadBuffer(buffer);
-		std::vector<uint8_t> pixels(numPixels * sizeof(sf::Color), 0);
-		glReadPixels(0, 0, windowSize.x, windowSize.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
-		// Restaurer la source de glReadBuffer.
-		glReadBuffer((GLenum)readBufferSrc);
+		// Tampon temporaire (sf::Image fait sa propre copie) : on le prend dans l'arène de trame plutôt que sur le tas.
+		FrameVector<uint8_t> pixels(numPixels * sizeof(sf::Color), 0, frameArena.get());
+
+		if (settings_.headless) {
+			// Sans fenêtre, il n'y a ni front ni back buffer : on lit l'attache de couleur du FBO (résolue d'abord si elle est multiéchantillonnée). Le framebuffer par défaut (donc le FBO) est lié après.
+			const Framebuffer& source = headlessResolveFramebuffer_.getObject() != 0 ? headlessResolveFramebuffer_ : headlessFramebuffer_;
+			if (&source != &headlessFramebuffer_)
+				headlessFramebuffer_.resolveTo(headlessResolveFramebuffer_);
+			source.bind(GL_READ_FRAMEBUFFER);
+			glReadPixels(0, 0, windowSize.x, windowSize.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		} else {
+			// Obtenir la source actuelle de glReadBuffer.
+			GLint readBufferSrc;
+			glGetIntegerv(GL_READ_BUFFER, &readBufferSrc);
+			// Par défaut, lire du front buffer (le tampon d'affichage, donc ce qui est à l'écran). On remarque qu'on n'a pas besoin de faire glFinish(), vu que le tampon d'affichage est complet après le buffer swap.
+			glReadBuffer(buffer);
+			glReadPixels(0, 0, windowSize.x, windowSize.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			// Restaurer la source de glReadBuffer.
+			glReadBuffer((GLenum)readBufferSrc);
+		}
 		// Créer l'image avec les pixels lus.
 		sf::Image img;
 		img.resize({windowSize.x, windowSize.y}, pixels.data());
@@ -178,15 +408,13 @@ public:
 		return std::move(img);
 	}
 
+	// Capture d'écran en PNG, écrite quelques trames plus tard sans bloquer l'affichage (voir FrameCapture). Retourne le nom du fichier.
 	std::string saveScreenshot(const std::string& folder = "screenshots", const std::string& filename = "") {
 		using namespace std::filesystem;
 
 		path trimmedFilename = trim(filename);
 		path trimmedFolder = trim(folder);
 
-		// Capturer la trame actuelle.
-		sf::Image frameImage = captureCurrentFrame();
-
 		// Si le dossier cible n'existe pas, le créer.
 		if (not trimmedFolder.empty())
 			create_directory(trimmedFolder);
@@ -196,35 +424,80 @@ public:
 		if (not trimmedFilename.empty()) {
 			filePathStr = (trimmedFolder / trimmedFilename).make_preferred().string();
 		} else {
-			// Si aucun nom de fichier est fourni, construire un nom avec le nom de l'exécutable, l'heure de démarrage de l'application et le numéro de la trame actuelle.
-			int frameNumber = getCurrentFrameNumber();
-			std::string dateTimeStr = formatStartTime("%Y%m%d_%H%M%S");
-			std::string execFilename = argv_[0];
-			path execName = path(execFilename).stem();
-			filePathStr = std::format(
-				"{}_{}_{}.png",
-				(trimmedFolder / execName).make_preferred().string(),
-				dateTimeStr,
-				frameNumber
-			);
+			filePathStr = makeOutputFilename(trimmedFolder, "png");
 		}
 
-		// Faire l'écriture dans le fichier dans un fil parallèle pour moins ralentir le fil principal avec une écriture sur le disque. La capture (avec glReadPixels) doit être faite dans le fil principal, mais l'écriture sur le disque peut être faite en parallèle sans causer de problème de synchronisation. On remarque la capture par copie.
-		std::thread savingThread([=]() {
-			bool ok = frameImage.saveToFile(filePathStr);
-		});
-		// Détacher le fil pour qu'il se gère tout seul, donc pas besoin de join() ou de garder la variable vivante.
-		savingThread.detach();
+		// La copie des pixels est mise en file sur le GPU (dans le fil principal, comme tout appel OpenGL). La lecture et l'encodage se font plus tard, l'encodage dans un fil du bassin de FrameCapture.
+		captureFrameAsync(filePathStr, ImageFileFormat::Png);
 
 		return filePathStr;
 	}
 
+	// Enregistrer une image sur `interval` trames dans un sous-dossier de recordFolder, à pleine vitesse. Les images sont numérotées à partir de 0 (000000.qoi, 000001.qoi, etc.) pour être lues directement par ffmpeg, par exemple :
+	//   ffmpeg -framerate 30 -i recording/<dossier>/%06d.qoi video.mp4
+	void startRecording(int interval = 1, ImageFileFormat format = ImageFileFormat::Qoi) {
+		recordingFolder_ = std::filesystem::path(settings_.recordFolder) / std::format("{}_{}", getExecutableName(), formatStartTime("%Y%m%d_%H%M%S"));
+		std::filesystem::create_directories(recordingFolder_);
+		recordingInterval_ = std::max(interval, 1);
+		recordingFormat_ = format;
+		recordingFirstFrame_ = frame_;
+		numRecordedFrames_ = 0;
+		isRecording_ = true;
+		std::cout << "Enregistrement des trames dans " << recordingFolder_.string() << std::endl;
+	}
+
+	void stopRecording() {
+		if (not isRecording_)
+			return;
+		isRecording_ = false;
+		frameCapture_.finish();
+		FrameCaptureStats stats = frameCapture_.getStats();
+		std::cout << std::format("{} trames enregistrées dans {} ({} attentes du GPU, {} attentes de l'encodage)", numRecordedFrames_, recordingFolder_.string(), stats.numStalls, stats.numBlockedSubmits) << std::endl;
+	}
+
+	bool isRecording() const { return isRecording_; }
+
+	// Écrire ce que le profileur CPU a gardé des dernières trames (tous les fils) en format Chrome trace, avec un nom construit comme celui des captures d'écran.
+	std::string saveCpuTrace(const std::string& folder = "traces") {
+		std::filesystem::create_directory(folder);
+		std::string path = makeOutputFilename(folder, "json");
+		cpuProfiler.writeChromeTrace(path);
+		return path;
+	}
+
+	// Construire un nom de fichier avec le nom de l'exécutable, l'heure de démarrage de l'application et le numéro de la trame actuelle.
+	std::string makeOutputFilename(const std::filesystem::path& folder, std::string_view extension) const {
+		using namespace std::filesystem;
+		int frameNumber = getCurrentFrameNumber();
+		std::string dateTimeStr = formatStartTime("%Y%m%d_%H%M%S");
+		std::string execFilename = argv_[0];
+		path execName = path(execFilename).stem();
+		return std::format(
+			"{}_{}_{}.{}",
+			(folder / execName).make_preferred().string(),
+			dateTimeStr,
+			frameNumber,
+			extension
+		);
+	}
+
 	// Les méthodes virtuelles suivantes sont à surcharger.
 
 	// Appelée avant la première trame.
 	virtual void init() { }
 
+	// Appelée au début de chaque trame, avant les update(). Par exemple pour GpuProfiler::beginFrame() quand update() fait aussi du travail GPU à mesurer.
+	virtual void onFrameStart() { }
+
+	// Appelée à fréquence fixe (WindowSettings::updateRate), zéro, une ou plusieurs fois avant chaque trame, pour faire avancer la simulation ou les animations. dt est toujours getUpdateDeltaTime() : le résultat ne dépend donc pas du fps de l'affichage.
+	virtual void update(float dt) { }
+
+	// En mode sur demande, vrai tant qu'une animation est en cours : on dessine alors toutes les trames comme d'habitude.
+	virtual bool isAnimating() const { return false; }
+
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
+	// alpha, dans [0, 1[, est la fraction d'un pas de update() écoulée depuis le dernier appel. Pour un mouvement fluide quand l'affichage et la simulation ne vont pas au même rythme, on dessine l'état interpolé mix(précédent, courant, alpha). Par défaut, appelle drawFrame() sans paramètre.
+	virtual void drawFrame(float alpha) { drawFrame(); }
 	virtual void drawFrame() { }
 
 	// Appelée lorsque la fenêtre se ferme.
@@ -259,45 +532,399 @@ protected:
 		lastMouseState_ = currentMouseState_;
 		currentMouseState_ = getMouseState(window_);
 
-		// Traiter les événements survenus depuis la dernière trame.
-		while (auto event = window_.pollEvent()) {
-			// N'importe quel événement.
-			onEvent(*event); // À surcharger
-
-			// L'utilisateur a voulu fermer la fenêtre (le X de la fenêtre, Alt+F4 sur Windows, etc.).
-			if (event->is<sf::Event::Closed>()) {
-				glFinish();
-				onClose(); // À surcharger
-				glFinish();
-				window_.close();
-			// Redimensionnement de la fenêtre.
-			} else if (auto* e = event->getIf<sf::Event::Resized>()) {
-				glViewport(0, 0, e->size.x, e->size.y);
-				onResize(*e); // À surcharger
-				lastResize_ = *e;
-			// Touche appuyée.
-			} else if (auto* e = event->getIf<sf::Event::KeyPressed>()) {
-				onKeyPress(*e); // À surcharger
-			// Touche relâchée.
-			} else if (auto* e = event->getIf<sf::Event::KeyReleased>()) {
-				onKeyRelease(*e); // À surcharger
-			// Bouton appuyé.
-			} else if (auto* e = event->getIf<sf::Event::MouseButtonPressed>()) {
-				onMouseButtonPress(*e); // À surcharger
-			// Bouton relâché.
-			} else if (auto* e = event->getIf<sf::Event::MouseButtonReleased>()) {
-				onMouseButtonRelease(*e); // À surcharger
-			// Souris bougée.
-			} else if (auto* e = event->getIf<sf::Event::MouseMoved>()) {
-				onMouseMove({{
-					e->position.x - lastMouseState_.relative.x,
-					e->position.y - lastMouseState_.relative.y
-				}});
-			// Souris défilée
-			} else if (auto* e = event->getIf<sf::Event::MouseWheelScrolled>()) {
-				onMouseScroll(*e);
+		// Traiter les événements gardés par latchInput(), puis ceux survenus depuis la dernière trame.
+		std::vector<sf::Event> pendingEvents = std::move(pendingEvents_);
+		pendingEvents_.clear();
+		for (auto&& event : pendingEvents)
+			dispatchEvent(event);
+		while (auto event = window_.pollEvent())
+			dispatchEvent(*event);
+		framePacer_.markInputSampled();
+	}
+
+	// En mode sur demande, bloquer dans waitEvent jusqu'à ce qu'il y ait une raison de dessiner. Les captures en cours ont besoin de quelques trames de plus pour être lues, donc on continue tant qu'il en reste.
+	void waitForRedraw() {
+		if (not isRenderingOnDemand())
+			return;
+		auto needsRedraw = [&] {
+			return not isRunning() or isRedrawRequested_.exchange(false) or isAnimating() or isRecording_ or frameCapture_.getNumPending() > 0;
+		};
+		if (needsRedraw())
+			return;
+
+		CPU_PROFILE_SCOPE("waitForRedraw");
+		while (true) {
+			// Une tâche du fil principal peut demander une trame (requestRedraw) quand son résultat est prêt.
+			jobSystem.runMainThreadJobs();
+			if (needsRedraw())
+				break;
+			auto event = window_.waitEvent(sf::seconds(settings_.onDemandTimeout));
+			if (not event.has_value())
+				continue;
+			lastMouseState_ = currentMouseState_;
+			currentMouseState_ = getMouseState(window_);
+			dispatchEvent(*event);
+			while (auto nextEvent = window_.pollEvent())
+				dispatchEvent(*nextEvent);
+			framePacer_.markInputSampled();
+		}
+		// Le temps passé à attendre ne compte pas comme une trame : la prochaine a un dt normal et le rythme reprend de maintenant.
+		lastFrameTime_ = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(1.0f / settings_.fps));
+		framePacer_.resync();
+	}
+
+	void dispatchEvent(const sf::Event& event) {
+		// Tout événement demande une trame en mode sur demande.
+		isRedrawRequested_ = true;
+
+		// N'importe quel événement.
+		onEvent(event); // À surcharger
+
+		// L'utilisateur a voulu fermer la fenêtre (le X de la fenêtre, Alt+F4 sur Windows, etc.).
+		if (event.is<sf::Event::Closed>()) {
+			close();
+		// Redimensionnement de la fenêtre.
+		} else if (auto* e = event.getIf<sf::Event::Resized>()) {
+			glState.viewport(0, 0, e->size.x, e->size.y);
+			onResize(*e); // À surcharger
+			lastResize_ = *e;
+		// Touche appuyée.
+		} else if (auto* e = event.getIf<sf::Event::KeyPressed>()) {
+			onKeyPress(*e); // À surcharger
+		// Touche relâchée.
+		} else if (auto* e = event.getIf<sf::Event::KeyReleased>()) {
+			onKeyRelease(*e); // À surcharger
+		// Bouton appuyé.
+		} else if (auto* e = event.getIf<sf::Event::MouseButtonPressed>()) {
+			onMouseButtonPress(*e); // À surcharger
+		// Bouton relâché.
+		} else if (auto* e = event.getIf<sf::Event::MouseButtonReleased>()) {
+			onMouseButtonRelease(*e); // À surcharger
+		// Souris bougée.
+		} else if (auto* e = event.getIf<sf::Event::MouseMoved>()) {
+			onMouseMove({{
+				e->position.x - lastMouseState_.relative.x,
+				e->position.y - lastMouseState_.relative.y
+			}});
+		// Souris défilée
+		} else if (auto* e = event.getIf<sf::Event::MouseWheelScrolled>()) {
+			onMouseScroll(*e);
+		}
+	}
+
+	// Avec --cpu-trace=N sur la ligne de commande, écrire la trace CPU (dans traces/) après N trames.
+	void parseCpuTraceArg() {
+		std::string_view prefix = "--cpu-trace=";
+		for (int i = 1; i < argc_; i++) {
+			std::string_view arg = argv_[i];
+			if (not arg.starts_with(prefix))
+				continue;
+			int numFrames = std::atoi(arg.substr(prefix.size()).data());
+			if (numFrames <= 0) {
+				std::cerr << "--cpu-trace attend un nombre de trames positif" << std::endl;
+				continue;
+			}
+			std::filesystem::create_directory("traces");
+			cpuProfiler.captureFrames(numFrames, makeOutputFilename("traces", "json"));
+		}
+	}
+
+	// --gl-resources[=S] : afficher toutes les S secondes (5 par défaut) le nombre d'objets OpenGL et d'octets par catégorie, pour voir la mémoire graphique grandir pendant une longue exécution.
+	void parseGLResourcesArg() {
+		for (int i = 1; i < argc_; i++) {
+			std::string_view arg = argv_[i];
+			if (arg == "--gl-resources")
+				glResourcesInterval_ = 5;
+			else if (arg.starts_with("--gl-resources="))
+				glResourcesInterval_ = std::atof(arg.substr(15).data());
+		}
+		lastGLResourcesReport_ = std::chrono::steady_clock::now();
+	}
+
+	void printGLResourcesIfNeeded() {
+		if (glResourcesInterval_ <= 0)
+			return;
+		auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<float>(now - lastGLResourcesReport_).count() < glResourcesInterval_)
+			return;
+		lastGLResourcesReport_ = now;
+		glResources.printReport(std::cout);
+	}
+
+	// Options de ligne de commande du mode sans fenêtre (voir WindowSettings). Elles s'ajoutent aux paramètres donnés par l'application, qui n'a donc rien à changer. Les autres arguments sont ignorés.
+	void parseHeadlessArgs() {
+		for (int i = 1; i < argc_; i++) {
+			std::string arg = argv_[i];
+			size_t equalPos = arg.find('=');
+			std::string name = arg.substr(0, equalPos);
+			std::string value = equalPos != std::string::npos ? arg.substr(equalPos + 1) : "";
+			if (name == "--headless") {
+				settings_.headless = true;
+			} else if (name == "--frames") {
+				settings_.maxFrames = std::atoi(value.c_str());
+			} else if (name == "--fixed-dt") {
+				settings_.fixedDeltaTime = (float)std::atof(value.c_str());
+			} else if (name == "--save-frames") {
+				std::stringstream frameNumbers(value);
+				std::string frameNumber;
+				while (std::getline(frameNumbers, frameNumber, ','))
+					settings_.saveFrames.push_back(std::atoi(frameNumber.c_str()));
+			} else if (name == "--save-every") {
+				settings_.saveFrameInterval = std::atoi(value.c_str());
+			} else if (name == "--frames-folder") {
+				settings_.framesFolder = value;
+			} else if (name == "--record") {
+				settings_.record = true;
+				if (not value.empty())
+					settings_.recordInterval = std::max(std::atoi(value.c_str()), 1);
+			} else if (name == "--record-format") {
+				if (not parseImageFileFormat(value, settings_.recordFormat))
+					std::cerr << "--record-format attend png, ppm ou qoi" << std::endl;
+			} else if (name == "--record-folder") {
+				settings_.recordFolder = value;
+			} else if (name == "--on-demand") {
+				settings_.renderOnDemand = true;
+			} else if (name == "--pacing") {
+				if (not parseFramePacingMode(value, settings_.framePacing))
+					std::cerr << "--pacing attend precise, vsync ou uncapped" << std::endl;
 			}
 		}
+		if (settings_.headless and settings_.maxFrames <= 0)
+			std::cerr << "Mode sans fenêtre sans --frames=N : l'application ne s'arrêtera pas d'elle-même" << std::endl;
+	}
+
+	// Options du banc d'essai : --benchmark[=N] (N trames mesurées), --warmup=M, --benchmark-out=FICHIER.json, --baseline=FICHIER.json et --threshold=0.1.
+	// Le mode banc d'essai est déterministe : temps fixe entre les trames (1/fps si --fixed-dt n'est pas donné), pas de limite de fps, caméra scriptée et fin automatique après les mesures.
+	void parseBenchmarkArgs() {
+		for (int i = 1; i < argc_; i++) {
+			std::string arg = argv_[i];
+			size_t equalPos = arg.find('=');
+			std::string name = arg.substr(0, equalPos);
+			std::string value = equalPos != std::string::npos ? arg.substr(equalPos + 1) : "";
+			if (name == "--benchmark") {
+				isBenchmarkRequested_ = true;
+				if (not value.empty())
+					benchmarkSettings_.numFrames = std::max(std::atoi(value.c_str()), 1);
+			} else if (name == "--warmup") {
+				benchmarkSettings_.warmupFrames = std::max(std::atoi(value.c_str()), 0);
+			} else if (name == "--benchmark-out") {
+				benchmarkSettings_.outputPath = value;
+			} else if (name == "--baseline") {
+				benchmarkSettings_.baselinePath = value;
+			} else if (name == "--threshold") {
+				benchmarkSettings_.regressionThreshold = (float)std::atof(value.c_str());
+			}
+		}
+		if (not isBenchmarkRequested_)
+			return;
+
+		if (benchmarkSettings_.outputPath.empty())
+			benchmarkSettings_.outputPath = (std::filesystem::path("benchmarks") / (getExecutableName() + ".json")).string();
+		if (settings_.fixedDeltaTime <= 0)
+			settings_.fixedDeltaTime = 1.0f / settings_.fps;
+		settings_.framePacing = FramePacingMode::Uncapped;
+		settings_.maxFrames = benchmarkSettings_.warmupFrames + benchmarkSettings_.numFrames;
+	}
+
+	// La caméra scriptée du banc d'essai : un glissement constant avec le bouton droit, comme si on faisait tourner la caméra autour de la scène. Les exemples le reçoivent par onMouseMove comme un vrai mouvement, donc chaque exécution voit exactement les mêmes vues.
+	void injectScriptedCameraMove() {
+		auto windowSize = getWindowSize();
+		MouseState mouse = {};
+		mouse.buttons[(int)sf::Mouse::Button::Right] = true;
+		mouse.relative = {(int)windowSize.x / 2, (int)windowSize.y / 2};
+		mouse.absolute = mouse.relative;
+		mouse.isInsideWindow = true;
+		lastMouseState_ = currentMouseState_ = mouse;
+		onMouseMove({{benchmarkSettings_.cameraPixelsPerFrame, 0}}); // À surcharger
+	}
+
+	// Options de la trace d'appels OpenGL : --gl-trace=FICHIER et --gl-trace-frames=N (sinon jusqu'à la fermeture). Voir GLTrace.hpp et l'outil Extra_GLTraceReplay.
+	void parseGLTraceArgs() {
+		for (int i = 1; i < argc_; i++) {
+			std::string arg = argv_[i];
+			size_t equalPos = arg.find('=');
+			std::string name = arg.substr(0, equalPos);
+			std::string value = equalPos != std::string::npos ? arg.substr(equalPos + 1) : "";
+			if (name == "--gl-trace")
+				glTracePath_ = not value.empty() ? value : getExecutableName() + ".gltrace";
+			else if (name == "--gl-trace-frames")
+				glTraceFrames_ = std::atoi(value.c_str());
+		}
+		// Les deux se servent des rappels de glbinding, et l'enregistrement fausserait les mesures de toute façon.
+		if (not glTracePath_.empty() and isBenchmarkRequested_) {
+			std::cerr << "--gl-trace est ignoré avec --benchmark" << std::endl;
+			glTracePath_.clear();
+		}
+	}
+
+	// --gl-debug demande un contexte de débogage et active la sortie de débogage d'OpenGL (voir GLDebugOutput.hpp). --gl-debug-break arrête en plus le programme dans le débogueur à la première erreur.
+	void parseGLDebugArgs() {
+		for (int i = 1; i < argc_; i++) {
+			std::string_view arg = argv_[i];
+			if (arg == "--gl-debug") {
+				isGLDebugRequested_ = true;
+			} else if (arg == "--gl-debug-break") {
+				isGLDebugRequested_ = true;
+				isGLDebugBreakRequested_ = true;
+			}
+		}
+		if (isGLDebugRequested_)
+			settings_.context.attributeFlags |= sf::ContextSettings::Debug;
+	}
+
+	// Paquets de ressources (voir AssetPack.hpp et l'outil Extra_AssetPacker) : assets.pack dans le dossier courant s'il existe, ou ceux donnés par --pack=FICHIER (plusieurs permis). --no-pack force la lecture des fichiers séparés, par exemple pendant qu'on modifie les nuanceurs.
+	void mountAssetPacks() {
+		std::vector<std::string> packPaths;
+		bool isDisabled = false;
+		for (int i = 1; i < argc_; i++) {
+			std::string_view arg = argv_[i];
+			if (arg.starts_with("--pack="))
+				packPaths.emplace_back(arg.substr(7));
+			else if (arg == "--no-pack")
+				isDisabled = true;
+		}
+		if (isDisabled)
+			return;
+		if (packPaths.empty() and std::filesystem::exists("assets.pack"))
+			packPaths.push_back("assets.pack");
+		for (auto&& path : packPaths) {
+			if (assetPacks.mount(path))
+				std::cout << "Ressources lues dans " << path << std::endl;
+		}
+	}
+
+	void startGLTrace() {
+		sf::Vector2u size = settings_.headless ? settings_.videoMode.size : window_.getSize();
+		if (glTrace_.start(glTracePath_, size.x, size.y))
+			std::cout << "Enregistrement de la trace OpenGL dans " << glTracePath_ << std::endl;
+	}
+
+	void stopGLTrace() {
+		if (not glTrace_.isRecording())
+			return;
+		glTrace_.stop();
+		std::cout << std::format("Trace OpenGL : {} appels sur {} trames, {:.1f} Mo dans {}", glTrace_.getNumCalls(), glTrace_.getNumFrames(), glTrace_.getNumBytes() / 1e6, glTracePath_) << std::endl;
+	}
+
+	std::string getExecutableName() const {
+		return std::filesystem::path(argv_[0]).stem().string();
+	}
+
+	bool createHeadlessContext() {
+		if (not headlessContext_.create(settings_.context)) {
+			std::cerr << "Impossible de créer le contexte OpenGL sans fenêtre" << std::endl;
+			return false;
+		}
+		headlessContext_.initializeGLBinding();
+		isHeadlessRunning_ = true;
+		return true;
+	}
+
+	// Le FBO qui remplace le tampon de la fenêtre. Il devient le framebuffer par défaut de glState, donc les exemples qui lient 0 dessinent dedans.
+	void createHeadlessFramebuffer() {
+		headlessSize_ = {(int)settings_.videoMode.size.x, (int)settings_.videoMode.size.y};
+		int samples = std::max((int)settings_.context.antiAliasingLevel, 1);
+		headlessColor_ = RenderTarget::create({headlessSize_, GL_RGBA8, samples}, "sans fenêtre (couleur)");
+		headlessFramebuffer_.create("sans fenêtre");
+		headlessFramebuffer_.attachColor(0, headlessColor_);
+		if (settings_.context.depthBits > 0 or settings_.context.stencilBits > 0) {
+			headlessDepth_ = RenderTarget::create({headlessSize_, GL_DEPTH24_STENCIL8, samples}, "sans fenêtre (profondeur)");
+			headlessFramebuffer_.attachDepth(headlessDepth_);
+		}
+		headlessFramebuffer_.finalize();
+		// Un FBO multiéchantillonné ne se lit pas directement avec glReadPixels : on le résout dans un deuxième avant les captures.
+		if (samples > 1) {
+			headlessResolveColor_ = RenderTarget::create({headlessSize_, GL_RGBA8, 1}, "sans fenêtre (résolution)");
+			headlessResolveFramebuffer_.create("sans fenêtre (résolution)");
+			headlessResolveFramebuffer_.attachColor(0, headlessResolveColor_);
+			headlessResolveFramebuffer_.finalize();
+		}
+
+		glState.setDefaultFramebuffer(headlessFramebuffer_.getObject());
+		glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		// Sans surface, le viewport initial du contexte est vide.
+		glState.viewport(0, 0, headlessSize_.x, headlessSize_.y);
+		lastResize_ = {{(unsigned)headlessSize_.x, (unsigned)headlessSize_.y}};
+	}
+
+	void deleteHeadlessObjects() {
+		glState.setDefaultFramebuffer(0);
+		headlessFramebuffer_.deleteObject();
+		headlessResolveFramebuffer_.deleteObject();
+		headlessColor_.deleteObject();
+		headlessDepth_.deleteObject();
+		headlessResolveColor_.deleteObject();
+		headlessContext_.destroy();
+	}
+
+	// Écrire la trame qui vient d'être affichée si elle fait partie de celles demandées (WindowSettings::saveFrames et saveFrameInterval). close() attend l'écriture des dernières trames.
+	void saveFrameIfSelected() {
+		bool isSelected = std::find(settings_.saveFrames.begin(), settings_.saveFrames.end(), frame_) != settings_.saveFrames.end();
+		if (settings_.saveFrameInterval > 0 and frame_ % settings_.saveFrameInterval == 0)
+			isSelected = true;
+		if (not isSelected)
+			return;
+		CPU_PROFILE_SCOPE("saveFrame");
+		std::filesystem::create_directory(settings_.framesFolder);
+		captureFrameAsync(makeOutputFilename(settings_.framesFolder, "png"), ImageFileFormat::Png);
+	}
+
+	void recordFrameIfNeeded() {
+		if (not isRecording_ or (frame_ - recordingFirstFrame_) % recordingInterval_ != 0)
+			return;
+		std::string filename = std::format("{:06}.{}", numRecordedFrames_, getImageFileExtension(recordingFormat_));
+		captureFrameAsync((recordingFolder_ / filename).string(), recordingFormat_);
+		numRecordedFrames_++;
+	}
+
+	// Comme captureCurrentFrame, mais la copie est faite dans un PBO de FrameCapture et le fichier est écrit plus tard.
+	void captureFrameAsync(const std::string& path, ImageFileFormat format, GLenum buffer = GL_FRONT) {
+		auto windowSize = getWindowSize();
+		if (settings_.headless) {
+			const Framebuffer& source = headlessResolveFramebuffer_.getObject() != 0 ? headlessResolveFramebuffer_ : headlessFramebuffer_;
+			if (&source != &headlessFramebuffer_)
+				headlessFramebuffer_.resolveTo(headlessResolveFramebuffer_);
+			source.bind(GL_READ_FRAMEBUFFER);
+			frameCapture_.capture(0, 0, windowSize.x, windowSize.y, path, format);
+			glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		} else {
+			GLint readBufferSrc;
+			glGetIntegerv(GL_READ_BUFFER, &readBufferSrc);
+			glReadBuffer(buffer);
+			frameCapture_.capture(0, 0, windowSize.x, windowSize.y, path, format);
+			glReadBuffer((GLenum)readBufferSrc);
+		}
+	}
+
+	// Fermer l'application : onClose(), puis la fenêtre ou le contexte sans fenêtre. La boucle de run() se termine à la fin de la trame.
+	void close() {
+		benchmark_.cancel();
+		stopGLTrace();
+		stopRecording();
+		if (framePacer_.getMode() != FramePacingMode::Uncapped)
+			framePacer_.print(std::cout);
+		if constexpr (isHeapAllocationTrackingEnabled)
+			printHeapAllocations();
+		// Les captures en cours ont besoin du contexte pour être lues.
+		frameCapture_.deleteObjects();
+		glFinish();
+		onClose(); // À surcharger
+		// Terminer les tâches encore en cours (par exemple des fichiers à écrire) et arrêter les fils avant de détruire le contexte.
+		jobSystem.shutdown();
+		glFinish();
+		// Les objets possédés par un GLObject ou un GLOwned (par exemple des membres de l'application) sont supprimés ici, tant que le contexte existe encore.
+		glDeletionQueue.shutdown();
+		glDebugOutput.disable();
+		if (settings_.headless) {
+			deleteHeadlessObjects();
+			isHeadlessRunning_ = false;
+		} else {
+			window_.close();
+		}
+		glDebugOutput.printSummary(std::cerr);
+		// Ce qui reste dans le registre n'a été supprimé ni par onClose() ni par un propriétaire : ce sont des fuites.
+		glResources.printLeaks(std::cerr);
+		glResources.clear();
 	}
 
 	void createWindowAndContext(std::string_view title) {
@@ -314,7 +941,9 @@ protected:
 			sf::State::Windowed,
 			settings_.context
 		);
-		window_.setFramerateLimit(settings_.fps);
+		// Le fps est respecté par FramePacer plutôt que par setFramerateLimit. La synchronisation verticale n'est activée qu'avec FramePacingMode::VSync (jamais pour le banc d'essai, qui mesure le coût réel des trames).
+		window_.setFramerateLimit(0);
+		window_.setVerticalSyncEnabled(settings_.framePacing == FramePacingMode::VSync);
 		bool ok = window_.setActive(true);
 		if (not ok)
 			std::cerr << "Could not activate created window" << "\n";
@@ -325,20 +954,95 @@ protected:
 		glbinding::Binding::initialize(nullptr, true);
 	}
 
+	// Faire autant de pas fixes de update() que le temps écoulé en contient. Le reste du temps est gardé pour la prochaine trame et donne le facteur d'interpolation de drawFrame().
+	void runFixedUpdates() {
+		updateAccumulator_ += deltaTime_;
+		int numUpdates = 0;
+		while (updateAccumulator_ >= updateDeltaTime_ and numUpdates < settings_.maxUpdatesPerFrame) {
+			update(updateDeltaTime_); // À surcharger
+			updateAccumulator_ -= updateDeltaTime_;
+			numUpdates++;
+		}
+		if (updateAccumulator_ >= updateDeltaTime_) {
+			int numDropped = (int)(updateAccumulator_ / updateDeltaTime_);
+			numDroppedUpdates_ += numDropped;
+			updateAccumulator_ -= numDropped * updateDeltaTime_;
+		}
+		interpolationAlpha_ = updateAccumulator_ / updateDeltaTime_;
+	}
+
 	void updateDeltaTime() {
 		using namespace std::chrono;
-		auto t = high_resolution_clock::now();
+		auto t = steady_clock::now();
 		duration<float> dt = t - lastFrameTime_;
-		deltaTime_ = dt.count();
+		deltaTime_ = settings_.fixedDeltaTime > 0 ? settings_.fixedDeltaTime : dt.count();
 		lastFrameTime_ = t;
 	}
 
+	// Seulement avec INF2705_TRACK_HEAP_ALLOCATIONS (voir FrameArena.hpp). Comme pour FramePacer, on garde les dernières trames seulement. La capacité est réservée d'avance pour que le compteur ne compte pas ses propres allocations.
+	void recordHeapAllocations(size_t numAllocations) {
+		static constexpr size_t maxSamples = 20000;
+		if (heapAllocationsPerFrame_.capacity() < maxSamples)
+			heapAllocationsPerFrame_.reserve(maxSamples);
+		if (heapAllocationsPerFrame_.size() >= maxSamples)
+			heapAllocationsPerFrame_.erase(heapAllocationsPerFrame_.begin(), heapAllocationsPerFrame_.begin() + maxSamples / 2);
+		heapAllocationsPerFrame_.push_back((float)numAllocations);
+	}
+
+	void printHeapAllocations() const {
+		PercentileStats stats = PercentileStats::compute(heapAllocationsPerFrame_);
+		std::cout << std::format(
+			"Allocations sur le tas par trame : p50 {:.0f}, p95 {:.0f}, max {:.0f}, moy {:.2f} (dernière trame : {:.0f})",
+			stats.p50, stats.p95, stats.max, stats.avg,
+			heapAllocationsPerFrame_.empty() ? 0.0f : heapAllocationsPerFrame_.back()
+		) << "\n";
+		std::cout << std::format(
+			"Arène de trame : {:.1f} Kio au maximum, {} allocation(s) hors du bloc",
+			frameArena.getPeakBytes() / 1024.0,
+			frameArena.getNumOverflows()
+		) << std::endl;
+	}
+
 	sf::RenderWindow window_;
+	Benchmark benchmark_;
+	BenchmarkSettings benchmarkSettings_;
+	bool isBenchmarkRequested_ = false;
+	FrameCapture frameCapture_;
+	bool isRecording_ = false;
+	std::filesystem::path recordingFolder_;
+	int recordingInterval_ = 1;
+	int recordingFirstFrame_ = 0;
+	int numRecordedFrames_ = 0;
+	ImageFileFormat recordingFormat_ = ImageFileFormat::Qoi;
+	GLTraceRecorder glTrace_;
+	std::string glTracePath_;
+	int glTraceFrames_ = 0;
+	float glResourcesInterval_ = 0;
+	bool isGLDebugRequested_ = false;
+	bool isGLDebugBreakRequested_ = false;
+	std::chrono::steady_clock::time_point lastGLResourcesReport_;
+	HeadlessContext headlessContext_;
+	bool isHeadlessRunning_ = false;
+	ivec2 headlessSize_ = {};
+	RenderTarget headlessColor_;
+	RenderTarget headlessDepth_;
+	RenderTarget headlessResolveColor_;
+	Framebuffer headlessFramebuffer_;
+	Framebuffer headlessResolveFramebuffer_;
 	sf::Event::Resized lastResize_ = {};
 	int frame_ = 0;
 	float deltaTime_ = 0.0f;
+	float updateDeltaTime_ = 1.0f / 60;
+	float updateAccumulator_ = 0.0f;
+	float interpolationAlpha_ = 0.0f;
+	int numDroppedUpdates_ = 0;
 	std::chrono::system_clock::time_point startTime_;
-	std::chrono::high_resolution_clock::time_point lastFrameTime_;
+	// Horloge monotone : high_resolution_clock peut être l'horloge système, qui saute quand l'heure est ajustée.
+	std::chrono::steady_clock::time_point lastFrameTime_;
+	FramePacer framePacer_;
+	std::vector<float> heapAllocationsPerFrame_;
+	std::vector<sf::Event> pendingEvents_;
+	std::atomic<bool> isRedrawRequested_ = true;
 	MouseState lastMouseState_ = {};
 	MouseState currentMouseState_ = {};
 
@@ -365,6 +1069,12 @@ inline void printGLError(std::string_view sourceFile = "", int sourceLine = -1)
 		{GL_TEXTURE_TOO_LARGE_EXT, "GL_TEXTURE_TOO_LARGE_EXT"},
 	};
 
+	// Avec la sortie de débogage (--gl-debug), les erreurs arrivent déjà par le rappel, avec plus de détails : on traite les messages en attente plutôt que d'interroger glGetError, qui force une synchronisation avec le pilote.
+	if (glDebugOutput.isEnabled()) {
+		glDebugOutput.flush();
+		return;
+	}
+
 	std::string sourceFileStr = "";
 	if (not sourceFile.empty()) {
 		std::string filename = std::filesystem::path(sourceFile).filename().string();
@@ -0,0 +1,20 @@
+# Options de compilation communes à tous les exemples. À inclure après add_executable : les options s'appliquent à la cible ${PROJECT_NAME}.
+#   include("${CMAKE_CURRENT_SOURCE_DIR}/../inf2705/Options.cmake")
+
+# EGL (optionnel, Linux) : contexte OpenGL sans fenêtre ni serveur d'affichage pour le mode --headless, par exemple avec le rendu logiciel de Mesa.
+#      Sans cette option, le mode sans fenêtre utilise un contexte caché de SFML.
+option(INF2705_HEADLESS_EGL "Créer le contexte du mode sans fenêtre avec EGL" OFF)
+if (INF2705_HEADLESS_EGL)
+    find_library(EGL_LIBRARY EGL)
+    if (NOT EGL_LIBRARY)
+        message(FATAL_ERROR "INF2705_HEADLESS_EGL : bibliothèque EGL introuvable (libEGL)")
+    endif()
+    target_compile_definitions(${PROJECT_NAME} PRIVATE INF2705_HEADLESS_EGL)
+    target_link_libraries(${PROJECT_NAME} PRIVATE ${EGL_LIBRARY})
+endif()
+
+# Compteur d'allocations sur le tas (optionnel) : remplace new et delete pour afficher le nombre d'allocations par trame (voir inf2705/FrameArena.hpp).
+option(INF2705_TRACK_HEAP_ALLOCATIONS "Compter les allocations sur le tas à chaque trame" OFF)
+if (INF2705_TRACK_HEAP_ALLOCATIONS)
+    target_compile_definitions(${PROJECT_NAME} PRIVATE INF2705_TRACK_HEAP_ALLOCATIONS)
+endif()
@@ -0,0 +1,187 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <bit>
+#include <functional>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.hpp"
+#include "ShaderProgram.hpp"
+#include "Texture.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Un paquet de dessin : tout ce qu'il faut pour dessiner un objet (programme, textures, mesh, variables uniformes), mais sans l'avoir encore dessiné.
+struct DrawPacket
+{
+	static constexpr int maxTextures = 4;
+
+	ShaderProgram* program = nullptr;
+	Mesh* mesh = nullptr;
+	std::array<Texture*, maxTextures> textures = {}; // L'index est l'unité de texture. nullptr = rien à lier.
+	mat4 model = mat4(1); // Envoyée à la variable uniforme « model ».
+	std::function<void(ShaderProgram&)> setUniforms; // Les autres variables uniformes propres à l'objet (optionnel).
+	GLenum drawMode = GL_TRIANGLES;
+	bool isTranslucent = false;
+};
+
+// Ce que la dernière exécution de la file a coûté en changements d'état.
+struct RenderQueueStats
+{
+	int numDraws = 0;
+	int programChanges = 0;
+	int textureChanges = 0;
+	int meshChanges = 0;
+};
+
+// Une file de rendu. Plutôt que de dessiner les objets dans l'ordre du code (ou d'un hash map), on les soumet comme paquets, on les trie puis on les dessine.
+// Chaque paquet reçoit une clé de tri de 64 bits construite pour que l'ordre croissant des clés soit le bon ordre de dessin :
+//   - Objets opaques d'abord. On les groupe par programme, puis texture, puis mesh pour changer d'état le moins souvent possible, et à état égal on va de l'avant vers l'arrière pour que le test de profondeur élimine le plus de fragments possible.
+//       [63] = 0 | [62..51] programme | [50..35] texture | [34..23] mesh | [22..0] profondeur
+//   - Objets translucides ensuite, de l'arrière vers l'avant (sinon la fusion de couleurs est fausse), donc la profondeur inversée passe avant l'état.
+//       [63] = 1 | [62..39] profondeur inversée | [38..27] programme | [26..11] texture | [10..0] mesh
+// Les ID OpenGL sont tronqués pour entrer dans leurs bits. Deux objets différents peuvent donc avoir le même morceau de clé, ce qui nuit un peu au regroupement mais jamais au résultat.
+class RenderQueue
+{
+public:
+	// La matrice de visualisation sert à calculer la profondeur de chaque objet (celle de son origine).
+	void setViewMatrix(const mat4& view) { view_ = view; }
+
+	void submit(DrawPacket packet) {
+		vec4 viewPosition = view_ * packet.model[3];
+		float depth = -viewPosition.z;
+		keys_.push_back(makeSortKey(packet, depth));
+		packets_.push_back(std::move(packet));
+	}
+
+	size_t size() const { return packets_.size(); }
+	const RenderQueueStats& getLastStats() const { return stats_; }
+
+	// Trier, dessiner puis vider la file.
+	void flush() {
+		sort();
+		execute();
+		clear();
+	}
+
+	// Trier les paquets selon leur clé (tri par base, ou radix sort).
+	void sort() {
+		size_t n = keys_.size();
+		order_.resize(n);
+		for (size_t i = 0; i < n; i++)
+			order_[i] = (uint32_t)i;
+		radixSort(keys_, order_);
+	}
+
+	// Dessiner les paquets dans l'ordre trié. On ne change le programme, les textures et le mesh que s'ils diffèrent du paquet précédent.
+	void execute() {
+		stats_ = {};
+		ShaderProgram* currentProgram = nullptr;
+		const Mesh* currentMesh = nullptr;
+		std::array<const Texture*, DrawPacket::maxTextures> currentTextures = {};
+
+		for (uint32_t i : order_) {
+			DrawPacket& packet = packets_[i];
+			if (packet.program != currentProgram) {
+				currentProgram = packet.program;
+				currentProgram->use();
+				stats_.programChanges++;
+			}
+			for (int unit = 0; unit < DrawPacket::maxTextures; unit++) {
+				Texture* tex = packet.textures[unit];
+				if (tex != nullptr and tex != currentTextures[unit]) {
+					tex->bindToTextureUnit(unit);
+					currentTextures[unit] = tex;
+					stats_.textureChanges++;
+				}
+			}
+
+			modelUniform_ = packet.model;
+			currentProgram->setUniform(modelUniform_);
+			if (packet.setUniforms)
+				packet.setUniforms(*currentProgram);
+
+			if (packet.mesh != currentMesh) {
+				currentMesh = packet.mesh;
+				stats_.meshChanges++;
+			}
+			packet.mesh->draw(packet.drawMode);
+			stats_.numDraws++;
+		}
+	}
+
+	void clear() {
+		packets_.clear();
+		keys_.clear();
+		order_.clear();
+	}
+
+	static uint64_t makeSortKey(const DrawPacket& packet, float depth) {
+		uint64_t program = packet.program != nullptr ? packet.program->getObject() : 0;
+		uint64_t texture = packet.textures[0] != nullptr ? packet.textures[0]->id : 0;
+		uint64_t mesh = packet.mesh != nullptr ? packet.mesh->vao : 0;
+
+		if (not packet.isTranslucent) {
+			return (0ull << 63)
+				| ((program & 0xFFF) << 51)
+				| ((texture & 0xFFFF) << 35)
+				| ((mesh & 0xFFF) << 23)
+				| quantizeDepth(depth, 23);
+		} else {
+			uint64_t invDepth = ~quantizeDepth(depth, 24) & 0xFFFFFF;
+			return (1ull << 63)
+				| (invDepth << 39)
+				| ((program & 0xFFF) << 27)
+				| ((texture & 0xFFFF) << 11)
+				| (mesh & 0x7FF);
+		}
+	}
+
+private:
+	// Les bits d'un float positif, lus comme un entier, sont dans le même ordre que les valeurs. Garder les `numBits` bits du haut donne donc une profondeur quantifiée (plus précise près de la caméra) sans avoir besoin des plans avant et arrière.
+	static uint64_t quantizeDepth(float depth, int numBits) {
+		uint32_t bits = std::bit_cast<uint32_t>(depth > 0 ? depth : 0.0f);
+		return bits >> (31 - numBits);
+	}
+
+	// Tri par base (LSD) de 8 bits à la fois. C'est linéaire en nombre de paquets et stable. On saute les passes où tous les paquets ont le même octet, ce qui est fréquent (peu de programmes, peu de textures).
+	void radixSort(const std::vector<uint64_t>& keys, std::vector<uint32_t>& order) {
+		size_t n = order.size();
+		tmpOrder_.resize(n);
+		for (int shift = 0; shift < 64; shift += 8) {
+			std::array<size_t, 257> counts = {};
+			for (uint32_t i : order)
+				counts[((keys[i] >> shift) & 0xFF) + 1]++;
+			bool isSingleBucket = false;
+			for (size_t c : counts) {
+				if (c == n)
+					isSingleBucket = true;
+			}
+			if (isSingleBucket)
+				continue;
+			for (int b = 0; b < 256; b++)
+				counts[b + 1] += counts[b];
+			for (uint32_t i : order)
+				tmpOrder_[counts[(keys[i] >> shift) & 0xFF]++] = i;
+			order.swap(tmpOrder_);
+		}
+	}
+
+	std::vector<DrawPacket> packets_;
+	std::vector<uint64_t> keys_;
+	std::vector<uint32_t> order_;
+	std::vector<uint32_t> tmpOrder_;
+	mat4 view_ = mat4(1);
+	Uniform<mat4> modelUniform_ = {"model"};
+	RenderQueueStats stats_;
+};
@@ -6,10 +6,12 @@
 
 #include <format>
 #include <iostream>
+#include <source_location>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <type_traits>
+#include <vector>
 
 #include <glbinding/gl/gl.h>
 #include <glm/glm.hpp>
@@ -18,6 +20,9 @@
 
 #include "utils.hpp"
 #include "TransformStack.hpp"
+#include "UniformBufferRing.hpp"
+#include "BufferLayout.hpp"
+#include "GLStateCache.hpp"
 
 
 using namespace gl;
@@ -44,24 +49,20 @@ public:
 		return it != shadersByType_.end() ? it->second : emptyValue;
 	}
 
-	// Demander à OpenGL de créer un programme de nuanceur
-	void create() {
+	// Demander à OpenGL de créer un programme de nuanceur. Le nom et l'endroit d'où on a appelé sont donnés au registre glResources (voir GLResources.hpp).
+	void create(std::string_view label = "programme", std::source_location where = std::source_location::current()) {
 		if (programObject_ != 0)
 			*this = {};
 		programObject_ = glCreateProgram();
+		glResources.track(GLResourceType::Program, programObject_, label, where);
 	}
 
 	// Associer le contenu d'un fichier au nuanceur spécifié.
-	GLuint attachSourceFile(GLenum type, std::string_view filename) {
+	GLuint attachSourceFile(GLenum type, std::string_view filename, std::source_location where = std::source_location::current()) {
 		if (programObject_ == 0)
-			create();
+			create(filename, where);
 
-		// Créer le nuanceur.
-		GLuint shaderObject = glCreateShader(type);
-		if (shaderObject == 0)
-			return 0;
-
-		// Charger la source et compiler.
+		// Charger la source.
 		std::string source;
 		try {
 			source = readFile(filename);
@@ -69,8 +70,24 @@ public:
 			std::cerr << "Could not open shader file " << filename << std::endl;
 			return 0;
 		}
-		auto src = source.c_str();
-		glShaderSource(shaderObject, 1, &src, nullptr);
+
+		return attachSource(type, source, filename);
+	}
+
+	// Compiler une source déjà en mémoire (par exemple un nuanceur fourni par un entête de inf2705) et l'associer au programme. Le nom sert seulement aux messages d'erreur.
+	GLuint attachSource(GLenum type, std::string_view source, std::string_view name) {
+		if (programObject_ == 0)
+			create(name);
+
+		// Créer le nuanceur.
+		GLuint shaderObject = glCreateShader(type);
+		if (shaderObject == 0)
+			return 0;
+
+		// Compiler.
+		auto src = source.data();
+		GLint srcLength = (GLint)source.size();
+		glShaderSource(shaderObject, 1, &src, &srcLength);
 		glCompileShader(shaderObject);
 
 		// Afficher le message d'erreur si applicable.
@@ -79,7 +96,7 @@ public:
 		if (infologLength > 1) {
 			std::string infoLog(infologLength, '\0');
 			glGetShaderInfoLog(shaderObject, infologLength, nullptr, infoLog.data());
-			std::cerr << std::format("Compilation Error in '{}':\n{}", filename, infoLog) << std::endl;
+			std::cerr << std::format("Compilation Error in '{}':\n{}", name, infoLog) << std::endl;
 			glDeleteShader(shaderObject);
 			return 0;
 		}
@@ -115,11 +132,11 @@ public:
 
 	// Utiliser ce programme comme pipeline graphique
 	void use() {
-		glUseProgram(programObject_);
+		glState.useProgram(programObject_);
 	}
 
 	void unuse() {
-		glUseProgram(0);
+		glState.useProgram(0);
 	}
 
 	void deleteShaders() {
@@ -134,7 +151,7 @@ public:
 	}
 
 	void deleteProgram() {
-		glDeleteProgram(programObject_);
+		glState.deleteProgram(programObject_);
 		programObject_ = 0;
 		unuse();
 	}
@@ -321,6 +338,34 @@ protected:
 	std::unordered_map<GLuint, GLuint> locs_;
 };
 
+// Comparer les décalages déclarés d'une struct (avec DECLARE_BLOCK_LAYOUT) à ceux que le compilateur GLSL a vraiment choisis pour un bloc. Les clés de glslOffsets sont les noms de membres tels que rapportés par OpenGL (ex. « LightSource.position » ou « Objects.objects[0].position »). Les différences sont affichées dans std::cerr.
+template <typename T>
+bool reportBlockLayoutMismatches(std::string_view blockName, GLuint progObj, const std::unordered_map<std::string, GLint>& glslOffsets) {
+	bool ok = true;
+	for (auto&& [glslName, glslOffset] : glslOffsets) {
+		// Garder seulement le nom du membre, sans le préfixe du bloc et sans le [0] des tableaux.
+		std::string_view memberName = glslName;
+		memberName = memberName.substr(memberName.rfind('.') + 1);
+		if (memberName.ends_with("[0]"))
+			memberName.remove_suffix(3);
+
+		const BlockMemberInfo* member = nullptr;
+		for (auto& m : BlockLayoutOf<T>::members) {
+			if (m.name == memberName)
+				member = &m;
+		}
+		if (member == nullptr) {
+			std::cerr << std::format("Layout Error in block '{}' of program {}: member '{}' is not declared in C++", blockName, progObj, memberName) << "\n";
+			ok = false;
+		} else if ((size_t)glslOffset != member->offset) {
+			std::cerr << std::format("Layout Error in block '{}' of program {}: member '{}' is at offset {} in C++ but {} in GLSL", blockName, progObj, memberName, member->offset, glslOffset) << "\n";
+			ok = false;
+		}
+	}
+	// Les membres déclarés en C++ mais absents de glslOffsets sont simplement inutilisés par les nuanceurs (le compilateur GLSL les a peut-être éliminés), ce n'est pas une erreur.
+	return ok;
+}
+
 // Un bloc de données uniforme. C'est une variable uniforme mais chargé dans un buffer (un Uniform Buffer Object, ou UBO) et un index plutôt qu'avec des glUniform*. On hérite de Uniform<T> pour réutiliser les fonctionnalités de sauvegarde de localisation.
 template <typename T>
 class UniformBlock : public Uniform<T>
@@ -348,22 +393,69 @@ public:
 		bindingIndex_ = bindingIndex;
 	}
 
-	void setup(GLenum usageMode = GL_DYNAMIC_COPY) {
-		if (ubo_ == 0)
+	void setup(GLenum usageMode = GL_DYNAMIC_COPY, std::source_location where = std::source_location::current()) {
+		if (ubo_ == 0) {
 			glGenBuffers(1, &ubo_);
-		glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+			glResources.track(GLResourceType::Buffer, ubo_, std::format("bloc {} (UBO)", this->getName()), where);
+		}
+		glState.bindBuffer(GL_UNIFORM_BUFFER, ubo_);
 		glBufferData(GL_UNIFORM_BUFFER, sizeof(this->get()), &this->get(), usageMode);
-		glBindBufferBase(GL_UNIFORM_BUFFER, bindingIndex_, ubo_);
+		glResources.setSize(GLResourceType::Buffer, ubo_, sizeof(this->get()));
+		glState.bindBufferBase(GL_UNIFORM_BUFFER, bindingIndex_, ubo_);
 	}
 
 	void updateBuffer() {
-		glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+		glState.bindBuffer(GL_UNIFORM_BUFFER, ubo_);
 		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(this->get()), &this->get());
 	}
 
+	// Copier la valeur dans une portion fraîche de l'anneau et lier cette portion à l'index de liaison du bloc. Contrairement à updateBuffer(), on n'écrase jamais des données que le GPU est peut-être encore en train de lire, donc pas d'attente. On peut l'appeler avant chaque dessin avec une valeur différente.
+	UniformBufferRange updateBuffer(UniformBufferRing& ring) {
+		UniformBufferRange range = ring.allocate(this->get());
+		range.bind(bindingIndex_);
+		return range;
+	}
+
+	// Lier le bloc du programme à l'index de liaison. C'est fait après l'édition de liens, donc c'est aussi là qu'on vérifie que la struct C++ correspond au bloc GLSL (si sa disposition est déclarée).
 	void bindToProgram(ShaderProgram& prog) {
 		prog.use();
 		prog.bindUniformBlock(this->getLoc(prog), bindingIndex_);
+		if constexpr (hasBlockLayout_v<T>)
+			checkLayout(prog);
+	}
+
+	// Demander à OpenGL le décalage de chaque membre actif du bloc et le comparer à la struct C++. Retourne vrai si tout correspond (ou si le programme n'utilise pas le bloc).
+	bool checkLayout(const ShaderProgram& prog) const {
+		static_assert(BlockLayoutOf<T>::layout == BufferLayout::Std140, "Un bloc uniforme doit être déclaré en std140");
+		GLuint progObj = prog.getObject();
+		GLuint blockIndex = this->getLoc(prog);
+		if (blockIndex == GL_INVALID_INDEX)
+			return true;
+
+		GLint numUniforms = 0;
+		glGetActiveUniformBlockiv(progObj, blockIndex, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &numUniforms);
+		std::vector<GLint> indices(numUniforms);
+		glGetActiveUniformBlockiv(progObj, blockIndex, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+		std::vector<GLuint> uniformIndices(indices.begin(), indices.end());
+		std::vector<GLint> offsets(numUniforms);
+		glGetActiveUniformsiv(progObj, numUniforms, uniformIndices.data(), GL_UNIFORM_OFFSET, offsets.data());
+
+		std::unordered_map<std::string, GLint> glslOffsets;
+		for (int i = 0; i < numUniforms; i++) {
+			char name[256] = {};
+			glGetActiveUniformName(progObj, uniformIndices[i], sizeof(name), nullptr, name);
+			glslOffsets[name] = offsets[i];
+		}
+		bool ok = reportBlockLayoutMismatches<T>(this->getName(), progObj, glslOffsets);
+
+		// Le pilote peut arrondir la taille du bloc (souvent à 16 octets), mais elle ne doit pas dépasser ce qu'on copie.
+		GLint dataSize = 0;
+		glGetActiveUniformBlockiv(progObj, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+		if ((size_t)dataSize > (sizeof(T) + 15) / 16 * 16) {
+			std::cerr << std::format("Layout Error in block '{}' of program {}: block is {} bytes in GLSL but {} in C++", this->getName(), progObj, dataSize, sizeof(T)) << "\n";
+			ok = false;
+		}
+		return ok;
 	}
 
 	GLuint queryUniformLocation(const ShaderProgram& prog) const override {
@@ -371,10 +463,127 @@ public:
 	}
 
 	void deleteObject() {
-		glDeleteBuffers(1, &ubo_);
+		glState.deleteBuffers(1, &ubo_);
 	}
 
 private:
 	GLuint ubo_ = 0;
 	GLuint bindingIndex_ = -1;
 };
+
+// Un tableau de structs dans un tampon de stockage (un Shader Storage Buffer Object, ou SSBO, OpenGL 4.3). Dans les nuanceurs, c'est un bloc « buffer » en disposition std430 dont le seul membre est un tableau de taille variable :
+//     layout(std430) buffer ObjectData { ObjectInfo objects[]; };
+// Contrairement aux blocs uniformes, la taille n'est pas limitée à quelques dizaines de Ko et std430 n'arrondit pas les pas des tableaux à 16 octets, donc on peut y mettre les données de milliers d'objets sans rembourrage.
+template <typename T>
+class ShaderStorageBlock : public Uniform<std::vector<T>>
+{
+public:
+	ShaderStorageBlock(const std::string& name = "", GLuint bindingIndex = -1, const std::vector<T>& values = {}) {
+		reset(name, bindingIndex, values);
+	}
+
+	ShaderStorageBlock& operator= (const ShaderStorageBlock& other) {
+		reset(other.name_, other.bindingIndex_, other.value_);
+		return *this;
+	}
+
+	ShaderStorageBlock& operator= (const std::vector<T>& values) {
+		this->get() = values;
+		return *this;
+	}
+
+	GLuint getSsbo() const { return ssbo_; }
+	GLuint getBindingIndex() const { return bindingIndex_; }
+	size_t size() const { return this->get().size(); }
+	T& operator[](size_t i) { return this->get()[i]; }
+	const T& operator[](size_t i) const { return this->get()[i]; }
+
+	void reset(const std::string& name, GLuint bindingIndex, const std::vector<T>& values = {}) {
+		Uniform<std::vector<T>>::reset(name, values);
+		bindingIndex_ = bindingIndex;
+	}
+
+	void setup(GLenum usageMode = GL_DYNAMIC_DRAW, std::source_location where = std::source_location::current()) {
+		static_assert(isStd140Copyable_v<T>, "Le type doit être copiable tel quel dans un tampon (pas de pointeurs, de bool ni de conteneurs)");
+		if (ssbo_ == 0) {
+			glGenBuffers(1, &ssbo_);
+			glResources.track(GLResourceType::Buffer, ssbo_, std::format("bloc {} (SSBO)", this->getName()), where);
+		}
+		usageMode_ = usageMode;
+		capacity_ = size();
+		glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity_ * sizeof(T), this->get().data(), usageMode_);
+		glResources.setSize(GLResourceType::Buffer, ssbo_, capacity_ * sizeof(T));
+		glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingIndex_, ssbo_);
+	}
+
+	void updateBuffer() {
+		// Si le tableau a grandi, il faut réallouer le tampon (et le relier, puisque c'est un nouveau stockage).
+		if (size() > capacity_) {
+			setup(usageMode_);
+			return;
+		}
+		glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size() * sizeof(T), this->get().data());
+	}
+
+	// Mettre à jour seulement quelques éléments.
+	void updateBuffer(size_t first, size_t count) {
+		glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(T), count * sizeof(T), this->get().data() + first);
+	}
+
+	void bindToProgram(ShaderProgram& prog) {
+		prog.use();
+		glShaderStorageBlockBinding(prog.getObject(), this->getLoc(prog), bindingIndex_);
+		if constexpr (hasBlockLayout_v<T>)
+			checkLayout(prog);
+	}
+
+	// Comme UniformBlock::checkLayout, mais avec l'interface de requête des ressources de programme (OpenGL 4.3). On vérifie aussi que le pas du tableau est sizeof(T).
+	bool checkLayout(const ShaderProgram& prog) const {
+		static_assert(BlockLayoutOf<T>::layout == BufferLayout::Std430, "Un tampon de stockage doit être déclaré en std430");
+		GLuint progObj = prog.getObject();
+		GLuint blockIndex = this->getLoc(prog);
+		if (blockIndex == GL_INVALID_INDEX)
+			return true;
+
+		GLenum numVarsProp = GL_NUM_ACTIVE_VARIABLES;
+		GLint numVars = 0;
+		glGetProgramResourceiv(progObj, GL_SHADER_STORAGE_BLOCK, blockIndex, 1, &numVarsProp, 1, nullptr, &numVars);
+		std::vector<GLint> vars(numVars);
+		GLenum varsProp = GL_ACTIVE_VARIABLES;
+		glGetProgramResourceiv(progObj, GL_SHADER_STORAGE_BLOCK, blockIndex, 1, &varsProp, numVars, nullptr, vars.data());
+
+		bool ok = true;
+		std::unordered_map<std::string, GLint> glslOffsets;
+		for (GLint var : vars) {
+			GLenum props[] = {GL_OFFSET, GL_TOP_LEVEL_ARRAY_STRIDE};
+			GLint values[2] = {};
+			glGetProgramResourceiv(progObj, GL_BUFFER_VARIABLE, var, 2, props, 2, nullptr, values);
+			char name[256] = {};
+			glGetProgramResourceName(progObj, GL_BUFFER_VARIABLE, var, sizeof(name), nullptr, name);
+			glslOffsets[name] = values[0];
+			if (values[1] != 0 and (size_t)values[1] != sizeof(T)) {
+				std::cerr << std::format("Layout Error in block '{}' of program {}: array stride is {} bytes in GLSL but {} in C++", this->getName(), progObj, values[1], sizeof(T)) << "\n";
+				ok = false;
+			}
+		}
+		return reportBlockLayoutMismatches<T>(this->getName(), progObj, glslOffsets) and ok;
+	}
+
+	GLuint queryUniformLocation(const ShaderProgram& prog) const override {
+		return glGetProgramResourceIndex(prog.getObject(), GL_SHADER_STORAGE_BLOCK, this->getName().c_str());
+	}
+
+	void deleteObject() {
+		glState.deleteBuffers(1, &ssbo_);
+		ssbo_ = 0;
+	}
+
+private:
+	GLuint ssbo_ = 0;
+	GLuint bindingIndex_ = -1;
+	size_t capacity_ = 0;
+	GLenum usageMode_ = GL_DYNAMIC_DRAW;
+};
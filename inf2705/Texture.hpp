@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <source_location>
 #include <string>
 #include <format>
 
@@ -11,8 +12,11 @@
 #include <glm/glm.hpp>
 #include <SFML/Graphics.hpp>
 
+#include "AssetPack.hpp"
 #include "sfml_utils.hpp"
 #include "ShaderProgram.hpp"
+#include "GLStateCache.hpp"
+#include "CpuProfiler.hpp"
 
 
 using namespace gl;
@@ -26,8 +30,7 @@ struct Texture
 	int numLevels = 0; // Le nombre de niveaux de détails (mipmap ou manuel).
 
 	void bindToTextureUnit(int textureUnit) {
-		glActiveTexture(GL_TEXTURE0 + textureUnit);
-		glBindTexture(GL_TEXTURE_2D, id);
+		glState.bindTextureToUnit(textureUnit, GL_TEXTURE_2D, id);
 	}
 
 	void bindToTextureUnit(int textureUnit, ShaderProgram& prog, std::string_view name) {
@@ -41,7 +44,7 @@ struct Texture
 	}
 
 	void setPixelData(GLenum format, const void* data) {
-		glBindTexture(GL_TEXTURE_2D, id);
+		glState.bindTexture(GL_TEXTURE_2D, id);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -53,15 +56,22 @@ struct Texture
 			GL_UNSIGNED_BYTE,
 			data
 		);
+		glResources.setSize(GLResourceType::Texture, id, estimateTextureBytes(format, size, numLevels));
 	}
 
 	void deleteObject() {
-		glDeleteTextures(1, &id);
+		glState.deleteTextures(1, &id);
 		id = 0;
 	}
 
-	// Si detailLevels est > 1, demande à OpenGL de générer les mipmaps.
-	static Texture loadFromImage(const sf::Image& img, int detailLevels = 1) {
+	// Pour GLOwned (voir GLObject.hpp).
+	template <typename F>
+	void forEachGLObject(F&& f) const {
+		f(GLResourceType::Texture, id);
+	}
+
+	// Si detailLevels est > 1, demande à OpenGL de générer les mipmaps. Le nom et l'endroit d'où on a appelé sont donnés au registre glResources (voir GLResources.hpp).
+	static Texture loadFromImage(const sf::Image& img, int detailLevels = 1, std::string_view label = "image", std::source_location where = std::source_location::current()) {
 		// Beaucoup de bibliothèques importent les images avec x=0,y=0 (donc premier pixel du tableau) au coin haut-gauche de l'image. C'est la convention en graphisme, mais les textures en OpenGL ont leur origine au coin bas-gauche.
 		// SFML applique la convention origine = haut-gauche, il faut donc renverser l'image verticalement avant de la passer à OpenGL.
 		sf::Image texImg = img;
@@ -72,7 +82,8 @@ struct Texture
 		tex.size = {texImg.getSize().x, texImg.getSize().y};
 		tex.numLevels = detailLevels;
 		glGenTextures(1, &tex.id);
-		glBindTexture(GL_TEXTURE_2D, tex.id);
+		glResources.track(GLResourceType::Texture, tex.id, label, where);
+		glState.bindTexture(GL_TEXTURE_2D, tex.id);
 		// Passer les données de l'image (un peu comme avec glBufferData). Il faut spécifier le format interne qui sera enregistré sur le GPU ainsi que celui dont est fait le tableau de données passé en paramètre.
 		tex.setPixelData(GL_RGBA, texImg.getPixelsPtr());
 
@@ -95,29 +106,38 @@ struct Texture
 	}
 
 	// Si detailLevels est > 1, demande à OpenGL de générer les mipmaps.
-	static Texture loadFromFile(const std::string& filename, int detailLevels = 1) {
+	static Texture loadFromFile(const std::string& filename, int detailLevels = 1, std::source_location where = std::source_location::current()) {
+		CPU_PROFILE_SCOPE("Texture::loadFromFile");
 		// Lire les pixels de l'image. SFML (la bibliothèque qu'on utilise pour gérer la fenêtre) a déjà une fonctionnalité de chargement d'images. Une alternative plus légère est stb_image.
 		sf::Image texImg;
-		if (not texImg.loadFromFile(filename)) {
+		if (not loadImage(texImg, filename)) {
 			std::cerr << std::format("{} could not be loaded", filename) << "\n";
 			return {};
 		}
-		return loadFromImage(texImg, detailLevels);
+		return loadFromImage(texImg, detailLevels, filename, where);
+	}
+
+	// Charger une image du disque, ou d'un paquet de ressources monté s'il la contient (voir AssetPack.hpp). Dans le paquet, l'image est décodée directement depuis le fichier mappé, sans copie.
+	static bool loadImage(sf::Image& image, const std::string& filename) {
+		if (auto data = assetPacks.find(filename))
+			return image.loadFromMemory(data->data(), data->size());
+		return image.loadFromFile(filename);
 	}
 
 	// filenamePattern doit contenir un "{}" qui sera remplacé par 0 à numLevels (avec un format de spécification optionnel comme en Python).
-	static Texture loadFromMipmapFiles(const std::string& filenamePattern, int numLevels) {
+	static Texture loadFromMipmapFiles(const std::string& filenamePattern, int numLevels, std::source_location where = std::source_location::current()) {
 		// Créer et lier l'objet de texture. Quand on fait des mipmap manuellement, il faut créer une seule texture à laquelle on passe une image différente pour chaque niveau de détail.
 		Texture result = {};
 		glGenTextures(1, &result.id);
-		glBindTexture(GL_TEXTURE_2D, result.id);
+		glResources.track(GLResourceType::Texture, result.id, filenamePattern, where);
+		glState.bindTexture(GL_TEXTURE_2D, result.id);
 		// Pour chaque niveau de détails:
 		for (int i = 0; i < numLevels; i++) {
 			// Générer le nom de fichier (du beau C++20).
 			auto filename = std::vformat(filenamePattern, std::make_format_args(i));
 			// Charger l'image et la renverser verticalement (voir commentaire dans fonction précédente).
 			sf::Image texImg;
-			if (not texImg.loadFromFile(filename))
+			if (not loadImage(texImg, filename))
 				throw std::runtime_error(std::format("{} could not be loaded", filename));
 			texImg.flipVertically();
 			// Passer l'image en spécifiant le niveau de détail (2e paramètre de glTexImage2D).
@@ -145,18 +165,21 @@ struct Texture
 		// Par exemple, si on a 6 niveaux, donc 0 à 5, alors on passe 5.
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
 		result.numLevels = numLevels;
+		glResources.setSize(GLResourceType::Texture, result.id, estimateTextureBytes(GL_RGBA, result.size, numLevels));
 
 		return result;
 	}
 
 	// Créer une texture de 1 pixel d'une couleur donnée.
-	static Texture createFromColor(vec4 color) {
+	static Texture createFromColor(vec4 color, std::source_location where = std::source_location::current()) {
 		Texture tex = {};
 		tex.size = {1, 1};
 		tex.numLevels = 1;
 		glGenTextures(1, &tex.id);
-		glBindTexture(GL_TEXTURE_2D, tex.id);
+		glResources.track(GLResourceType::Texture, tex.id, std::format("couleur ({}, {}, {}, {})", color.r, color.g, color.b, color.a), where);
+		glState.bindTexture(GL_TEXTURE_2D, tex.id);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, &color);
+		glResources.setSize(GLResourceType::Texture, tex.id, 4);
 		return tex;
 	}
 };
@@ -0,0 +1,165 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <source_location>
+#include <stdexcept>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "utils.hpp"
+#include "BufferLayout.hpp"
+#include "GLStateCache.hpp"
+
+
+using namespace gl;
+
+
+// Une portion d'un tampon uniforme qu'on lie à un index de liaison avec glBindBufferRange (plutôt que tout le tampon avec glBindBufferBase).
+struct UniformBufferRange
+{
+	GLuint buffer = 0;
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+
+	void bind(GLuint bindingIndex) const {
+		glState.bindBufferRange(GL_UNIFORM_BUFFER, bindingIndex, buffer, offset, size);
+	}
+};
+
+// Un anneau de tampon uniforme dans lequel on sous-alloue les blocs uniformes de chaque dessin (matériau, lumière, matrices d'un objet, etc.).
+// Le problème avec un glBufferSubData sur un seul UBO, c'est que les dessins de la trame précédente qui sont encore en cours sur le GPU lisent le même tampon. Le pilote doit donc attendre qu'ils soient terminés (ou copier le tampon en cachette) avant de faire la mise à jour.
+// Ici, on a un gros tampon découpé en une région par trame « en vol ». Pendant une trame, on écrit seulement dans sa région, à des décalages toujours nouveaux. Une clôture (glFenceSync) posée à la fin de la trame nous dit quand le GPU a fini de lire la région et qu'on peut la réutiliser.
+class UniformBufferRing
+{
+public:
+	GLuint getBuffer() const { return buffer_; }
+	GLsizeiptr getBytesPerFrame() const { return regionSize_; }
+	int getNumFramesInFlight() const { return (int)fences_.size(); }
+	GLint getOffsetAlignment() const { return offsetAlignment_; }
+	bool isPersistentlyMapped() const { return mappedPtr_ != nullptr; }
+	// Nombre d'octets alloués dans la trame courante.
+	GLsizeiptr getBytesUsed() const { return cursor_; }
+
+	// Créer le tampon. Il faut avoir au moins autant de régions que de trames que le pilote peut mettre en file (généralement 2 ou 3).
+	void setup(GLsizeiptr bytesPerFrame = 1 << 20, int numFramesInFlight = 3, std::source_location where = std::source_location::current()) {
+		if (buffer_ != 0)
+			deleteObjects();
+
+		// Les décalages passés à glBindBufferRange doivent être des multiples de cette valeur (souvent 256 octets, parfois 16 ou 64).
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment_);
+		regionSize_ = alignUp(bytesPerFrame, offsetAlignment_);
+		fences_.assign(numFramesInFlight, nullptr);
+		currentRegion_ = 0;
+		cursor_ = 0;
+
+		GLsizeiptr totalSize = regionSize_ * numFramesInFlight;
+		glGenBuffers(1, &buffer_);
+		glResources.track(GLResourceType::Buffer, buffer_, "UniformBufferRing", where);
+		glResources.setSize(GLResourceType::Buffer, buffer_, totalSize);
+		glState.bindBuffer(GL_UNIFORM_BUFFER, buffer_);
+
+		// Avec OpenGL 4.4 (ou l'extension ARB_buffer_storage), on crée un stockage immuable qu'on garde mappé en permanence. On écrit alors directement dans la mémoire vue par le GPU, sans appel OpenGL par allocation.
+		if (isGLVersionAtLeast(4, 4) or isGLExtensionSupported("GL_ARB_buffer_storage")) {
+			auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_UNIFORM_BUFFER, totalSize, nullptr, flags);
+			mappedPtr_ = (uint8_t*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, totalSize, flags);
+		} else {
+			// Sinon (macOS par exemple est limité à 4.1), on a un tampon normal et on mappe chaque allocation sans synchronisation. C'est sécuritaire parce que nos clôtures garantissent déjà que le GPU ne lit plus la région.
+			glBufferData(GL_UNIFORM_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+			mappedPtr_ = nullptr;
+		}
+	}
+
+	// À appeler au début de chaque trame, avant la première allocation.
+	void beginFrame() {
+		currentRegion_ = (currentRegion_ + 1) % fences_.size();
+		cursor_ = 0;
+
+		// Attendre (normalement pas du tout) que le GPU ait fini la trame qui utilisait cette région.
+		GLsync& fence = fences_[currentRegion_];
+		if (fence != nullptr) {
+			GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			while (status == GL_TIMEOUT_EXPIRED)
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	// À appeler à la fin de chaque trame, après le dernier dessin qui utilise les allocations.
+	void endFrame() {
+		GLsync& fence = fences_[currentRegion_];
+		if (fence != nullptr)
+			glDeleteSync(fence);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT);
+	}
+
+	// Copier des données dans la région de la trame courante et retourner la portion à lier.
+	// En std140, la taille d'un bloc (GL_UNIFORM_BLOCK_DATA_SIZE) est arrondie à un multiple de 16 octets : un bloc de 68 octets en occupe 80. La portion liée doit couvrir toute cette taille, sinon le pilote peut refuser le dessin (GL_INVALID_OPERATION) ou lire au-delà. On réserve et on lie donc la taille arrondie; les octets de rembourrage à la fin ne sont jamais lus.
+	UniformBufferRange allocate(const void* data, GLsizeiptr size) {
+		GLsizeiptr offsetInRegion = alignUp(cursor_, offsetAlignment_);
+		GLsizeiptr boundSize = alignUp(size, std140BlockAlignment);
+		if (offsetInRegion + boundSize > regionSize_) {
+			throw std::runtime_error(std::format(
+				"UniformBufferRing: {} octets par trame ne suffisent pas (demandé {} de plus)",
+				regionSize_, boundSize
+			));
+		}
+		cursor_ = offsetInRegion + boundSize;
+
+		UniformBufferRange range = {buffer_, (GLintptr)currentRegion_ * regionSize_ + offsetInRegion, boundSize};
+		if (mappedPtr_ != nullptr) {
+			std::memcpy(mappedPtr_ + range.offset, data, size);
+		} else {
+			glState.bindBuffer(GL_UNIFORM_BUFFER, buffer_);
+			auto flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+			void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, range.offset, boundSize, flags);
+			std::memcpy(dst, data, size);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+		}
+		return range;
+	}
+
+	template <typename T>
+	UniformBufferRange allocate(const T& value) {
+		static_assert(isStd140Copyable_v<T>, "Le type doit être copiable tel quel dans un bloc std140 (pas de pointeurs, de bool ni de conteneurs)");
+		return allocate(&value, sizeof(T));
+	}
+
+	void deleteObjects() {
+		for (auto& fence : fences_) {
+			if (fence != nullptr)
+				glDeleteSync(fence);
+			fence = nullptr;
+		}
+		if (mappedPtr_ != nullptr) {
+			glState.bindBuffer(GL_UNIFORM_BUFFER, buffer_);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			mappedPtr_ = nullptr;
+		}
+		glState.deleteBuffers(1, &buffer_);
+		buffer_ = 0;
+	}
+
+private:
+	static constexpr GLsizeiptr std140BlockAlignment = 16;
+
+	static GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	GLuint buffer_ = 0;
+	uint8_t* mappedPtr_ = nullptr;
+	GLint offsetAlignment_ = 256;
+	GLsizeiptr regionSize_ = 0;
+	size_t currentRegion_ = 0;
+	GLsizeiptr cursor_ = 0;
+	std::vector<GLsync> fences_; // Une clôture par région (donc par trame en vol).
+};
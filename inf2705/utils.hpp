@@ -9,12 +9,18 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <type_traits>
 
-#include <glbinding/gl/enum.h>
+#include <glbinding/gl/gl.h>
+
+#include "AssetPack.hpp"
 
 
 inline std::string readFile(std::string_view filename) {
+	// Si le fichier est dans un paquet de ressources monté (voir AssetPack.hpp), on le prend là plutôt que sur le disque.
+	if (auto data = assetPacks.find(filename))
+		return std::string((const char*)data->data(), data->size());
 	// Ouvrir le fichier
 	std::ifstream file(filename.data());
 	file.exceptions(std::ios::failbit);
@@ -45,6 +51,31 @@ inline std::string replaceAll(std::string str, const std::string& oldSubStr, con
 	return str;
 }
 
+// Vérifier que le contexte OpenGL actuel est d'une version au moins égale à major.minor (par exemple 4.4 pour glBufferStorage).
+inline bool isGLVersionAtLeast(int major, int minor) {
+	using namespace gl;
+
+	GLint ctxMajor = 0;
+	GLint ctxMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &ctxMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &ctxMinor);
+	return ctxMajor > major or (ctxMajor == major and ctxMinor >= minor);
+}
+
+// Vérifier que le contexte OpenGL actuel supporte une extension donnée (par exemple "GL_ARB_buffer_storage").
+inline bool isGLExtensionSupported(std::string_view name) {
+	using namespace gl;
+
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; i++) {
+		auto ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext != nullptr and name == ext)
+			return true;
+	}
+	return false;
+}
+
 template <typename T>
 inline constexpr gl::GLenum getTypeGLenum() {
 	using namespace gl;